@@ -230,6 +230,15 @@ class Blob {
   void Update();
   void FromProto(const BlobProto& proto, bool reshape = true);
   void ToProto(BlobProto* proto, bool write_diff = false) const;
+  /**
+   * @brief Like ToProto, but writes the values in bulk to raw_data and
+   *        raw_diff instead of the repeated fields.
+   *
+   * Only readers that know the raw fields (FromProto and pycaffe in this
+   * version) can load the result, so use it only for formats that no other
+   * reader opens, such as the chunks of a SnapshotStore.
+   */
+  void ToRawProto(BlobProto* proto, bool write_diff = false) const;
 
   /// @brief Compute the sum of absolute values (L1 norm) of the data.
   Dtype asum_data() const;
@@ -263,6 +272,15 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Set the data_ shared_ptr to point to the given SyncedMemory, which
+   *        must hold at least count() elements -- useful for letting the
+   *        activations of nets that never run at the same time use the same
+   *        memory.
+   *
+   * Later reshapes keep using it as long as the Blob fits in it.
+   */
+  void ShareDataMemory(const shared_ptr<SyncedMemory>& data);
 
   bool ShapeEquals(const BlobProto& other);
 
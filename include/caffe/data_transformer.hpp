@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/philox.hpp"
 
 namespace caffe {
 
@@ -143,7 +144,7 @@ class DataTransformer {
   TransformationParameter param_;
 
 
-  shared_ptr<Caffe::RNG> rng_;
+  shared_ptr<Philox> rng_;
   Phase phase_;
   Blob<Dtype> data_mean_;
   vector<Dtype> mean_values_;
@@ -38,7 +38,7 @@ class Layer {
    * layer.
    */
   explicit Layer(const LayerParameter& param)
-      : layer_param_(param) {
+      : layer_param_(param), recomputing_(false) {
     // Set phase and copy blobs (if there are any).
     phase_ = param.phase();
     if (layer_param_.blobs_size() > 0) {
@@ -269,6 +269,27 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Return whether Forward may be run a second time on the same
+   *        bottoms to recompute the tops, as done by activation checkpointing.
+   *
+   * While recomputing, recomputing() is set so that layers can replay their
+   * random draws and skip updates of internal state. Layers that cannot do so
+   * should return false; the net then always keeps their tops.
+   */
+  virtual inline bool AllowRecompute() const { return true; }
+
+  /**
+   * @brief Returns whether the coming Forward calls recompute tops that were
+   *        already computed for the current batch.
+   */
+  inline bool recomputing() const { return recomputing_; }
+  /**
+   * @brief Sets whether the coming Forward calls recompute tops that were
+   *        already computed for the current batch.
+   */
+  inline void set_recomputing(const bool value) { recomputing_ = value; }
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
@@ -291,6 +312,31 @@ class Layer {
     param_propagate_down_[param_id] = value;
   }
 
+  /**
+   * @brief Returns the rows (along the first axis) of the param_id-th param
+   *        blob whose diff the last Backward accumulated into, or NULL if it
+   *        may have accumulated into the whole diff.
+   *
+   * Layers with row-sparse parameter gradients, such as EmbedLayer, override
+   * this so that the net and the solvers can clear and update only the rows
+   * an iteration touched. Whether the result is NULL must not change after
+   * SetUp. Rows may repeat and only cover CPU backward passes.
+   */
+  virtual inline const vector<int>* param_diff_rows(const int param_id) const {
+    return NULL;
+  }
+
+  /**
+   * @brief Returns the internal Blob%s whose contents are only needed within
+   *        a single Forward or Backward call, such as an im2col buffer.
+   *
+   * A Net may let these share memory with another net that never runs at the
+   * same time (see Net::ShareActivationsWith).
+   */
+  virtual inline vector<Blob<Dtype>*> scratch_blobs() {
+    return vector<Blob<Dtype>*>();
+  }
+
 
  protected:
   /** The protobuf that stores the layer parameters */
@@ -306,6 +352,9 @@ class Layer {
    *  the objective function. */
   vector<Dtype> loss_;
 
+  /** Whether Forward is recomputing tops for activation checkpointing. */
+  bool recomputing_;
+
   /** @brief Using the CPU device, compute the layer output. */
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) = 0;
@@ -7,6 +7,8 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/packed_gemm.hpp"
+#include "caffe/util/sparse_weights.hpp"
 
 namespace caffe {
 
@@ -27,6 +29,9 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
+  virtual inline vector<Blob<Dtype>*> scratch_blobs() {
+    return vector<Blob<Dtype>*>(1, &col_buffer_);
+  }
 
  protected:
   // Helper functions that abstract away the column buffer and gemm arguments.
@@ -40,6 +45,14 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // Direct counterparts of the CPU gemm helpers, used when direct_grouped_
+  // is set. They process all num_ images of the batch at once.
+  void forward_cpu_direct(const Dtype* input, const Dtype* weights,
+      Dtype* output);
+  void backward_cpu_direct(const Dtype* output, const Dtype* weights,
+      Dtype* input);
+  void weight_cpu_direct(const Dtype* input, const Dtype* output,
+      Dtype* weights);
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -92,6 +105,15 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief Whether the CPU path convolves directly instead of by GEMM.
+  bool direct_grouped_;
+  /// @brief The widest group (input channels per group) convolved directly.
+  static const int kDirectGroupWidth = 2;
+  /// @brief The weights of each group in packed form, if
+  ///        convolution_param.pack_weights is set.
+  vector<shared_ptr<PackedGemm<Dtype> > > packed_weights_;
+  /// @brief The CSR weights, if convolution_param.sparse_threshold is set.
+  shared_ptr<SparseWeights<Dtype> > sparse_weights_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
 
 namespace caffe {
 
@@ -42,6 +43,9 @@ class EltwiseLayer : public Layer<Dtype> {
   EltwiseParameter_EltwiseOp op_;
   vector<Dtype> coeffs_;
   Blob<int> max_idx_;
+  /// The CPU argmax as a one byte bottom index, used instead of max_idx_ for
+  /// up to 256 bottoms.
+  shared_ptr<SyncedMemory> max_bottom_idx_;
 
   bool stable_prod_grad_;
 };
@@ -14,6 +14,10 @@ namespace caffe {
  *        Equivalent to an InnerProductLayer with one-hot vectors as input, but
  *        for efficiency the input is the "hot" index of each column itself.
  *
+ * With sparse_gradient set, the weight gradient is reported as row-sparse
+ * (see Layer::param_diff_rows), so that solvers only touch the rows of the
+ * inputs seen by an iteration.
+ *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
 template <typename Dtype>
@@ -29,6 +33,9 @@ class EmbedLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Embed"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  virtual inline const vector<int>* param_diff_rows(const int param_id) const {
+    return (sparse_gradient_ && param_id == 0) ? &diff_rows_ : NULL;
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -45,6 +52,9 @@ class EmbedLayer : public Layer<Dtype> {
   int N_;
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
+  bool sparse_gradient_;
+  /// the weight rows accumulated into by the last Backward_cpu
+  vector<int> diff_rows_;
 };
 
 }  // namespace caffe
@@ -7,20 +7,26 @@
 #include <vector>
 
 #include "caffe/blob.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 #include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/blocking_queue.hpp"
 
 namespace caffe {
 
 /**
  * @brief Provides data to the Net from HDF5 files.
  *
+ * Files, or chunks of hdf5_data_param.chunk_size rows of them, are read on
+ * a background thread while the previous one is output, so that the net
+ * does not wait for them at file boundaries.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
-class HDF5DataLayer : public Layer<Dtype> {
+class HDF5DataLayer : public Layer<Dtype>, public InternalThread {
  public:
   explicit HDF5DataLayer(const LayerParameter& param)
       : Layer<Dtype>(param), offset_() {}
@@ -36,8 +42,18 @@ class HDF5DataLayer : public Layer<Dtype> {
   virtual inline int MinTopBlobs() const { return 1; }
 
  protected:
+  // Rows of a file, one blob per top, and the order they are output in.
+  struct Chunk {
+    std::vector<shared_ptr<Blob<Dtype> > > blobs;
+    std::vector<unsigned int> permutation;
+  };
+
   void Next();
-  bool Skip();
+  bool Skip() const { return Skip(offset_); }
+  bool Skip(uint64_t offset) const;
+  // The number of rows, up to max_rows, to be output from current_row_ on
+  // that are stored one after the other, and can be copied at once.
+  int ContiguousRows(int max_rows) const;
 
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -47,16 +63,34 @@ class HDF5DataLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
-  virtual void LoadHDF5FileData(const char* filename);
+  virtual void InternalThreadEntry();
+  // Loads the rows of filename from start on into chunk, and returns the
+  // number of rows of the file.
+  virtual hsize_t LoadHDF5FileData(const char* filename, hsize_t start,
+      Chunk* chunk);
+  // Loads the next chunk of the files, in order.
+  void LoadChunk(Chunk* chunk);
+  // The most rows a chunk of the files holds.
+  int MaxChunkRows();
+  // Allocates the chunks, and grows hdf_blobs_, for rows rows, so that
+  // loading chunks never reallocates them.
+  void AllocateChunks(int rows);
 
   std::vector<std::string> hdf_filenames_;
   unsigned int num_files_;
+  // The file, and row of it, the next chunk is loaded from.
   unsigned int current_file_;
+  hsize_t file_row_;
+  // The chunk being output, and the row of it to output next.
   hsize_t current_row_;
   std::vector<shared_ptr<Blob<Dtype> > > hdf_blobs_;
   std::vector<unsigned int> data_permutation_;
   std::vector<unsigned int> file_permutation_;
   uint64_t offset_;
+  // The chunks read ahead, by index.
+  std::vector<shared_ptr<Chunk> > chunks_;
+  BlockingQueue<int> free_chunks_;
+  BlockingQueue<int> full_chunks_;
 };
 
 }  // namespace caffe
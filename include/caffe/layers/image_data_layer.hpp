@@ -11,6 +11,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/image_cache.hpp"
 
 namespace caffe {
 
@@ -36,9 +37,16 @@ class ImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
   shared_ptr<Caffe::RNG> prefetch_rng_;
   virtual void ShuffleImages();
   virtual void load_batch(Batch<Dtype>* batch);
+#ifdef USE_OPENCV
+  // Reads an image, from cache_ if it is there. The image may refer to
+  // cache_buffer_, until the next call.
+  cv::Mat ReadImage(const string& filename);
+#endif  // USE_OPENCV
 
   vector<std::pair<std::string, int> > lines_;
   int lines_id_;
+  shared_ptr<ImageCache> cache_;
+  string cache_buffer_;
 };
 
 
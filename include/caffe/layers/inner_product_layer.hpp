@@ -6,6 +6,8 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/packed_gemm.hpp"
+#include "caffe/util/sparse_weights.hpp"
 
 namespace caffe {
 
@@ -45,6 +47,10 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+  /// The weights in packed form, if inner_product_param.pack_weights is set.
+  shared_ptr<PackedGemm<Dtype> > packed_weights_;
+  /// The CSR weights, if inner_product_param.sparse_threshold is set.
+  shared_ptr<SparseWeights<Dtype> > sparse_weights_;
 };
 
 }  // namespace caffe
@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
 
 namespace caffe {
 
@@ -53,6 +54,10 @@ class PoolingLayer : public Layer<Dtype> {
   bool global_pooling_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
+  /// The CPU max pooling argmax as a one byte index into the pooling window,
+  /// used instead of max_idx_ when the window has fewer than 256 elements.
+  shared_ptr<SyncedMemory> max_window_idx_;
+  bool use_window_idx_;
 };
 
 }  // namespace caffe
@@ -10,6 +10,19 @@ namespace bp = boost::python;
 
 namespace caffe {
 
+// Holds the GIL for its scope, so that Python code may run from threads
+// that released it, such as pycaffe forward and backward passes.
+class ScopedGILAcquire {
+ public:
+  ScopedGILAcquire() : state_(PyGILState_Ensure()) { }
+  ~ScopedGILAcquire() { PyGILState_Release(state_); }
+
+ private:
+  PyGILState_STATE state_;
+
+  DISABLE_COPY_AND_ASSIGN(ScopedGILAcquire);
+};
+
 template <typename Dtype>
 class PythonLayer : public Layer<Dtype> {
  public:
@@ -24,6 +37,7 @@ class PythonLayer : public Layer<Dtype> {
         && !Caffe::multiprocess()) {
       LOG(FATAL) << "PythonLayer does not support CLI Multi-GPU, use train.py";
     }
+    ScopedGILAcquire gil;
     self_.attr("param_str") = bp::str(
         this->layer_param_.python_param().param_str());
     self_.attr("phase") = static_cast<int>(this->phase_);
@@ -31,18 +45,23 @@ class PythonLayer : public Layer<Dtype> {
   }
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    ScopedGILAcquire gil;
     self_.attr("reshape")(bottom, top);
   }
 
   virtual inline const char* type() const { return "Python"; }
+  // The Python forward may hold arbitrary state, so it is never rerun.
+  virtual inline bool AllowRecompute() const { return false; }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    ScopedGILAcquire gil;
     self_.attr("forward")(bottom, top);
   }
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    ScopedGILAcquire gil;
     self_.attr("backward")(top, propagate_down, bottom);
   }
 
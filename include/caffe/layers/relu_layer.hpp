@@ -23,9 +23,14 @@ class ReLULayer : public NeuronLayer<Dtype> {
    *     with ReLULayer options:
    *   - negative_slope (\b optional, default 0).
    *     the value @f$ \nu @f$ by which negative values are multiplied.
+   *   - sign_mask (\b optional, default false).
+   *     store the sign of the input as a bit mask for the CPU backward pass
+   *     instead of reading the input again.
    */
   explicit ReLULayer(const LayerParameter& param)
       : NeuronLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "ReLU"; }
 
@@ -78,6 +83,9 @@ class ReLULayer : public NeuronLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// bit i is set iff @f$ x_i > 0 @f$ (only with sign_mask)
+  Blob<unsigned int> sign_mask_;
 };
 
 }  // namespace caffe
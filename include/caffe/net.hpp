@@ -53,6 +53,12 @@ class Net {
    * extra computation on unrelated branches, and (2) computation starting in
    * the middle may be incorrect if all of the layers of a fan-in are not
    * included.
+   *
+   * With activation checkpointing (see LayerParameter.checkpoint), the tops
+   * computed inside a checkpoint segment are released once the forward pass
+   * has run through the segment, and BackwardFromTo recomputes them from the
+   * preceding checkpoint before the segment's first backward step. Such
+   * activations are thus not available for inspection after Forward.
    */
   Dtype ForwardFromTo(int start, int end);
   Dtype ForwardFrom(int start);
@@ -107,6 +113,21 @@ class Net {
    *        additional memory) the pre-trained layers from another Net.
    */
   void ShareTrainedLayersWith(const Net* other);
+  /**
+   * @brief For an already initialized net, copies the pre-trained layers from
+   *        another Net into this net's own parameter memory, so that later
+   *        updates to the other Net leave this one unchanged.
+   */
+  void CopyTrainedLayersFrom(const Net* other);
+  /**
+   * @brief Lets the activations and layer scratch buffers of this net and
+   *        other use the same memory, pairing blobs of similar size.
+   *
+   * The two nets must never run at the same time, e.g. a test net that is
+   * only tested between iterations of the train net. Tops of layers without
+   * bottoms (data and input layers) keep their own memory.
+   */
+  void ShareActivationsWith(Net* other);
   // For an already initialized net, CopyTrainedLayersFrom() copies the already
   // trained layers from another net parameter instance.
   /**
@@ -190,6 +211,23 @@ class Net {
   inline const vector<bool>& has_params_decay() const {
     return has_params_decay_;
   }
+  /**
+   * @brief returns the rows (along the first axis) of learnable param
+   *        param_id whose diff may be nonzero, or NULL if any may be.
+   *
+   * Rows are tracked on the CPU for the params whose layers all report
+   * row-sparse gradients (see Layer::param_diff_rows), from one
+   * ClearParamDiffs to the next; they are sorted and unique. ClearParamDiffs
+   * and Update then only visit those rows, and so do the solvers.
+   */
+  const vector<int>* learnable_param_diff_rows(const int param_id) const;
+  /**
+   * @brief replaces the rows whose diff may be nonzero until the next
+   *        ClearParamDiffs, e.g. after the diff was overwritten by an
+   *        all-reduce; rows is sorted and unique, or NULL if any may be.
+   */
+  void set_learnable_param_diff_rows(const int param_id,
+      const vector<int>* rows);
   const map<string, int>& param_names_index() const {
     return param_names_index_;
   }
@@ -218,6 +256,8 @@ class Net {
   const shared_ptr<Layer<Dtype> > layer_by_name(const string& layer_name) const;
 
   void set_debug_info(const bool value) { debug_info_ = value; }
+  /// @brief returns whether activation checkpointing releases any blobs
+  inline bool has_checkpoints() const { return !segment_end_.empty(); }
 
   // Helpers for Init.
   /**
@@ -269,6 +309,19 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Helper for Init: find the learnable params with row-sparse diffs.
+  void InitSparseParams();
+  /// @brief Helper for Backward: collect the diff rows layer_id touched.
+  void AppendDiffRows(const int layer_id);
+  /// @brief Helper for Init: choose the activation checkpoint segments.
+  void InitCheckpoints(const NetParameter& param);
+  /// @brief Run the forward pass of one layer along with its callbacks.
+  Dtype ForwardLayer(const int layer_id);
+  /// @brief Release the activations of the segment ending at layer end.
+  void ReleaseSegment(const int end);
+  /// @brief Helper for ShareActivationsWith: collect the shareable blobs.
+  void AppendShareableBlobs(vector<Blob<Dtype>*>* shareable);
+
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -329,10 +382,24 @@ class Net {
   /// the weight decay multipliers for learnable_params_
   vector<float> params_weight_decay_;
   vector<bool> has_params_decay_;
+  /// Whether each learnable param has a row-sparse diff, the rows its diff
+  /// may be nonzero in, and whether those rows are currently known, which
+  /// takes a dense clear on the CPU first.
+  vector<bool> learnable_param_sparse_;
+  vector<vector<int> > learnable_param_diff_rows_;
+  vector<bool> learnable_param_rows_known_;
   /// The bytes of memory used by this net
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Activation checkpointing: the first and last layer of the segment of
+  /// each layer, and for each segment (indexed by its last layer) the blobs
+  /// it releases and whether they currently await recomputation. Empty when
+  /// checkpointing is off.
+  vector<int> segment_start_;
+  vector<int> segment_end_;
+  vector<vector<int> > segment_release_blobs_;
+  vector<bool> segment_released_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
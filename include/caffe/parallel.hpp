@@ -1,8 +1,6 @@
 #ifndef CAFFE_PARALLEL_HPP_
 #define CAFFE_PARALLEL_HPP_
 
-#ifdef USE_NCCL
-
 #include <boost/thread.hpp>
 
 #include <string>
@@ -16,6 +14,7 @@
 #include "caffe/solver.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/gradient_compression.hpp"
 #include "caffe/util/nccl.hpp"
 
 namespace caffe {
@@ -48,6 +47,81 @@ class Params {
 DISABLE_COPY_AND_ASSIGN(Params);
 };
 
+// Params stored in host memory.
+template<typename Dtype>
+class CPUParams : public Params<Dtype> {
+ public:
+  explicit CPUParams(shared_ptr<Solver<Dtype> > root_solver);
+  virtual ~CPUParams();
+
+  void Configure(Solver<Dtype>* solver) const;
+
+ protected:
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
+/**
+ * Data-parallel training on the CPU, with one solver per thread. Every
+ * iteration, each solver encodes its gradient with the solver's
+ * gradient_compression method into a message in shared memory, and replaces
+ * it with the average of all the decoded messages, as a compressed
+ * all-gather would.
+ *
+ * With a local_sgd_period K > 1, the gradients are only averaged for the
+ * local_sgd_warmup first iterations. The solvers then update their own
+ * weights, which are averaged every K iterations instead, with the solver
+ * history if local_sgd_average_history.
+ */
+template<typename Dtype>
+class CPUSync : public CPUParams<Dtype>,
+                public Solver<Dtype>::Callback {
+ public:
+  explicit CPUSync(shared_ptr<Solver<Dtype> > solver);
+
+  /**
+   * Connects instances created for the same group, indexed by solver rank.
+   */
+  static void InitSingleProcess(vector<CPUSync<Dtype>*>* syncs,
+                                boost::barrier* barrier);
+
+  /**
+   * Broadcast weights from rank 0 to the other solvers.
+   */
+  void Broadcast();
+
+  /**
+   * Single process, one solver thread per worker.
+   */
+  void Run(int workers, const char* restore);
+
+ protected:
+  void on_start() {}
+  void on_gradients_ready();
+  void on_update_applied();
+  // Whether the current iteration is past the local SGD warmup
+  bool local_step() const;
+  // The solver's history blobs if they are to be averaged, or NULL
+  const vector<shared_ptr<Blob<Dtype> > >* averaged_history() const;
+
+  shared_ptr<Solver<Dtype> > solver_;
+  shared_ptr<GradientCompressor<Dtype> > compressor_;
+  string message_;              // This solver's encoded gradient
+  vector<Dtype> reduced_;       // Average of the group's gradients or weights
+  vector<Dtype> history_reduced_;  // Average of the group's solver history
+  vector<vector<int> > diff_rows_;  // Union of the group's gradient rows
+  vector<bool> diff_rows_known_;
+  const vector<CPUSync<Dtype>*>* syncs_;
+  boost::barrier* barrier_;
+  int stats_iters_;             // Iterations since the stats were logged
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
+#ifdef USE_NCCL
+
 // Params stored in GPU memory.
 template<typename Dtype>
 class GPUParams : public Params<Dtype> {
@@ -117,7 +191,8 @@ class NCCL : public GPUParams<Dtype>,
   using Params<Dtype>::diff_;
 };
 
+#endif  // USE_NCCL
+
 }  // namespace caffe
 
-#endif  // USE_NCCL
 #endif  // header
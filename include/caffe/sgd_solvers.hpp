@@ -31,11 +31,21 @@ class SGDSolver : public Solver<Dtype> {
   virtual void Regularize(int param_id);
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
   virtual void ClipGradients();
+  // Fills offsets with the segments of param param_id's diff that the update
+  // visits and returns their length: on the CPU, the rows a row-sparse diff
+  // may be nonzero in (see Net::learnable_param_diff_rows), so that momentum,
+  // decay and moments of the other rows are updated lazily; otherwise the
+  // whole blob, as a single segment.
+  int DiffSegments(int param_id, vector<int>* offsets) const;
+  // Segments shorter than this are not worth splitting across threads.
+  static const int kMinParallelSegment = 4096;
   virtual void SnapshotSolverState(const string& model_filename);
   virtual void SnapshotSolverStateToBinaryProto(const string& model_filename);
   virtual void SnapshotSolverStateToHDF5(const string& model_filename);
+  virtual void SnapshotSolverStateToStore(const string& model_filename);
   virtual void RestoreSolverStateFromHDF5(const string& state_file);
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file);
+  virtual void RestoreSolverStateFromStore(const string& state_file);
   // history maintains the historical momentum data.
   // update maintains update related data and is not needed in snapshots.
   // temp maintains other information that might be needed in computation
@@ -143,6 +153,59 @@ class AdamSolver : public SGDSolver<Dtype> {
   DISABLE_COPY_AND_ASSIGN(AdamSolver);
 };
 
+/**
+ * @brief LARSSolver, SGD with momentum where each parameter blob's learning
+ *        rate is scaled by a layer-wise trust ratio, for training with large
+ *        batches. Described in [1].
+ *
+ * The trust ratio is trust_coefficient * ||w|| / ||g||, where g is the
+ * gradient including weight decay, or 1 when either norm is zero.
+ *
+ * [1] Y. You, I. Gitman and B. Ginsburg, "Large Batch Training of
+ *     Convolutional Networks." arXiv preprint arXiv:1708.03888 (2017).
+ */
+template <typename Dtype>
+class LARSSolver : public SGDSolver<Dtype> {
+ public:
+  explicit LARSSolver(const SolverParameter& param)
+      : SGDSolver<Dtype>(param) {}
+  explicit LARSSolver(const string& param_file)
+      : SGDSolver<Dtype>(param_file) {}
+  virtual inline const char* type() const { return "LARS"; }
+
+ protected:
+  virtual void ComputeUpdateValue(int param_id, Dtype rate);
+
+  DISABLE_COPY_AND_ASSIGN(LARSSolver);
+};
+
+/**
+ * @brief LAMBSolver, Adam with decoupled weight decay where each parameter
+ *        blob's step is scaled by the layer-wise trust ratio ||w|| / ||r||
+ *        of its weights to its Adam direction r. Described in [1].
+ *
+ * [1] Y. You et al., "Large Batch Optimization for Deep Learning: Training
+ *     BERT in 76 minutes." arXiv preprint arXiv:1904.00962 (2019).
+ */
+template <typename Dtype>
+class LAMBSolver : public SGDSolver<Dtype> {
+ public:
+  explicit LAMBSolver(const SolverParameter& param)
+      : SGDSolver<Dtype>(param) { LAMBPreSolve(); }
+  explicit LAMBSolver(const string& param_file)
+      : SGDSolver<Dtype>(param_file) { LAMBPreSolve(); }
+  virtual inline const char* type() const { return "LAMB"; }
+
+ protected:
+  void LAMBPreSolve();
+  // Weight decay is applied to the Adam direction in ComputeUpdateValue
+  // rather than added to the gradient.
+  virtual void Regularize(int param_id) {}
+  virtual void ComputeUpdateValue(int param_id, Dtype rate);
+
+  DISABLE_COPY_AND_ASSIGN(LAMBSolver);
+};
+
 }  // namespace caffe
 
 #endif  // CAFFE_SGD_SOLVERS_HPP_
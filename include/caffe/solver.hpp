@@ -4,9 +4,12 @@
 #include <string>
 #include <vector>
 
+#include "caffe/internal_thread.hpp"
 #include "caffe/net.hpp"
 #include "caffe/solver_factory.hpp"
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/snapshot_store.hpp"
 
 namespace caffe {
 
@@ -57,6 +60,10 @@ class Solver {
   virtual void Solve(const char* resume_file = NULL);
   inline void Solve(const string resume_file) { Solve(resume_file.c_str()); }
   void Step(int iters);
+  // With test_async, blocks until every background evaluation queued so far
+  // has been reported. Solve does so before returning; callers of Step that
+  // need the results should too.
+  void WaitForAsyncTests();
   // The Restore method simply dispatches to one of the
   // RestoreSolverStateFrom___ protected methods. You should implement these
   // methods to restore the state from the appropriate snapshot type.
@@ -66,7 +73,7 @@ class Solver {
   // function that produces a SolverState protocol buffer that needs to be
   // written to disk together with the learned net.
   void Snapshot();
-  virtual ~Solver() {}
+  virtual ~Solver();
   inline const SolverParameter& param() const { return param_; }
   inline shared_ptr<Net<Dtype> > net() { return net_; }
   inline const vector<shared_ptr<Net<Dtype> > >& test_nets() {
@@ -79,6 +86,8 @@ class Solver {
    protected:
     virtual void on_start() = 0;
     virtual void on_gradients_ready() = 0;
+    // After the update is applied, before the iteration count is incremented
+    virtual void on_update_applied() {}
 
     template <typename T>
     friend class Solver;
@@ -100,12 +109,25 @@ class Solver {
   string SnapshotFilename(const string extension);
   string SnapshotToBinaryProto();
   string SnapshotToHDF5();
+  string SnapshotToStore();
+  // The store of CHUNKED snapshots, created on first use
+  SnapshotStore* snapshot_store();
   // The test routine
   void TestAll();
   void Test(const int test_net_id = 0);
+  // Runs test_iter forward passes of test_net, whose weights were taken at
+  // iteration iter, and logs the averaged outputs. Only an interruptible
+  // (foreground) test polls the action function. Background tests call it
+  // from their own threads.
+  virtual void TestNet(Net<Dtype>* test_net, const int test_net_id, const int iter,
+      const bool interruptible);
+  // With test_async, TestAll hands a copy of the current weights to an idle
+  // background tester and returns.
+  void TestAllAsync();
   virtual void SnapshotSolverState(const string& model_filename) = 0;
   virtual void RestoreSolverStateFromHDF5(const string& state_file) = 0;
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file) = 0;
+  virtual void RestoreSolverStateFromStore(const string& state_file) = 0;
   void DisplayOutputBlobs(const int net_id);
   void UpdateSmoothedLoss(Dtype loss, int start_iter, int average_loss);
 
@@ -129,6 +151,32 @@ class Solver {
   Timer iteration_timer_;
   float iterations_last_;
 
+  shared_ptr<SnapshotStore> snapshot_store_;
+
+  // Evaluates test nets on a thread of its own. Each tester owns a replica of
+  // every test net (the first one uses test_nets_), with weights copied from
+  // the train net when an evaluation is queued rather than shared with it.
+  class AsyncTester : public InternalThread {
+   public:
+    AsyncTester(Solver* solver, const vector<shared_ptr<Net<Dtype> > >& nets,
+        int id) : solver_(solver), nets_(nets), id_(id) {}
+    virtual ~AsyncTester() { StopInternalThread(); }
+    const vector<shared_ptr<Net<Dtype> > >& nets() const { return nets_; }
+    // Queues an evaluation of the weights taken at iteration iter.
+    void Evaluate(int iter) { iters_.push(iter); }
+
+   protected:
+    virtual void InternalThreadEntry();
+
+    Solver* solver_;
+    vector<shared_ptr<Net<Dtype> > > nets_;
+    int id_;
+    BlockingQueue<int> iters_;
+  };
+  vector<shared_ptr<AsyncTester> > async_testers_;
+  // Ids of the testers that have no evaluation in flight.
+  BlockingQueue<int> idle_testers_;
+
   DISABLE_COPY_AND_ASSIGN(Solver);
 };
 
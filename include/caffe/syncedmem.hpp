@@ -65,9 +65,17 @@ class SyncedMemory {
   void set_gpu_data(void* data);
   void* mutable_cpu_data();
   void* mutable_gpu_data();
+  // Frees the owned host and device buffers; the next access allocates fresh
+  // zero-filled memory. Buffers borrowed through set_cpu_data/set_gpu_data
+  // are left in place.
+  void release();
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
+  // Bumped by every call that may change the contents (the mutable accessors,
+  // set_*_data and release), so that caches derived from the data can tell
+  // when they are stale.
+  size_t version() const { return version_; }
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -86,6 +94,7 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int device_;
+  size_t version_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
@@ -0,0 +1,58 @@
+#ifndef CAFFE_UTIL_CHANNEL_PRUNING_HPP_
+#define CAFFE_UTIL_CHANNEL_PRUNING_HPP_
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// The new (num_output, group) of the convolution_param of each Convolution
+// layer changed by pruning, by layer name.
+typedef std::map<string, std::pair<int, int> > PrunedConvolutions;
+
+/**
+ * @brief Removes the weakest output channels of the group 1 convolutions of
+ *        a trained net, and returns how many convolutions were pruned.
+ *
+ * The channels of every convolution, or of those named in layers, are
+ * ranked by the magnitude of the Scale (BatchNorm gamma) weights following
+ * it ("gamma"), by the L1 norm of its filters ("l1"), or by gamma when there
+ * is a Scale layer and L1 otherwise ("auto"). The fraction ratio of them is
+ * removed from the convolution and from every layer they flow through:
+ * BatchNorm, Scale, Bias, PReLU, element-wise activations, Dropout, Pooling,
+ * Depthwise and group == channels Convolution layers (keeping their
+ * multiplier), up to the Convolution or InnerProduct layers consuming them.
+ * Convolutions whose outputs reach anything else (e.g. Eltwise or Concat) are
+ * left untouched.
+ *
+ * The blobs of net are pruned in place, so net itself cannot run anymore:
+ * build the pruned net from its definition updated by
+ * UpdatePrunedConvolutions, with the weights of PrunedWeightsToProto.
+ */
+template <typename Dtype>
+int PruneChannels(Net<Dtype>* net, float ratio, const string& criterion,
+    const std::set<string>& layers, PrunedConvolutions* convolutions);
+
+/// @brief Applies the convolution_param changes of pruning to a definition
+///        of the net, such as its deploy or train_val prototxt.
+void UpdatePrunedConvolutions(const PrunedConvolutions& convolutions,
+    NetParameter* param);
+
+/// @brief Copies the pruned blobs of net into weights, a copy of the pruned
+///        definition param with the blobs of each layer.
+template <typename Dtype>
+void PrunedWeightsToProto(const Net<Dtype>& net, const NetParameter& param,
+    NetParameter* weights);
+
+/// @brief The multiply-adds of the convolutions and inner products of a net.
+template <typename Dtype>
+double MultiplyAdds(const Net<Dtype>& net);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CHANNEL_PRUNING_HPP_
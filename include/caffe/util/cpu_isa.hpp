@@ -0,0 +1,52 @@
+#ifndef CAFFE_UTIL_CPU_ISA_HPP_
+#define CAFFE_UTIL_CPU_ISA_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+// Kernels for specific x86 instruction sets are built with GCC's target
+// pragmas and attributes; other compilers and CPUs get the generic ones.
+#if defined(__GNUC__) && !defined(__clang__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_CPU_KERNELS_X86
+#endif
+
+namespace caffe {
+
+// The instruction set levels CPU kernels are compiled for, each one implying
+// the previous ones:
+//   sse4:        SSE4.1 and SSE4.2
+//   avx2:        AVX, AVX2 and FMA
+//   avx512:      AVX-512 F, BW, DQ and VL
+//   avx512_vnni: AVX-512 VNNI
+enum CpuIsa {
+  CPU_ISA_GENERIC = 0,
+  CPU_ISA_SSE4,
+  CPU_ISA_AVX2,
+  CPU_ISA_AVX512,
+  CPU_ISA_AVX512_VNNI,
+  CPU_ISA_COUNT
+};
+
+// Returns the highest level supported by both the CPU and the OS.
+CpuIsa DetectCpuIsa();
+
+const char* CpuIsaName(const CpuIsa isa);
+
+// Parses a name returned by CpuIsaName; returns false if it is unknown.
+bool CpuIsaFromName(const string& name, CpuIsa* isa);
+
+// Returns the level CPU kernels are picked for. It is detected the first
+// time it is needed (at the latest when Caffe is initialized) and can be
+// lowered with the CAFFE_CPU_ISA environment variable, e.g. CAFFE_CPU_ISA=sse4,
+// to run and test the kernels of a lower level.
+CpuIsa SelectedCpuIsa();
+
+// Changes the selected level, which must be supported by the CPU. Kernels
+// already picked by CpuKernel follow the change.
+void SetSelectedCpuIsa(const CpuIsa isa);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CPU_ISA_HPP_
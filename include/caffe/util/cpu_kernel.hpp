@@ -0,0 +1,112 @@
+#ifndef CAFFE_UTIL_CPU_KERNEL_HPP_
+#define CAFFE_UTIL_CPU_KERNEL_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/cpu_isa.hpp"
+
+namespace caffe {
+
+/**
+ * @brief The variants of the CPU kernels of one signature, keyed by name and
+ *        instruction set level.
+ *
+ * Each kernel is compiled once per level it has a variant for, usually in a
+ * translation unit per level, and registered with REGISTER_CPU_KERNEL. The
+ * signature (Function) includes the Dtype, so float and double kernels of the
+ * same name live in different registries. Every kernel needs a
+ * CPU_ISA_GENERIC variant to fall back to.
+ */
+template <typename Function>
+class CpuKernelRegistry {
+ public:
+  typedef std::map<CpuIsa, Function> Variants;
+  typedef std::map<string, Variants> KernelRegistry;
+
+  static KernelRegistry& Registry() {
+    static KernelRegistry* g_registry_ = new KernelRegistry();
+    return *g_registry_;
+  }
+
+  // Adds a variant.
+  static void AddKernel(const string& name, const CpuIsa isa,
+      Function function) {
+    Variants& variants = Registry()[name];
+    CHECK_EQ(variants.count(isa), 0) << "CPU kernel " << name << " already "
+        << "registered for " << CpuIsaName(isa) << ".";
+    variants[isa] = function;
+  }
+
+  // Gets the variant for the highest level up to isa, and the level of that
+  // variant if level is not NULL.
+  static Function GetKernel(const string& name, const CpuIsa isa,
+      CpuIsa* level = NULL) {
+    KernelRegistry& registry = Registry();
+    CHECK_EQ(registry.count(name), 1) << "Unknown CPU kernel: " << name;
+    const Variants& variants = registry[name];
+    typename Variants::const_iterator variant = variants.upper_bound(isa);
+    CHECK(variant != variants.begin()) << "CPU kernel " << name
+        << " has no variant up to " << CpuIsaName(isa) << ".";
+    --variant;
+    if (level) {
+      *level = variant->first;
+    }
+    return variant->second;
+  }
+
+ private:
+  // Kernel registry should never be instantiated - everything is done with
+  // its static variables.
+  CpuKernelRegistry() {}
+};
+
+
+template <typename Function>
+class CpuKernelRegisterer {
+ public:
+  CpuKernelRegisterer(const string& name, const CpuIsa isa,
+      Function function) {
+    CpuKernelRegistry<Function>::AddKernel(name, isa, function);
+  }
+};
+
+
+#define REGISTER_CPU_KERNEL(Function, name, isa, function)                    \
+  static CpuKernelRegisterer<Function> g_cpu_kernel_##function(#name, isa,    \
+      function)
+
+
+/**
+ * @brief The variants of a registered kernel, resolved for every level, to
+ *        be called through get() at the selected level (see SelectedCpuIsa).
+ *
+ * Meant to be a function-local static next to the call site, so that the
+ * registry is only searched once:
+ *
+ *     static CpuKernel<ExpFunction> kernel("exp");
+ *     kernel.get()(n, a, y);
+ */
+template <typename Function>
+class CpuKernel {
+ public:
+  explicit CpuKernel(const string& name) : functions_(CPU_ISA_COUNT) {
+    for (int isa = 0; isa < CPU_ISA_COUNT; ++isa) {
+      functions_[isa] = CpuKernelRegistry<Function>::GetKernel(name,
+          static_cast<CpuIsa>(isa));
+    }
+  }
+
+  Function get() const { return functions_[SelectedCpuIsa()]; }
+
+ private:
+  vector<Function> functions_;
+
+  DISABLE_COPY_AND_ASSIGN(CpuKernel);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CPU_KERNEL_HPP_
@@ -0,0 +1,39 @@
+#ifndef CAFFE_UTIL_FAST_MATH_HPP_
+#define CAFFE_UTIL_FAST_MATH_HPP_
+
+namespace caffe {
+
+// Vectorized single precision transcendental functions, used by caffe_exp,
+// caffe_log, caffe_powx, caffe_tanh and caffe_sigmoid when MKL's VML is not
+// available. Each is a CpuKernel with variants for SSE4, AVX2 and AVX-512
+// that evaluate Cephes-style polynomials 4, 8 and 16 elements at a time
+// (see fast_math_vector.hpp), and a generic one looping over libm.
+// Infinities and NaNs are handled as by libm. The error bounds below,
+// relative to the correctly rounded result, hold for every variant and are
+// checked by the math functions tests:
+//   exp:     2 ulp for results in the normal range
+//   log:     2 ulp, or 1e-7 absolute around log(1) = 0
+//   tanh:    3 ulp
+//   sigmoid: 3 ulp for results in the normal range
+//   powx:    2 + 2 * |b * log(a)| ulp for positive finite a; other inputs
+//            defer to std::pow.
+// y may alias a.
+
+// The kernel signatures, registered under the names of the functions below.
+typedef void (*FastMathFunction)(const int n, const float* a, float* y);
+typedef void (*FastPowxFunction)(const int n, const float* a, const float b,
+    float* y);
+
+void fast_exp(const int n, const float* a, float* y);
+
+void fast_log(const int n, const float* a, float* y);
+
+void fast_powx(const int n, const float* a, const float b, float* y);
+
+void fast_tanh(const int n, const float* a, float* y);
+
+void fast_sigmoid(const int n, const float* a, float* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FAST_MATH_HPP_
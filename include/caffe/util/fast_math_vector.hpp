@@ -0,0 +1,250 @@
+#ifndef CAFFE_UTIL_FAST_MATH_VECTOR_HPP_
+#define CAFFE_UTIL_FAST_MATH_VECTOR_HPP_
+
+// The vector kernels behind fast_math.hpp, written with GCC vector extensions
+// for vectors of kBytes bytes. This header is only included by the
+// fast_math_<isa>.cpp kernels, between
+//   #pragma GCC push_options
+//   #pragma GCC target("...")
+// and
+//   #pragma GCC pop_options
+// so that everything here is compiled for that instruction set; it must not
+// be included anywhere else. The lane helpers are forced inline into the
+// kernels, so their vector arguments never cross an ABI boundary.
+
+#define CAFFE_VECTOR_INLINE inline __attribute__((always_inline))
+
+namespace caffe {
+
+template <int kBytes>
+class FastMathVector {
+ public:
+  static void Exp(const int n, const float* a, float* y) {
+    Apply(n, a, y, ExpOp());
+  }
+
+  static void Log(const int n, const float* a, float* y) {
+    Apply(n, a, y, LogOp());
+  }
+
+  static void Tanh(const int n, const float* a, float* y) {
+    Apply(n, a, y, TanhOp());
+  }
+
+  static void Sigmoid(const int n, const float* a, float* y) {
+    Apply(n, a, y, SigmoidOp());
+  }
+
+  static void Powx(const int n, const float* a, const float b, float* y) {
+    // exp(b * log(a)) only covers positive finite a.
+    int i = 0;
+    while (i < n) {
+      if (a[i] > 0 && a[i] < __builtin_inff()) {
+        int end = i + 1;
+        while (end < n && a[end] > 0 && a[end] < __builtin_inff()) {
+          ++end;
+        }
+        Apply(end - i, a + i, y + i, PowxOp(b));
+        i = end;
+      } else {
+        y[i] = __builtin_powf(a[i], b);
+        ++i;
+      }
+    }
+  }
+
+ private:
+  typedef float vfloat __attribute__((vector_size(kBytes)));
+  typedef int vint __attribute__((vector_size(kBytes)));
+  // Same as vfloat but with the alignment of float, for loads and stores.
+  typedef float vfloat_unaligned __attribute__((vector_size(kBytes),
+      aligned(4)));
+  static const int kLanes = kBytes / sizeof(float);
+
+  static CAFFE_VECTOR_INLINE vfloat splat(const float x) {
+    return vfloat() + x;
+  }
+
+  static CAFFE_VECTOR_INLINE vint splat(const int x) {
+    return vint() + x;
+  }
+
+  static CAFFE_VECTOR_INLINE vfloat as_float(const vint& x) {
+    return reinterpret_cast<vfloat>(x);
+  }
+
+  static CAFFE_VECTOR_INLINE vint as_int(const vfloat& x) {
+    return reinterpret_cast<vint>(x);
+  }
+
+  // Converts |x| < 2^22.
+  static CAFFE_VECTOR_INLINE vfloat to_float(const vint& x) {
+    const int magic = 0x4b400000;  // 1.5 * 2^23
+    return as_float(x + splat(magic)) - as_float(splat(magic));
+  }
+
+  // Lanes of a where mask is set (all ones), of b elsewhere.
+  static CAFFE_VECTOR_INLINE vfloat select(const vint& mask, const vfloat& a,
+      const vfloat& b) {
+    return as_float((as_int(a) & mask) | (as_int(b) & ~mask));
+  }
+
+  static CAFFE_VECTOR_INLINE vfloat vmin(const vfloat& a, const vfloat& b) {
+    return select(a < b, a, b);
+  }
+
+  static CAFFE_VECTOR_INLINE vfloat vmax(const vfloat& a, const vfloat& b) {
+    return select(a > b, a, b);
+  }
+
+  // Rounds to the nearest integer, returned both as float and as int, for
+  // |x| < 2^22.
+  static CAFFE_VECTOR_INLINE vfloat round(const vfloat& x, vint* n) {
+    const vfloat magic = splat(12582912.f);  // 1.5 * 2^23
+    const vfloat shifted = x + magic;
+    *n = as_int(shifted) - as_int(magic);
+    return shifted - magic;
+  }
+
+  // 2^n for -126 <= n <= 127.
+  static CAFFE_VECTOR_INLINE vfloat pow2(const vint& n) {
+    return as_float((n + splat(127)) << 23);
+  }
+
+  static CAFFE_VECTOR_INLINE vfloat exp(const vfloat& x) {
+    const vfloat clamped = vmin(vmax(x, splat(-103.9f)), splat(88.72283f));
+    vint n;
+    const vfloat fn = round(clamped * splat(1.44269504088896341f), &n);
+    // Cody-Waite reduction: r = x - n * ln(2), with ln(2) split in two.
+    vfloat r = clamped - fn * splat(0.693359375f);
+    r = r - fn * splat(-2.12194440e-4f);
+    vfloat p = splat(1.9875691500e-4f);
+    p = p * r + splat(1.3981999507e-3f);
+    p = p * r + splat(8.3334519073e-3f);
+    p = p * r + splat(4.1665795894e-2f);
+    p = p * r + splat(1.6666665459e-1f);
+    p = p * r + splat(5.0000001201e-1f);
+    p = p * r * r + r + splat(1.f);
+    // Scale in two steps so that results down in the subnormal range and up
+    // to FLT_MAX need no special exponent.
+    const vint half = n >> 1;
+    vfloat y = p * pow2(half) * pow2(n - half);
+    y = select(x > splat(88.72283f), splat(__builtin_inff()), y);
+    y = select(x < splat(-103.97208f), splat(0.f), y);
+    return select(x != x, x, y);
+  }
+
+  static CAFFE_VECTOR_INLINE vfloat log(const vfloat& x) {
+    // Scale subnormals into the normal range first.
+    const vint subnormal = x < as_float(splat(0x00800000));
+    const vfloat scaled = select(subnormal, x * splat(8388608.f), x);
+    const vint bits = as_int(scaled);
+    vint e = ((bits >> 23) & splat(0xff)) - splat(126) -
+        (subnormal & splat(23));
+    // Mantissa in [0.5, 1), then in [sqrt(0.5) - 1, sqrt(2) - 1).
+    vfloat m = as_float((bits & splat(~0x7f800000)) | splat(0x3f000000));
+    const vint small = m < splat(0.707106781186547524f);
+    e = e + small;  // -1 where set
+    m = select(small, m + m, m) - splat(1.f);
+    const vfloat fe = to_float(e);
+    const vfloat z = m * m;
+    vfloat p = splat(7.0376836292e-2f);
+    p = p * m + splat(-1.1514610310e-1f);
+    p = p * m + splat(1.1676998740e-1f);
+    p = p * m + splat(-1.2420140846e-1f);
+    p = p * m + splat(1.4249322787e-1f);
+    p = p * m + splat(-1.6668057665e-1f);
+    p = p * m + splat(2.0000714765e-1f);
+    p = p * m + splat(-2.4999993993e-1f);
+    p = p * m + splat(3.3333331174e-1f);
+    vfloat y = p * m * z;
+    y = y + fe * splat(-2.12194440e-4f);
+    y = y - splat(0.5f) * z;
+    y = m + y + fe * splat(0.693359375f);
+    // log(0) = -inf, log(x < 0) = NaN, log(inf) = inf and NaNs propagate.
+    y = select(x == splat(0.f), splat(-__builtin_inff()), y);
+    y = select(x < splat(0.f), as_float(splat(0x7fc00000)), y);
+    return select((x == splat(__builtin_inff())) | (x != x), x, y);
+  }
+
+  static CAFFE_VECTOR_INLINE vfloat tanh(const vfloat& x) {
+    const vint negative = x < splat(0.f);
+    const vfloat ax = select(negative, -x, x);
+    // Small arguments: odd polynomial.
+    const vfloat z = x * x;
+    vfloat p = splat(-5.70498872745e-3f);
+    p = p * z + splat(2.06390887954e-2f);
+    p = p * z + splat(-5.37397155531e-2f);
+    p = p * z + splat(1.33314422036e-1f);
+    p = p * z + splat(-3.33332819422e-1f);
+    const vfloat small = p * z * x + x;
+    // Others: 1 - 2 / (exp(2|x|) + 1).
+    vfloat large = splat(1.f) - splat(2.f) / (exp(ax + ax) + splat(1.f));
+    large = select(negative, -large, large);
+    return select(ax < splat(0.625f), small, large);
+  }
+
+  static CAFFE_VECTOR_INLINE vfloat sigmoid(const vfloat& x) {
+    return splat(1.f) / (splat(1.f) + exp(-x));
+  }
+
+  // Applies op to n elements, a vector at a time, zero-padding the tail.
+  template <typename Op>
+  static CAFFE_VECTOR_INLINE void Apply(const int n, const float* a,
+      float* y, const Op& op) {
+    int i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+      const vfloat v = *reinterpret_cast<const vfloat_unaligned*>(a + i);
+      *reinterpret_cast<vfloat_unaligned*>(y + i) = op(v);
+    }
+    if (i < n) {
+      float tail[kLanes];
+      for (int j = 0; j < kLanes; ++j) {
+        tail[j] = i + j < n ? a[i + j] : 0.f;
+      }
+      const vfloat v = *reinterpret_cast<const vfloat_unaligned*>(tail);
+      *reinterpret_cast<vfloat_unaligned*>(tail) = op(v);
+      for (int j = 0; i + j < n; ++j) {
+        y[i + j] = tail[j];
+      }
+    }
+  }
+
+  struct ExpOp {
+    CAFFE_VECTOR_INLINE vfloat operator()(const vfloat& x) const {
+      return exp(x);
+    }
+  };
+
+  struct LogOp {
+    CAFFE_VECTOR_INLINE vfloat operator()(const vfloat& x) const {
+      return log(x);
+    }
+  };
+
+  struct PowxOp {
+    CAFFE_VECTOR_INLINE explicit PowxOp(const float b) : b(splat(b)) {}
+    CAFFE_VECTOR_INLINE vfloat operator()(const vfloat& x) const {
+      return exp(b * log(x));
+    }
+    const vfloat b;
+  };
+
+  struct TanhOp {
+    CAFFE_VECTOR_INLINE vfloat operator()(const vfloat& x) const {
+      return tanh(x);
+    }
+  };
+
+  struct SigmoidOp {
+    CAFFE_VECTOR_INLINE vfloat operator()(const vfloat& x) const {
+      return sigmoid(x);
+    }
+  };
+};
+
+}  // namespace caffe
+
+#undef CAFFE_VECTOR_INLINE
+
+#endif  // CAFFE_UTIL_FAST_MATH_VECTOR_HPP_
@@ -0,0 +1,127 @@
+#ifndef CAFFE_UTIL_GRADIENT_COMPRESSION_HPP_
+#define CAFFE_UTIL_GRADIENT_COMPRESSION_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Encodes gradients into compact messages for data-parallel training,
+ *        and adds received messages into a gradient.
+ *
+ * One compressor is kept per worker and gradient buffer, as with error
+ * feedback it remembers what its previous encodings lost: that residual is
+ * added to the next gradient before encoding, so that lossy methods delay
+ * the dropped part of the gradient instead of discarding it.
+ *
+ * The compressor also measures the compression ratio and the time spent
+ * encoding and decoding, accumulated until ResetStats().
+ */
+template <typename Dtype>
+class GradientCompressor {
+ public:
+  GradientCompressor(const GradientCompressionParameter& param, int count);
+  virtual ~GradientCompressor() {}
+
+  /// @brief Encodes the count values of grad into message.
+  void Encode(const Dtype* grad, string* message);
+  /// @brief Adds alpha times the gradient encoded in message to grad.
+  void DecodeAdd(const string& message, Dtype alpha, Dtype* grad);
+
+  inline int count() const { return count_; }
+  /// @brief Uncompressed over encoded bytes, since the last ResetStats().
+  double compression_ratio() const;
+  inline double encode_ms() const { return encode_us_ / 1000; }
+  inline double decode_ms() const { return decode_us_ / 1000; }
+  void ResetStats();
+
+ protected:
+  virtual void EncodeValues(const Dtype* values, string* message) = 0;
+  virtual void DecodeValues(const string& message, Dtype alpha,
+      Dtype* values) const = 0;
+
+  GradientCompressionParameter param_;
+  const int count_;
+  vector<Dtype> residual_;
+  CPUTimer timer_;
+  double raw_bytes_, encoded_bytes_;
+  double encode_us_, decode_us_;
+
+  DISABLE_COPY_AND_ASSIGN(GradientCompressor);
+};
+
+/// @brief Sends each value as an IEEE half precision float.
+template <typename Dtype>
+class HalfGradientCompressor : public GradientCompressor<Dtype> {
+ public:
+  HalfGradientCompressor(const GradientCompressionParameter& param, int count)
+      : GradientCompressor<Dtype>(param, count) {}
+
+ protected:
+  virtual void EncodeValues(const Dtype* values, string* message);
+  virtual void DecodeValues(const string& message, Dtype alpha,
+      Dtype* values) const;
+};
+
+/// @brief Sends each value as a bfloat16, the upper half of a float: the
+///        range of a float with 8 bits of precision.
+template <typename Dtype>
+class BFloat16GradientCompressor : public GradientCompressor<Dtype> {
+ public:
+  BFloat16GradientCompressor(const GradientCompressionParameter& param,
+      int count) : GradientCompressor<Dtype>(param, count) {}
+
+ protected:
+  virtual void EncodeValues(const Dtype* values, string* message);
+  virtual void DecodeValues(const string& message, Dtype alpha,
+      Dtype* values) const;
+};
+
+/// @brief Sends the topk_ratio fraction of the values with the largest
+///        magnitudes, with their indices.
+template <typename Dtype>
+class TopKGradientCompressor : public GradientCompressor<Dtype> {
+ public:
+  TopKGradientCompressor(const GradientCompressionParameter& param,
+      int count);
+
+ protected:
+  virtual void EncodeValues(const Dtype* values, string* message);
+  virtual void DecodeValues(const string& message, Dtype alpha,
+      Dtype* values) const;
+
+  const int k_;
+  vector<int> order_;
+};
+
+/// @brief Sends one sign bit per value and a single scale, the mean
+///        magnitude of the values.
+template <typename Dtype>
+class SignGradientCompressor : public GradientCompressor<Dtype> {
+ public:
+  SignGradientCompressor(const GradientCompressionParameter& param, int count)
+      : GradientCompressor<Dtype>(param, count) {}
+
+ protected:
+  virtual void EncodeValues(const Dtype* values, string* message);
+  virtual void DecodeValues(const string& message, Dtype alpha,
+      Dtype* values) const;
+};
+
+/**
+ * @brief Returns a compressor for count values with the method in param, or
+ *        NULL for GradientCompressionParameter_Method_NONE. The caller owns
+ *        the compressor.
+ */
+template <typename Dtype>
+GradientCompressor<Dtype>* GetGradientCompressor(
+    const GradientCompressionParameter& param, int count);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_GRADIENT_COMPRESSION_HPP_
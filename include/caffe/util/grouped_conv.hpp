@@ -0,0 +1,40 @@
+#ifndef _CAFFE_UTIL_GROUPED_CONV_HPP_
+#define _CAFFE_UTIL_GROUPED_CONV_HPP_
+
+namespace caffe {
+
+// Direct (im2col-free) 2D grouped convolution over a batch of num images,
+// meant for narrow groups such as depthwise convolution where the per-group
+// GEMMs are too small to be efficient. The weights are laid out as
+// num_output x (channels / group) x kernel_h x kernel_w, as in
+// ConvolutionLayer. Work is split over images and channels.
+
+template <typename Dtype>
+void grouped_conv_forward_cpu(const Dtype* data_im, const int num,
+    const int channels, const int height, const int width,
+    const Dtype* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, Dtype* data_out);
+
+// Computes the gradient w.r.t. the input (overwriting im_diff).
+template <typename Dtype>
+void grouped_conv_backward_data_cpu(const Dtype* out_diff, const int num,
+    const int channels, const int height, const int width,
+    const Dtype* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, Dtype* im_diff);
+
+// Accumulates the gradient w.r.t. the weights into weight_diff.
+template <typename Dtype>
+void grouped_conv_backward_weight_cpu(const Dtype* data_im,
+    const Dtype* out_diff, const int num, const int channels,
+    const int height, const int width, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, Dtype* weight_diff);
+
+}  // namespace caffe
+
+#endif  // _CAFFE_UTIL_GROUPED_CONV_HPP_
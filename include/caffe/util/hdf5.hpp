@@ -10,6 +10,26 @@
 
 namespace caffe {
 
+/**
+ * @brief Serializes calls into the HDF5 library across the threads of the
+ *        process while in scope.
+ *
+ * HDF5 is usually built without thread safety, while data layers read it
+ * on threads of their own, so every caller holds this lock from opening a
+ * file to closing it. It is recursive: the functions below take it too.
+ */
+class HDF5Lock {
+ public:
+  HDF5Lock();
+  ~HDF5Lock();
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(HDF5Lock);
+};
+
+/// @brief Whether filename is an HDF5 file.
+bool hdf5_is_file(const string& filename);
+
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
@@ -20,6 +40,14 @@ void hdf5_load_nd_dataset(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
     Blob<Dtype>* blob, bool reshape = false);
 
+// Loads count rows, along the first axis, of a dataset from row start on,
+// or up to its last row if there are fewer left or count is 0. The blob is
+// reshaped to them. Returns the number of rows of the whole dataset.
+template <typename Dtype>
+hsize_t hdf5_load_nd_dataset_rows(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    hsize_t start, hsize_t count, Blob<Dtype>* blob);
+
 template <typename Dtype>
 void hdf5_save_nd_dataset(
     const hid_t file_id, const string& dataset_name, const Blob<Dtype>& blob,
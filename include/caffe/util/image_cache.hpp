@@ -0,0 +1,85 @@
+#ifndef CAFFE_UTIL_IMAGE_CACHE_HPP_
+#define CAFFE_UTIL_IMAGE_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A bounded cache of decoded 8-bit images, keyed by strings such as
+ *        their file name and the size they are resized to.
+ *
+ * The cache lives either in the memory of the process, or in a named POSIX
+ * shared memory segment, which every local process opening the same name
+ * shares; it outlives them until Remove()d. When full, images that were not
+ * used recently are evicted by the CLOCK approximation of LRU. The
+ * statistics are those of all processes sharing the cache.
+ *
+ * The lock of a shared cache is not released if a process dies while
+ * holding it; the other processes then fail after a timeout, and the segment
+ * has to be removed. Keys are not checked against the files they name, so
+ * they should change with them (ImageDataLayer includes the file size and
+ * modification time).
+ */
+class ImageCache {
+ public:
+  /// @brief Opens the cache of the given name, or a process-local one if
+  ///        name is empty. A new cache holds up to capacity bytes of images;
+  ///        an existing one keeps its capacity.
+  ImageCache(size_t capacity, const string& name);
+  ~ImageCache();
+
+  /// @brief Returns the cache of the given name, opened once per process
+  ///        and shared by its callers, such as the data layers of its nets.
+  ///        Process-local caches are only shared by callers asking for the
+  ///        same capacity.
+  static shared_ptr<ImageCache> Open(size_t capacity, const string& name);
+  /// @brief Removes the shared memory segment of the given name, which
+  ///        should not be open anymore.
+  static void Remove(const string& name);
+
+  /// @brief Copies the image cached under key into shape, as (height, width,
+  ///        channels), and data, with interleaved channels. Returns false if
+  ///        it is not cached.
+  bool Get(const string& key, vector<int>* shape, string* data);
+  /// @brief Caches an image of the given shape, as returned by Get, unless
+  ///        it is larger than the cache.
+  void Put(const string& key, const vector<int>& shape, const char* data);
+
+  size_t capacity() const;
+  /// @brief The number and bytes of the cached images.
+  int size() const;
+  size_t bytes() const;
+  uint64_t hits() const;
+  uint64_t misses() const;
+  uint64_t evictions() const;
+
+ private:
+  struct Entry;
+  struct Header;
+  class Lock;
+  class Segment;
+
+  int Find(const string& key, size_t hash) const;
+  void Evict();
+
+  const string name_;
+  shared_ptr<Segment> segment_;
+  Header* header_;
+  Entry* entries_;
+  int num_entries_;
+  // Open addressing hash table of entry indices, -1 for none.
+  int* index_;
+  int index_size_;
+
+  DISABLE_COPY_AND_ASSIGN(ImageCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_IMAGE_CACHE_HPP_
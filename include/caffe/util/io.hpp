@@ -126,6 +126,13 @@ inline bool ReadImageToDatum(const string& filename, const int label,
   return ReadImageToDatum(filename, label, 0, 0, true, encoding, datum);
 }
 
+// Like ReadImageToDatum, for a datum holding the contents of the image file
+// as read by ReadFileToDatum. This separates reading images from decoding
+// them, so that the two can be done by different threads.
+bool DecodeImageToDatum(const string& filename, const int label,
+    const int height, const int width, const bool is_color,
+    const std::string & encoding, Datum* datum);
+
 bool DecodeDatumNative(Datum* datum);
 bool DecodeDatum(Datum* datum, bool is_color);
 
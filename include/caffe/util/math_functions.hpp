@@ -20,6 +20,9 @@ void caffe_cpu_gemm(const CBLAS_TRANSPOSE TransA,
     const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
     Dtype* C);
 
+// Runs count independent gemms on densely packed operands: the i-th uses
+// A + i * M * K, B + i * K * N and C + i * M * N. The batch is handed to the
+// BLAS batched gemm where available and otherwise spread over threads.
 template <typename Dtype>
 void caffe_cpu_gemm_batched(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
@@ -94,12 +97,36 @@ void caffe_rng_bernoulli(const int n, const Dtype p, int* r);
 template <typename Dtype>
 void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r);
 
+// Bit masks pack one flag per element: flag i is bit (i % 32) of word i / 32,
+// so a mask over n elements takes caffe_mask_words(n) words.
+inline int caffe_mask_words(const int n) { return (n + 31) / 32; }
+
+// Sets each flag of mask independently with probability p.
+template <typename Dtype>
+void caffe_rng_bernoulli_mask(const int n, const Dtype p, unsigned int* mask);
+
+// Sets flag i of mask iff x[i] > 0.
+template <typename Dtype>
+void caffe_cpu_positive_mask(const int n, const Dtype* x, unsigned int* mask);
+
+// y[i] = x[i] * (flag i of mask ? on : off); x and y may alias.
+template <typename Dtype>
+void caffe_cpu_mask_scale(const int n, const unsigned int* mask,
+    const Dtype* x, const Dtype on, const Dtype off, Dtype* y);
+
 template <typename Dtype>
 void caffe_exp(const int n, const Dtype* a, Dtype* y);
 
 template <typename Dtype>
 void caffe_log(const int n, const Dtype* a, Dtype* y);
 
+template <typename Dtype>
+void caffe_tanh(const int n, const Dtype* a, Dtype* y);
+
+// y[i] = 1 / (1 + exp(-a[i]))
+template <typename Dtype>
+void caffe_sigmoid(const int n, const Dtype* a, Dtype* y);
+
 template <typename Dtype>
 void caffe_abs(const int n, const Dtype* a, Dtype* y);
 
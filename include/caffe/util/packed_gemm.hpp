@@ -0,0 +1,58 @@
+#ifndef CAFFE_UTIL_PACKED_GEMM_HPP_
+#define CAFFE_UTIL_PACKED_GEMM_HPP_
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Keeps a constant GEMM operand, such as the weights of a layer, in the
+ *        BLAS-internal packed layout so that repeated products with it skip
+ *        repacking it on every call.
+ *
+ * The packed copy is tied to the SyncedMemory holding the weights and is
+ * rebuilt whenever that memory is replaced or may have been written (see
+ * SyncedMemory::version()), or when the product shape changes. Packing uses
+ * MKL's cblas_?gemm_pack; with other BLAS libraries the products are plain
+ * caffe_cpu_gemm calls.
+ */
+template <typename Dtype>
+class PackedGemm {
+ public:
+  /**
+   * @param weights_left whether the weights are the left (A) operand of the
+   *        product rather than the right (B) one.
+   * @param trans_weights whether the weights are used transposed.
+   */
+  PackedGemm(bool weights_left, CBLAS_TRANSPOSE trans_weights);
+  ~PackedGemm();
+
+  /**
+   * @brief Computes C = op(W) * X if the weights are the left operand, or
+   *        C = X * op(W) otherwise, with the M x N x K dimensions and
+   *        row-major layout of caffe_cpu_gemm (alpha = 1, beta = 0).
+   *        W starts at offset in the data of weights; X is never transposed.
+   */
+  void Gemm(const int M, const int N, const int K, const Blob<Dtype>& weights,
+      const int offset, const Dtype* X, Dtype* C);
+
+ private:
+  void Pack(const int M, const int N, const int K, const Dtype* W);
+
+  const bool weights_left_;
+  const CBLAS_TRANSPOSE trans_weights_;
+  // What the packed copy was built from.
+  shared_ptr<SyncedMemory> source_;
+  size_t source_version_;
+  int offset_, M_, N_, K_;
+  Dtype* packed_;
+
+  DISABLE_COPY_AND_ASSIGN(PackedGemm);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PACKED_GEMM_HPP_
@@ -0,0 +1,136 @@
+#ifndef CAFFE_UTIL_PHILOX_HPP_
+#define CAFFE_UTIL_PHILOX_HPP_
+
+#include <stdint.h>
+
+namespace caffe {
+
+/**
+ * @brief Philox4x32-10 counter-based random number generator
+ *        (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC'11).
+ *
+ * The generator is a keyed bijection of a 128-bit counter: block @f$ i @f$ of
+ * the stream is philox(key, i) and yields four 32-bit values. Any range of the
+ * stream can therefore be produced independently of the others, which lets a
+ * fill be split across threads by offset while staying bit-identical for a
+ * given key no matter how many threads take part.
+ */
+class Philox {
+ public:
+  // Number of 32-bit outputs produced per counter block.
+  static const int kBlockSize = 4;
+
+  Philox() : counter_(0), cached_block_(~uint64_t(0)) {
+    key_[0] = key_[1] = 0;
+  }
+  Philox(uint32_t key0, uint32_t key1)
+      : counter_(0), cached_block_(~uint64_t(0)) {
+    key_[0] = key0;
+    key_[1] = key1;
+  }
+  explicit Philox(uint64_t seed) : counter_(0), cached_block_(~uint64_t(0)) {
+    key_[0] = static_cast<uint32_t>(seed);
+    key_[1] = static_cast<uint32_t>(seed >> 32);
+  }
+
+  // Computes the four outputs of counter block (ctr[0..3]) under key.
+  static inline void Block(const uint32_t ctr[4], const uint32_t key[2],
+      uint32_t out[4]) {
+    uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; ++round) {
+      const uint64_t p0 = static_cast<uint64_t>(kMul0) * c0;
+      const uint64_t p1 = static_cast<uint64_t>(kMul1) * c2;
+      const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+      const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+      c1 = static_cast<uint32_t>(p1);
+      c3 = static_cast<uint32_t>(p0);
+      c0 = n0;
+      c2 = n2;
+      k0 += kWeyl0;
+      k1 += kWeyl1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+  }
+
+  // Writes the outputs of blocks [block, block + num_blocks) of this stream
+  // to out (kBlockSize values per block). The blocks are computed in lanes of
+  // independent counters so that the rounds vectorize.
+  inline void Generate(uint64_t block, int num_blocks, uint32_t* out) const {
+    const int kLanes = 8;
+    int b = 0;
+    for (; b + kLanes <= num_blocks; b += kLanes) {
+      uint32_t c0[kLanes], c1[kLanes], c2[kLanes], c3[kLanes];
+      for (int l = 0; l < kLanes; ++l) {
+        const uint64_t ctr = block + b + l;
+        c0[l] = static_cast<uint32_t>(ctr);
+        c1[l] = static_cast<uint32_t>(ctr >> 32);
+        c2[l] = 0;
+        c3[l] = 0;
+      }
+      uint32_t k0 = key_[0], k1 = key_[1];
+      for (int round = 0; round < 10; ++round) {
+        for (int l = 0; l < kLanes; ++l) {
+          const uint64_t p0 = static_cast<uint64_t>(kMul0) * c0[l];
+          const uint64_t p1 = static_cast<uint64_t>(kMul1) * c2[l];
+          const uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1[l] ^ k0;
+          const uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3[l] ^ k1;
+          c1[l] = static_cast<uint32_t>(p1);
+          c3[l] = static_cast<uint32_t>(p0);
+          c0[l] = n0;
+          c2[l] = n2;
+        }
+        k0 += kWeyl0;
+        k1 += kWeyl1;
+      }
+      for (int l = 0; l < kLanes; ++l) {
+        uint32_t* o = out + (b + l) * kBlockSize;
+        o[0] = c0[l]; o[1] = c1[l]; o[2] = c2[l]; o[3] = c3[l];
+      }
+    }
+    for (; b < num_blocks; ++b) {
+      const uint64_t ctr = block + b;
+      const uint32_t c[4] = { static_cast<uint32_t>(ctr),
+                              static_cast<uint32_t>(ctr >> 32), 0, 0 };
+      Block(c, key_, out + b * kBlockSize);
+    }
+  }
+
+  // Sequential use: returns the next 32-bit value of the stream.
+  inline uint32_t operator()() {
+    const uint64_t block = counter_ / kBlockSize;
+    const int lane = static_cast<int>(counter_ % kBlockSize);
+    if (lane == 0 || block != cached_block_) {
+      Generate(block, 1, cache_);
+      cached_block_ = block;
+    }
+    ++counter_;
+    return cache_[lane];
+  }
+
+ private:
+  static const uint32_t kMul0 = 0xD2511F53;
+  static const uint32_t kMul1 = 0xCD9E8D57;
+  static const uint32_t kWeyl0 = 0x9E3779B9;
+  static const uint32_t kWeyl1 = 0xBB67AE85;
+
+  uint32_t key_[2];
+  uint64_t counter_;
+  uint64_t cached_block_;
+  uint32_t cache_[kBlockSize];
+};
+
+// Maps a 32-bit random integer to [0, 1) with 24 bits of precision.
+inline float philox_uniform_float(uint32_t x) {
+  return static_cast<float>(x >> 8) * (1.0f / 16777216.0f);
+}
+
+// Maps two 32-bit random integers to [0, 1) with 53 bits of precision.
+inline double philox_uniform_double(uint32_t hi, uint32_t lo) {
+  const uint64_t bits = (static_cast<uint64_t>(hi >> 5) << 26) | (lo >> 6);
+  return static_cast<double>(bits) * (1.0 / 9007199254740992.0);
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PHILOX_HPP_
@@ -0,0 +1,88 @@
+#ifndef CAFFE_UTIL_SNAPSHOT_STORE_HPP_
+#define CAFFE_UTIL_SNAPSHOT_STORE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A directory of content-addressed chunks, one serialized BlobProto
+ *        each, shared by the snapshots of a run.
+ *
+ * A chunk is named after a 128-bit hash of its blob's type, shape and
+ * values, computed from the blob memory; a blob whose chunk already exists,
+ * such as a frozen layer's, is neither serialized nor written again. The
+ * snapshots themselves are SnapshotManifest files listing chunk ids. The
+ * directory is only created by the first Put, so that reading a store never
+ * writes to the file system.
+ */
+class SnapshotStore {
+ public:
+  explicit SnapshotStore(const string& directory);
+
+  /// @brief Stores the blob, and its diff if write_diff, and returns the id
+  ///        of its chunk.
+  template <typename Dtype>
+  string Put(const Blob<Dtype>& blob, bool write_diff = false);
+  /// @brief Reads the chunk with the given id.
+  void Get(const string& id, BlobProto* proto) const;
+
+  /// @brief Deletes the chunks that none of the given manifests refer to.
+  void CollectGarbage(const vector<SnapshotManifest>& manifests);
+
+  inline const string& directory() const { return directory_; }
+  /// @brief Chunks and bytes written, and blobs found already stored, since
+  ///        the last ResetStats().
+  inline int chunks_written() const { return chunks_written_; }
+  inline size_t bytes_written() const { return bytes_written_; }
+  inline int chunks_reused() const { return chunks_reused_; }
+  void ResetStats();
+
+ private:
+  string ChunkFilename(const string& id) const;
+
+  const string directory_;
+  int chunks_written_;
+  size_t bytes_written_;
+  int chunks_reused_;
+
+  DISABLE_COPY_AND_ASSIGN(SnapshotStore);
+};
+
+/// @brief Records the directory of store in manifest, relative to the
+///        directory of the manifest file filename, so that the snapshots can
+///        be moved together with their chunks.
+void SetManifestStore(const SnapshotStore& store, const string& filename,
+    SnapshotManifest* manifest);
+/// @brief The directory of the chunks of manifest, read from filename.
+string ManifestStoreDirectory(const SnapshotManifest& manifest,
+    const string& filename);
+
+/// @brief Stores the learnable layers' blobs of net and writes the manifest
+///        of the model to filename.
+template <typename Dtype>
+void WriteNetToSnapshotStore(const Net<Dtype>& net, bool write_diff,
+    SnapshotStore* store, const string& filename);
+
+/// @brief Reads the model manifest in filename into param, with the blobs
+///        of each layer, as CopyTrainedLayersFrom expects.
+void ReadNetParamsFromSnapshotStoreOrDie(const string& filename,
+    NetParameter* param);
+
+/**
+ * @brief Deletes all but the keep latest solver state manifests written with
+ *        the given snapshot prefix, with their model manifests, and the
+ *        chunks that are no longer used.
+ */
+void RetainSnapshots(const string& snapshot_prefix, int keep,
+    SnapshotStore* store);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SNAPSHOT_STORE_HPP_
@@ -0,0 +1,67 @@
+#ifndef CAFFE_UTIL_SPARSE_WEIGHTS_HPP_
+#define CAFFE_UTIL_SPARSE_WEIGHTS_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A CSR copy of a pruned weight matrix, used to skip the zero weights
+ *        in the CPU products of Convolution and InnerProduct layers.
+ *
+ * The weights are seen as a rows x cols matrix with one row per output
+ * (weight blob shape(0) x count(1), or the transpose of that if the layer
+ * stores its weights transposed). The copy is rebuilt whenever the weight
+ * SyncedMemory is replaced or written (see SyncedMemory::version()), and is
+ * only built if the fraction of zero weights reaches the threshold; the
+ * sparsity and the chosen path are logged whenever that choice changes.
+ * Layers only use it in the TEST phase, where the weights change when they
+ * are loaded or, for test nets, at each test interval.
+ */
+template <typename Dtype>
+class SparseWeights {
+ public:
+  SparseWeights(const string& name, bool transposed, float threshold);
+
+  /// @brief Refreshes the copy if needed and returns whether the weights are
+  ///        sparse enough for the sparse products to be used.
+  bool Update(const Blob<Dtype>& weights);
+
+  /**
+   * @brief Computes C = W_g * B_g for each of group equal row blocks W_g of
+   *        the weights, where B holds group consecutive cols x N matrices and
+   *        C is rows x N, as in the per-group convolution GEMMs.
+   */
+  void MultiplyLeft(const int N, const int group, const Dtype* B,
+      Dtype* C) const;
+  /// @brief Computes C = X * W^T, with X M x cols and C M x rows, as in the
+  ///        InnerProduct forward pass.
+  void MultiplyRight(const int M, const Dtype* X, Dtype* C) const;
+
+  /// @brief The fraction of zero weights.
+  float sparsity() const { return sparsity_; }
+
+ private:
+  const string name_;
+  const bool transposed_;
+  const float threshold_;
+  shared_ptr<SyncedMemory> source_;
+  size_t source_version_;
+  int rows_, cols_;
+  float sparsity_;
+  bool sparse_;
+  std::vector<int> row_start_;
+  std::vector<int> col_index_;
+  std::vector<Dtype> values_;
+
+  DISABLE_COPY_AND_ASSIGN(SparseWeights);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SPARSE_WEIGHTS_HPP_
@@ -0,0 +1,25 @@
+#ifndef CAFFE_UTIL_TOP_K_HPP_
+#define CAFFE_UTIL_TOP_K_HPP_
+
+namespace caffe {
+
+// Both functions look at the n values x[0], x[stride], ..., x[(n - 1) *
+// stride] and order them as std::greater orders (value, index) pairs: by
+// decreasing value, and by decreasing index among equal values.
+
+// Writes the k largest values, largest first, and their indices. Neither
+// allocates, so they can run for many rows in parallel.
+template <typename Dtype>
+void caffe_cpu_top_k(const int n, const Dtype* x, const int stride,
+    const int k, Dtype* values, int* indices);
+
+// Returns the number of values ordered before x[index * stride], i.e. its
+// position in a full sort; x[index * stride] is in the top k iff that is
+// less than k.
+template <typename Dtype>
+int caffe_cpu_rank(const int n, const Dtype* x, const int stride,
+    const int index);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_TOP_K_HPP_
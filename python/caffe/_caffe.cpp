@@ -5,6 +5,7 @@
 
 #include <boost/make_shared.hpp>
 #include <boost/python.hpp>
+#include <boost/thread.hpp>
 #include <boost/python/raw_function.hpp>
 #include <boost/python/suite/indexing/vector_indexing_suite.hpp>
 #include <numpy/arrayobject.h>
@@ -15,6 +16,7 @@
 #include <fstream>  // NOLINT
 
 #include "caffe/caffe.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layers/memory_data_layer.hpp"
 #include "caffe/layers/python_layer.hpp"
 #include "caffe/sgd_solvers.hpp"
@@ -196,6 +198,119 @@ void Net_SetInputArrays(Net<Dtype>* net, bp::object data_obj,
       PyArray_DIMS(data_arr)[0]);
 }
 
+// Releases the GIL for its scope, so that other Python threads run while
+// caffe computes. Python layers and callbacks take it back as needed.
+class ScopedGILRelease {
+ public:
+  ScopedGILRelease() : state_(PyEval_SaveThread()) { }
+  ~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+
+ private:
+  PyThreadState* state_;
+
+  DISABLE_COPY_AND_ASSIGN(ScopedGILRelease);
+};
+
+Dtype Net_Forward(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease release;
+  return net->ForwardFromTo(start, end);
+}
+
+void Net_Backward(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease release;
+  net->BackwardFromTo(start, end);
+}
+
+// A forward pass running on its own thread, which inherits the Caffe mode,
+// device and solver settings of the thread starting it. The net must not be
+// used by anything else until the pass is waited for.
+class NetForwardJob : public InternalThread {
+ public:
+  NetForwardJob(shared_ptr<Net<Dtype> > net, int start, int end)
+      : net_(net), start_(start), end_(end), loss_(0), done_(false),
+        error_type_(NULL), error_value_(NULL), error_traceback_(NULL) {
+    StartInternalThread();
+  }
+  ~NetForwardJob() {
+    Join();
+    Py_XDECREF(error_type_);
+    Py_XDECREF(error_value_);
+    Py_XDECREF(error_traceback_);
+  }
+
+  bool done() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return done_;
+  }
+  // Returns the loss of the pass, raising the error it failed with if any.
+  Dtype Wait() {
+    Join();
+    if (error_type_) {
+      PyErr_Restore(error_type_, error_value_, error_traceback_);
+      error_type_ = error_value_ = error_traceback_ = NULL;
+      bp::throw_error_already_set();
+    }
+    if (!error_.empty()) {
+      const string error = error_;
+      error_.clear();
+      throw std::runtime_error(error);
+    }
+    return loss_;
+  }
+
+ protected:
+  virtual void InternalThreadEntry() {
+    // The thread state outlives the Python layers of the pass, so that
+    // their errors can be fetched once it unwinds.
+    PyGILState_STATE state = PyGILState_Ensure();
+    try {
+      ScopedGILRelease release;
+      loss_ = net_->ForwardFromTo(start_, end_);
+    } catch (const bp::error_already_set&) {
+      PyErr_Fetch(&error_type_, &error_value_, &error_traceback_);
+    } catch (const std::exception& e) {
+      error_ = e.what();
+    }
+    PyGILState_Release(state);
+    boost::mutex::scoped_lock lock(mutex_);
+    done_ = true;
+    done_condition_.notify_all();
+  }
+
+ private:
+  // Waits for the pass to finish; stopping the thread any earlier would
+  // interrupt data layers waiting for their prefetch.
+  void Join() {
+    ScopedGILRelease release;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while (!done_) {
+        done_condition_.wait(lock);
+      }
+    }
+    StopInternalThread();
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+  int start_;
+  int end_;
+  boost::mutex mutex_;
+  boost::condition_variable done_condition_;
+  Dtype loss_;
+  bool done_;
+  string error_;
+  PyObject* error_type_;
+  PyObject* error_value_;
+  PyObject* error_traceback_;
+
+  DISABLE_COPY_AND_ASSIGN(NetForwardJob);
+};
+
+shared_ptr<NetForwardJob> Net_ForwardAsync(shared_ptr<Net<Dtype> > net,
+    int start, int end) {
+  return shared_ptr<NetForwardJob>(new NetForwardJob(net, start, end));
+}
+
 Solver<Dtype>* GetSolverFromFile(const string& filename) {
   SolverParameter param;
   ReadSolverParamsFromTextFileOrDie(filename, &param);
@@ -313,6 +428,7 @@ class NetCallback: public Net<Dtype>::Callback {
 
  protected:
   virtual void run(int layer) {
+    ScopedGILAcquire gil;
     run_(layer);
   }
   bp::object run_;
@@ -347,6 +463,15 @@ class NCCL {
 };
 #endif
 
+bool HasGPU() {
+#ifdef CPU_ONLY
+  return false;
+#else
+  int count = 0;
+  return cudaGetDeviceCount(&count) == cudaSuccess && count > 0;
+#endif
+}
+
 bool HasNCCL() {
 #ifdef USE_NCCL
   return true;
@@ -384,11 +509,18 @@ BOOST_PYTHON_MODULE(_caffe) {
 
   bp::scope().attr("__version__") = AS_STRING(CAFFE_VERSION);
 
+#if PY_VERSION_HEX < 0x03070000
+  // Older Pythons only create the GIL once asked to, which forward and
+  // backward need to release it.
+  PyEval_InitThreads();
+#endif
+
   // Caffe utility functions
   bp::def("init_log", &InitLog);
   bp::def("init_log", &InitLogLevel);
   bp::def("init_log", &InitLogLevelPipe);
   bp::def("log", &Log);
+  bp::def("has_gpu", &HasGPU);
   bp::def("has_nccl", &HasNCCL);
   bp::def("set_mode_cpu", &set_mode_cpu);
   bp::def("set_mode_gpu", &set_mode_gpu);
@@ -411,8 +543,9 @@ BOOST_PYTHON_MODULE(_caffe) {
             bp::arg("weights")=bp::object())))
     // Legacy constructor
     .def("__init__", bp::make_constructor(&Net_Init_Load))
-    .def("_forward", &Net<Dtype>::ForwardFromTo)
-    .def("_backward", &Net<Dtype>::BackwardFromTo)
+    .def("_forward", &Net_Forward)
+    .def("_forward_async", &Net_ForwardAsync)
+    .def("_backward", &Net_Backward)
     .def("reshape", &Net<Dtype>::Reshape)
     .def("clear_param_diffs", &Net<Dtype>::ClearParamDiffs)
     // The cast is to select a particular overload.
@@ -450,6 +583,12 @@ BOOST_PYTHON_MODULE(_caffe) {
     .def("after_backward", &Net_add_nccl);
   BP_REGISTER_SHARED_PTR_TO_PYTHON(Net<Dtype>);
 
+  bp::class_<NetForwardJob, shared_ptr<NetForwardJob>, boost::noncopyable>(
+    "_NetForwardJob", bp::no_init)
+    .def("done", &NetForwardJob::done)
+    .def("wait", &NetForwardJob::Wait);
+  BP_REGISTER_SHARED_PTR_TO_PYTHON(NetForwardJob);
+
   bp::class_<Blob<Dtype>, shared_ptr<Blob<Dtype> >, boost::noncopyable>(
     "Blob", bp::no_init)
     .add_property("shape",
@@ -521,6 +660,12 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::class_<AdamSolver<Dtype>, bp::bases<Solver<Dtype> >,
     shared_ptr<AdamSolver<Dtype> >, boost::noncopyable>(
         "AdamSolver", bp::init<string>());
+  bp::class_<LARSSolver<Dtype>, bp::bases<Solver<Dtype> >,
+    shared_ptr<LARSSolver<Dtype> >, boost::noncopyable>(
+        "LARSSolver", bp::init<string>());
+  bp::class_<LAMBSolver<Dtype>, bp::bases<Solver<Dtype> >,
+    shared_ptr<LAMBSolver<Dtype> >, boost::noncopyable>(
+        "LAMBSolver", bp::init<string>());
 
   bp::def("get_solver", &GetSolverFromFile,
       bp::return_value_policy<bp::manage_new_object>());
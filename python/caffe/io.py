@@ -21,7 +21,13 @@ def blobproto_to_array(blob, return_diff=False):
     unless return_diff is True, in which case we will return the diff.
     """
     # Read the data into an array
-    if return_diff:
+    raw_field = 'raw_diff' if return_diff else 'raw_data'
+    if blob.HasField(raw_field):
+        dtype = np.dtype(np.float64 if blob.raw_type == caffe_pb2.BlobProto.DOUBLE
+                         else np.float32)
+        dtype = dtype.newbyteorder('>' if blob.raw_big_endian else '<')
+        data = np.frombuffer(getattr(blob, raw_field), dtype=dtype).copy()
+    elif return_diff:
         data = np.array(blob.diff)
     else:
         data = np.array(blob.data)
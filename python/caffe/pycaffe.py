@@ -11,7 +11,8 @@ except:
 import numpy as np
 
 from ._caffe import Net, SGDSolver, NesterovSolver, AdaGradSolver, \
-        RMSPropSolver, AdaDeltaSolver, AdamSolver, NCCL, Timer
+        RMSPropSolver, AdaDeltaSolver, AdamSolver, LARSSolver, LAMBSolver, \
+        NCCL, Timer
 import caffe.io
 
 import six
@@ -134,6 +135,76 @@ def _Net_forward(self, blobs=None, start=None, end=None, **kwargs):
     return {out: self.blobs[out].data for out in outputs}
 
 
+class NetForwardHandle(object):
+    """
+    Handle to a forward pass running in the background, as started by
+    Net.forward_async().
+    """
+    def __init__(self, net, job, outputs):
+        self._net = net
+        self._job = job
+        self._outputs = outputs
+
+    def done(self):
+        """Whether the forward pass has finished."""
+        return self._job.done()
+
+    def wait(self):
+        """
+        Wait for the forward pass to finish.
+
+        Returns
+        -------
+        outs : {blob name: blob ndarray} dict, as returned by Net.forward().
+        """
+        self._job.wait()
+        return {out: self._net.blobs[out].data for out in self._outputs}
+
+
+def _Net_forward_async(self, data=None, labels=None, blobs=None,
+                       start=None, end=None):
+    """
+    Start a forward pass on a worker thread, which runs without holding the
+    GIL, so that the calling thread can prepare the next batch meanwhile.
+    The net must not be used until the pass is waited for.
+
+    Parameters
+    ----------
+    data, labels : optional input arrays of the MemoryDataLayer, set as by
+                   Net.set_input_arrays(), which uses them without copying.
+    blobs : list of blobs to return in addition to output blobs.
+    start : optional name of layer at which to begin the forward pass
+    end : optional name of layer at which to finish the forward pass
+          (inclusive)
+
+    Returns
+    -------
+    handle : NetForwardHandle whose wait() returns the outputs.
+    """
+    if blobs is None:
+        blobs = []
+
+    if start is not None:
+        start_ind = list(self._layer_names).index(start)
+    else:
+        start_ind = 0
+
+    if end is not None:
+        end_ind = list(self._layer_names).index(end)
+        outputs = set(self.top_names[end] + blobs)
+    else:
+        end_ind = len(self.layers) - 1
+        outputs = set(self.outputs + blobs)
+
+    if data is not None:
+        if labels is None:
+            labels = np.zeros(data.shape[0], dtype=np.float32)
+        self.set_input_arrays(data, labels)
+
+    return NetForwardHandle(self, self._forward_async(start_ind, end_ind),
+                            outputs)
+
+
 def _Net_backward(self, diffs=None, start=None, end=None, **kwargs):
     """
     Backward pass: prepare diffs and run the net backward.
@@ -334,6 +405,7 @@ Net.blob_loss_weights = _Net_blob_loss_weights
 Net.layer_dict = _Net_layer_dict
 Net.params = _Net_params
 Net.forward = _Net_forward
+Net.forward_async = _Net_forward_async
 Net.backward = _Net_backward
 Net.forward_all = _Net_forward_all
 Net.forward_backward_all = _Net_forward_backward_all
@@ -32,6 +32,17 @@ class TestBlobProtoToArray(unittest.TestCase):
         with self.assertRaises(ValueError):
             caffe.io.blobproto_to_array(blob)
 
+    def test_raw_format(self):
+        data = np.arange(6, dtype='>f8').reshape((2, 3))
+        blob = caffe.proto.caffe_pb2.BlobProto()
+        blob.raw_data = data.tobytes()
+        blob.raw_type = caffe.proto.caffe_pb2.BlobProto.DOUBLE
+        blob.raw_big_endian = True
+        blob.shape.dim.extend(list(data.shape))
+
+        arr = caffe.io.blobproto_to_array(blob)
+        self.assertTrue(np.array_equal(arr, data))
+
     def test_scalar(self):
         data = np.ones((1)) * 123
         blob = caffe.proto.caffe_pb2.BlobProto()
@@ -71,6 +71,15 @@ class TestNet(unittest.TestCase):
         self.net.forward()
         self.net.backward()
 
+    def test_forward_async(self):
+        self.net.forward(start='conv')
+        expected = self.net.blobs['loss'].data.copy()
+        handle = self.net.forward_async(start='conv')
+        outs = handle.wait()
+        self.assertTrue(handle.done())
+        self.assertEqual(list(outs.keys()), ['loss'])
+        np.testing.assert_allclose(outs['loss'], expected)
+
     def test_forward_start_end(self):
         conv_blob=self.net.blobs['conv'];
         ip_blob=self.net.blobs['ip_blob'];
@@ -56,6 +56,18 @@ class PhaseLayer(caffe.Layer):
     def forward(self, bottom, top):
         top[0].data[()] = self.phase
 
+class ThreadStateLayer(caffe.Layer):
+    """A layer for checking the solver settings of the thread running it"""
+
+    def setup(self, bottom, top):
+        pass
+
+    def reshape(self, bottom, top):
+        top[0].reshape(2)
+
+    def forward(self, bottom, top):
+        top[0].data[...] = [caffe.solver_count(), caffe.solver_rank()]
+
 def python_net_file():
     with tempfile.NamedTemporaryFile(mode='w+', delete=False) as f:
         f.write("""name: 'pythonnet' force_backward: true
@@ -96,6 +108,15 @@ def phase_net_file():
           """)
         return f.name
 
+def thread_state_net_file():
+    with tempfile.NamedTemporaryFile(mode='w+', delete=False) as f:
+        f.write("""name: 'pythonnet'
+        layer { type: 'Python' name: 'layer' top: 'state'
+          python_param { module: 'test_python_layer'
+            layer: 'ThreadStateLayer' } }
+          """)
+        return f.name
+
 
 @unittest.skipIf('Python' not in caffe.layer_type_list(),
     'Caffe built without Python layer support')
@@ -166,3 +187,31 @@ class TestPythonLayer(unittest.TestCase):
         for phase in caffe.TRAIN, caffe.TEST:
             net = caffe.Net(net_file, phase)
             self.assertEqual(net.forward()['phase'], phase)
+
+    def test_forward_async_thread_state(self):
+        net_file = thread_state_net_file()
+        net = caffe.Net(net_file, caffe.TRAIN)
+        os.remove(net_file)
+        caffe.set_solver_count(3)
+        caffe.set_solver_rank(2)
+        try:
+            outs = net.forward_async().wait()
+        finally:
+            caffe.set_solver_count(1)
+            caffe.set_solver_rank(0)
+        self.assertEqual(list(outs['state']), [3, 2])
+
+    @unittest.skipIf(not caffe.has_gpu(), 'Caffe built without GPU support')
+    def test_forward_async_gpu(self):
+        caffe.set_mode_gpu()
+        try:
+            net_file = python_net_file()
+            net = caffe.Net(net_file, caffe.TRAIN)
+            os.remove(net_file)
+            x = 8
+            net.blobs['data'].data[...] = x
+            outs = net.forward_async().wait()
+        finally:
+            caffe.set_mode_cpu()
+        for y in outs['three'].flat:
+            self.assertEqual(y, 10**3 * x)
@@ -1,4 +1,9 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
 #include <climits>
+#include <string>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -164,6 +169,15 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::ShareDataMemory(const shared_ptr<SyncedMemory>& data) {
+  CHECK_GE(data->size(), count_ * sizeof(Dtype));
+  // Reshaping beyond the memory's size must reallocate; diff_ is still large
+  // enough for the old capacity.
+  capacity_ = std::min<size_t>(capacity_, data->size() / sizeof(Dtype));
+  data_ = data;
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
 // Blob<int> or Blob<unsigned int>.
@@ -462,6 +476,76 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
   }
 }
 
+static bool IsBigEndian() {
+  const uint16_t one = 1;
+  return *reinterpret_cast<const uint8_t*>(&one) == 0;
+}
+
+// Whether Dtype values are stored as the given raw type.
+static inline bool IsRawType(const float*, BlobProto_RawType type) {
+  return type == BlobProto_RawType_FLOAT;
+}
+static inline bool IsRawType(const double*, BlobProto_RawType type) {
+  return type == BlobProto_RawType_DOUBLE;
+}
+template <typename Dtype>
+static inline bool IsRawType(const Dtype*, BlobProto_RawType type) {
+  return false;
+}
+
+// Reads count values of the given raw type and byte order from bytes.
+template <typename Dtype>
+static void CopyRawValues(const string& bytes, BlobProto_RawType type,
+    bool big_endian, int count, Dtype* values) {
+  const size_t size =
+      type == BlobProto_RawType_DOUBLE ? sizeof(double) : sizeof(float);
+  CHECK_EQ(count * size, bytes.size()) << "raw blob size mismatch";
+  if (big_endian == IsBigEndian() && IsRawType(values, type)) {
+    memcpy(values, bytes.data(), bytes.size());  // NOLINT(caffe/alt_fn)
+    return;
+  }
+  // Swap the byte order or convert the values one at a time.
+  const bool swap = big_endian != IsBigEndian();
+  char value[sizeof(double)];
+  for (int i = 0; i < count; ++i) {
+    memcpy(value, bytes.data() + i * size, size);  // NOLINT(caffe/alt_fn)
+    if (swap) {
+      std::reverse(value, value + size);
+    }
+    if (type == BlobProto_RawType_DOUBLE) {
+      double v;
+      memcpy(&v, value, sizeof(v));  // NOLINT(caffe/alt_fn)
+      values[i] = static_cast<Dtype>(v);
+    } else {
+      float v;
+      memcpy(&v, value, sizeof(v));  // NOLINT(caffe/alt_fn)
+      values[i] = static_cast<Dtype>(v);
+    }
+  }
+}
+
+// Writes the shape and the values of blob as raw bytes, in a single copy.
+template <typename Dtype>
+static void WriteRawProto(const Blob<Dtype>& blob, BlobProto_RawType type,
+    bool write_diff, BlobProto* proto) {
+  proto->clear_shape();
+  for (int i = 0; i < blob.num_axes(); ++i) {
+    proto->mutable_shape()->add_dim(blob.shape(i));
+  }
+  proto->clear_data();
+  proto->clear_diff();
+  proto->clear_double_data();
+  proto->clear_double_diff();
+  proto->set_raw_type(type);
+  proto->set_raw_big_endian(IsBigEndian());
+  proto->set_raw_data(blob.cpu_data(), blob.count() * sizeof(Dtype));
+  if (write_diff) {
+    proto->set_raw_diff(blob.cpu_diff(), blob.count() * sizeof(Dtype));
+  } else {
+    proto->clear_raw_diff();
+  }
+}
+
 template <typename Dtype>
 void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
   if (reshape) {
@@ -487,7 +571,10 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
   }
   // copy data
   Dtype* data_vec = mutable_cpu_data();
-  if (proto.double_data_size() > 0) {
+  if (proto.has_raw_data()) {
+    CopyRawValues(proto.raw_data(), proto.raw_type(), proto.raw_big_endian(),
+        count_, data_vec);
+  } else if (proto.double_data_size() > 0) {
     CHECK_EQ(count_, proto.double_data_size());
     for (int i = 0; i < count_; ++i) {
       data_vec[i] = proto.double_data(i);
@@ -498,7 +585,10 @@ void Blob<Dtype>::FromProto(const BlobProto& proto, bool reshape) {
       data_vec[i] = proto.data(i);
     }
   }
-  if (proto.double_diff_size() > 0) {
+  if (proto.has_raw_diff()) {
+    CopyRawValues(proto.raw_diff(), proto.raw_type(), proto.raw_big_endian(),
+        count_, mutable_cpu_diff());
+  } else if (proto.double_diff_size() > 0) {
     CHECK_EQ(count_, proto.double_diff_size());
     Dtype* diff_vec = mutable_cpu_diff();
     for (int i = 0; i < count_; ++i) {
@@ -553,6 +643,16 @@ void Blob<float>::ToProto(BlobProto* proto, bool write_diff) const {
   }
 }
 
+template <>
+void Blob<double>::ToRawProto(BlobProto* proto, bool write_diff) const {
+  WriteRawProto(*this, BlobProto_RawType_DOUBLE, write_diff, proto);
+}
+
+template <>
+void Blob<float>::ToRawProto(BlobProto* proto, bool write_diff) const {
+  WriteRawProto(*this, BlobProto_RawType_FLOAT, write_diff, proto);
+}
+
 INSTANTIATE_CLASS(Blob);
 template class Blob<int>;
 template class Blob<unsigned int>;
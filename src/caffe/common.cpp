@@ -5,6 +5,7 @@
 #include <ctime>
 
 #include "caffe/common.hpp"
+#include "caffe/util/cpu_isa.hpp"
 #include "caffe/util/rng.hpp"
 
 namespace caffe {
@@ -47,6 +48,8 @@ void GlobalInit(int* pargc, char*** pargv) {
   ::google::InitGoogleLogging(*(pargv)[0]);
   // Provide a backtrace on segfault.
   ::google::InstallFailureSignalHandler();
+  // Pick the CPU kernels for this machine.
+  SelectedCpuIsa();
 }
 
 #ifdef CPU_ONLY  // CPU-only Caffe.
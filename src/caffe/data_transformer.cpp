@@ -524,8 +524,9 @@ void DataTransformer<Dtype>::InitRand() {
   const bool needs_rand = param_.mirror() ||
       (phase_ == TRAIN && param_.crop_size());
   if (needs_rand) {
-    const unsigned int rng_seed = caffe_rng_rand();
-    rng_.reset(new Caffe::RNG(rng_seed));
+    const uint32_t key0 = caffe_rng_rand();
+    const uint32_t key1 = caffe_rng_rand();
+    rng_.reset(new Philox(key0, key1));
   } else {
     rng_.reset();
   }
@@ -535,9 +536,7 @@ template <typename Dtype>
 int DataTransformer<Dtype>::Rand(int n) {
   CHECK(rng_);
   CHECK_GT(n, 0);
-  caffe::rng_t* rng =
-      static_cast<caffe::rng_t*>(rng_->generator());
-  return ((*rng)() % n);
+  return ((*rng_)() % n);
 }
 
 INSTANTIATE_CLASS(DataTransformer);
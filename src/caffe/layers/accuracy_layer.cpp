@@ -1,9 +1,8 @@
-#include <functional>
-#include <utility>
 #include <vector>
 
 #include "caffe/layers/accuracy_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/top_k.hpp"
 
 namespace caffe {
 
@@ -52,42 +51,43 @@ void AccuracyLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_label = bottom[1]->cpu_data();
   const int dim = bottom[0]->count() / outer_num_;
   const int num_labels = bottom[0]->shape(label_axis_);
-  vector<Dtype> maxval(top_k_+1);
-  vector<int> max_id(top_k_+1);
   if (top.size() > 1) {
     caffe_set(nums_buffer_.count(), Dtype(0), nums_buffer_.mutable_cpu_data());
     caffe_set(top[1]->count(), Dtype(0), top[1]->mutable_cpu_data());
   }
+  // The prediction is correct iff fewer than top_k scores rank before the
+  // score of the true label, which needs no sorting. Rank all instances in
+  // parallel, then count serially.
+  const int num = outer_num_ * inner_num_;
+  vector<int> ranks(num);
+#ifdef _OPENMP
+  #pragma omp parallel for
+#endif
+  for (int index = 0; index < num; ++index) {
+    const int i = index / inner_num_;
+    const int j = index % inner_num_;
+    const int label_value = static_cast<int>(bottom_label[index]);
+    if (has_ignore_label_ && label_value == ignore_label_) {
+      ranks[index] = -1;
+      continue;
+    }
+    DCHECK_GE(label_value, 0);
+    DCHECK_LT(label_value, num_labels);
+    ranks[index] = caffe_cpu_rank(num_labels, bottom_data + i * dim + j,
+        inner_num_, label_value);
+  }
   int count = 0;
-  for (int i = 0; i < outer_num_; ++i) {
-    for (int j = 0; j < inner_num_; ++j) {
-      const int label_value =
-          static_cast<int>(bottom_label[i * inner_num_ + j]);
-      if (has_ignore_label_ && label_value == ignore_label_) {
-        continue;
-      }
-      if (top.size() > 1) ++nums_buffer_.mutable_cpu_data()[label_value];
-      DCHECK_GE(label_value, 0);
-      DCHECK_LT(label_value, num_labels);
-      // Top-k accuracy
-      std::vector<std::pair<Dtype, int> > bottom_data_vector;
-      for (int k = 0; k < num_labels; ++k) {
-        bottom_data_vector.push_back(std::make_pair(
-            bottom_data[i * dim + k * inner_num_ + j], k));
-      }
-      std::partial_sort(
-          bottom_data_vector.begin(), bottom_data_vector.begin() + top_k_,
-          bottom_data_vector.end(), std::greater<std::pair<Dtype, int> >());
-      // check if true label is in top k predictions
-      for (int k = 0; k < top_k_; k++) {
-        if (bottom_data_vector[k].second == label_value) {
-          ++accuracy;
-          if (top.size() > 1) ++top[1]->mutable_cpu_data()[label_value];
-          break;
-        }
-      }
-      ++count;
+  for (int index = 0; index < num; ++index) {
+    if (ranks[index] < 0) {
+      continue;
+    }
+    const int label_value = static_cast<int>(bottom_label[index]);
+    if (top.size() > 1) ++nums_buffer_.mutable_cpu_data()[label_value];
+    if (ranks[index] < top_k_) {
+      ++accuracy;
+      if (top.size() > 1) ++top[1]->mutable_cpu_data()[label_value];
     }
+    ++count;
   }
 
   // LOG(INFO) << "Accuracy: " << accuracy;
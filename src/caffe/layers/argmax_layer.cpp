@@ -1,9 +1,7 @@
-#include <algorithm>
-#include <functional>
-#include <utility>
 #include <vector>
 
 #include "caffe/layers/argmax_layer.hpp"
+#include "caffe/util/top_k.hpp"
 
 namespace caffe {
 
@@ -65,31 +63,34 @@ void ArgMaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     dim = bottom[0]->count(1);
     axis_dist = 1;
   }
-  int num = bottom[0]->count() / dim;
-  std::vector<std::pair<Dtype, int> > bottom_data_vector(dim);
+  const int num = bottom[0]->count() / dim;
+  const int top_k = top_k_;
+  vector<Dtype> values(num * top_k);
+  vector<int> indices(num * top_k);
+#ifdef _OPENMP
+  #pragma omp parallel for
+#endif
   for (int i = 0; i < num; ++i) {
-    for (int j = 0; j < dim; ++j) {
-      bottom_data_vector[j] = std::make_pair(
-        bottom_data[(i / axis_dist * dim + j) * axis_dist + i % axis_dist], j);
-    }
-    std::partial_sort(
-        bottom_data_vector.begin(), bottom_data_vector.begin() + top_k_,
-        bottom_data_vector.end(), std::greater<std::pair<Dtype, int> >());
-    for (int j = 0; j < top_k_; ++j) {
+    Dtype* value = &values[i * top_k];
+    int* index = &indices[i * top_k];
+    caffe_cpu_top_k(dim,
+        bottom_data + i / axis_dist * dim * axis_dist + i % axis_dist,
+        axis_dist, top_k, value, index);
+    for (int j = 0; j < top_k; ++j) {
       if (out_max_val_) {
         if (has_axis_) {
           // Produces max_val per axis
-          top_data[(i / axis_dist * top_k_ + j) * axis_dist + i % axis_dist]
-            = bottom_data_vector[j].first;
+          top_data[(i / axis_dist * top_k + j) * axis_dist + i % axis_dist]
+            = value[j];
         } else {
           // Produces max_ind and max_val
-          top_data[2 * i * top_k_ + j] = bottom_data_vector[j].second;
-          top_data[2 * i * top_k_ + top_k_ + j] = bottom_data_vector[j].first;
+          top_data[2 * i * top_k + j] = index[j];
+          top_data[2 * i * top_k + top_k + j] = value[j];
         }
       } else {
         // Produces max_ind per axis
-        top_data[(i / axis_dist * top_k_ + j) * axis_dist + i % axis_dist]
-          = bottom_data_vector[j].second;
+        top_data[(i / axis_dist * top_k + j) * axis_dist + i % axis_dist]
+          = index[j];
       }
     }
   }
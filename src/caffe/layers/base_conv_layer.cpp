@@ -3,6 +3,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/grouped_conv.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -177,6 +178,26 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   kernel_dim_ = this->blobs_[0]->count(1);
   weight_offset_ = conv_out_channels_ * kernel_dim_ / group_;
+  // Narrow groups (e.g. depthwise) are convolved directly on the CPU: their
+  // per-group GEMMs are too small to make up for the im2col.
+  direct_grouped_ = !reverse_dimensions() && group_ > 1 &&
+      num_spatial_axes_ == 2 && !force_nd_im2col_ &&
+      channels_ / group_ <= kDirectGroupWidth;
+  packed_weights_.clear();
+  if (conv_param.pack_weights() && !reverse_dimensions() && !direct_grouped_) {
+    for (int g = 0; g < group_; ++g) {
+      packed_weights_.push_back(shared_ptr<PackedGemm<Dtype> >(
+          new PackedGemm<Dtype>(true, CblasNoTrans)));
+    }
+  }
+  sparse_weights_.reset();
+  // Training changes the weights on every iteration, which would rebuild the
+  // sparse copy before every forward pass.
+  if (conv_param.has_sparse_threshold() && this->phase_ == TEST &&
+      !reverse_dimensions() && !direct_grouped_) {
+    sparse_weights_.reset(new SparseWeights<Dtype>(this->layer_param_.name(),
+        false, conv_param.sparse_threshold()));
+  }
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
 }
@@ -262,12 +283,26 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     }
     col_buff = col_buffer_.cpu_data();
   }
-  for (int g = 0; g < group_; ++g) {
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
-        group_, conv_out_spatial_dim_, kernel_dim_,
-        (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
-        (Dtype)0., output + output_offset_ * g);
+  // The sparse and packed weights always come from the weight blob.
+  if (sparse_weights_ && sparse_weights_->Update(*this->blobs_[0])) {
+    DCHECK_EQ(weights, this->blobs_[0]->cpu_data());
+    sparse_weights_->MultiplyLeft(conv_out_spatial_dim_, group_, col_buff,
+        output);
+    return;
   }
+  if (!packed_weights_.empty()) {
+    DCHECK_EQ(weights, this->blobs_[0]->cpu_data());
+    for (int g = 0; g < group_; ++g) {
+      packed_weights_[g]->Gemm(conv_out_channels_ / group_,
+          conv_out_spatial_dim_, kernel_dim_, *this->blobs_[0],
+          weight_offset_ * g, col_buff + col_offset_ * g,
+          output + output_offset_ * g);
+    }
+    return;
+  }
+  caffe_cpu_gemm_batched<Dtype>(CblasNoTrans, CblasNoTrans,
+      conv_out_channels_ / group_, conv_out_spatial_dim_, kernel_dim_,
+      (Dtype)1., weights, col_buff, (Dtype)0., output, group_);
 }
 
 template <typename Dtype>
@@ -285,12 +320,9 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
   if (is_1x1_) {
     col_buff = input;
   }
-  for (int g = 0; g < group_; ++g) {
-    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
-        conv_out_spatial_dim_, conv_out_channels_ / group_,
-        (Dtype)1., weights + weight_offset_ * g, output + output_offset_ * g,
-        (Dtype)0., col_buff + col_offset_ * g);
-  }
+  caffe_cpu_gemm_batched<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
+      conv_out_spatial_dim_, conv_out_channels_ / group_,
+      (Dtype)1., weights, output, (Dtype)0., col_buff, group_);
   if (!is_1x1_) {
     conv_col2im_cpu(col_buff, input);
   }
@@ -304,12 +336,9 @@ void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
     conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
     col_buff = col_buffer_.cpu_data();
   }
-  for (int g = 0; g < group_; ++g) {
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
-        kernel_dim_, conv_out_spatial_dim_,
-        (Dtype)1., output + output_offset_ * g, col_buff + col_offset_ * g,
-        (Dtype)1., weights + weight_offset_ * g);
-  }
+  caffe_cpu_gemm_batched<Dtype>(CblasNoTrans, CblasTrans,
+      conv_out_channels_ / group_, kernel_dim_, conv_out_spatial_dim_,
+      (Dtype)1., output, col_buff, (Dtype)1., weights, group_);
 }
 
 template <typename Dtype>
@@ -319,6 +348,42 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
       input, bias_multiplier_.cpu_data(), 1., bias);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_direct(const Dtype* input,
+    const Dtype* weights, Dtype* output) {
+  grouped_conv_forward_cpu(input, num_, channels_,
+      conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+      weights, num_output_, group_,
+      kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+      pad_.cpu_data()[0], pad_.cpu_data()[1],
+      stride_.cpu_data()[0], stride_.cpu_data()[1],
+      dilation_.cpu_data()[0], dilation_.cpu_data()[1], output);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_direct(const Dtype* output,
+    const Dtype* weights, Dtype* input) {
+  grouped_conv_backward_data_cpu(output, num_, channels_,
+      conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+      weights, num_output_, group_,
+      kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+      pad_.cpu_data()[0], pad_.cpu_data()[1],
+      stride_.cpu_data()[0], stride_.cpu_data()[1],
+      dilation_.cpu_data()[0], dilation_.cpu_data()[1], input);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_direct(const Dtype* input,
+    const Dtype* output, Dtype* weights) {
+  grouped_conv_backward_weight_cpu(input, output, num_, channels_,
+      conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+      num_output_, group_,
+      kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+      pad_.cpu_data()[0], pad_.cpu_data()[1],
+      stride_.cpu_data()[0], stride_.cpu_data()[1],
+      dilation_.cpu_data()[0], dilation_.cpu_data()[1], weights);
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
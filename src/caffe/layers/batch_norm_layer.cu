@@ -58,16 +58,18 @@ void BatchNormLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
         num_by_chans_.gpu_data(), batch_sum_multiplier_.gpu_data(), Dtype(0.),
         variance_.mutable_gpu_data());  // E((X_EX)^2)
 
-    // compute and save moving average
-    this->blobs_[2]->mutable_cpu_data()[0] *= moving_average_fraction_;
-    this->blobs_[2]->mutable_cpu_data()[0] += 1;
-    caffe_gpu_axpby(mean_.count(), Dtype(1), mean_.gpu_data(),
-        moving_average_fraction_, this->blobs_[0]->mutable_gpu_data());
-    int m = bottom[0]->count()/channels_;
-    Dtype bias_correction_factor = m > 1 ? Dtype(m)/(m-1) : 1;
-    caffe_gpu_axpby(variance_.count(), bias_correction_factor,
-        variance_.gpu_data(), moving_average_fraction_,
-        this->blobs_[1]->mutable_gpu_data());
+    // compute and save moving average, once per batch
+    if (!this->recomputing_) {
+      this->blobs_[2]->mutable_cpu_data()[0] *= moving_average_fraction_;
+      this->blobs_[2]->mutable_cpu_data()[0] += 1;
+      caffe_gpu_axpby(mean_.count(), Dtype(1), mean_.gpu_data(),
+          moving_average_fraction_, this->blobs_[0]->mutable_gpu_data());
+      int m = bottom[0]->count()/channels_;
+      Dtype bias_correction_factor = m > 1 ? Dtype(m)/(m-1) : 1;
+      caffe_gpu_axpby(variance_.count(), bias_correction_factor,
+          variance_.gpu_data(), moving_average_fraction_,
+          this->blobs_[1]->mutable_gpu_data());
+    }
   }
 
   // normalize variance
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/bnll_layer.hpp"
@@ -13,10 +14,23 @@ void BNLLLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = bottom_data[i] > 0 ?
-        bottom_data[i] + log(1. + exp(-bottom_data[i])) :
-        log(1. + exp(bottom_data[i]));
+  // log(1 + exp(x)) = max(x, 0) + log(1 + exp(-|x|)), computed a block at a
+  // time with caffe_exp and caffe_log.
+  const int kBlock = 1024;
+  Dtype softplus[kBlock];
+  for (int start = 0; start < count; start += kBlock) {
+    const int n = std::min(kBlock, count - start);
+    const Dtype* x = bottom_data + start;
+    for (int i = 0; i < n; ++i) {
+      softplus[i] = -std::abs(x[i]);
+    }
+    caffe_exp(n, softplus, softplus);
+    caffe_add_scalar(n, Dtype(1), softplus);
+    caffe_log(n, softplus, softplus);
+    Dtype* y = top_data + start;
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::max(x[i], Dtype(0)) + softplus[i];
+    }
   }
 }
 
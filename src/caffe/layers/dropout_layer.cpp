@@ -25,6 +25,9 @@ void DropoutLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   // Set up the cache for random number generation
   // ReshapeLike does not work because rand_vec_ is of Dtype uint
   rand_vec_.Reshape(bottom[0]->shape());
+  // The CPU mask only needs one bit per input. Blob memory is allocated on
+  // first use, so each device only pays for the mask it uses.
+  mask_bits_.Reshape(vector<int>(1, caffe_mask_words(bottom[0]->count())));
 }
 
 template <typename Dtype>
@@ -32,14 +35,14 @@ void DropoutLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  unsigned int* mask = rand_vec_.mutable_cpu_data();
   const int count = bottom[0]->count();
   if (this->phase_ == TRAIN) {
-    // Create random numbers
-    caffe_rng_bernoulli(count, 1. - threshold_, mask);
-    for (int i = 0; i < count; ++i) {
-      top_data[i] = bottom_data[i] * mask[i] * scale_;
+    // Create random numbers, or reuse them when recomputing the same batch
+    unsigned int* mask = mask_bits_.mutable_cpu_data();
+    if (!this->recomputing_) {
+      caffe_rng_bernoulli_mask(count, 1. - threshold_, mask);
     }
+    caffe_cpu_mask_scale(count, mask, bottom_data, scale_, Dtype(0), top_data);
   } else {
     caffe_copy(bottom[0]->count(), bottom_data, top_data);
   }
@@ -53,11 +56,9 @@ void DropoutLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     if (this->phase_ == TRAIN) {
-      const unsigned int* mask = rand_vec_.cpu_data();
-      const int count = bottom[0]->count();
-      for (int i = 0; i < count; ++i) {
-        bottom_diff[i] = top_diff[i] * mask[i] * scale_;
-      }
+      const unsigned int* mask = mask_bits_.cpu_data();
+      caffe_cpu_mask_scale(bottom[0]->count(), mask, top_diff, scale_,
+          Dtype(0), bottom_diff);
     } else {
       caffe_copy(top[0]->count(), top_diff, bottom_diff);
     }
@@ -1,4 +1,3 @@
-#include <cfloat>
 #include <vector>
 
 #include "caffe/layers/eltwise_layer.hpp"
@@ -40,15 +39,52 @@ void EltwiseLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (this->layer_param_.eltwise_param().operation() ==
       EltwiseParameter_EltwiseOp_MAX && top.size() == 1) {
     max_idx_.Reshape(bottom[0]->shape());
+    const size_t bottom_idx_size = top[0]->count() * sizeof(uint8_t);
+    if (bottom.size() <= 256 && (!max_bottom_idx_ ||
+        max_bottom_idx_->size() < bottom_idx_size)) {
+      max_bottom_idx_.reset(new SyncedMemory(bottom_idx_size));
+    }
+  }
+}
+
+// Takes the elementwise max over the bottoms, recording the index of the
+// winning bottom in mask.
+template <typename Dtype, typename Itype>
+static void eltwise_max_forward(const vector<Blob<Dtype>*>& bottom,
+    const int count, Dtype* top_data, Itype* mask) {
+  // bottom 0 & 1
+  const Dtype* bottom_data_a = bottom[0]->cpu_data();
+  const Dtype* bottom_data_b = bottom[1]->cpu_data();
+  for (int idx = 0; idx < count; ++idx) {
+    const bool a_wins = bottom_data_a[idx] > bottom_data_b[idx];
+    top_data[idx] = a_wins ? bottom_data_a[idx] : bottom_data_b[idx];  // maxval
+    mask[idx] = a_wins ? 0 : 1;  // maxid
+  }
+  // bottom 2++
+  for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
+    bottom_data_b = bottom[blob_idx]->cpu_data();
+    for (int idx = 0; idx < count; ++idx) {
+      if (bottom_data_b[idx] > top_data[idx]) {
+        top_data[idx] = bottom_data_b[idx];  // maxval
+        mask[idx] = blob_idx;  // maxid
+      }
+    }
+  }
+}
+
+// Routes top_diff to the bottom that won the max.
+template <typename Dtype, typename Itype>
+static void eltwise_max_backward(const int count, const Itype* mask,
+    const int bottom_id, const Dtype* top_diff, Dtype* bottom_diff) {
+  const Itype id = static_cast<Itype>(bottom_id);
+  for (int index = 0; index < count; ++index) {
+    bottom_diff[index] = (mask[index] == id) ? top_diff[index] : Dtype(0);
   }
 }
 
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  int* mask = NULL;
-  const Dtype* bottom_data_a = NULL;
-  const Dtype* bottom_data_b = NULL;
   const int count = top[0]->count();
   Dtype* top_data = top[0]->mutable_cpu_data();
   switch (op_) {
@@ -66,31 +102,12 @@ void EltwiseLayer<Dtype>::Forward_cpu(
     }
     break;
   case EltwiseParameter_EltwiseOp_MAX:
-    // Initialize
-    mask = max_idx_.mutable_cpu_data();
-    caffe_set(count, -1, mask);
-    caffe_set(count, Dtype(-FLT_MAX), top_data);
-    // bottom 0 & 1
-    bottom_data_a = bottom[0]->cpu_data();
-    bottom_data_b = bottom[1]->cpu_data();
-    for (int idx = 0; idx < count; ++idx) {
-      if (bottom_data_a[idx] > bottom_data_b[idx]) {
-        top_data[idx] = bottom_data_a[idx];  // maxval
-        mask[idx] = 0;  // maxid
-      } else {
-        top_data[idx] = bottom_data_b[idx];  // maxval
-        mask[idx] = 1;  // maxid
-      }
-    }
-    // bottom 2++
-    for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
-      bottom_data_b = bottom[blob_idx]->cpu_data();
-      for (int idx = 0; idx < count; ++idx) {
-        if (bottom_data_b[idx] > top_data[idx]) {
-          top_data[idx] = bottom_data_b[idx];  // maxval
-          mask[idx] = blob_idx;  // maxid
-        }
-      }
+    if (max_bottom_idx_) {
+      eltwise_max_forward(bottom, count, top_data,
+          static_cast<uint8_t*>(max_bottom_idx_->mutable_cpu_data()));
+    } else {
+      eltwise_max_forward(bottom, count, top_data,
+          max_idx_.mutable_cpu_data());
     }
     break;
   default:
@@ -101,7 +118,6 @@ void EltwiseLayer<Dtype>::Forward_cpu(
 template <typename Dtype>
 void EltwiseLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-  const int* mask = NULL;
   const int count = top[0]->count();
   const Dtype* top_data = top[0]->cpu_data();
   const Dtype* top_diff = top[0]->cpu_diff();
@@ -136,13 +152,13 @@ void EltwiseLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
         }
         break;
       case EltwiseParameter_EltwiseOp_MAX:
-        mask = max_idx_.cpu_data();
-        for (int index = 0; index < count; ++index) {
-          Dtype gradient = 0;
-          if (mask[index] == i) {
-            gradient += top_diff[index];
-          }
-          bottom_diff[index] = gradient;
+        if (max_bottom_idx_) {
+          eltwise_max_backward(count,
+              static_cast<const uint8_t*>(max_bottom_idx_->cpu_data()), i,
+              top_diff, bottom_diff);
+        } else {
+          eltwise_max_backward(count, max_idx_.cpu_data(), i, top_diff,
+              bottom_diff);
         }
         break;
       default:
@@ -12,9 +12,21 @@ void ELULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype alpha = this->layer_param_.elu_param().alpha();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + alpha * (exp(std::min(bottom_data[i], Dtype(0))) - Dtype(1));
+  // Exponentiate a block at a time with caffe_exp, which stays correct when
+  // the layer runs in place.
+  const int kBlock = 1024;
+  Dtype negative_exp[kBlock];
+  for (int start = 0; start < count; start += kBlock) {
+    const int n = std::min(kBlock, count - start);
+    const Dtype* x = bottom_data + start;
+    for (int i = 0; i < n; ++i) {
+      negative_exp[i] = std::min(x[i], Dtype(0));
+    }
+    caffe_exp(n, negative_exp, negative_exp);
+    Dtype* y = top_data + start;
+    for (int i = 0; i < n; ++i) {
+      y[i] = std::max(x[i], Dtype(0)) + alpha * (negative_exp[i] - Dtype(1));
+    }
   }
 }
 
@@ -14,6 +14,8 @@ void EmbedLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   K_ = this->layer_param_.embed_param().input_dim();
   CHECK_GT(K_, 0) << "EmbedLayer input_dim must be positive.";
   bias_term_ = this->layer_param_.embed_param().bias_term();
+  sparse_gradient_ = this->layer_param_.embed_param().sparse_gradient();
+  diff_rows_.clear();
   // Check if we need to set up the weights
   if (this->blobs_.size() > 0) {
     LOG(INFO) << "Skipping parameter initialization";
@@ -92,6 +94,7 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     // Gradient with respect to weight
     Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
     int index;
+    if (sparse_gradient_) { diff_rows_.resize(M_); }
     for (int n = 0; n < M_; ++n) {
       index = static_cast<int>(bottom_data[n]);
       DCHECK_GE(index, 0);
@@ -99,6 +102,7 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       DCHECK_EQ(static_cast<Dtype>(index), bottom_data[n])
           << "non-integer input";
       caffe_axpy(N_, Dtype(1), top_diff + n * N_, weight_diff + index * N_);
+      if (sparse_gradient_) { diff_rows_[n] = index; }
     }
   }
   if (bias_term_ && this->param_propagate_down_[1]) {
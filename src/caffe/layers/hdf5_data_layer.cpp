@@ -1,11 +1,5 @@
-/*
-TODO:
-- load file in a separate thread ("prefetch")
-- can be smarter about the memcpy call instead of doing it row-by-row
-  :: use util functions caffe_copy, and Blob->offset()
-  :: don't forget to update hdf5_daa_layer.cu accordingly
-- add ability to shuffle filenames if flag is set
-*/
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
@@ -20,58 +14,152 @@ TODO:
 namespace caffe {
 
 template <typename Dtype>
-HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() { }
+HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {
+  this->StopInternalThread();
+}
 
-// Load data and label from HDF5 filename into the class property blobs.
+// Load rows of data and label from HDF5 filename into the chunk's blobs.
 template <typename Dtype>
-void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
-  DLOG(INFO) << "Loading HDF5 file: " << filename;
+hsize_t HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename,
+    hsize_t start, Chunk* chunk) {
+  DLOG(INFO) << "Loading HDF5 file: " << filename << " from row " << start;
+  // Other data layers and snapshots may be using HDF5 meanwhile.
+  HDF5Lock lock;
   hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
   if (file_id < 0) {
     LOG(FATAL) << "Failed opening HDF5 file: " << filename;
   }
 
   int top_size = this->layer_param_.top_size();
-  hdf_blobs_.resize(top_size);
+  chunk->blobs.resize(top_size);
 
   const int MIN_DATA_DIM = 1;
   const int MAX_DATA_DIM = INT_MAX;
 
+  // The blobs of a chunk are reused, so that their memory only grows.
+  const hsize_t chunk_size = this->layer_param_.hdf5_data_param().chunk_size();
+  hsize_t num_rows = 0;
   for (int i = 0; i < top_size; ++i) {
-    hdf_blobs_[i] = shared_ptr<Blob<Dtype> >(new Blob<Dtype>());
-    // Allow reshape here, as we are loading data not params
-    hdf5_load_nd_dataset(file_id, this->layer_param_.top(i).c_str(),
-        MIN_DATA_DIM, MAX_DATA_DIM, hdf_blobs_[i].get(), true);
+    if (!chunk->blobs[i]) {
+      chunk->blobs[i].reset(new Blob<Dtype>());
+    }
+    const hsize_t rows = hdf5_load_nd_dataset_rows(file_id,
+        this->layer_param_.top(i).c_str(), MIN_DATA_DIM, MAX_DATA_DIM, start,
+        chunk_size, chunk->blobs[i].get());
+    if (i == 0) {
+      num_rows = rows;
+    }
+    CHECK_EQ(rows, num_rows);
   }
 
   herr_t status = H5Fclose(file_id);
   CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
 
-  // MinTopBlobs==1 guarantees at least one top blob
-  CHECK_GE(hdf_blobs_[0]->num_axes(), 1) << "Input must have at least 1 axis.";
-  const int num = hdf_blobs_[0]->shape(0);
-  for (int i = 1; i < top_size; ++i) {
-    CHECK_EQ(hdf_blobs_[i]->shape(0), num);
-  }
   // Default to identity permutation.
-  data_permutation_.clear();
-  data_permutation_.resize(hdf_blobs_[0]->shape(0));
-  for (int i = 0; i < hdf_blobs_[0]->shape(0); i++)
-    data_permutation_[i] = i;
+  const int num = chunk->blobs[0]->shape(0);
+  chunk->permutation.resize(num);
+  for (int i = 0; i < num; i++)
+    chunk->permutation[i] = i;
 
   // Shuffle if needed.
   if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
-    DLOG(INFO) << "Successfully loaded " << hdf_blobs_[0]->shape(0)
-               << " rows (shuffled)";
+    std::random_shuffle(chunk->permutation.begin(), chunk->permutation.end());
+    DLOG(INFO) << "Successfully loaded " << num << " rows (shuffled)";
   } else {
-    DLOG(INFO) << "Successfully loaded " << hdf_blobs_[0]->shape(0) << " rows";
+    DLOG(INFO) << "Successfully loaded " << num << " rows";
+  }
+  return num_rows;
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::LoadChunk(Chunk* chunk) {
+  const hsize_t num_rows = LoadHDF5FileData(
+      hdf_filenames_[file_permutation_[current_file_]].c_str(), file_row_,
+      chunk);
+  file_row_ += chunk->blobs[0]->shape(0);
+  if (file_row_ == num_rows) {
+    file_row_ = 0;
+    if (++current_file_ == num_files_) {
+      current_file_ = 0;
+      if (this->layer_param_.hdf5_data_param().shuffle()) {
+        std::random_shuffle(file_permutation_.begin(),
+                            file_permutation_.end());
+      }
+      DLOG(INFO) << "Looping around to first file.";
+    }
+  }
+}
+
+template <typename Dtype>
+int HDF5DataLayer<Dtype>::MaxChunkRows() {
+  const hsize_t chunk_size = this->layer_param_.hdf5_data_param().chunk_size();
+  const char* dataset_name = this->layer_param_.top(0).c_str();
+  hsize_t max_rows = 0;
+  HDF5Lock lock;
+  for (int i = 0; i < num_files_ && (!chunk_size || max_rows < chunk_size);
+       ++i) {
+    const char* filename = hdf_filenames_[i].c_str();
+    hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+    CHECK_GE(file_id, 0) << "Failed opening HDF5 file: " << filename;
+    int ndims;
+    herr_t status = H5LTget_dataset_ndims(file_id, dataset_name, &ndims);
+    CHECK_GE(status, 0) << "Failed to get dataset ndims for " << dataset_name;
+    std::vector<hsize_t> dims(ndims);
+    H5T_class_t class_;
+    size_t type_size;
+    status = H5LTget_dataset_info(file_id, dataset_name, &dims[0], &class_,
+        &type_size);
+    CHECK_GE(status, 0) << "Failed to get dataset info for " << dataset_name;
+    const hsize_t rows = chunk_size ? std::min(dims[0], chunk_size) : dims[0];
+    max_rows = std::max(max_rows, rows);
+    status = H5Fclose(file_id);
+    CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+  }
+  return max_rows;
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::AllocateChunks(int rows) {
+  const int top_size = this->layer_param_.top_size();
+  for (int j = 0; j < top_size; ++j) {
+    vector<int> shape = hdf_blobs_[j]->shape();
+    shape[0] = rows;
+    for (int i = 0; i < chunks_.size(); ++i) {
+      chunks_[i]->blobs.push_back(
+          shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
+      chunks_[i]->blobs[j]->mutable_cpu_data();
+    }
+    // The first chunk goes back to be loaded into once output, so it grows
+    // too; shrinking a blob keeps its memory and data.
+    shared_ptr<Blob<Dtype> > blob(new Blob<Dtype>(shape));
+    caffe_copy(hdf_blobs_[j]->count(), hdf_blobs_[j]->cpu_data(),
+        blob->mutable_cpu_data());
+    blob->Reshape(hdf_blobs_[j]->shape());
+    hdf_blobs_[j] = blob;
+  }
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      const int index = free_chunks_.pop();
+      LoadChunk(chunks_[index].get());
+      full_chunks_.push(index);
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
   }
 }
 
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  // Stop reading ahead for a previous setup.
+  this->StopInternalThread();
+  int index;
+  while (free_chunks_.try_pop(&index)) { }
+  while (full_chunks_.try_pop(&index)) { }
   // Refuse transformation parameters since HDF5 is totally generic.
   CHECK(!this->layer_param_.has_transform_param()) <<
       this->type() << " does not transform data.";
@@ -90,7 +178,6 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   source_file.close();
   num_files_ = hdf_filenames_.size();
-  current_file_ = 0;
   LOG(INFO) << "Number of HDF5 files: " << num_files_;
   CHECK_GE(num_files_, 1) << "Must have at least 1 HDF5 filename listed in "
     << source;
@@ -107,10 +194,34 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
   }
 
-  // Load the first HDF5 file and initialize the line counter.
-  LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  // Load the first chunk and initialize the line counter.
+  current_file_ = 0;
+  file_row_ = 0;
+  Chunk chunk;
+  LoadChunk(&chunk);
+  hdf_blobs_.swap(chunk.blobs);
+  data_permutation_.swap(chunk.permutation);
   current_row_ = 0;
 
+  // Unless the first chunk holds all the data, read the next ones ahead.
+  if (num_files_ > 1 || file_row_ > 0) {
+    const int prefetch = this->layer_param_.hdf5_data_param().prefetch();
+    CHECK_GT(prefetch, 0) << "Must read at least one chunk ahead";
+    chunks_.resize(prefetch);
+    for (int i = 0; i < prefetch; ++i) {
+      chunks_[i].reset(new Chunk());
+      free_chunks_.push(i);
+    }
+    // In GPU mode, blob memory is pinned by cudaMallocHost, which should not
+    // run on the prefetch thread while the main thread uses CUDA, so the
+    // chunks are allocated here for the largest of them, as
+    // BasePrefetchingDataLayer does for its batches.
+    if (Caffe::mode() == Caffe::GPU) {
+      AllocateChunks(MaxChunkRows());
+    }
+    StartInternalThread();
+  }
+
   // Reshape blobs.
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
   const int top_size = this->layer_param_.top_size();
@@ -126,10 +237,10 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 }
 
 template <typename Dtype>
-bool HDF5DataLayer<Dtype>::Skip() {
+bool HDF5DataLayer<Dtype>::Skip(uint64_t offset) const {
   int size = Caffe::solver_count();
   int rank = Caffe::solver_rank();
-  bool keep = (offset_ % size) == rank ||
+  bool keep = (offset % size) == rank ||
               // In test mode, only rank 0 runs, so avoid skipping
               this->layer_param_.phase() == TEST;
   return !keep;
@@ -138,41 +249,52 @@ bool HDF5DataLayer<Dtype>::Skip() {
 template<typename Dtype>
 void HDF5DataLayer<Dtype>::Next() {
   if (++current_row_ == hdf_blobs_[0]->shape(0)) {
-    if (num_files_ > 1) {
-      ++current_file_;
-      if (current_file_ == num_files_) {
-        current_file_ = 0;
-        if (this->layer_param_.hdf5_data_param().shuffle()) {
-          std::random_shuffle(file_permutation_.begin(),
-                              file_permutation_.end());
-        }
-        DLOG(INFO) << "Looping around to first file.";
-      }
-      LoadHDF5FileData(
-        hdf_filenames_[file_permutation_[current_file_]].c_str());
+    if (is_started()) {
+      // Swap in the next chunk, and hand the current one back to be loaded.
+      const int index = full_chunks_.pop("Waiting for HDF5 data");
+      hdf_blobs_.swap(chunks_[index]->blobs);
+      data_permutation_.swap(chunks_[index]->permutation);
+      free_chunks_.push(index);
+    } else if (this->layer_param_.hdf5_data_param().shuffle()) {
+      std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
     }
     current_row_ = 0;
-    if (this->layer_param_.hdf5_data_param().shuffle())
-      std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
   }
   offset_++;
 }
 
+template <typename Dtype>
+int HDF5DataLayer<Dtype>::ContiguousRows(int max_rows) const {
+  const hsize_t num_rows = hdf_blobs_[0]->shape(0);
+  const unsigned int first = data_permutation_[current_row_];
+  int rows = 1;
+  while (rows < max_rows && current_row_ + rows < num_rows &&
+         data_permutation_[current_row_ + rows] == first + rows &&
+         !Skip(offset_ + rows)) {
+    ++rows;
+  }
+  return rows;
+}
+
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  for (int i = 0; i < batch_size; ++i) {
+  for (int i = 0; i < batch_size; ) {
     while (Skip()) {
       Next();
     }
+    const int rows = ContiguousRows(batch_size - i);
     for (int j = 0; j < this->layer_param_.top_size(); ++j) {
       int data_dim = top[j]->count() / top[j]->shape(0);
-      caffe_copy(data_dim,
+      caffe_copy(rows * data_dim,
           &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_]
             * data_dim], &top[j]->mutable_cpu_data()[i * data_dim]);
     }
-    Next();
+    for (int k = 0; k < rows; ++k) {
+      Next();
+    }
+    i += rows;
   }
 }
 
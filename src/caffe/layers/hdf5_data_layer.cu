@@ -1,8 +1,3 @@
-/*
-TODO:
-- only load parts of the file, in accordance with a prototxt param "max_mem"
-*/
-
 #include <stdint.h>
 #include <vector>
 
@@ -17,17 +12,21 @@ template <typename Dtype>
 void HDF5DataLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  for (int i = 0; i < batch_size; ++i) {
+  for (int i = 0; i < batch_size; ) {
     while (Skip()) {
       Next();
     }
+    const int rows = ContiguousRows(batch_size - i);
     for (int j = 0; j < this->layer_param_.top_size(); ++j) {
       int data_dim = top[j]->count() / top[j]->shape(0);
-      caffe_copy(data_dim,
+      caffe_copy(rows * data_dim,
           &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_]
             * data_dim], &top[j]->mutable_gpu_data()[i * data_dim]);
     }
-    Next();
+    for (int k = 0; k < rows; ++k) {
+      Next();
+    }
+    i += rows;
   }
 }
 
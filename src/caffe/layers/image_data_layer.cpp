@@ -1,8 +1,11 @@
 #ifdef USE_OPENCV
+#include <boost/filesystem.hpp>
 #include <opencv2/core/core.hpp>
 
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -11,6 +14,7 @@
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/layers/image_data_layer.hpp"
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/image_cache.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
@@ -27,7 +31,6 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int new_height = this->layer_param_.image_data_param().new_height();
   const int new_width  = this->layer_param_.image_data_param().new_width();
-  const bool is_color  = this->layer_param_.image_data_param().is_color();
   string root_folder = this->layer_param_.image_data_param().root_folder();
 
   CHECK((new_height == 0 && new_width == 0) ||
@@ -48,6 +51,14 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
 
   CHECK(!lines_.empty()) << "File is empty";
 
+  const ImageDataParameter& image_data_param =
+      this->layer_param_.image_data_param();
+  if (image_data_param.cache_size() > 0) {
+    cache_ = ImageCache::Open(
+        static_cast<size_t>(image_data_param.cache_size()) << 20,
+        image_data_param.cache_name());
+  }
+
   if (this->layer_param_.image_data_param().shuffle()) {
     // randomly shuffle data
     LOG(INFO) << "Shuffling data";
@@ -72,8 +83,7 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     lines_id_ = skip;
   }
   // Read an image, and use it to initialize the top blob.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-                                    new_height, new_width, is_color);
+  cv::Mat cv_img = ReadImage(root_folder + lines_[lines_id_].first);
   CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
   // Use data_transformer to infer the expected blob shape from a cv_image.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
@@ -105,6 +115,47 @@ void ImageDataLayer<Dtype>::ShuffleImages() {
   shuffle(lines_.begin(), lines_.end(), prefetch_rng);
 }
 
+template <typename Dtype>
+cv::Mat ImageDataLayer<Dtype>::ReadImage(const string& filename) {
+  const ImageDataParameter& image_data_param =
+      this->layer_param_.image_data_param();
+  const int new_height = image_data_param.new_height();
+  const int new_width = image_data_param.new_width();
+  const bool is_color = image_data_param.is_color();
+  if (!cache_) {
+    return ReadImageToCVMat(filename, new_height, new_width, is_color);
+  }
+  // The size and modification time of the file are part of the key, so that
+  // images changed since they were cached are read again.
+  boost::system::error_code size_error, time_error;
+  const boost::uintmax_t file_size =
+      boost::filesystem::file_size(filename, size_error);
+  const std::time_t file_time =
+      boost::filesystem::last_write_time(filename, time_error);
+  if (size_error || time_error) {
+    return ReadImageToCVMat(filename, new_height, new_width, is_color);
+  }
+  std::ostringstream key_stream;
+  key_stream << filename << ":" << file_size << ":" << file_time
+      << (is_color ? ":color:" : ":gray:") << new_height << "x" << new_width;
+  const string key = key_stream.str();
+  vector<int> shape;
+  if (cache_->Get(key, &shape, &cache_buffer_)) {
+    return cv::Mat(shape[0], shape[1], CV_8UC(shape[2]), &cache_buffer_[0]);
+  }
+  cv::Mat cv_img = ReadImageToCVMat(filename, new_height, new_width,
+      is_color);
+  if (cv_img.data) {
+    CHECK(cv_img.isContinuous() && cv_img.depth() == CV_8U);
+    shape.resize(3);
+    shape[0] = cv_img.rows;
+    shape[1] = cv_img.cols;
+    shape[2] = cv_img.channels();
+    cache_->Put(key, shape, reinterpret_cast<const char*>(cv_img.data));
+  }
+  return cv_img;
+}
+
 // This function is called on prefetch thread
 template <typename Dtype>
 void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
@@ -117,15 +168,11 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CHECK(this->transformed_data_.count());
   ImageDataParameter image_data_param = this->layer_param_.image_data_param();
   const int batch_size = image_data_param.batch_size();
-  const int new_height = image_data_param.new_height();
-  const int new_width = image_data_param.new_width();
-  const bool is_color = image_data_param.is_color();
   string root_folder = image_data_param.root_folder();
 
   // Reshape according to the first image of each batch
   // on single input batches allows for inputs of varying dimension.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-      new_height, new_width, is_color);
+  cv::Mat cv_img = ReadImage(root_folder + lines_[lines_id_].first);
   CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
   // Use data_transformer to infer the expected blob shape from a cv_img.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
@@ -143,8 +190,7 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
     // get a blob
     timer.Start();
     CHECK_GT(lines_size, lines_id_);
-    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-        new_height, new_width, is_color);
+    cv::Mat cv_img = ReadImage(root_folder + lines_[lines_id_].first);
     CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
     read_time += timer.MicroSeconds();
     timer.Start();
@@ -160,6 +206,13 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
     if (lines_id_ >= lines_size) {
       // We have reached the end. Restart from the first.
       DLOG(INFO) << "Restarting data prefetching from start.";
+      if (cache_) {
+        const uint64_t lookups = cache_->hits() + cache_->misses();
+        LOG(INFO) << "Image cache: " << cache_->size() << " images, "
+            << (cache_->bytes() >> 20) << " MB, hit rate "
+            << 100. * cache_->hits() / std::max<uint64_t>(lookups, 1)
+            << "%, " << cache_->evictions() << " evictions";
+      }
       lines_id_ = 0;
       if (this->layer_param_.image_data_param().shuffle()) {
         ShuffleImages();
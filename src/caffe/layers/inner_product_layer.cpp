@@ -52,6 +52,18 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }  // parameter initialization
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  if (this->layer_param_.inner_product_param().pack_weights()) {
+    packed_weights_.reset(new PackedGemm<Dtype>(false,
+        transpose_ ? CblasNoTrans : CblasTrans));
+  }
+  const InnerProductParameter& param =
+      this->layer_param_.inner_product_param();
+  // Training changes the weights on every iteration, which would rebuild the
+  // sparse copy before every forward pass.
+  if (param.has_sparse_threshold() && this->phase_ == TEST) {
+    sparse_weights_.reset(new SparseWeights<Dtype>(this->layer_param_.name(),
+        transpose_, param.sparse_threshold()));
+  }
 }
 
 template <typename Dtype>
@@ -85,10 +97,17 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  if (sparse_weights_ && sparse_weights_->Update(*this->blobs_[0])) {
+    sparse_weights_->MultiplyRight(M_, bottom_data, top_data);
+  } else if (packed_weights_) {
+    packed_weights_->Gemm(M_, N_, K_, *this->blobs_[0], 0, bottom_data,
+        top_data);
+  } else {
+    const Dtype* weight = this->blobs_[0]->cpu_data();
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
+        M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
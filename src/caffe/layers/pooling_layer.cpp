@@ -10,6 +10,9 @@ namespace caffe {
 using std::min;
 using std::max;
 
+// Marks a max pooling window that had no maximum (e.g. all NaN).
+static const uint8_t kNoWindowIndex = 255;
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -109,10 +112,17 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     top[1]->ReshapeLike(*top[0]);
   }
   // If max pooling, we will initialize the vector index part.
+  use_window_idx_ = false;
   if (this->layer_param_.pooling_param().pool() ==
       PoolingParameter_PoolMethod_MAX && top.size() == 1) {
     max_idx_.Reshape(bottom[0]->num(), channels_, pooled_height_,
         pooled_width_);
+    use_window_idx_ = kernel_h_ * kernel_w_ < kNoWindowIndex;
+    const size_t window_idx_size = top[0]->count() * sizeof(uint8_t);
+    if (use_window_idx_ && (!max_window_idx_ ||
+        max_window_idx_->size() < window_idx_size)) {
+      max_window_idx_.reset(new SyncedMemory(window_idx_size));
+    }
   }
   // If stochastic pooling, we will initialize the random index part.
   if (this->layer_param_.pooling_param().pool() ==
@@ -133,6 +143,7 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
   int* mask = NULL;  // suppress warnings about uninitalized variables
+  uint8_t* window_mask = NULL;
   Dtype* top_mask = NULL;
   // Different pooling methods. We explicitly do the switch outside the for
   // loop to save time, although this results in more code.
@@ -142,6 +153,9 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     if (use_top_mask) {
       top_mask = top[1]->mutable_cpu_data();
       caffe_set(top_count, Dtype(-1), top_mask);
+    } else if (use_window_idx_) {
+      window_mask = static_cast<uint8_t*>(max_window_idx_->mutable_cpu_data());
+      caffe_memset(top_count, kNoWindowIndex, window_mask);
     } else {
       mask = max_idx_.mutable_cpu_data();
       caffe_set(top_count, -1, mask);
@@ -152,12 +166,12 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       for (int c = 0; c < channels_; ++c) {
         for (int ph = 0; ph < pooled_height_; ++ph) {
           for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
+            const int hwindow = ph * stride_h_ - pad_h_;
+            const int wwindow = pw * stride_w_ - pad_w_;
+            int hend = min(hwindow + kernel_h_, height_);
+            int wend = min(wwindow + kernel_w_, width_);
+            int hstart = max(hwindow, 0);
+            int wstart = max(wwindow, 0);
             const int pool_index = ph * pooled_width_ + pw;
             for (int h = hstart; h < hend; ++h) {
               for (int w = wstart; w < wend; ++w) {
@@ -166,6 +180,9 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                   top_data[pool_index] = bottom_data[index];
                   if (use_top_mask) {
                     top_mask[pool_index] = static_cast<Dtype>(index);
+                  } else if (use_window_idx_) {
+                    window_mask[pool_index] = (h - hwindow) * kernel_w_
+                        + (w - wwindow);
                   } else {
                     mask[pool_index] = index;
                   }
@@ -179,6 +196,8 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
         top_data += top[0]->offset(0, 1);
         if (use_top_mask) {
           top_mask += top[0]->offset(0, 1);
+        } else if (use_window_idx_) {
+          window_mask += top[0]->offset(0, 1);
         } else {
           mask += top[0]->offset(0, 1);
         }
@@ -240,12 +259,15 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
   const int* mask = NULL;  // suppress warnings about uninitialized variables
+  const uint8_t* window_mask = NULL;
   const Dtype* top_mask = NULL;
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
     // The main loop
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
+    } else if (use_window_idx_) {
+      window_mask = static_cast<const uint8_t*>(max_window_idx_->cpu_data());
     } else {
       mask = max_idx_.cpu_data();
     }
@@ -254,8 +276,17 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
         for (int ph = 0; ph < pooled_height_; ++ph) {
           for (int pw = 0; pw < pooled_width_; ++pw) {
             const int index = ph * pooled_width_ + pw;
-            const int bottom_index =
-                use_top_mask ? top_mask[index] : mask[index];
+            int bottom_index;
+            if (use_top_mask) {
+              bottom_index = top_mask[index];
+            } else if (use_window_idx_) {
+              const int k = window_mask[index];
+              if (k == kNoWindowIndex) { continue; }
+              bottom_index = (ph * stride_h_ - pad_h_ + k / kernel_w_) * width_
+                  + pw * stride_w_ - pad_w_ + k % kernel_w_;
+            } else {
+              bottom_index = mask[index];
+            }
             bottom_diff[bottom_index] += top_diff[index];
           }
         }
@@ -263,6 +294,8 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
         top_diff += top[0]->offset(0, 1);
         if (use_top_mask) {
           top_mask += top[0]->offset(0, 1);
+        } else if (use_window_idx_) {
+          window_mask += top[0]->offset(0, 1);
         } else {
           mask += top[0]->offset(0, 1);
         }
@@ -2,9 +2,19 @@
 #include <vector>
 
 #include "caffe/layers/relu_layer.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+void ReLULayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  NeuronLayer<Dtype>::Reshape(bottom, top);
+  if (this->layer_param_.relu_param().sign_mask()) {
+    sign_mask_.Reshape(vector<int>(1, caffe_mask_words(bottom[0]->count())));
+  }
+}
+
 template <typename Dtype>
 void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -12,6 +22,11 @@ void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
+  if (this->layer_param_.relu_param().sign_mask()) {
+    // Record the sign before an in-place top overwrites the input.
+    caffe_cpu_positive_mask(count, bottom_data,
+        sign_mask_.mutable_cpu_data());
+  }
   for (int i = 0; i < count; ++i) {
     top_data[i] = std::max(bottom_data[i], Dtype(0))
         + negative_slope * std::min(bottom_data[i], Dtype(0));
@@ -23,11 +38,16 @@ void ReLULayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
   if (propagate_down[0]) {
-    const Dtype* bottom_data = bottom[0]->cpu_data();
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
     Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
+    if (this->layer_param_.relu_param().sign_mask()) {
+      caffe_cpu_mask_scale(count, sign_mask_.cpu_data(), top_diff, Dtype(1),
+          negative_slope, bottom_diff);
+      return;
+    }
+    const Dtype* bottom_data = bottom[0]->cpu_data();
     for (int i = 0; i < count; ++i) {
       bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
           + negative_slope * (bottom_data[i] <= 0));
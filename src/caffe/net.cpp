@@ -15,6 +15,7 @@
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/snapshot_store.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -251,10 +252,178 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  InitSparseParams();
+  InitCheckpoints(param);
   debug_info_ = param.debug_info();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+template <typename Dtype>
+void Net<Dtype>::InitSparseParams() {
+  learnable_param_sparse_.assign(learnable_params_.size(), true);
+  learnable_param_diff_rows_.assign(learnable_params_.size(), vector<int>());
+  learnable_param_rows_known_.assign(learnable_params_.size(), false);
+  for (int i = 0; i < params_.size(); ++i) {
+    const int layer_id = param_layer_indices_[i].first;
+    const int param_id = param_layer_indices_[i].second;
+    if (!layers_[layer_id]->param_diff_rows(param_id)) {
+      learnable_param_sparse_[learnable_param_ids_[i]] = false;
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::AppendDiffRows(const int layer_id) {
+  const vector<int>& param_ids = param_id_vecs_[layer_id];
+  for (int j = 0; j < param_ids.size(); ++j) {
+    const int learnable_id = learnable_param_ids_[param_ids[j]];
+    if (!learnable_param_rows_known_[learnable_id] ||
+        !layers_[layer_id]->param_propagate_down(j)) {
+      continue;
+    }
+    if (Caffe::mode() != Caffe::CPU) {
+      learnable_param_rows_known_[learnable_id] = false;
+      continue;
+    }
+    const vector<int>* layer_rows = layers_[layer_id]->param_diff_rows(j);
+    vector<int>& rows = learnable_param_diff_rows_[learnable_id];
+    const int size = rows.size();
+    rows.insert(rows.end(), layer_rows->begin(), layer_rows->end());
+    std::sort(rows.begin() + size, rows.end());
+    std::inplace_merge(rows.begin(), rows.begin() + size, rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+  }
+}
+
+template <typename Dtype>
+const vector<int>* Net<Dtype>::learnable_param_diff_rows(
+    const int param_id) const {
+  return (learnable_param_rows_known_[param_id] &&
+          Caffe::mode() == Caffe::CPU) ?
+      &learnable_param_diff_rows_[param_id] : NULL;
+}
+
+template <typename Dtype>
+void Net<Dtype>::set_learnable_param_diff_rows(const int param_id,
+    const vector<int>* rows) {
+  if (!rows) {
+    learnable_param_rows_known_[param_id] = false;
+  } else if (learnable_param_rows_known_[param_id]) {
+    learnable_param_diff_rows_[param_id] = *rows;
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::InitCheckpoints(const NetParameter& param) {
+  segment_start_.clear();
+  segment_end_.clear();
+  segment_release_blobs_.clear();
+  segment_released_.clear();
+  if (phase_ != TRAIN) { return; }
+  const uint64_t budget = param.checkpoint_segment_bytes();
+  bool enabled = budget > 0;
+  for (int layer_id = 0; layer_id < param.layer_size(); ++layer_id) {
+    enabled |= param.layer(layer_id).checkpoint();
+  }
+  if (!enabled) { return; }
+  // Mark the checkpoints: requested layers, layers that cannot be rerun
+  // (no bottoms, loss, AllowRecompute() == false), and, given a budget, the
+  // layer at which the activations of the current segment exceed it.
+  const int num_layers = layers_.size();
+  vector<bool> checkpoint(num_layers, false);
+  vector<vector<int> > writers(blobs_.size());
+  uint64_t segment_bytes = 0;
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    bool is_checkpoint = param.layer(layer_id).checkpoint() ||
+        bottom_vecs_[layer_id].empty() || !layers_[layer_id]->AllowRecompute();
+    const vector<int>& bottom_ids = bottom_id_vecs_[layer_id];
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      writers[blob_id].push_back(layer_id);
+      if (layers_[layer_id]->loss(top_id)) { is_checkpoint = true; }
+      if (std::find(bottom_ids.begin(), bottom_ids.end(), blob_id) ==
+          bottom_ids.end()) {
+        segment_bytes += blobs_[blob_id]->count() * sizeof(Dtype);
+      }
+    }
+    if (budget > 0 && segment_bytes >= budget) { is_checkpoint = true; }
+    if (is_checkpoint) { segment_bytes = 0; }
+    checkpoint[layer_id] = is_checkpoint;
+  }
+  // Each layer belongs to the segment ending at the next checkpoint. In-place
+  // writers of a blob must not be split over segments, nor mix checkpoints
+  // with recomputed layers, or recomputing would apply a write twice; such
+  // chains are closed by making all of their writers checkpoints.
+  segment_end_.resize(num_layers);
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    int end = num_layers - 1;
+    for (int layer_id = num_layers - 1; layer_id >= 0; --layer_id) {
+      if (checkpoint[layer_id]) { end = layer_id; }
+      segment_end_[layer_id] = end;
+    }
+    for (int blob_id = 0; blob_id < writers.size(); ++blob_id) {
+      const vector<int>& blob_writers = writers[blob_id];
+      bool close = false;
+      for (int i = 0; i < blob_writers.size(); ++i) {
+        close |= checkpoint[blob_writers[i]] ||
+            segment_end_[blob_writers[i]] != segment_end_[blob_writers[0]];
+      }
+      for (int i = 0; close && blob_writers.size() > 1 &&
+           i < blob_writers.size(); ++i) {
+        changed |= !checkpoint[blob_writers[i]];
+        checkpoint[blob_writers[i]] = true;
+      }
+    }
+  }
+  segment_start_.resize(num_layers);
+  for (int layer_id = 0, start = 0; layer_id < num_layers; ++layer_id) {
+    segment_start_[layer_id] = start;
+    if (checkpoint[layer_id]) { start = layer_id + 1; }
+  }
+  // A blob is released when it is written by recomputed layers only and used
+  // only inside its segment. The final segment is kept since its backward
+  // follows right after the forward pass.
+  vector<vector<int> > readers(blobs_.size());
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      readers[bottom_id_vecs_[layer_id][i]].push_back(layer_id);
+    }
+  }
+  const set<int> outputs(net_output_blob_indices_.begin(),
+      net_output_blob_indices_.end());
+  segment_release_blobs_.resize(num_layers);
+  segment_released_.resize(num_layers, false);
+  int num_segments = 0;
+  size_t released_bytes = 0;
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const vector<int>& blob_writers = writers[blob_id];
+    if (blob_writers.empty() || checkpoint[blob_writers[0]]) { continue; }
+    const int end = segment_end_[blob_writers[0]];
+    bool release = end < num_layers - 1 && outputs.count(blob_id) == 0 &&
+        (blob_id >= blob_loss_weights_.size() ||
+         blob_loss_weights_[blob_id] == 0);
+    for (int i = 0; i < readers[blob_id].size(); ++i) {
+      release &= segment_end_[readers[blob_id][i]] == end;
+    }
+    if (release) {
+      num_segments += segment_release_blobs_[end].empty();
+      segment_release_blobs_[end].push_back(blob_id);
+      released_bytes += blobs_[blob_id]->count() * sizeof(Dtype);
+    }
+  }
+  if (num_segments == 0) {
+    segment_start_.clear();
+    segment_end_.clear();
+    segment_release_blobs_.clear();
+    segment_released_.clear();
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Activation checkpointing: releasing " << released_bytes
+      << " bytes of activations from " << num_segments << " segment(s).";
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
@@ -518,19 +687,54 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_LT(end, layers_.size());
   Dtype loss = 0;
   for (int i = start; i <= end; ++i) {
-    for (int c = 0; c < before_forward_.size(); ++c) {
-      before_forward_[c]->run(i);
-    }
-    Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
-    loss += layer_loss;
-    if (debug_info_) { ForwardDebugInfo(i); }
-    for (int c = 0; c < after_forward_.size(); ++c) {
-      after_forward_[c]->run(i);
+    loss += ForwardLayer(i);
+    if (has_checkpoints() && segment_end_[i] == i &&
+        !segment_release_blobs_[i].empty()) {
+      ReleaseSegment(i);
     }
   }
   return loss;
 }
 
+template <typename Dtype>
+Dtype Net<Dtype>::ForwardLayer(const int layer_id) {
+  for (int c = 0; c < before_forward_.size(); ++c) {
+    before_forward_[c]->run(layer_id);
+  }
+  Dtype layer_loss = layers_[layer_id]->Forward(bottom_vecs_[layer_id],
+      top_vecs_[layer_id]);
+  if (debug_info_) { ForwardDebugInfo(layer_id); }
+  for (int c = 0; c < after_forward_.size(); ++c) {
+    after_forward_[c]->run(layer_id);
+  }
+  return layer_loss;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ReleaseSegment(const int end) {
+  const vector<int>& release_blobs = segment_release_blobs_[end];
+  vector<bool> release(blobs_.size(), false);
+  for (int i = 0; i < release_blobs.size(); ++i) {
+    release[release_blobs[i]] = true;
+  }
+  // Blobs may share memory (e.g. Split and Reshape tops share their bottom's
+  // data), so memory still referenced by a kept blob is not freed.
+  set<SyncedMemory*> kept;
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    if (!release[blob_id] && blobs_[blob_id]->count() > 0) {
+      kept.insert(blobs_[blob_id]->data().get());
+      kept.insert(blobs_[blob_id]->diff().get());
+    }
+  }
+  for (int i = 0; i < release_blobs.size(); ++i) {
+    Blob<Dtype>* blob = blobs_[release_blobs[i]].get();
+    if (blob->count() == 0) { continue; }
+    if (kept.count(blob->data().get()) == 0) { blob->data()->release(); }
+    if (kept.count(blob->diff().get()) == 0) { blob->diff()->release(); }
+  }
+  segment_released_[end] = true;
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardTimer(vector<float>& timer) {
   Dtype loss = 0;
@@ -601,17 +805,33 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
   for (int i = start; i >= end; --i) {
+    if (has_checkpoints() && segment_released_[segment_end_[i]]) {
+      // Recompute the released activations of this segment, which the
+      // backward steps from here down to the segment start depend on.
+      const int last = (i == segment_end_[i]) ? i - 1 : i;
+      for (int j = segment_start_[i]; j <= last; ++j) {
+        layers_[j]->set_recomputing(true);
+        ForwardLayer(j);
+        layers_[j]->set_recomputing(false);
+      }
+      segment_released_[segment_end_[i]] = false;
+    }
     for (int c = 0; c < before_backward_.size(); ++c) {
       before_backward_[c]->run(i);
     }
     if (layer_need_backward_[i]) {
       layers_[i]->Backward(
           top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+      AppendDiffRows(i);
       if (debug_info_) { BackwardDebugInfo(i); }
     }
     for (int c = 0; c < after_backward_.size(); ++c) {
       after_backward_[c]->run(i);
     }
+    if (has_checkpoints() && segment_start_[i] == i &&
+        !segment_release_blobs_[segment_end_[i]].empty()) {
+      ReleaseSegment(segment_end_[i]);
+    }
   }
 }
 
@@ -631,6 +851,7 @@ void Net<Dtype>::BackwardTimer(vector<float>& timer) {
     if (layer_need_backward_[i]) {
       layers_[i]->Backward(
           top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+      AppendDiffRows(i);
     }
     cudaEventRecord(stop);
     //cudaDeviceSynchronize();
@@ -760,6 +981,112 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFrom(const Net* other) {
+  int num_source_layers = other->layers().size();
+  for (int i = 0; i < num_source_layers; ++i) {
+    Layer<Dtype>* source_layer = other->layers()[i].get();
+    const string& source_layer_name = other->layer_names()[i];
+    int target_layer_id = 0;
+    while (target_layer_id != layer_names_.size() &&
+        layer_names_[target_layer_id] != source_layer_name) {
+      ++target_layer_id;
+    }
+    if (target_layer_id == layer_names_.size()) {
+      DLOG(INFO) << "Ignoring source layer " << source_layer_name;
+      continue;
+    }
+    DLOG(INFO) << "Copying source layer " << source_layer_name;
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+        layers_[target_layer_id]->blobs();
+    CHECK_EQ(target_blobs.size(), source_layer->blobs().size())
+        << "Incompatible number of blobs for layer " << source_layer_name;
+    for (int j = 0; j < target_blobs.size(); ++j) {
+      Blob<Dtype>* source_blob = source_layer->blobs()[j].get();
+      CHECK(target_blobs[j]->shape() == source_blob->shape())
+          << "Cannot copy param " << j << " weights from layer '"
+          << source_layer_name << "'; shape mismatch.  Source param shape is "
+          << source_blob->shape_string() << "; target param shape is "
+          << target_blobs[j]->shape_string();
+      target_blobs[j]->CopyFrom(*source_blob);
+    }
+  }
+}
+
+template <typename Dtype>
+static bool LargerDataMemory(Blob<Dtype>* a, Blob<Dtype>* b) {
+  return a->data()->size() > b->data()->size();
+}
+
+template <typename Dtype>
+void Net<Dtype>::ShareActivationsWith(Net* other) {
+  vector<Blob<Dtype>*> blobs;
+  vector<Blob<Dtype>*> other_blobs;
+  AppendShareableBlobs(&blobs);
+  other->AppendShareableBlobs(&other_blobs);
+  // Pair the largest blobs of both nets first, so that little memory is lost
+  // to a pair's smaller blob, and hand each pair the larger of its memories.
+  std::stable_sort(blobs.begin(), blobs.end(), LargerDataMemory<Dtype>);
+  std::stable_sort(other_blobs.begin(), other_blobs.end(),
+      LargerDataMemory<Dtype>);
+  size_t shared_bytes = 0;
+  const int num_pairs = std::min(blobs.size(), other_blobs.size());
+  for (int i = 0; i < num_pairs; ++i) {
+    const size_t size = blobs[i]->data()->size();
+    const size_t other_size = other_blobs[i]->data()->size();
+    if (size <= other_size) {
+      blobs[i]->ShareDataMemory(other_blobs[i]->data());
+    } else {
+      other_blobs[i]->ShareDataMemory(blobs[i]->data());
+    }
+    shared_bytes += std::min(size, other_size);
+  }
+  LOG_IF(INFO, Caffe::root_solver()) << "Net " << name_ << " shares "
+      << shared_bytes << " bytes of activation memory with net "
+      << other->name();
+}
+
+template <typename Dtype>
+void Net<Dtype>::AppendShareableBlobs(vector<Blob<Dtype>*>* shareable) {
+  // Tops of layers without bottoms may be filled outside of Forward or point
+  // into the layer's own buffers (e.g. prefetched batches), so they are kept.
+  vector<bool> source_top(blobs_.size(), false);
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (bottom_vecs_[i].empty()) {
+      for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+        source_top[top_id_vecs_[i][j]] = true;
+      }
+    }
+  }
+  vector<Blob<Dtype>*> candidates;
+  for (int i = 0; i < blobs_.size(); ++i) {
+    if (!source_top[i]) { candidates.push_back(blobs_[i].get()); }
+  }
+  for (int i = 0; i < layers_.size(); ++i) {
+    const vector<Blob<Dtype>*> scratch = layers_[i]->scratch_blobs();
+    candidates.insert(candidates.end(), scratch.begin(), scratch.end());
+  }
+  // Memory that blobs of this net already share (e.g. Split and Reshape tops
+  // with their bottom) is left alone.
+  map<SyncedMemory*, int> num_users;
+  for (int i = 0; i < candidates.size(); ++i) {
+    if (candidates[i]->count() > 0) {
+      ++num_users[candidates[i]->data().get()];
+    }
+  }
+  for (int i = 0; i < blobs_.size(); ++i) {
+    if (source_top[i] && blobs_[i]->count() > 0) {
+      ++num_users[blobs_[i]->data().get()];
+    }
+  }
+  for (int i = 0; i < candidates.size(); ++i) {
+    if (candidates[i]->count() > 0 &&
+        num_users[candidates[i]->data().get()] == 1) {
+      shareable->push_back(candidates[i]);
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::BackwardFrom(int start) {
   BackwardFromTo(start, 0);
@@ -836,7 +1163,14 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
-  if (H5Fis_hdf5(trained_filename.c_str())) {
+  const string manifest = ".manifest";
+  if (trained_filename.size() >= manifest.size() &&
+      trained_filename.compare(trained_filename.size() - manifest.size(),
+          manifest.size(), manifest) == 0) {
+    NetParameter param;
+    ReadNetParamsFromSnapshotStoreOrDie(trained_filename, &param);
+    CopyTrainedLayersFrom(param);
+  } else if (hdf5_is_file(trained_filename)) {
     CopyTrainedLayersFromHDF5(trained_filename);
   } else {
     CopyTrainedLayersFromBinaryProto(trained_filename);
@@ -853,6 +1187,7 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
+  HDF5Lock lock;
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
@@ -915,6 +1250,7 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
 
 template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
+  HDF5Lock lock;
   hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
       H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -973,7 +1309,19 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
 template <typename Dtype>
 void Net<Dtype>::Update() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
-    learnable_params_[i]->Update();
+    const vector<int>* rows = learnable_param_diff_rows(i);
+    if (rows) {
+      Blob<Dtype>* blob = learnable_params_[i];
+      const int row_size = blob->count(1);
+      const Dtype* diff = blob->cpu_diff();
+      Dtype* data = blob->mutable_cpu_data();
+      for (int r = 0; r < rows->size(); ++r) {
+        const int offset = (*rows)[r] * row_size;
+        caffe_axpy(row_size, Dtype(-1), diff + offset, data + offset);
+      }
+    } else {
+      learnable_params_[i]->Update();
+    }
   }
 }
 
@@ -981,10 +1329,23 @@ template <typename Dtype>
 void Net<Dtype>::ClearParamDiffs() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
     Blob<Dtype>* blob = learnable_params_[i];
+    const vector<int>* rows = learnable_param_diff_rows(i);
+    learnable_param_rows_known_[i] =
+        learnable_param_sparse_[i] && Caffe::mode() == Caffe::CPU;
     switch (Caffe::mode()) {
     case Caffe::CPU:
-      caffe_set(blob->count(), static_cast<Dtype>(0),
-                blob->mutable_cpu_diff());
+      if (rows) {
+        const int row_size = blob->count(1);
+        Dtype* diff = blob->mutable_cpu_diff();
+        for (int r = 0; r < rows->size(); ++r) {
+          caffe_set(row_size, static_cast<Dtype>(0),
+                    diff + (*rows)[r] * row_size);
+        }
+      } else {
+        caffe_set(blob->count(), static_cast<Dtype>(0),
+                  blob->mutable_cpu_diff());
+      }
+      learnable_param_diff_rows_[i].clear();
       break;
     case Caffe::GPU:
 #ifndef CPU_ONLY
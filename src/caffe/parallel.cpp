@@ -1,8 +1,9 @@
 #ifdef USE_NCCL
-
 #include <cuda_runtime.h>
+#endif
 #include <glog/logging.h>
 #include <stdio.h>
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -72,6 +73,276 @@ Params<Dtype>::Params(shared_ptr<Solver<Dtype> > root_solver)
     diff_() {
 }
 
+template<typename Dtype>
+CPUParams<Dtype>::CPUParams(shared_ptr<Solver<Dtype> > root_solver)
+  : Params<Dtype>(root_solver) {
+  data_ = new Dtype[size_];
+  const vector<Blob<Dtype>*>& net =
+    root_solver->net()->learnable_params();
+  apply_buffers(net, data_, size_, copy);
+
+  diff_ = new Dtype[size_];
+  caffe_set(size_, Dtype(0), diff_);
+}
+
+template<typename Dtype>
+CPUParams<Dtype>::~CPUParams() {
+  delete [] data_;
+  delete [] diff_;
+}
+
+template<typename Dtype>
+void CPUParams<Dtype>::Configure(Solver<Dtype>* solver) const {
+  const vector<Blob<Dtype>*>& net =
+    solver->net()->learnable_params();
+  apply_buffers(net, data_, size_, replace_cpu);
+  apply_buffers(net, diff_, size_, replace_cpu_diff);
+}
+
+template<typename Dtype>
+CPUSync<Dtype>::CPUSync(shared_ptr<Solver<Dtype> > solver)
+  : CPUParams<Dtype>(solver),
+    solver_(solver),
+    compressor_(GetGradientCompressor<Dtype>(
+        solver->param().gradient_compression(), static_cast<int>(size_))),
+    reduced_(size_), syncs_(), barrier_(), stats_iters_() {
+  this->Configure(solver.get());
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::InitSingleProcess(vector<CPUSync<Dtype>*>* syncs,
+                                       boost::barrier* barrier) {
+  for (int i = 0; i < syncs->size(); ++i) {
+    (*syncs)[i]->syncs_ = syncs;
+    (*syncs)[i]->barrier_ = barrier;
+  }
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::Broadcast() {
+  barrier_->wait();
+  if (!Caffe::root_solver()) {
+    caffe_copy(static_cast<int>(size_), (*syncs_)[0]->data_, data_);
+  }
+  barrier_->wait();
+}
+
+template<typename Dtype>
+bool CPUSync<Dtype>::local_step() const {
+  const SolverParameter& param = solver_->param();
+  return param.local_sgd_period() > 1 &&
+      solver_->iter() >= param.local_sgd_warmup();
+}
+
+template<typename Dtype>
+const vector<shared_ptr<Blob<Dtype> > >*
+CPUSync<Dtype>::averaged_history() const {
+  if (!solver_->param().local_sgd_average_history()) {
+    return NULL;
+  }
+  SGDSolver<Dtype>* sgd = dynamic_cast<SGDSolver<Dtype>*>(solver_.get());
+  return sgd ? &sgd->history() : NULL;
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::on_gradients_ready() {
+  if (local_step()) {
+    return;
+  }
+  const int count = static_cast<int>(size_);
+  const Dtype scale = Dtype(1) / syncs_->size();
+  if (compressor_) {
+    compressor_->Encode(diff_, &message_);
+  }
+  barrier_->wait();
+  Dtype* reduced = &reduced_[0];
+  caffe_set(count, Dtype(0), reduced);
+  for (int i = 0; i < syncs_->size(); ++i) {
+    const CPUSync<Dtype>* peer = (*syncs_)[i];
+    if (compressor_) {
+      compressor_->DecodeAdd(peer->message_, scale, reduced);
+    } else {
+      caffe_axpy(count, scale, peer->diff_, reduced);
+    }
+  }
+  // The average is nonzero in every row a peer's row-sparse gradient
+  // touched, so the update and the next ClearParamDiffs have to visit all of
+  // them. Decoded gradients may be nonzero anywhere.
+  Net<Dtype>& net = *solver_->net();
+  const int num_params = net.learnable_params().size();
+  diff_rows_.resize(num_params);
+  diff_rows_known_.assign(num_params, !compressor_);
+  for (int j = 0; j < num_params; ++j) {
+    vector<int>& rows = diff_rows_[j];
+    rows.clear();
+    for (int i = 0; i < syncs_->size() && diff_rows_known_[j]; ++i) {
+      const vector<int>* peer_rows =
+          (*syncs_)[i]->solver_->net()->learnable_param_diff_rows(j);
+      if (!peer_rows) {
+        diff_rows_known_[j] = false;
+      } else {
+        rows.insert(rows.end(), peer_rows->begin(), peer_rows->end());
+      }
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+  }
+  // The peers may still be reading this solver's gradient and rows.
+  barrier_->wait();
+  caffe_copy(count, reduced, diff_);
+  for (int j = 0; j < num_params; ++j) {
+    net.set_learnable_param_diff_rows(j,
+        diff_rows_known_[j] ? &diff_rows_[j] : NULL);
+  }
+
+  const int display = solver_->param().display();
+  ++stats_iters_;
+  if (compressor_ && Caffe::root_solver() && display &&
+      solver_->iter() % display == 0) {
+    LOG(INFO) << "Gradient compression ratio "
+        << compressor_->compression_ratio() << ", encode "
+        << compressor_->encode_ms() / stats_iters_ << " ms, decode "
+        << compressor_->decode_ms() / stats_iters_ << " ms per iteration";
+    compressor_->ResetStats();
+    stats_iters_ = 0;
+  }
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::on_update_applied() {
+  if (!local_step()) {
+    return;
+  }
+  const SolverParameter& param = solver_->param();
+  const int iter = solver_->iter();
+  LOG_IF(INFO, iter == param.local_sgd_warmup() && Caffe::root_solver())
+      << "Local SGD: averaging the weights every " << param.local_sgd_period()
+      << " iterations";
+  // The last iteration is also averaged, so that all workers end up with the
+  // same weights.
+  if ((iter + 1 - param.local_sgd_warmup()) % param.local_sgd_period() &&
+      iter + 1 != param.max_iter()) {
+    return;
+  }
+  const Dtype scale = Dtype(1) / syncs_->size();
+  const vector<shared_ptr<Blob<Dtype> > >* history = averaged_history();
+  // Wait for all the solvers to have updated their weights.
+  barrier_->wait();
+  Dtype* reduced = &reduced_[0];
+  caffe_set(static_cast<int>(size_), Dtype(0), reduced);
+  for (int i = 0; i < syncs_->size(); ++i) {
+    caffe_axpy(static_cast<int>(size_), scale, (*syncs_)[i]->data_, reduced);
+  }
+  if (history) {
+    int history_count = 0;
+    for (int j = 0; j < history->size(); ++j) {
+      history_count += (*history)[j]->count();
+    }
+    history_reduced_.resize(history_count);
+    caffe_set(history_count, Dtype(0), &history_reduced_[0]);
+    for (int i = 0; i < syncs_->size(); ++i) {
+      const vector<shared_ptr<Blob<Dtype> > >& peer_history =
+          *(*syncs_)[i]->averaged_history();
+      Dtype* peer_reduced = &history_reduced_[0];
+      for (int j = 0; j < peer_history.size(); ++j) {
+        caffe_axpy(peer_history[j]->count(), scale,
+            peer_history[j]->cpu_data(), peer_reduced);
+        peer_reduced += peer_history[j]->count();
+      }
+    }
+  }
+  // The peers may still be reading this solver's weights and history.
+  barrier_->wait();
+  // Copy through the blobs, so that their memory sees the write.
+  const vector<Blob<Dtype>*>& params = solver_->net()->learnable_params();
+  for (int j = 0; j < params.size(); ++j) {
+    caffe_copy(params[j]->count(), reduced, params[j]->mutable_cpu_data());
+    reduced += params[j]->count();
+  }
+  if (history) {
+    const Dtype* history_reduced = &history_reduced_[0];
+    for (int j = 0; j < history->size(); ++j) {
+      caffe_copy((*history)[j]->count(), history_reduced,
+          (*history)[j]->mutable_cpu_data());
+      history_reduced += (*history)[j]->count();
+    }
+  }
+}
+
+template<typename Dtype>
+class CPUWorker : public InternalThread {
+ public:
+  explicit CPUWorker(shared_ptr<Solver<Dtype> > rank0,
+                     boost::barrier* barrier, vector<CPUSync<Dtype>*>* syncs,
+                     const char* restore)
+    : rank0_(rank0), barrier_(barrier), syncs_(syncs), restore_(restore) {
+  }
+  virtual ~CPUWorker() {}
+
+ protected:
+  void InternalThreadEntry() {
+    SolverParameter param(rank0_->param());
+    param.set_type(rank0_->type());
+    shared_ptr<Solver<Dtype> > s(SolverRegistry<Dtype>::CreateSolver(param));
+    CHECK_EQ(s->type(), rank0_->type());
+    if (restore_) {
+      s->Restore(restore_);
+    }
+    CPUSync<Dtype> sync(s);
+    s->add_callback(&sync);
+    (*syncs_)[Caffe::solver_rank()] = &sync;
+    // Wait for other threads
+    barrier_->wait();
+    // Wait for the group to be connected
+    barrier_->wait();
+    // Broadcast rank 0 state
+    sync.Broadcast();
+    // Solve
+    s->Step(param.max_iter() - s->iter());
+    barrier_->wait();
+  }
+
+  shared_ptr<Solver<Dtype> > rank0_;
+  boost::barrier* barrier_;
+  vector<CPUSync<Dtype>*>* syncs_;
+  const char* restore_;
+};
+
+template<typename Dtype>
+void CPUSync<Dtype>::Run(int workers, const char* restore) {
+  CHECK_EQ(workers, Caffe::solver_count())
+      << "Set the solver count before creating the root solver, so that "
+      << "data layers give each worker its own share of the data.";
+  boost::barrier barrier(workers);
+  vector<CPUSync<Dtype>*> syncs(workers);
+  // Create workers
+  vector<shared_ptr<CPUWorker<Dtype> > > threads(workers);
+  for (int i = 1; i < workers; ++i) {
+    Caffe::set_solver_rank(i);
+    CPUWorker<Dtype>* w = new CPUWorker<Dtype>(solver_, &barrier, &syncs,
+                                               restore);
+    w->StartInternalThread();
+    threads[i].reset(w);
+  }
+  Caffe::set_solver_rank(0);
+  solver_->add_callback(this);
+  syncs[0] = this;
+  // Wait for workers
+  barrier.wait();
+  InitSingleProcess(&syncs, &barrier);
+  barrier.wait();
+  // Run first solver on current thread
+  Broadcast();
+  solver_->Solve();
+  barrier.wait();
+  // Wait for shutdown
+  for (int i = 1; i < workers; ++i) {
+    threads[i]->StopInternalThread();
+  }
+}
+
+#ifdef USE_NCCL
+
 template<typename Dtype>
 GPUParams<Dtype>::GPUParams(shared_ptr<Solver<Dtype> > root_solver, int device)
   : Params<Dtype>(root_solver) {
@@ -361,11 +632,15 @@ void NCCL<Dtype>::Run(const vector<int>& gpus, const char* restore) {
   }
 }
 
-INSTANTIATE_CLASS(Params);
 INSTANTIATE_CLASS(GPUParams);
 INSTANTIATE_CLASS(Worker);
 INSTANTIATE_CLASS(NCCL);
 
-}  // namespace caffe
-
 #endif  // USE_NCCL
+
+INSTANTIATE_CLASS(Params);
+INSTANTIATE_CLASS(CPUParams);
+INSTANTIATE_CLASS(CPUSync);
+INSTANTIATE_CLASS(CPUWorker);
+
+}  // namespace caffe
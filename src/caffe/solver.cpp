@@ -1,3 +1,4 @@
+#include <boost/thread.hpp>
 #include <cstdio>
 
 #include <string>
@@ -39,6 +40,15 @@ Solver<Dtype>::Solver(const string& param_file)
   Init(param);
 }
 
+template <typename Dtype>
+Solver<Dtype>::~Solver() {
+  // Background testers call back into this solver; stop them while it is
+  // still whole.
+  for (int i = 0; i < async_testers_.size(); ++i) {
+    async_testers_[i]->StopInternalThread();
+  }
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Init(const SolverParameter& param) {
   LOG_IF(INFO, Caffe::root_solver()) << "Initializing solver from parameters: "
@@ -131,6 +141,8 @@ void Solver<Dtype>::InitTestNets() {
   if (num_test_net_instances) {
     CHECK_GT(param_.test_interval(), 0);
   }
+  CHECK(!(param_.test_async() && param_.test_share_activations()))
+      << "Background test nets cannot share activations with the train net.";
   int test_net_id = 0;
   vector<string> sources(num_test_net_instances);
   vector<NetParameter> net_params(num_test_net_instances);
@@ -173,6 +185,27 @@ void Solver<Dtype>::InitTestNets() {
         << "Creating test net (#" << i << ") specified by " << sources[i];
     test_nets_[i].reset(new Net<Dtype>(net_params[i]));
     test_nets_[i]->set_debug_info(param_.debug_info());
+    if (param_.test_share_activations()) {
+      test_nets_[i]->ShareActivationsWith(net_.get());
+    }
+  }
+  if (param_.test_async() && num_test_net_instances &&
+      Caffe::root_solver()) {
+    CHECK_GT(param_.test_async_max_pending(), 0)
+        << "test_async_max_pending must be positive.";
+    for (int t = 0; t < param_.test_async_max_pending(); ++t) {
+      vector<shared_ptr<Net<Dtype> > > nets(test_nets_);
+      for (int i = 0; t > 0 && i < num_test_net_instances; ++i) {
+        LOG(INFO) << "Creating background test net (#" << i << ") replica "
+            << t;
+        nets[i].reset(new Net<Dtype>(net_params[i]));
+        nets[i]->set_debug_info(param_.debug_info());
+      }
+      async_testers_.push_back(
+          shared_ptr<AsyncTester>(new AsyncTester(this, nets, t)));
+      async_testers_[t]->StartInternalThread();
+      idle_testers_.push(t);
+    }
   }
 }
 
@@ -325,6 +358,9 @@ void Solver<Dtype>::Step(int iters) {
       callbacks_[i]->on_gradients_ready();
     }
     ApplyUpdate();
+    for (int i = 0; i < callbacks_.size(); ++i) {
+      callbacks_[i]->on_update_applied();
+    }
 
     // Increment the internal iter_ counter -- its value should always indicate
     // the number of times the weights have been updated.
@@ -400,6 +436,7 @@ void Solver<Dtype>::Solve(const char* resume_file) {
     Snapshot();
   }
   if (requested_early_exit_) {
+    WaitForAsyncTests();
     LOG(INFO) << "Optimization stopped early.";
     return;
   }
@@ -421,11 +458,16 @@ void Solver<Dtype>::Solve(const char* resume_file) {
   if (param_.test_interval() && iter_ % param_.test_interval() == 0) {
     TestAll();
   }
+  WaitForAsyncTests();
   LOG(INFO) << "Optimization Done.";
 }
 
 template <typename Dtype>
 void Solver<Dtype>::TestAll() {
+  if (!async_testers_.empty()) {
+    TestAllAsync();
+    return;
+  }
   for (int test_net_id = 0;
        test_net_id < test_nets_.size() && !requested_early_exit_;
        ++test_net_id) {
@@ -433,6 +475,46 @@ void Solver<Dtype>::TestAll() {
   }
 }
 
+template <typename Dtype>
+void Solver<Dtype>::TestAllAsync() {
+  const int tester_id = idle_testers_.pop(
+      "Waiting for a background test evaluation to finish");
+  AsyncTester* tester = async_testers_[tester_id].get();
+  for (int i = 0; i < tester->nets().size(); ++i) {
+    tester->nets()[i]->CopyTrainedLayersFrom(net_.get());
+  }
+  LOG(INFO) << "Iteration " << iter_ << ", Testing in background";
+  tester->Evaluate(iter_);
+}
+
+template <typename Dtype>
+void Solver<Dtype>::WaitForAsyncTests() {
+  // Holding every tester at once means none has an evaluation in flight.
+  vector<int> tester_ids;
+  for (int i = 0; i < async_testers_.size(); ++i) {
+    tester_ids.push_back(idle_testers_.pop(
+        "Waiting for background test evaluations to finish"));
+  }
+  for (int i = 0; i < tester_ids.size(); ++i) {
+    idle_testers_.push(tester_ids[i]);
+  }
+}
+
+template <typename Dtype>
+void Solver<Dtype>::AsyncTester::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      const int iter = iters_.pop();
+      for (int i = 0; i < nets_.size(); ++i) {
+        solver_->TestNet(nets_[i].get(), i, iter, false);
+      }
+      solver_->idle_testers_.push(id_);
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Test(const int test_net_id) {
   CHECK(Caffe::root_solver());
@@ -440,12 +522,18 @@ void Solver<Dtype>::Test(const int test_net_id) {
             << ", Testing net (#" << test_net_id << ")";
   CHECK_NOTNULL(test_nets_[test_net_id].get())->
       ShareTrainedLayersWith(net_.get());
+  TestNet(test_nets_[test_net_id].get(), test_net_id, iter_, true);
+}
+
+template <typename Dtype>
+void Solver<Dtype>::TestNet(Net<Dtype>* test_net, const int test_net_id,
+    const int iter, const bool interruptible) {
   vector<Dtype> test_score;
   vector<int> test_score_output_id;
-  const shared_ptr<Net<Dtype> >& test_net = test_nets_[test_net_id];
   Dtype loss = 0;
   for (int i = 0; i < param_.test_iter(test_net_id); ++i) {
-    SolverAction::Enum request = GetRequestedAction();
+    SolverAction::Enum request =
+        interruptible ? GetRequestedAction() : SolverAction::NONE;
     // Check to see if stoppage of testing/training has been requested.
     while (request != SolverAction::NONE) {
         if (SolverAction::SNAPSHOT == request) {
@@ -455,7 +543,7 @@ void Solver<Dtype>::Test(const int test_net_id) {
         }
         request = GetRequestedAction();
     }
-    if (requested_early_exit_) {
+    if (interruptible && requested_early_exit_) {
       // break out of test loop.
       break;
     }
@@ -484,10 +572,15 @@ void Solver<Dtype>::Test(const int test_net_id) {
       }
     }
   }
-  if (requested_early_exit_) {
+  if (interruptible && requested_early_exit_) {
     LOG(INFO)     << "Test interrupted.";
     return;
   }
+  if (!interruptible) {
+    // Training has moved on; say which weights these results belong to.
+    LOG(INFO) << "Iteration " << iter << ", Background test net (#"
+              << test_net_id << ") results:";
+  }
   if (param_.test_compute_loss()) {
     loss /= param_.test_iter(test_net_id);
     LOG(INFO) << "Test loss: " << loss;
@@ -519,11 +612,24 @@ void Solver<Dtype>::Snapshot() {
   case caffe::SolverParameter_SnapshotFormat_HDF5:
     model_filename = SnapshotToHDF5();
     break;
+  case caffe::SolverParameter_SnapshotFormat_CHUNKED:
+    model_filename = SnapshotToStore();
+    break;
   default:
     LOG(FATAL) << "Unsupported snapshot format.";
   }
 
   SnapshotSolverState(model_filename);
+
+  if (param_.snapshot_format() == SolverParameter_SnapshotFormat_CHUNKED) {
+    LOG(INFO) << "Snapshot store: wrote "
+        << snapshot_store_->chunks_written() << " chunks ("
+        << snapshot_store_->bytes_written() << " bytes), reused "
+        << snapshot_store_->chunks_reused();
+    snapshot_store_->ResetStats();
+    RetainSnapshots(param_.snapshot_prefix(), param_.snapshot_keep(),
+        snapshot_store_.get());
+  }
 }
 
 template <typename Dtype>
@@ -568,12 +674,33 @@ string Solver<Dtype>::SnapshotToHDF5() {
   return model_filename;
 }
 
+template <typename Dtype>
+string Solver<Dtype>::SnapshotToStore() {
+  string model_filename = SnapshotFilename(".caffemodel.manifest");
+  LOG(INFO) << "Snapshotting to snapshot store manifest " << model_filename;
+  WriteNetToSnapshotStore(*net_, param_.snapshot_diff(), snapshot_store(),
+      model_filename);
+  return model_filename;
+}
+
+template <typename Dtype>
+SnapshotStore* Solver<Dtype>::snapshot_store() {
+  if (!snapshot_store_) {
+    snapshot_store_.reset(
+        new SnapshotStore(param_.snapshot_prefix() + "_chunks"));
+  }
+  return snapshot_store_.get();
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Restore(const char* state_file) {
   string state_filename(state_file);
   if (state_filename.size() >= 3 &&
       state_filename.compare(state_filename.size() - 3, 3, ".h5") == 0) {
     RestoreSolverStateFromHDF5(state_filename);
+  } else if (state_filename.size() >= 9 && state_filename.compare(
+      state_filename.size() - 9, 9, ".manifest") == 0) {
+    RestoreSolverStateFromStore(state_filename);
   } else {
     RestoreSolverStateFromBinaryProto(state_filename);
   }
@@ -18,34 +18,30 @@ void AdaGradSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   Dtype local_rate = rate * net_params_lr[param_id];
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    // compute square of gradient in update
-    caffe_powx(net_params[param_id]->count(),
-        net_params[param_id]->cpu_diff(), Dtype(2),
-        this->update_[param_id]->mutable_cpu_data());
+    vector<int> offsets;
+    const int n = this->DiffSegments(param_id, &offsets);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* history = this->history_[param_id]->mutable_cpu_data();
+    Dtype* update = this->update_[param_id]->mutable_cpu_data();
+    for (int s = 0; s < offsets.size(); ++s) {
+      const int offset = offsets[s];
+      // compute square of gradient in update
+      caffe_powx(n, diff + offset, Dtype(2), update + offset);
 
-    // update history
-    caffe_add(net_params[param_id]->count(),
-        this->update_[param_id]->cpu_data(),
-        this->history_[param_id]->cpu_data(),
-        this->history_[param_id]->mutable_cpu_data());
+      // update history
+      caffe_add(n, update + offset, history + offset, history + offset);
 
-    // prepare update
-    caffe_powx(net_params[param_id]->count(),
-              this->history_[param_id]->cpu_data(), Dtype(0.5),
-              this->update_[param_id]->mutable_cpu_data());
+      // prepare update
+      caffe_powx(n, history + offset, Dtype(0.5), update + offset);
 
-    caffe_add_scalar(net_params[param_id]->count(),
-              delta, this->update_[param_id]->mutable_cpu_data());
+      caffe_add_scalar(n, delta, update + offset);
 
-    caffe_div(net_params[param_id]->count(),
-              net_params[param_id]->cpu_diff(),
-              this->update_[param_id]->cpu_data(),
-              this->update_[param_id]->mutable_cpu_data());
+      caffe_div(n, diff + offset, update + offset, update + offset);
 
-    // scale and copy
-    caffe_cpu_axpby(net_params[param_id]->count(), local_rate,
-        this->update_[param_id]->cpu_data(), Dtype(0),
-        net_params[param_id]->mutable_cpu_diff());
+      // scale and copy
+      caffe_cpu_axpby(n, local_rate, update + offset, Dtype(0),
+          diff + offset);
+    }
     break;
   }
   case Caffe::GPU: {
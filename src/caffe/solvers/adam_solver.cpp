@@ -39,42 +39,38 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   const int t = this->iter_ + 1;
   const Dtype correction = std::sqrt(Dtype(1) - pow(beta2, t)) /
       (Dtype(1.) - pow(beta1, t));
-  const int N = net_params[param_id]->count();
   const Dtype eps_hat = this->param_.delta();
 
   switch (Caffe::mode()) {
     case Caffe::CPU: {
-    // update m <- \beta_1 m_{t-1} + (1-\beta_1)g_t
-    caffe_cpu_axpby(N, Dtype(1)-beta1,
-        net_params[param_id]->cpu_diff(), beta1,
-        val_m->mutable_cpu_data());
+    vector<int> offsets;
+    const int n = this->DiffSegments(param_id, &offsets);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* m_data = val_m->mutable_cpu_data();
+    Dtype* v_data = val_v->mutable_cpu_data();
+    Dtype* t_data = val_t->mutable_cpu_data();
+    for (int s = 0; s < offsets.size(); ++s) {
+      const int offset = offsets[s];
+      // update m <- \beta_1 m_{t-1} + (1-\beta_1)g_t
+      caffe_cpu_axpby(n, Dtype(1)-beta1, diff + offset, beta1, m_data + offset);
 
-    // update v <- \beta_2 m_{t-1} + (1-\beta_2)g_t^2
-    caffe_mul(N,
-        net_params[param_id]->cpu_diff(),
-        net_params[param_id]->cpu_diff(),
-    val_t->mutable_cpu_data());
-    caffe_cpu_axpby(N, Dtype(1)-beta2,
-        val_t->cpu_data(), beta2,
-        val_v->mutable_cpu_data());
+      // update v <- \beta_2 m_{t-1} + (1-\beta_2)g_t^2
+      caffe_mul(n, diff + offset, diff + offset, t_data + offset);
+      caffe_cpu_axpby(n, Dtype(1)-beta2, t_data + offset, beta2,
+          v_data + offset);
 
-    // set update
-    caffe_powx(N,
-        val_v->cpu_data(), Dtype(0.5),
-        val_t->mutable_cpu_data());
-    caffe_add_scalar(N, eps_hat, val_t->mutable_cpu_data());
-    caffe_div(N,
-        val_m->cpu_data(),
-        val_t->cpu_data(),
-        val_t->mutable_cpu_data());
+      // set update
+      caffe_powx(n, v_data + offset, Dtype(0.5), t_data + offset);
+      caffe_add_scalar(n, eps_hat, t_data + offset);
+      caffe_div(n, m_data + offset, t_data + offset, t_data + offset);
 
-    caffe_cpu_scale(N, local_rate*correction,
-        val_t->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
+      caffe_cpu_scale(n, local_rate*correction, t_data + offset, diff + offset);
+    }
     break;
   }
   case Caffe::GPU: {
 #ifndef CPU_ONLY
+    const int N = net_params[param_id]->count();
     adam_update_gpu(N, net_params[param_id]->mutable_gpu_diff(),
         val_m->mutable_gpu_data(), val_v->mutable_gpu_data(), beta1, beta2,
         eps_hat, local_rate*correction);
@@ -0,0 +1,130 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe/sgd_solvers.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void LAMBSolver<Dtype>::LAMBPreSolve() {
+  CHECK_EQ("L2", this->param_.regularization_type())
+      << "LAMB only supports decoupled L2 weight decay.";
+  // Add the entries for the second moments after the first moments from
+  // SGDSolver::PreSolve, as Adam does.
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  for (int i = 0; i < net_params.size(); ++i) {
+    const vector<int>& shape = net_params[i]->shape();
+    this->history_.push_back(
+            shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
+  }
+}
+
+#ifndef CPU_ONLY
+template <typename Dtype>
+void lamb_update_gpu(int N, Dtype* g, const Dtype* w, Dtype* m, Dtype* v,
+    Dtype beta1, Dtype beta2, Dtype correction1, Dtype correction2,
+    Dtype eps_hat, Dtype local_decay);
+#endif
+
+template <typename Dtype>
+void LAMBSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  const vector<float>& net_params_lr = this->net_->params_lr();
+  const vector<float>& net_params_weight_decay =
+      this->net_->params_weight_decay();
+  Dtype local_rate = rate * net_params_lr[param_id];
+  Dtype local_decay =
+      this->param_.weight_decay() * net_params_weight_decay[param_id];
+  const Dtype beta1 = this->param_.momentum();
+  const Dtype beta2 = this->param_.momentum2();
+
+  // we create aliases for convenience
+  size_t update_history_offset = net_params.size();
+  Blob<Dtype>* val_m = this->history_[param_id].get();
+  Blob<Dtype>* val_v = this->history_[param_id + update_history_offset].get();
+
+  const int t = this->iter_ + 1;
+  const Dtype correction1 = Dtype(1) / (Dtype(1) - pow(beta1, t));
+  const Dtype correction2 = Dtype(1) / (Dtype(1) - pow(beta2, t));
+  const int N = net_params[param_id]->count();
+  const Dtype eps_hat = this->param_.delta();
+
+  // The diff is replaced by the Adam direction plus decoupled weight decay,
+  //   r = m_hat / (sqrt(v_hat) + eps) + local_decay * w,
+  // which is then scaled by local_rate * ||w|| / ||r||.
+  Dtype w_sumsq = 0;
+  Dtype r_sumsq = 0;
+  switch (Caffe::mode()) {
+  case Caffe::CPU: {
+    vector<int> offsets;
+    const int n = this->DiffSegments(param_id, &offsets);
+    const Dtype* data = net_params[param_id]->cpu_data();
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* m_data = val_m->mutable_cpu_data();
+    Dtype* v_data = val_v->mutable_cpu_data();
+#ifdef _OPENMP
+    #pragma omp parallel for reduction(+:w_sumsq) \
+        if (N > this->kMinParallelSegment)
+#endif
+    for (int i = 0; i < N; ++i) {
+      w_sumsq += data[i] * data[i];
+    }
+    // Update the moments, compute r and accumulate ||r|| in a single pass.
+    for (int s = 0; s < offsets.size(); ++s) {
+      const int offset = offsets[s];
+      const Dtype* w = data + offset;
+      Dtype* g = diff + offset;
+      Dtype* m = m_data + offset;
+      Dtype* v = v_data + offset;
+#ifdef _OPENMP
+      #pragma omp parallel for reduction(+:r_sumsq) \
+          if (n > this->kMinParallelSegment)
+#endif
+      for (int i = 0; i < n; ++i) {
+        const Dtype gi = g[i];
+        const Dtype mi = m[i] = beta1 * m[i] + (1 - beta1) * gi;
+        const Dtype vi = v[i] = beta2 * v[i] + (1 - beta2) * gi * gi;
+        const Dtype ri = mi * correction1 /
+            (std::sqrt(vi * correction2) + eps_hat) + local_decay * w[i];
+        g[i] = ri;
+        r_sumsq += ri * ri;
+      }
+    }
+    const Dtype w_norm = std::sqrt(w_sumsq);
+    const Dtype r_norm = std::sqrt(r_sumsq);
+    const Dtype trust = (w_norm > 0 && r_norm > 0) ? w_norm / r_norm : 1;
+    for (int s = 0; s < offsets.size(); ++s) {
+      caffe_scal(n, local_rate * trust, diff + offsets[s]);
+    }
+    break;
+  }
+  case Caffe::GPU: {
+#ifndef CPU_ONLY
+    lamb_update_gpu(N, net_params[param_id]->mutable_gpu_diff(),
+        net_params[param_id]->gpu_data(), val_m->mutable_gpu_data(),
+        val_v->mutable_gpu_data(), beta1, beta2, correction1, correction2,
+        eps_hat, local_decay);
+    caffe_gpu_dot(N, net_params[param_id]->gpu_data(),
+        net_params[param_id]->gpu_data(), &w_sumsq);
+    caffe_gpu_dot(N, net_params[param_id]->gpu_diff(),
+        net_params[param_id]->gpu_diff(), &r_sumsq);
+    const Dtype w_norm = std::sqrt(w_sumsq);
+    const Dtype r_norm = std::sqrt(r_sumsq);
+    const Dtype trust = (w_norm > 0 && r_norm > 0) ? w_norm / r_norm : 1;
+    caffe_gpu_scal(N, local_rate * trust,
+        net_params[param_id]->mutable_gpu_diff());
+#else
+    NO_GPU;
+#endif
+    break;
+  }
+  default:
+    LOG(FATAL) << "Unknown caffe mode: " << Caffe::mode();
+  }
+}
+
+INSTANTIATE_CLASS(LAMBSolver);
+REGISTER_SOLVER_CLASS(LAMB);
+
+}  // namespace caffe
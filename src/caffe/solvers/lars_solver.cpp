@@ -0,0 +1,94 @@
+#include <cmath>
+#include <vector>
+
+#include "caffe/sgd_solvers.hpp"
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+template <typename Dtype>
+void sgd_update_gpu(int N, Dtype* g, Dtype* h, Dtype momentum,
+    Dtype local_rate);
+#endif
+
+template <typename Dtype>
+void LARSSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  const vector<float>& net_params_lr = this->net_->params_lr();
+  Dtype momentum = this->param_.momentum();
+  Dtype local_rate = rate * net_params_lr[param_id];
+  const Dtype eta = this->param_.trust_coefficient();
+  const int N = net_params[param_id]->count();
+  switch (Caffe::mode()) {
+  case Caffe::CPU: {
+    vector<int> offsets;
+    const int n = this->DiffSegments(param_id, &offsets);
+    const Dtype* data = net_params[param_id]->cpu_data();
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* history = this->history_[param_id]->mutable_cpu_data();
+    // Rows outside the segments have no gradient, so add nothing to ||g||.
+    Dtype w_sumsq = 0;
+    Dtype g_sumsq = 0;
+#ifdef _OPENMP
+    #pragma omp parallel for reduction(+:w_sumsq) \
+        if (N > this->kMinParallelSegment)
+#endif
+    for (int i = 0; i < N; ++i) {
+      w_sumsq += data[i] * data[i];
+    }
+    for (int s = 0; s < offsets.size(); ++s) {
+      const Dtype* g = diff + offsets[s];
+#ifdef _OPENMP
+      #pragma omp parallel for reduction(+:g_sumsq) \
+          if (n > this->kMinParallelSegment)
+#endif
+      for (int i = 0; i < n; ++i) {
+        g_sumsq += g[i] * g[i];
+      }
+    }
+    const Dtype w_norm = std::sqrt(w_sumsq);
+    const Dtype g_norm = std::sqrt(g_sumsq);
+    const Dtype trust = (w_norm > 0 && g_norm > 0) ?
+        eta * w_norm / g_norm : Dtype(1);
+    const Dtype scaled_rate = local_rate * trust;
+    // Fused momentum update and copy back to the diff.
+    for (int s = 0; s < offsets.size(); ++s) {
+      Dtype* g = diff + offsets[s];
+      Dtype* h = history + offsets[s];
+#ifdef _OPENMP
+      #pragma omp parallel for if (n > this->kMinParallelSegment)
+#endif
+      for (int i = 0; i < n; ++i) {
+        g[i] = h[i] = momentum * h[i] + scaled_rate * g[i];
+      }
+    }
+    break;
+  }
+  case Caffe::GPU: {
+#ifndef CPU_ONLY
+    Dtype w_sumsq, g_sumsq;
+    caffe_gpu_dot(N, net_params[param_id]->gpu_data(),
+        net_params[param_id]->gpu_data(), &w_sumsq);
+    caffe_gpu_dot(N, net_params[param_id]->gpu_diff(),
+        net_params[param_id]->gpu_diff(), &g_sumsq);
+    const Dtype w_norm = std::sqrt(w_sumsq);
+    const Dtype g_norm = std::sqrt(g_sumsq);
+    const Dtype trust = (w_norm > 0 && g_norm > 0) ?
+        eta * w_norm / g_norm : Dtype(1);
+    sgd_update_gpu(N, net_params[param_id]->mutable_gpu_diff(),
+        this->history_[param_id]->mutable_gpu_data(),
+        momentum, local_rate * trust);
+#else
+    NO_GPU;
+#endif
+    break;
+  }
+  default:
+    LOG(FATAL) << "Unknown caffe mode: " << Caffe::mode();
+  }
+}
+
+INSTANTIATE_CLASS(LARSSolver);
+REGISTER_SOLVER_CLASS(LARS);
+
+}  // namespace caffe
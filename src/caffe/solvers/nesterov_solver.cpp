@@ -18,25 +18,27 @@ void NesterovSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   Dtype local_rate = rate * net_params_lr[param_id];
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    // save history momentum for stepping back
-    caffe_copy(net_params[param_id]->count(),
-        this->history_[param_id]->cpu_data(),
-        this->update_[param_id]->mutable_cpu_data());
-
-    // update history
-    caffe_cpu_axpby(net_params[param_id]->count(), local_rate,
-              net_params[param_id]->cpu_diff(), momentum,
-              this->history_[param_id]->mutable_cpu_data());
-
-    // compute update: step back then over step
-    caffe_cpu_axpby(net_params[param_id]->count(), Dtype(1) + momentum,
-        this->history_[param_id]->cpu_data(), -momentum,
-        this->update_[param_id]->mutable_cpu_data());
-
-    // copy
-    caffe_copy(net_params[param_id]->count(),
-        this->update_[param_id]->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
+    vector<int> offsets;
+    const int n = this->DiffSegments(param_id, &offsets);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* history = this->history_[param_id]->mutable_cpu_data();
+    Dtype* update = this->update_[param_id]->mutable_cpu_data();
+    for (int s = 0; s < offsets.size(); ++s) {
+      const int offset = offsets[s];
+      // save history momentum for stepping back
+      caffe_copy(n, history + offset, update + offset);
+
+      // update history
+      caffe_cpu_axpby(n, local_rate, diff + offset, momentum,
+          history + offset);
+
+      // compute update: step back then over step
+      caffe_cpu_axpby(n, Dtype(1) + momentum, history + offset, -momentum,
+          update + offset);
+
+      // copy
+      caffe_copy(n, update + offset, diff + offset);
+    }
     break;
   }
   case Caffe::GPU: {
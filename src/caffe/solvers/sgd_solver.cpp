@@ -77,14 +77,39 @@ void SGDSolver<Dtype>::PreSolve() {
   }
 }
 
+template <typename Dtype>
+int SGDSolver<Dtype>::DiffSegments(int param_id, vector<int>* offsets) const {
+  const Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const vector<int>* rows = this->net_->learnable_param_diff_rows(param_id);
+  offsets->clear();
+  if (!rows) {
+    offsets->push_back(0);
+    return param->count();
+  }
+  const int row_size = param->count(1);
+  for (int i = 0; i < rows->size(); ++i) {
+    offsets->push_back((*rows)[i] * row_size);
+  }
+  return row_size;
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::ClipGradients() {
   const Dtype clip_gradients = this->param_.clip_gradients();
   if (clip_gradients < 0) { return; }
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
   Dtype sumsq_diff = 0;
+  vector<int> offsets;
   for (int i = 0; i < net_params.size(); ++i) {
-    sumsq_diff += net_params[i]->sumsq_diff();
+    if (this->net_->learnable_param_diff_rows(i)) {
+      const int n = DiffSegments(i, &offsets);
+      const Dtype* diff = net_params[i]->cpu_diff();
+      for (int s = 0; s < offsets.size(); ++s) {
+        sumsq_diff += caffe_cpu_dot(n, diff + offsets[s], diff + offsets[s]);
+      }
+    } else {
+      sumsq_diff += net_params[i]->sumsq_diff();
+    }
   }
   const Dtype l2norm_diff = std::sqrt(sumsq_diff);
   if (l2norm_diff > clip_gradients) {
@@ -93,7 +118,15 @@ void SGDSolver<Dtype>::ClipGradients() {
         << l2norm_diff << " > " << clip_gradients << ") "
         << "by scale factor " << scale_factor;
     for (int i = 0; i < net_params.size(); ++i) {
-      net_params[i]->scale_diff(scale_factor);
+      if (this->net_->learnable_param_diff_rows(i)) {
+        const int n = DiffSegments(i, &offsets);
+        Dtype* diff = net_params[i]->mutable_cpu_diff();
+        for (int s = 0; s < offsets.size(); ++s) {
+          caffe_scal(n, scale_factor, diff + offsets[s]);
+        }
+      } else {
+        net_params[i]->scale_diff(scale_factor);
+      }
     }
   }
 }
@@ -123,8 +156,12 @@ void SGDSolver<Dtype>::Normalize(int param_id) {
   const Dtype accum_normalization = Dtype(1.) / this->param_.iter_size();
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    caffe_scal(net_params[param_id]->count(), accum_normalization,
-        net_params[param_id]->mutable_cpu_diff());
+    vector<int> offsets;
+    const int n = DiffSegments(param_id, &offsets);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    for (int s = 0; s < offsets.size(); ++s) {
+      caffe_scal(n, accum_normalization, diff + offsets[s]);
+    }
     break;
   }
   case Caffe::GPU: {
@@ -152,20 +189,21 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
   switch (Caffe::mode()) {
   case Caffe::CPU: {
     if (local_decay) {
+      vector<int> offsets;
+      const int n = DiffSegments(param_id, &offsets);
+      const Dtype* data = net_params[param_id]->cpu_data();
+      Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+      Dtype* temp = temp_[param_id]->mutable_cpu_data();
       if (regularization_type == "L2") {
         // add weight decay
-        caffe_axpy(net_params[param_id]->count(),
-            local_decay,
-            net_params[param_id]->cpu_data(),
-            net_params[param_id]->mutable_cpu_diff());
+        for (int s = 0; s < offsets.size(); ++s) {
+          caffe_axpy(n, local_decay, data + offsets[s], diff + offsets[s]);
+        }
       } else if (regularization_type == "L1") {
-        caffe_cpu_sign(net_params[param_id]->count(),
-            net_params[param_id]->cpu_data(),
-            temp_[param_id]->mutable_cpu_data());
-        caffe_axpy(net_params[param_id]->count(),
-            local_decay,
-            temp_[param_id]->cpu_data(),
-            net_params[param_id]->mutable_cpu_diff());
+        for (int s = 0; s < offsets.size(); ++s) {
+          caffe_cpu_sign(n, data + offsets[s], temp + offsets[s]);
+          caffe_axpy(n, local_decay, temp + offsets[s], diff + offsets[s]);
+        }
       } else {
         LOG(FATAL) << "Unknown regularization type: " << regularization_type;
       }
@@ -218,12 +256,16 @@ void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   // Compute the update to history, then copy it to the parameter diff.
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    caffe_cpu_axpby(net_params[param_id]->count(), local_rate,
-              net_params[param_id]->cpu_diff(), momentum,
-              history_[param_id]->mutable_cpu_data());
-    caffe_copy(net_params[param_id]->count(),
-        history_[param_id]->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
+    vector<int> offsets;
+    const int n = DiffSegments(param_id, &offsets);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* history = history_[param_id]->mutable_cpu_data();
+    for (int s = 0; s < offsets.size(); ++s) {
+      const int offset = offsets[s];
+      caffe_cpu_axpby(n, local_rate, diff + offset, momentum,
+          history + offset);
+      caffe_copy(n, history + offset, diff + offset);
+    }
     break;
   }
   case Caffe::GPU: {
@@ -251,6 +293,9 @@ void SGDSolver<Dtype>::SnapshotSolverState(const string& model_filename) {
     case caffe::SolverParameter_SnapshotFormat_HDF5:
       SnapshotSolverStateToHDF5(model_filename);
       break;
+    case caffe::SolverParameter_SnapshotFormat_CHUNKED:
+      SnapshotSolverStateToStore(model_filename);
+      break;
     default:
       LOG(FATAL) << "Unsupported snapshot format.";
   }
@@ -281,6 +326,7 @@ void SGDSolver<Dtype>::SnapshotSolverStateToHDF5(
   string snapshot_filename =
       Solver<Dtype>::SnapshotFilename(".solverstate.h5");
   LOG(INFO) << "Snapshotting solver state to HDF5 file " << snapshot_filename;
+  HDF5Lock lock;
   hid_t file_hid = H5Fcreate(snapshot_filename.c_str(), H5F_ACC_TRUNC,
       H5P_DEFAULT, H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -301,6 +347,25 @@ void SGDSolver<Dtype>::SnapshotSolverStateToHDF5(
   H5Fclose(file_hid);
 }
 
+template <typename Dtype>
+void SGDSolver<Dtype>::SnapshotSolverStateToStore(
+    const string& model_filename) {
+  SnapshotStore* store = this->snapshot_store();
+  string snapshot_filename =
+      Solver<Dtype>::SnapshotFilename(".solverstate.manifest");
+  SnapshotManifest state;
+  SetManifestStore(*store, snapshot_filename, &state);
+  state.set_iter(this->iter_);
+  state.set_learned_net(model_filename);
+  state.set_current_step(this->current_step_);
+  for (int i = 0; i < history_.size(); ++i) {
+    state.add_history(store->Put(*history_[i]));
+  }
+  LOG(INFO) << "Snapshotting solver state to snapshot store manifest "
+      << snapshot_filename;
+  WriteProtoToBinaryFile(state, snapshot_filename.c_str());
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::RestoreSolverStateFromBinaryProto(
     const string& state_file) {
@@ -323,6 +388,7 @@ void SGDSolver<Dtype>::RestoreSolverStateFromBinaryProto(
 
 template <typename Dtype>
 void SGDSolver<Dtype>::RestoreSolverStateFromHDF5(const string& state_file) {
+  HDF5Lock lock;
   hid_t file_hid = H5Fopen(state_file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open solver state file " << state_file;
   this->iter_ = hdf5_load_int(file_hid, "iter");
@@ -346,6 +412,27 @@ void SGDSolver<Dtype>::RestoreSolverStateFromHDF5(const string& state_file) {
   H5Fclose(file_hid);
 }
 
+template <typename Dtype>
+void SGDSolver<Dtype>::RestoreSolverStateFromStore(const string& state_file) {
+  SnapshotManifest state;
+  CHECK(ReadProtoFromBinaryFile(state_file, &state))
+      << "Failed to parse snapshot manifest " << state_file;
+  this->iter_ = state.iter();
+  if (state.has_learned_net()) {
+    this->net_->CopyTrainedLayersFrom(state.learned_net());
+  }
+  this->current_step_ = state.current_step();
+  CHECK_EQ(state.history_size(), history_.size())
+      << "Incorrect length of history blobs.";
+  LOG(INFO) << "SGDSolver: restoring history";
+  const SnapshotStore store(ManifestStoreDirectory(state, state_file));
+  for (int i = 0; i < history_.size(); ++i) {
+    BlobProto history_blob;
+    store.Get(state.history(i), &history_blob);
+    history_[i]->FromProto(history_blob);
+  }
+}
+
 INSTANTIATE_CLASS(SGDSolver);
 REGISTER_SOLVER_CLASS(SGD);
 
@@ -1,3 +1,7 @@
+#include <stdint.h>
+
+#include <iterator>
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -5,6 +9,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -112,6 +117,83 @@ TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   EXPECT_FALSE(this->blob_->ShapeEquals(blob_proto));
 }
 
+TYPED_TEST(BlobSimpleTest, TestToProtoRepeatedValues) {
+  typedef TypeParam Dtype;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_preshaped_);
+  BlobProto blob_proto;
+  this->blob_preshaped_->ToProto(&blob_proto);
+  // Other readers only know the repeated fields.
+  EXPECT_FALSE(blob_proto.has_raw_data());
+  EXPECT_EQ(this->blob_preshaped_->count(),
+      blob_proto.data_size() + blob_proto.double_data_size());
+  this->blob_->FromProto(blob_proto);
+  for (int i = 0; i < this->blob_->count(); ++i) {
+    EXPECT_EQ(this->blob_preshaped_->cpu_data()[i], this->blob_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(BlobSimpleTest, TestToFromRawProto) {
+  typedef TypeParam Dtype;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_preshaped_);
+  caffe_copy(this->blob_preshaped_->count(), this->blob_preshaped_->cpu_data(),
+      this->blob_preshaped_->mutable_cpu_diff());
+  caffe_scal(this->blob_preshaped_->count(), Dtype(2),
+      this->blob_preshaped_->mutable_cpu_diff());
+  BlobProto blob_proto;
+  this->blob_preshaped_->ToRawProto(&blob_proto, true);
+  // The values are written in bulk, not as repeated fields.
+  EXPECT_EQ(0, blob_proto.data_size() + blob_proto.double_data_size());
+  EXPECT_EQ(this->blob_preshaped_->count() * sizeof(Dtype),
+      blob_proto.raw_data().size());
+  this->blob_->FromProto(blob_proto);
+  EXPECT_EQ(this->blob_preshaped_->shape(), this->blob_->shape());
+  for (int i = 0; i < this->blob_->count(); ++i) {
+    EXPECT_EQ(this->blob_preshaped_->cpu_data()[i], this->blob_->cpu_data()[i]);
+    EXPECT_EQ(this->blob_preshaped_->cpu_diff()[i], this->blob_->cpu_diff()[i]);
+  }
+}
+
+TYPED_TEST(BlobSimpleTest, TestFromProtoRepeatedValues) {
+  // Blobs written before the raw values were added.
+  BlobProto blob_proto;
+  blob_proto.mutable_shape()->add_dim(3);
+  for (int i = 0; i < 3; ++i) {
+    blob_proto.add_data(i + 0.5);
+    blob_proto.add_double_diff(-i);
+  }
+  this->blob_->FromProto(blob_proto);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(i + 0.5, this->blob_->cpu_data()[i]);
+    EXPECT_EQ(-i, this->blob_->cpu_diff()[i]);
+  }
+}
+
+TYPED_TEST(BlobSimpleTest, TestFromProtoRawConversion) {
+  // Doubles in the other byte order, as another machine would write them.
+  const double values[] = {1.5, -2.25, 1e-3};
+  const uint16_t one = 1;
+  const bool big_endian = *reinterpret_cast<const uint8_t*>(&one) == 0;
+  string bytes;
+  for (int i = 0; i < 3; ++i) {
+    const char* value = reinterpret_cast<const char*>(&values[i]);
+    bytes.append(std::reverse_iterator<const char*>(value + sizeof(double)),
+        std::reverse_iterator<const char*>(value));
+  }
+  BlobProto blob_proto;
+  blob_proto.mutable_shape()->add_dim(3);
+  blob_proto.set_raw_type(BlobProto_RawType_DOUBLE);
+  blob_proto.set_raw_big_endian(!big_endian);
+  blob_proto.set_raw_data(bytes);
+  this->blob_->FromProto(blob_proto);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_FLOAT_EQ(values[i], this->blob_->cpu_data()[i]);
+  }
+}
+
 template <typename TypeParam>
 class BlobMathTest : public MultiDeviceTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
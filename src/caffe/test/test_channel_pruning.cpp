@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/channel_pruning.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class ChannelPruningTest : public CPUDeviceTest<Dtype> {
+ protected:
+  ChannelPruningTest() : seed_(1701) {}
+
+  // Parses proto, with the net's convolutions and inner products filled
+  // with Gaussian weights.
+  void InitNet(const string& proto) {
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+    Caffe::set_random_seed(seed_);
+    net_.reset(new Net<Dtype>(param_));
+  }
+
+  // A convolution followed by a per-channel Scale, ReLU, and a second
+  // convolution and inner product consuming its channels.
+  void InitChainNet() {
+    InitNet(
+        "name: 'PruningTestNetwork' "
+        "layer { name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 6 } } } "
+        "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+        "  top: 'conv1' convolution_param { num_output: 4 kernel_size: 3 "
+        "  pad: 1 weight_filler { type: 'gaussian' } "
+        "  bias_filler { type: 'gaussian' } } } "
+        "layer { name: 'scale1' type: 'Scale' bottom: 'conv1' top: 'conv1' "
+        "  scale_param { bias_term: true } } "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+        "layer { name: 'conv2' type: 'Convolution' bottom: 'conv1' "
+        "  top: 'conv2' convolution_param { num_output: 3 kernel_size: 3 "
+        "  weight_filler { type: 'gaussian' } } } "
+        "layer { name: 'ip' type: 'InnerProduct' bottom: 'conv2' top: 'ip' "
+        "  inner_product_param { num_output: 2 "
+        "  weight_filler { type: 'gaussian' } } } ");
+  }
+
+  void FillInput() {
+    Blob<Dtype>* data = net_->input_blobs()[0];
+    for (int i = 0; i < data->count(); ++i) {
+      data->mutable_cpu_data()[i] = (i % 7) * 0.25 - 0.5;
+    }
+  }
+
+  // Builds the net pruned into net_ from its updated definition.
+  shared_ptr<Net<Dtype> > PrunedNet(const PrunedConvolutions& convolutions) {
+    NetParameter pruned_param = param_;
+    UpdatePrunedConvolutions(convolutions, &pruned_param);
+    NetParameter weights;
+    PrunedWeightsToProto(*net_, pruned_param, &weights);
+    shared_ptr<Net<Dtype> > pruned(new Net<Dtype>(pruned_param));
+    pruned->CopyTrainedLayersFrom(weights);
+    return pruned;
+  }
+
+  const int seed_;
+  NetParameter param_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(ChannelPruningTest, TestDtypes);
+
+TYPED_TEST(ChannelPruningTest, TestPruneByGamma) {
+  typedef TypeParam Dtype;
+  this->InitChainNet();
+  // Channels 1 and 3 are scaled to 0, so removing them changes nothing.
+  Layer<Dtype>& scale = *this->net_->layer_by_name("scale1");
+  const Dtype gamma[] = {0.5, 0, 2, 0};
+  const Dtype beta[] = {0.1, 0, 0.2, 0};
+  std::copy(gamma, gamma + 4, scale.blobs()[0]->mutable_cpu_data());
+  std::copy(beta, beta + 4, scale.blobs()[1]->mutable_cpu_data());
+  Blob<Dtype> conv1_weights;
+  conv1_weights.CopyFrom(*this->net_->layer_by_name("conv1")->blobs()[0],
+      false, true);
+  this->FillInput();
+  this->net_->Forward();
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->net_->blob_by_name("ip"), false, true);
+  const double multiply_adds = MultiplyAdds(*this->net_);
+
+  std::set<string> layers;
+  layers.insert("conv1");
+  PrunedConvolutions convolutions;
+  EXPECT_EQ(1, PruneChannels(this->net_.get(), 0.5, "auto", layers,
+      &convolutions));
+  ASSERT_EQ(1, convolutions.size());
+  EXPECT_EQ(2, convolutions["conv1"].first);
+  EXPECT_EQ(1, convolutions["conv1"].second);
+  // The filters of channels 0 and 2 are kept, in order.
+  const Blob<Dtype>& weights =
+      *this->net_->layer_by_name("conv1")->blobs()[0];
+  ASSERT_EQ(2, weights.shape(0));
+  const int filter_size = weights.count(1);
+  for (int i = 0; i < filter_size; ++i) {
+    EXPECT_EQ(conv1_weights.cpu_data()[i], weights.cpu_data()[i]);
+    EXPECT_EQ(conv1_weights.cpu_data()[2 * filter_size + i],
+        weights.cpu_data()[filter_size + i]);
+  }
+  EXPECT_EQ(2, scale.blobs()[0]->count());
+  EXPECT_EQ(2, this->net_->layer_by_name("conv2")->blobs()[0]->shape(1));
+
+  shared_ptr<Net<Dtype> > pruned = this->PrunedNet(convolutions);
+  Blob<Dtype>* data = pruned->input_blobs()[0];
+  data->CopyFrom(*this->net_->input_blobs()[0]);
+  pruned->Forward();
+  const Blob<Dtype>& result = *pruned->blob_by_name("ip");
+  ASSERT_EQ(expected.count(), result.count());
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], result.cpu_data()[i], 1e-4);
+  }
+  EXPECT_LT(MultiplyAdds(*pruned), multiply_adds);
+}
+
+TYPED_TEST(ChannelPruningTest, TestPruneByL1) {
+  typedef TypeParam Dtype;
+  this->InitChainNet();
+  // Channel 2 has the smallest filters.
+  Blob<Dtype>& weights = *this->net_->layer_by_name("conv1")->blobs()[0];
+  const int filter_size = weights.count(1);
+  for (int i = 0; i < filter_size; ++i) {
+    weights.mutable_cpu_data()[2 * filter_size + i] = 1e-3;
+  }
+  const Dtype last = weights.cpu_data()[3 * filter_size];
+  PrunedConvolutions convolutions;
+  EXPECT_EQ(2, PruneChannels(this->net_.get(), 0.25, "l1",
+      std::set<string>(), &convolutions));
+  EXPECT_EQ(3, convolutions["conv1"].first);
+  EXPECT_EQ(2, convolutions["conv2"].first);
+  ASSERT_EQ(3, weights.shape(0));
+  EXPECT_EQ(last, weights.cpu_data()[2 * filter_size]);
+  // The inner product loses the inputs of the removed conv2 channel.
+  const Blob<Dtype>& ip_weights =
+      *this->net_->layer_by_name("ip")->blobs()[0];
+  EXPECT_EQ(2 * 4 * 4, ip_weights.shape(1));
+
+  shared_ptr<Net<Dtype> > pruned = this->PrunedNet(convolutions);
+  pruned->Forward();
+  EXPECT_EQ(2, pruned->blob_by_name("conv2")->shape(1));
+}
+
+TYPED_TEST(ChannelPruningTest, TestPruneThroughDepthwise) {
+  typedef TypeParam Dtype;
+  // conv1 feeds a group == channels convolution with a multiplier of 2.
+  this->InitNet(
+      "name: 'PruningTestNetwork' "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 6 } } } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' convolution_param { num_output: 4 kernel_size: 1 "
+      "  bias_term: false weight_filler { type: 'gaussian' } } } "
+      "layer { name: 'dw' type: 'Convolution' bottom: 'conv1' top: 'dw' "
+      "  convolution_param { num_output: 8 group: 4 kernel_size: 3 pad: 1 "
+      "  bias_term: false weight_filler { type: 'gaussian' } } } "
+      "layer { name: 'relu' type: 'ReLU' bottom: 'dw' top: 'dw' } "
+      "layer { name: 'conv2' type: 'Convolution' bottom: 'dw' "
+      "  top: 'conv2' convolution_param { num_output: 3 kernel_size: 3 "
+      "  weight_filler { type: 'gaussian' } } } ");
+  // Channels 1 and 3 are always 0, so removing them changes nothing.
+  Blob<Dtype>& weights = *this->net_->layer_by_name("conv1")->blobs()[0];
+  const int filter_size = weights.count(1);
+  for (int i = 0; i < filter_size; ++i) {
+    weights.mutable_cpu_data()[filter_size + i] = 0;
+    weights.mutable_cpu_data()[3 * filter_size + i] = 0;
+  }
+  Blob<Dtype> kept_dw_weights;
+  kept_dw_weights.CopyFrom(*this->net_->layer_by_name("dw")->blobs()[0],
+      false, true);
+  this->FillInput();
+  this->net_->Forward();
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->net_->blob_by_name("conv2"), false, true);
+
+  std::set<string> layers;
+  layers.insert("conv1");
+  PrunedConvolutions convolutions;
+  EXPECT_EQ(1, PruneChannels(this->net_.get(), 0.5, "l1", layers,
+      &convolutions));
+  EXPECT_EQ(2, convolutions["conv1"].first);
+  EXPECT_EQ(4, convolutions["dw"].first);
+  EXPECT_EQ(2, convolutions["dw"].second);
+  // The depthwise filters of channels 0 and 2 are kept, with both of their
+  // outputs.
+  const Blob<Dtype>& dw = *this->net_->layer_by_name("dw")->blobs()[0];
+  ASSERT_EQ(4, dw.shape(0));
+  const int dw_size = dw.count(1);
+  for (int i = 0; i < 2 * dw_size; ++i) {
+    EXPECT_EQ(kept_dw_weights.cpu_data()[i], dw.cpu_data()[i]);
+    EXPECT_EQ(kept_dw_weights.cpu_data()[4 * dw_size + i],
+        dw.cpu_data()[2 * dw_size + i]);
+  }
+  EXPECT_EQ(4, this->net_->layer_by_name("conv2")->blobs()[0]->shape(1));
+
+  shared_ptr<Net<Dtype> > pruned = this->PrunedNet(convolutions);
+  pruned->input_blobs()[0]->CopyFrom(*this->net_->input_blobs()[0]);
+  pruned->Forward();
+  const Blob<Dtype>& result = *pruned->blob_by_name("conv2");
+  ASSERT_EQ(expected.count(), result.count());
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], result.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ChannelPruningTest, TestSkipMultipleInputs) {
+  this->InitNet(
+      "name: 'PruningTestNetwork' "
+      "layer { name: 'data' type: 'Input' top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 6 } } } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' convolution_param { num_output: 3 kernel_size: 3 "
+      "  pad: 1 weight_filler { type: 'gaussian' } } } "
+      "layer { name: 'sum' type: 'Eltwise' bottom: 'data' bottom: 'conv1' "
+      "  top: 'sum' } "
+      "layer { name: 'ip' type: 'InnerProduct' bottom: 'sum' top: 'ip' "
+      "  inner_product_param { num_output: 2 "
+      "  weight_filler { type: 'gaussian' } } } ");
+  PrunedConvolutions convolutions;
+  EXPECT_EQ(0, PruneChannels(this->net_.get(), 0.5, "auto",
+      std::set<string>(), &convolutions));
+  EXPECT_TRUE(convolutions.empty());
+  EXPECT_EQ(3, this->net_->layer_by_name("conv1")->blobs()[0]->shape(0));
+}
+
+}  // namespace caffe
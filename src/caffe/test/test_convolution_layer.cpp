@@ -495,6 +495,125 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestDilatedConvolutionGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> bottom_shape(4);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 4;
+  bottom_shape[2] = 9;
+  bottom_shape[3] = 7;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  this->blob_bottom_->Reshape(bottom_shape);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(2);
+  convolution_param->add_stride(2);
+  convolution_param->add_dilation(2);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against reference convolution.
+  const Dtype* top_data;
+  const Dtype* ref_top_data;
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  top_data = this->blob_top_->cpu_data();
+  ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestPackedWeightsConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(4);
+  convolution_param->set_pack_weights(true);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The second pass checks that changed weights are repacked.
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass > 0) {
+      caffe_scal(layer->blobs()[0]->count(), Dtype(-2),
+          layer->blobs()[0]->mutable_cpu_data());
+    }
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestSparseWeightsConvolutionGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> bottom_shape(4);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 10;
+  bottom_shape[2] = 6;
+  bottom_shape[3] = 5;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  this->blob_bottom_->Reshape(bottom_shape);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->set_group(2);
+  convolution_param->set_sparse_threshold(0.5);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Prune all but every third weight; the second pass runs dense again.
+  Blob<Dtype>* weights = layer->blobs()[0].get();
+  for (int i = 0; i < weights->count(); ++i) {
+    if (i % 3) {
+      weights->mutable_cpu_data()[i] = 0;
+    }
+  }
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass > 0) {
+      filler.Fill(weights);
+    }
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   // Test separable convolution by computing the Sobel operator
   // as a single filter then comparing the result
@@ -811,6 +930,34 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestGradientDilatedGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> bottom_shape(4);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 4;
+  bottom_shape[2] = 7;
+  bottom_shape[3] = 6;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  this->blob_bottom_->Reshape(bottom_shape);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->add_stride(2);
+  convolution_param->add_dilation(2);
+  convolution_param->set_num_output(4);
+  convolution_param->set_group(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
@@ -0,0 +1,73 @@
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/cpu_isa.hpp"
+#include "caffe/util/cpu_kernel.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+typedef CpuIsa (*TestKernelFunction)();
+
+CpuIsa test_kernel_generic() { return CPU_ISA_GENERIC; }
+CpuIsa test_kernel_avx2() { return CPU_ISA_AVX2; }
+
+REGISTER_CPU_KERNEL(TestKernelFunction, test_kernel, CPU_ISA_GENERIC,
+    test_kernel_generic);
+REGISTER_CPU_KERNEL(TestKernelFunction, test_kernel, CPU_ISA_AVX2,
+    test_kernel_avx2);
+
+class CpuKernelTest : public ::testing::Test {
+ protected:
+  CpuKernelTest() : selected_isa_(SelectedCpuIsa()) {}
+
+  virtual ~CpuKernelTest() {
+    SetSelectedCpuIsa(selected_isa_);
+  }
+
+  const CpuIsa selected_isa_;
+};
+
+TEST_F(CpuKernelTest, TestIsaNames) {
+  for (int i = 0; i < CPU_ISA_COUNT; ++i) {
+    const CpuIsa isa = static_cast<CpuIsa>(i);
+    CpuIsa parsed;
+    EXPECT_TRUE(CpuIsaFromName(CpuIsaName(isa), &parsed));
+    EXPECT_EQ(isa, parsed);
+  }
+  CpuIsa parsed;
+  EXPECT_FALSE(CpuIsaFromName("avx3", &parsed));
+}
+
+TEST_F(CpuKernelTest, TestSelectedIsa) {
+  EXPECT_LE(SelectedCpuIsa(), DetectCpuIsa());
+  SetSelectedCpuIsa(CPU_ISA_GENERIC);
+  EXPECT_EQ(CPU_ISA_GENERIC, SelectedCpuIsa());
+}
+
+TEST_F(CpuKernelTest, TestGetKernel) {
+  const CpuIsa expected[CPU_ISA_COUNT] = {CPU_ISA_GENERIC, CPU_ISA_GENERIC,
+      CPU_ISA_AVX2, CPU_ISA_AVX2, CPU_ISA_AVX2};
+  for (int i = 0; i < CPU_ISA_COUNT; ++i) {
+    CpuIsa level;
+    TestKernelFunction kernel =
+        CpuKernelRegistry<TestKernelFunction>::GetKernel("test_kernel",
+            static_cast<CpuIsa>(i), &level);
+    EXPECT_EQ(expected[i], level);
+    EXPECT_EQ(expected[i], kernel());
+  }
+}
+
+TEST_F(CpuKernelTest, TestKernelFollowsSelectedIsa) {
+  CpuKernel<TestKernelFunction> kernel("test_kernel");
+  for (int i = 0; i <= DetectCpuIsa(); ++i) {
+    SetSelectedCpuIsa(static_cast<CpuIsa>(i));
+    EXPECT_EQ(i >= CPU_ISA_AVX2 ? CPU_ISA_AVX2 : CPU_ISA_GENERIC,
+              kernel.get()());
+  }
+}
+
+}  // namespace caffe
@@ -195,13 +195,81 @@ TYPED_TEST(EltwiseLayerTest, TestMax) {
   }
 }
 
+TYPED_TEST(EltwiseLayerTest, TestMaxManyBottoms) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Up to 256 bottoms, the winner is recorded as a byte; with more, the full
+  // index is used.
+  for (int num_bottoms = 255; num_bottoms <= 257; ++num_bottoms) {
+    vector<shared_ptr<Blob<Dtype> > > bottoms;
+    vector<Blob<Dtype>*> bottom_vec;
+    FillerParameter filler_param;
+    UniformFiller<Dtype> filler(filler_param);
+    for (int b = 0; b < num_bottoms; ++b) {
+      bottoms.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(2, 3, 1, 1)));
+      filler.Fill(bottoms.back().get());
+      bottom_vec.push_back(bottoms.back().get());
+    }
+    // The last bottoms win some elements.
+    const int winners[] = {num_bottoms - 1, num_bottoms - 2, 254, 0};
+    for (int i = 0; i < 4; ++i) {
+      bottoms[winners[i]]->mutable_cpu_data()[i] = 2;
+    }
+    LayerParameter layer_param;
+    layer_param.mutable_eltwise_param()->set_operation(
+        EltwiseParameter_EltwiseOp_MAX);
+    EltwiseLayer<Dtype> layer(layer_param);
+    layer.SetUp(bottom_vec, this->blob_top_vec_);
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+    caffe_set(this->blob_top_->count(), Dtype(1),
+        this->blob_top_->mutable_cpu_diff());
+    layer.Backward(this->blob_top_vec_,
+        vector<bool>(num_bottoms, true), bottom_vec);
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      int winner = 0;
+      for (int b = 1; b < num_bottoms; ++b) {
+        if (bottoms[b]->cpu_data()[i] > bottoms[winner]->cpu_data()[i]) {
+          winner = b;
+        }
+      }
+      if (i < 4) {
+        EXPECT_EQ(winners[i], winner);
+      }
+      EXPECT_EQ(bottoms[winner]->cpu_data()[i],
+          this->blob_top_->cpu_data()[i]);
+      for (int b = 0; b < num_bottoms; ++b) {
+        EXPECT_EQ(b == winner ? 1 : 0, bottoms[b]->cpu_diff()[i])
+            << num_bottoms << " bottoms, element " << i << ", bottom " << b;
+      }
+    }
+  }
+}
+
 TYPED_TEST(EltwiseLayerTest, TestMaxGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
   EltwiseParameter* eltwise_param = layer_param.mutable_eltwise_param();
   eltwise_param->set_operation(EltwiseParameter_EltwiseOp_MAX);
   EltwiseLayer<Dtype> layer(layer_param);
-  GradientChecker<Dtype> checker(1e-4, 1e-3);
+  // Max is not differentiable where its inputs tie: move them further apart
+  // than the step, so that no finite difference crosses a tie.
+  const Dtype kStepsize = 1e-4;
+  for (int i = 0; i < this->blob_bottom_a_->count(); ++i) {
+    bool moved = true;
+    while (moved) {
+      moved = false;
+      for (int j = 0; j < this->blob_bottom_vec_.size(); ++j) {
+        for (int k = j + 1; k < this->blob_bottom_vec_.size(); ++k) {
+          const Dtype x = this->blob_bottom_vec_[j]->cpu_data()[i];
+          Dtype* y = this->blob_bottom_vec_[k]->mutable_cpu_data() + i;
+          if (fabs(x - *y) < 4 * kStepsize) {
+            *y += 8 * kStepsize;
+            moved = true;
+          }
+        }
+      }
+    }
+  }
+  GradientChecker<Dtype> checker(kStepsize, 1e-3);
   checker.CheckGradientEltwise(&layer, this->blob_bottom_vec_,
       this->blob_top_vec_);
 }
@@ -1,11 +1,16 @@
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/embed_layer.hpp"
+#include "caffe/solver.hpp"
+#include "caffe/solver_factory.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -175,4 +180,120 @@ TYPED_TEST(EmbedLayerTest, TestGradientWithBias) {
       this->blob_top_vec_, -2);
 }
 
+TYPED_TEST(EmbedLayerTest, TestSparseGradientRows) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  EmbedParameter* embed_param = layer_param.mutable_embed_param();
+  embed_param->set_num_output(10);
+  embed_param->set_input_dim(5);
+  EmbedLayer<Dtype> dense_layer(layer_param);
+  dense_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_TRUE(dense_layer.param_diff_rows(0) == NULL);
+  embed_param->set_sparse_gradient(true);
+  EmbedLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_TRUE(layer.param_diff_rows(0) != NULL);
+  EXPECT_TRUE(layer.param_diff_rows(1) == NULL);
+  this->blob_bottom_->mutable_cpu_data()[0] = 4;
+  this->blob_bottom_->mutable_cpu_data()[1] = 2;
+  this->blob_bottom_->mutable_cpu_data()[2] = 2;
+  this->blob_bottom_->mutable_cpu_data()[3] = 3;
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Backward(this->blob_top_vec_, vector<bool>(1, false),
+      this->blob_bottom_vec_);
+  if (Caffe::mode() == Caffe::CPU) {
+    const vector<int>& rows = *layer.param_diff_rows(0);
+    ASSERT_EQ(4, rows.size());
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(this->blob_bottom_->cpu_data()[i], rows[i]);
+    }
+  }
+}
+
+template <typename Dtype>
+class EmbedSparseGradientTest : public CPUDeviceTest<Dtype> {
+ protected:
+  // Trains a net embedding the inputs 1 and 3 out of 5 for num_iters
+  // iterations and returns the embedding weights.
+  vector<Dtype> Train(const string& solver_type, const bool sparse_gradient,
+      const int num_iters) {
+    std::ostringstream proto;
+    const bool no_momentum = solver_type == "AdaGrad" ||
+        solver_type == "RMSProp";
+    proto <<
+        "type: '" << solver_type << "' "
+        "base_lr: 0.1 "
+        "lr_policy: 'fixed' "
+        "momentum: " << (no_momentum ? 0 : 0.9) << " "
+        "weight_decay: 0.01 "
+        "random_seed: 1701 "
+        "net_param { "
+        "  layer { "
+        "    name: 'a' type: 'DummyData' top: 'a' "
+        "    dummy_data_param { "
+        "      shape { dim: 2 } "
+        "      data_filler { type: 'constant' value: 1 } "
+        "    } "
+        "  } "
+        "  layer { "
+        "    name: 'b' type: 'DummyData' top: 'b' top: 'target' "
+        "    dummy_data_param { "
+        "      shape { dim: 2 } "
+        "      data_filler { type: 'constant' value: 3 } "
+        "      shape { dim: 4 dim: 3 } "
+        "      data_filler { type: 'gaussian' } "
+        "    } "
+        "  } "
+        "  layer { "
+        "    name: 'data' type: 'Concat' bottom: 'a' bottom: 'b' top: 'data' "
+        "    concat_param { axis: 0 } "
+        "  } "
+        "  layer { "
+        "    name: 'embed' type: 'Embed' bottom: 'data' top: 'embed' "
+        "    embed_param { "
+        "      num_output: 3 input_dim: 5 "
+        "      weight_filler { type: 'gaussian' } "
+        "      sparse_gradient: " << sparse_gradient <<
+        "    } "
+        "  } "
+        "  layer { "
+        "    name: 'loss' type: 'EuclideanLoss' "
+        "    bottom: 'embed' bottom: 'target' "
+        "  } "
+        "} ";
+    SolverParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto.str(), &param));
+    shared_ptr<Solver<Dtype> > solver(
+        SolverRegistry<Dtype>::CreateSolver(param));
+    solver->Step(num_iters);
+    const Blob<Dtype>* weights = solver->net()->learnable_params()[0];
+    return vector<Dtype>(weights->cpu_data(),
+                         weights->cpu_data() + weights->count());
+  }
+};
+
+TYPED_TEST_CASE(EmbedSparseGradientTest, TestDtypes);
+
+TYPED_TEST(EmbedSparseGradientTest, TestLazyUpdates) {
+  const int kNumSolvers = 6;
+  const char* solver_types[kNumSolvers] =
+      {"SGD", "Nesterov", "AdaGrad", "RMSProp", "AdaDelta", "Adam"};
+  for (int i = 0; i < kNumSolvers; ++i) {
+    const vector<TypeParam> initial = this->Train(solver_types[i], true, 0);
+    const vector<TypeParam> dense = this->Train(solver_types[i], false, 4);
+    const vector<TypeParam> sparse = this->Train(solver_types[i], true, 4);
+    // Rows 1 and 3 are updated as by the dense solver; the others, which no
+    // input touches, are left alone in spite of momentum and weight decay.
+    for (int j = 0; j < initial.size(); ++j) {
+      const int row = j / 3;
+      if (row == 1 || row == 3) {
+        EXPECT_NE(initial[j], sparse[j]) << solver_types[i];
+        EXPECT_NEAR(dense[j], sparse[j], 1e-5) << solver_types[i];
+      } else {
+        EXPECT_EQ(initial[j], sparse[j]) << solver_types[i];
+      }
+    }
+  }
+}
+
 }  // namespace caffe
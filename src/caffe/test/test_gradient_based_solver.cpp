@@ -26,7 +26,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
  protected:
   GradientBasedSolverTest() :
       seed_(1701), num_(4), channels_(3), height_(10), width_(10),
-      share_(false) {
+      share_(false),
+      snapshot_format_(SolverParameter_SnapshotFormat_BINARYPROTO) {
         input_file_ = new string(
         ABS_TEST_DATA_DIR "/solver_data_list.txt");
       }
@@ -44,6 +45,7 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
   // TODO this is brittle and the hdf5 file should be checked instead.
   int num_, channels_, height_, width_;
   bool share_;
+  SolverParameter_SnapshotFormat snapshot_format_;
   Dtype delta_;  // Stability constant for RMSProp, AdaGrad, AdaDelta and Adam
 
   // Test data: check out generate_sample_data.py in the same directory.
@@ -183,6 +185,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     proto << "snapshot_prefix: '" << snapshot_prefix_ << "/' ";
     if (snapshot) {
       proto << "snapshot: " << num_iters << " ";
+      proto << "snapshot_format: "
+            << SolverParameter_SnapshotFormat_Name(snapshot_format_) << " ";
     }
     Caffe::set_random_seed(this->seed_);
     this->InitSolverFromProtoString(proto.str());
@@ -215,6 +219,9 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
       ostringstream resume_file;
       resume_file << snapshot_prefix_ << "/_iter_" << num_iters
                   << ".solverstate";
+      if (snapshot_format_ == SolverParameter_SnapshotFormat_CHUNKED) {
+        resume_file << ".manifest";
+      }
       string resume_filename = resume_file.str();
       return resume_filename;
     }
@@ -261,9 +268,11 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     Blob<Dtype>& updated_bias = *(*updated_params)[1];
     updated_bias.ReshapeLike(bias);
 
+    // Compute the derivative with respect to each weight (i.e., each element
+    // of the gradient) first, as LARS and LAMB scale the updates by norms
+    // over the whole weight and bias blobs.
+    vector<Dtype> grads(D + 1);
     for (int i = 0; i <= D; ++i) {
-      // Compute the derivative with respect to the ith weight (i.e., the ith
-      // element of the gradient).
       Dtype grad = 0;
       for (int j = 0; j <= D; ++j) {
         // Compute element (i, j) of X^T * X.
@@ -285,14 +294,56 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
         grad -= element_i * targets.cpu_data()[k];
       }
       // Scale the gradient over the N samples.
-      grad /= N;
+      grads[i] = grad / N;
+    }
+
+    // The LARS and LAMB trust ratios of the weights (0) and the bias (1).
+    const vector<shared_ptr<Blob<Dtype> > >& history = solver_->history();
+    const Dtype momentum2 = 0.999;
+    vector<Dtype> lamb_dirs(D + 1);
+    Dtype trust[2] = {1, 1};
+    if (solver_->type() == string("LARS")
+        || solver_->type() == string("LAMB")) {
+      Dtype w_sumsq[2] = {0, 0};
+      Dtype dir_sumsq[2] = {0, 0};
+      for (int i = 0; i <= D; ++i) {
+        const Dtype w = (i == D) ? bias.cpu_data()[0] : weights.cpu_data()[i];
+        Dtype dir = grads[i] + weight_decay * w;
+        if (solver_->type() == string("LAMB")) {
+          // Adam direction of the undecayed gradient plus decoupled decay.
+          const Dtype m = (i == D) ?
+              history[1]->cpu_data()[0] : history[0]->cpu_data()[i];
+          const Dtype v = (i == D) ?
+              history[1 + num_param_blobs]->cpu_data()[0] :
+              history[0 + num_param_blobs]->cpu_data()[i];
+          const Dtype val_m = (1 - momentum) * grads[i] + momentum * m;
+          const Dtype val_v =
+              (1 - momentum2) * grads[i] * grads[i] + momentum2 * v;
+          const Dtype m_hat = val_m / (1 - pow(momentum, num_iters));
+          const Dtype v_hat = val_v / (1 - pow(momentum2, num_iters));
+          dir = m_hat / (std::sqrt(v_hat) + delta_) + weight_decay * w;
+          lamb_dirs[i] = dir;
+        }
+        w_sumsq[i == D] += w * w;
+        dir_sumsq[i == D] += dir * dir;
+      }
+      const Dtype eta = (solver_->type() == string("LARS")) ?
+          solver_->param().trust_coefficient() : 1;
+      for (int b = 0; b < 2; ++b) {
+        if (w_sumsq[b] > 0 && dir_sumsq[b] > 0) {
+          trust[b] = eta * std::sqrt(w_sumsq[b]) / std::sqrt(dir_sumsq[b]);
+        }
+      }
+    }
+
+    for (int i = 0; i <= D; ++i) {
       // Add the weight decay to the gradient.
-      grad += weight_decay *
+      const Dtype grad = grads[i] + weight_decay *
           ((i == D) ? bias.cpu_data()[0] : weights.cpu_data()[i]);
       // Finally, compute update.
-      const vector<shared_ptr<Blob<Dtype> > >& history = solver_->history();
       if (solver_->type() != string("AdaDelta")
-          && solver_->type() != string("Adam")) {
+          && solver_->type() != string("Adam")
+          && solver_->type() != string("LAMB")) {
         ASSERT_EQ(2, history.size());  // 1 blob for weights, 1 for bias
       } else {
         ASSERT_EQ(4, history.size());  // additional blobs for update history
@@ -325,7 +376,6 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
         // const Dtype weighted_update_average =
         //   momentum * update_history_value + (1 - momentum) * (update_value);
       } else if (solver_->type() == string("Adam")) {
-        const Dtype momentum2 = 0.999;
         const Dtype m = history_value;
         const Dtype v = (i == D) ?
             history[1 + num_param_blobs]->cpu_data()[0] :
@@ -336,6 +386,10 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
             std::sqrt(Dtype(1) - pow(momentum2, num_iters)) /
             (Dtype(1.) - pow(momentum, num_iters));
         update_value = alpha_t * val_m / (std::sqrt(val_v) + delta_);
+      } else if (solver_->type() == string("LARS")) {
+        update_value = trust[i == D] * update_value + temp;
+      } else if (solver_->type() == string("LAMB")) {
+        update_value = learning_rate * trust[i == D] * lamb_dirs[i];
       } else {
         LOG(FATAL) << "Unknown solver type: " << solver_->type();
       }
@@ -382,7 +436,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     EXPECT_NEAR(expected_updated_bias, solver_updated_bias, error_margin);
 
     // Check the solver's history -- should contain the previous update value.
-    if (solver_->type() == string("SGD")) {
+    if (solver_->type() == string("SGD")
+        || solver_->type() == string("LARS")) {
       const vector<shared_ptr<Blob<Dtype> > >& history = solver_->history();
       ASSERT_EQ(2, history.size());
       for (int i = 0; i < D; ++i) {
@@ -706,6 +761,18 @@ TYPED_TEST(SGDSolverTest, TestSnapshot) {
   }
 }
 
+TYPED_TEST(SGDSolverTest, TestSnapshotChunked) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->snapshot_format_ = SolverParameter_SnapshotFormat_CHUNKED;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 TYPED_TEST(SGDSolverTest, TestSnapshotShare) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -1183,6 +1250,185 @@ TYPED_TEST(AdamSolverTest, TestSnapshotShare) {
   }
 }
 
+template <typename TypeParam>
+class LARSSolverTest : public GradientBasedSolverTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void InitSolver(const SolverParameter& param) {
+    SolverParameter new_param = param;
+    // A large coefficient, so that the scaled steps are well above the
+    // precision of the checks.
+    new_param.set_trust_coefficient(0.5);
+    this->solver_.reset(new LARSSolver<Dtype>(new_param));
+  }
+};
+
+TYPED_TEST_CASE(LARSSolverTest, TestDtypesAndDevices);
+
+TYPED_TEST(LARSSolverTest, TestLARSLeastSquaresUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0;
+  const Dtype kMomentum = 0;
+  this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum);
+}
+
+TYPED_TEST(LARSSolverTest, TestLARSLeastSquaresUpdateWithWeightDecay) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0;
+  this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum);
+}
+
+TYPED_TEST(LARSSolverTest, TestLARSLeastSquaresUpdateWithEverything) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(LARSSolverTest, TestLARSLeastSquaresUpdateWithEverythingShare) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->share_ = true;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(LARSSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  const int kIterSize = 2;
+  this->CheckAccumulation(kLearningRate, kWeightDecay, kMomentum, kNumIters,
+      kIterSize);
+}
+
+TYPED_TEST(LARSSolverTest, TestSnapshot) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(LARSSolverTest, TestSnapshotShare) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->share_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+template <typename TypeParam>
+class LAMBSolverTest : public GradientBasedSolverTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void InitSolver(const SolverParameter& param) {
+    SolverParameter new_param = param;
+    const Dtype momentum = 0.9;
+    new_param.set_momentum(momentum);
+    const Dtype momentum2 = 0.999;
+    new_param.set_momentum2(momentum2);
+    this->solver_.reset(new LAMBSolver<Dtype>(new_param));
+  }
+};
+
+TYPED_TEST_CASE(LAMBSolverTest, TestDtypesAndDevices);
+
+TYPED_TEST(LAMBSolverTest, TestLAMBLeastSquaresUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0;
+  const Dtype kMomentum = 0.9;
+  this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum);
+}
+
+TYPED_TEST(LAMBSolverTest, TestLAMBLeastSquaresUpdateWithWeightDecay) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum);
+}
+
+TYPED_TEST(LAMBSolverTest, TestLAMBLeastSquaresUpdateWithEverything) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(LAMBSolverTest, TestLAMBLeastSquaresUpdateWithEverythingShare) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->share_ = true;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(LAMBSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  const int kIterSize = 2;
+  this->CheckAccumulation(kLearningRate, kWeightDecay, kMomentum, kNumIters,
+      kIterSize);
+}
+
+TYPED_TEST(LAMBSolverTest, TestSnapshot) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(LAMBSolverTest, TestSnapshotShare) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->share_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 template <typename TypeParam>
 class RMSPropSolverTest : public GradientBasedSolverTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
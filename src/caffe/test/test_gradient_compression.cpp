@@ -0,0 +1,551 @@
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/internal_thread.hpp"
+#include "caffe/parallel.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/sgd_solvers.hpp"
+#include "caffe/util/gradient_compression.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class GradientCompressionTest : public ::testing::Test {
+ protected:
+  GradientCompressionTest() : grad_(kCount) {
+    for (int i = 0; i < kCount; ++i) {
+      grad_[i] = (i % 2 ? -1 : 1) * Dtype(i + 1) / kCount;
+    }
+  }
+
+  GradientCompressor<Dtype>* Create(GradientCompressionParameter_Method method,
+      bool error_feedback) {
+    GradientCompressionParameter param;
+    param.set_method(method);
+    param.set_topk_ratio(0.1);
+    param.set_error_feedback(error_feedback);
+    return GetGradientCompressor<Dtype>(param, kCount);
+  }
+
+  // Encodes grad_ and returns the decoded gradient.
+  vector<Dtype> RoundTrip(GradientCompressor<Dtype>* compressor) {
+    string message;
+    compressor->Encode(&grad_[0], &message);
+    vector<Dtype> decoded(kCount, Dtype(0));
+    compressor->DecodeAdd(message, Dtype(1), &decoded[0]);
+    return decoded;
+  }
+
+  static const int kCount = 40;
+  vector<Dtype> grad_;
+};
+
+TYPED_TEST_CASE(GradientCompressionTest, TestDtypes);
+
+TYPED_TEST(GradientCompressionTest, TestNone) {
+  EXPECT_TRUE(this->Create(GradientCompressionParameter_Method_NONE, true)
+      == NULL);
+}
+
+TYPED_TEST(GradientCompressionTest, TestHalf) {
+  typedef TypeParam Dtype;
+  shared_ptr<GradientCompressor<Dtype> > compressor(
+      this->Create(GradientCompressionParameter_Method_FP16, false));
+  // Multiples of 1 / 40 have 11 significant bits at most after rounding.
+  const vector<Dtype> decoded = this->RoundTrip(compressor.get());
+  for (int i = 0; i < this->kCount; ++i) {
+    EXPECT_NEAR(this->grad_[i], decoded[i], std::abs(this->grad_[i]) / 1024);
+  }
+  EXPECT_EQ(sizeof(Dtype) / 2., compressor->compression_ratio());
+  // Exactly representable values, including the largest and the smallest
+  // subnormal half, are kept.
+  const Dtype exact[] = {65504, -1.5, 0.25, 6.103515625e-05,
+      5.9604644775390625e-08, 0};
+  for (int i = 0; i < 6; ++i) {
+    this->grad_[i] = exact[i];
+  }
+  const vector<Dtype> exact_decoded = this->RoundTrip(compressor.get());
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(exact[i], exact_decoded[i]);
+  }
+}
+
+TYPED_TEST(GradientCompressionTest, TestBFloat16) {
+  typedef TypeParam Dtype;
+  shared_ptr<GradientCompressor<Dtype> > compressor(
+      this->Create(GradientCompressionParameter_Method_BF16, false));
+  this->grad_[0] = 1e30;
+  this->grad_[1] = -1e-30;
+  const vector<Dtype> decoded = this->RoundTrip(compressor.get());
+  for (int i = 0; i < this->kCount; ++i) {
+    EXPECT_NEAR(this->grad_[i], decoded[i], std::abs(this->grad_[i]) / 256);
+  }
+  EXPECT_EQ(sizeof(Dtype) / 2., compressor->compression_ratio());
+}
+
+TYPED_TEST(GradientCompressionTest, TestTopK) {
+  typedef TypeParam Dtype;
+  shared_ptr<GradientCompressor<Dtype> > compressor(
+      this->Create(GradientCompressionParameter_Method_TOPK, false));
+  // The 4 largest magnitudes are the last 4 values.
+  const vector<Dtype> decoded = this->RoundTrip(compressor.get());
+  for (int i = 0; i < this->kCount; ++i) {
+    if (i < this->kCount - 4) {
+      EXPECT_EQ(0, decoded[i]);
+    } else {
+      EXPECT_NEAR(this->grad_[i], decoded[i], 1e-6);
+    }
+  }
+  EXPECT_NEAR(this->kCount * sizeof(Dtype) / (4. * 8),
+      compressor->compression_ratio(), 1e-6);
+}
+
+TYPED_TEST(GradientCompressionTest, TestSign) {
+  typedef TypeParam Dtype;
+  shared_ptr<GradientCompressor<Dtype> > compressor(
+      this->Create(GradientCompressionParameter_Method_SIGN, false));
+  Dtype mean_magnitude = 0;
+  for (int i = 0; i < this->kCount; ++i) {
+    mean_magnitude += std::abs(this->grad_[i]) / this->kCount;
+  }
+  const vector<Dtype> decoded = this->RoundTrip(compressor.get());
+  for (int i = 0; i < this->kCount; ++i) {
+    EXPECT_NEAR(this->grad_[i] > 0 ? mean_magnitude : -mean_magnitude,
+        decoded[i], 1e-6);
+  }
+  EXPECT_NEAR(this->kCount * sizeof(Dtype) / (4. + this->kCount / 8),
+      compressor->compression_ratio(), 1e-6);
+}
+
+TYPED_TEST(GradientCompressionTest, TestErrorFeedback) {
+  typedef TypeParam Dtype;
+  const GradientCompressionParameter_Method methods[] = {
+      GradientCompressionParameter_Method_TOPK,
+      GradientCompressionParameter_Method_SIGN};
+  for (int m = 0; m < 2; ++m) {
+    shared_ptr<GradientCompressor<Dtype> > compressor(
+        this->Create(methods[m], true));
+    // Sending the same gradient again and again, what is lost is carried
+    // over, so that the average of the decoded gradients converges to it.
+    const int kIters = 2000;
+    vector<Dtype> total(this->kCount, Dtype(0));
+    for (int iter = 0; iter < kIters; ++iter) {
+      const vector<Dtype> decoded = this->RoundTrip(compressor.get());
+      for (int i = 0; i < this->kCount; ++i) {
+        total[i] += decoded[i];
+      }
+    }
+    for (int i = 0; i < this->kCount; ++i) {
+      EXPECT_NEAR(this->grad_[i], total[i] / kIters, 0.02)
+          << "method " << methods[m] << " value " << i;
+    }
+  }
+}
+
+// Trains the solver of a replica other than rank 0, like CPUSync::Run does.
+template <typename Dtype>
+class CPUSyncTestWorker : public InternalThread {
+ public:
+  CPUSyncTestWorker(Solver<Dtype>* solver, CPUSync<Dtype>* sync,
+      boost::barrier* barrier)
+      : solver_(solver), sync_(sync), barrier_(barrier) {}
+
+ protected:
+  virtual void InternalThreadEntry() {
+    sync_->Broadcast();
+    solver_->Step(solver_->param().max_iter());
+    barrier_->wait();
+  }
+
+  Solver<Dtype>* solver_;
+  CPUSync<Dtype>* sync_;
+  boost::barrier* barrier_;
+};
+
+// Records the gradient, weights and momentum history of a solver by
+// iteration. Callbacks run in the order they were added, so a recorder added
+// before a CPUSync sees them before they are averaged, and one added after it
+// sees them after.
+template <typename Dtype>
+class CPUSyncTestRecorder : public Solver<Dtype>::Callback {
+ public:
+  explicit CPUSyncTestRecorder(SGDSolver<Dtype>* solver) : solver_(solver) {}
+
+  std::map<int, vector<Dtype> > diffs_;
+  std::map<int, vector<Dtype> > weights_;
+  std::map<int, vector<Dtype> > history_;
+
+ protected:
+  virtual void on_start() {}
+  virtual void on_gradients_ready() {
+    vector<Dtype>& diff = diffs_[solver_->iter()];
+    const vector<Blob<Dtype>*>& params = solver_->net()->learnable_params();
+    for (int i = 0; i < params.size(); ++i) {
+      diff.insert(diff.end(), params[i]->cpu_diff(),
+          params[i]->cpu_diff() + params[i]->count());
+    }
+  }
+  virtual void on_update_applied() {
+    vector<Dtype>& weights = weights_[solver_->iter()];
+    const vector<Blob<Dtype>*>& params = solver_->net()->learnable_params();
+    for (int i = 0; i < params.size(); ++i) {
+      weights.insert(weights.end(), params[i]->cpu_data(),
+          params[i]->cpu_data() + params[i]->count());
+    }
+    vector<Dtype>& history = history_[solver_->iter()];
+    for (int i = 0; i < solver_->history().size(); ++i) {
+      const Blob<Dtype>& blob = *solver_->history()[i];
+      history.insert(history.end(), blob.cpu_data(),
+          blob.cpu_data() + blob.count());
+    }
+  }
+
+  SGDSolver<Dtype>* solver_;
+};
+
+template <typename TypeParam>
+class CPUSyncTest : public MultiDeviceTest<CPUDevice<TypeParam> > {
+  typedef TypeParam Dtype;
+
+ protected:
+  // Trains one solver per worker on the solver definition proto, keeping
+  // them in solvers_ so that the replicas can be compared, and recording
+  // each of them before and after CPUSync. Each solver seeds its fillers
+  // with random_seed plus its rank, so random data differs from one worker
+  // to the next.
+  void TrainReplicas(int workers, const string& proto) {
+    SolverParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    Caffe::set_solver_count(workers);
+    solvers_.clear();
+    syncs_.clear();
+    before_.clear();
+    after_.clear();
+    for (int i = 0; i < workers; ++i) {
+      Caffe::set_solver_rank(i);
+      SGDSolver<Dtype>* solver = new SGDSolver<Dtype>(param);
+      solvers_.push_back(shared_ptr<Solver<Dtype> >(solver));
+      syncs_.push_back(
+          shared_ptr<CPUSync<Dtype> >(new CPUSync<Dtype>(solvers_[i])));
+      before_.push_back(shared_ptr<CPUSyncTestRecorder<Dtype> >(
+          new CPUSyncTestRecorder<Dtype>(solver)));
+      after_.push_back(shared_ptr<CPUSyncTestRecorder<Dtype> >(
+          new CPUSyncTestRecorder<Dtype>(solver)));
+      solver->add_callback(before_[i].get());
+      solver->add_callback(syncs_[i].get());
+      solver->add_callback(after_[i].get());
+    }
+    vector<CPUSync<Dtype>*> syncs(workers);
+    for (int i = 0; i < workers; ++i) {
+      syncs[i] = syncs_[i].get();
+    }
+    boost::barrier barrier(workers);
+    CPUSync<Dtype>::InitSingleProcess(&syncs, &barrier);
+    vector<shared_ptr<CPUSyncTestWorker<Dtype> > > threads(workers);
+    for (int i = 1; i < workers; ++i) {
+      Caffe::set_solver_rank(i);
+      threads[i].reset(new CPUSyncTestWorker<Dtype>(solvers_[i].get(),
+          syncs_[i].get(), &barrier));
+      threads[i]->StartInternalThread();
+    }
+    Caffe::set_solver_rank(0);
+    syncs_[0]->Broadcast();
+    solvers_[0]->Step(param.max_iter());
+    barrier.wait();
+    for (int i = 1; i < workers; ++i) {
+      threads[i]->StopInternalThread();
+    }
+    Caffe::set_solver_count(1);
+  }
+
+  // The learnable params of a replica, concatenated.
+  vector<Dtype> Weights(int rank) {
+    vector<Dtype> weights;
+    const vector<Blob<Dtype>*>& params =
+        solvers_[rank]->net()->learnable_params();
+    for (int i = 0; i < params.size(); ++i) {
+      weights.insert(weights.end(), params[i]->cpu_data(),
+          params[i]->cpu_data() + params[i]->count());
+    }
+    return weights;
+  }
+
+  // The solvers live in the buffers of their syncs.
+  vector<shared_ptr<Solver<Dtype> > > solvers_;
+  vector<shared_ptr<CPUSync<Dtype> > > syncs_;
+  vector<shared_ptr<CPUSyncTestRecorder<Dtype> > > before_;
+  vector<shared_ptr<CPUSyncTestRecorder<Dtype> > > after_;
+
+  // Checks that the replicas' recorded values differ from each other before
+  // CPUSync, and that each equals their element-wise mean after it.
+  void ExpectAveraged(const vector<const vector<Dtype>*>& before,
+      const vector<const vector<Dtype>*>& after, Dtype tolerance) {
+    const int size = before[0]->size();
+    ASSERT_GT(size, 0);
+    vector<Dtype> mean(size, Dtype(0));
+    for (int rank = 0; rank < before.size(); ++rank) {
+      ASSERT_EQ(size, before[rank]->size());
+      caffe_axpy(size, Dtype(1) / before.size(), &(*before[rank])[0],
+          &mean[0]);
+    }
+    for (int rank = 1; rank < before.size(); ++rank) {
+      EXPECT_NE(*before[0], *before[rank]) << "rank " << rank;
+    }
+    for (int rank = 0; rank < after.size(); ++rank) {
+      ASSERT_EQ(size, after[rank]->size());
+      for (int i = 0; i < size; ++i) {
+        EXPECT_NEAR(mean[i], (*after[rank])[i], tolerance)
+            << "rank " << rank << " at " << i;
+      }
+    }
+  }
+
+  // Checks that CPUSync left the replicas' recorded values alone, and that
+  // they differ from each other.
+  void ExpectLocal(const vector<const vector<Dtype>*>& before,
+      const vector<const vector<Dtype>*>& after) {
+    for (int rank = 0; rank < before.size(); ++rank) {
+      EXPECT_EQ(*before[rank], *after[rank]) << "rank " << rank;
+      if (rank > 0) {
+        EXPECT_NE(*before[0], *before[rank]) << "rank " << rank;
+      }
+    }
+  }
+
+  // The values recorded at iter by every replica's recorders.
+  typedef std::map<int, vector<Dtype> > CPUSyncTestRecorder<Dtype>::*Record;
+  vector<const vector<Dtype>*> Recorded(
+      const vector<shared_ptr<CPUSyncTestRecorder<Dtype> > >& recorders,
+      Record record, int iter) {
+    vector<const vector<Dtype>*> values;
+    for (int rank = 0; rank < recorders.size(); ++rank) {
+      values.push_back(&((*recorders[rank]).*record)[iter]);
+    }
+    return values;
+  }
+
+  // A linear regression on data filled by data_filler, with extra solver
+  // settings.
+  string RegressionProto(const string& extra, const string& data_filler) {
+    return
+       "base_lr: 0.1 "
+       "lr_policy: 'fixed' "
+       "momentum: 0.9 "
+       "max_iter: 5 "
+       "display: 1 "
+       "random_seed: 1701 "
+       "snapshot_after_train: false "
+       + extra +
+       "net_param { "
+       "  name: 'TestNetwork' "
+       "  layer { "
+       "    name: 'data' "
+       "    type: 'DummyData' "
+       "    dummy_data_param { "
+       "      shape { dim: 4 dim: 3 } "
+       "      shape { dim: 4 dim: 2 } "
+       "      data_filler { " + data_filler + " } "
+       "      data_filler { type: 'constant' value: 0.5 } "
+       "    } "
+       "    top: 'data' "
+       "    top: 'targets' "
+       "  } "
+       "  layer { "
+       "    name: 'innerprod' "
+       "    type: 'InnerProduct' "
+       "    inner_product_param { "
+       "      num_output: 2 "
+       "      weight_filler { type: 'gaussian' std: 0.5 } "
+       "    } "
+       "    bottom: 'data' "
+       "    top: 'innerprod' "
+       "  } "
+       "  layer { "
+       "    name: 'loss' "
+       "    type: 'EuclideanLoss' "
+       "    bottom: 'innerprod' "
+       "    bottom: 'targets' "
+       "  } "
+       "} ";
+  }
+
+  // Trains the regression on constant data with the given number of workers
+  // and extra solver settings, and returns the learned weights.
+  vector<Dtype> Train(int workers, const string& extra) {
+    SolverParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        RegressionProto(extra, "type: 'constant' value: 1"), &param));
+    Caffe::set_solver_count(workers);
+    shared_ptr<Solver<Dtype> > solver(new SGDSolver<Dtype>(param));
+    // The solver's parameters live in the sync's buffers.
+    shared_ptr<CPUSync<Dtype> > sync;
+    if (workers > 1) {
+      sync.reset(new CPUSync<Dtype>(solver));
+      sync->Run(workers, NULL);
+    } else {
+      solver->Solve();
+    }
+    Caffe::set_solver_count(1);
+    vector<Dtype> weights;
+    const vector<Blob<Dtype>*>& params = solver->net()->learnable_params();
+    for (int i = 0; i < params.size(); ++i) {
+      weights.insert(weights.end(), params[i]->cpu_data(),
+          params[i]->cpu_data() + params[i]->count());
+    }
+    return weights;
+  }
+};
+
+TYPED_TEST_CASE(CPUSyncTest, TestDtypes);
+
+TYPED_TEST(CPUSyncTest, TestMatchesSingleSolver) {
+  typedef TypeParam Dtype;
+  // Every worker computes the same gradient, so their average is the one a
+  // single solver computes.
+  const vector<Dtype> expected = this->Train(1, "");
+  const vector<Dtype> weights = this->Train(3, "");
+  ASSERT_EQ(expected.size(), weights.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(expected[i], weights[i], 1e-5);
+  }
+}
+
+TYPED_TEST(CPUSyncTest, TestHalfCompression) {
+  typedef TypeParam Dtype;
+  typedef CPUSyncTestRecorder<Dtype> Recorder;
+  // On random data of their own, the workers' gradients differ; each of
+  // them is replaced with their average, up to the FP16 rounding.
+  this->TrainReplicas(2, this->RegressionProto(
+      "gradient_compression { method: FP16 } ", "type: 'gaussian'"));
+  for (int iter = 0; iter < 5; ++iter) {
+    this->ExpectAveraged(this->Recorded(this->before_, &Recorder::diffs_, iter),
+        this->Recorded(this->after_, &Recorder::diffs_, iter), 1e-2);
+  }
+}
+
+TYPED_TEST(CPUSyncTest, TestLocalSGD) {
+  typedef TypeParam Dtype;
+  typedef CPUSyncTestRecorder<Dtype> Recorder;
+  // After a warmup iteration averaging the gradients, the workers train on
+  // their own data and average their weights and momentum every other
+  // iteration, and at the last one.
+  this->TrainReplicas(3, this->RegressionProto(
+      "local_sgd_period: 2 local_sgd_warmup: 1 ", "type: 'gaussian'"));
+  this->ExpectAveraged(this->Recorded(this->before_, &Recorder::diffs_, 0),
+      this->Recorded(this->after_, &Recorder::diffs_, 0), 1e-5);
+  for (int iter = 1; iter < 5; ++iter) {
+    if (iter % 2) {
+      this->ExpectLocal(this->Recorded(this->before_, &Recorder::diffs_, iter),
+          this->Recorded(this->after_, &Recorder::diffs_, iter));
+      this->ExpectLocal(
+          this->Recorded(this->before_, &Recorder::weights_, iter),
+          this->Recorded(this->after_, &Recorder::weights_, iter));
+    } else {
+      this->ExpectAveraged(
+          this->Recorded(this->before_, &Recorder::weights_, iter),
+          this->Recorded(this->after_, &Recorder::weights_, iter), 1e-5);
+      this->ExpectAveraged(
+          this->Recorded(this->before_, &Recorder::history_, iter),
+          this->Recorded(this->after_, &Recorder::history_, iter), 1e-5);
+    }
+  }
+}
+
+TYPED_TEST(CPUSyncTest, TestLocalSGDWithoutHistory) {
+  typedef TypeParam Dtype;
+  typedef CPUSyncTestRecorder<Dtype> Recorder;
+  // The weights are averaged at iterations 2 and 4, the last one, but each
+  // worker keeps its own momentum.
+  this->TrainReplicas(2, this->RegressionProto(
+      "local_sgd_period: 3 local_sgd_average_history: false ",
+      "type: 'gaussian'"));
+  for (int iter = 0; iter < 5; ++iter) {
+    if (iter == 2 || iter == 4) {
+      this->ExpectAveraged(
+          this->Recorded(this->before_, &Recorder::weights_, iter),
+          this->Recorded(this->after_, &Recorder::weights_, iter), 1e-5);
+    } else {
+      this->ExpectLocal(
+          this->Recorded(this->before_, &Recorder::weights_, iter),
+          this->Recorded(this->after_, &Recorder::weights_, iter));
+    }
+    this->ExpectLocal(this->Recorded(this->before_, &Recorder::history_, iter),
+        this->Recorded(this->after_, &Recorder::history_, iter));
+  }
+}
+
+TYPED_TEST(CPUSyncTest, TestSparseGradients) {
+  typedef TypeParam Dtype;
+  // Each worker looks up its own random rows of the embedding, so the
+  // averaged gradient touches rows some replicas did not; all of them still
+  // have to be updated alike.
+  this->TrainReplicas(3,
+      "base_lr: 0.1 "
+      "lr_policy: 'fixed' "
+      "momentum: 0.9 "
+      "max_iter: 4 "
+      "random_seed: 1701 "
+      "snapshot_after_train: false "
+      "net_param { "
+      "  name: 'TestNetwork' "
+      "  layer { "
+      "    name: 'data' "
+      "    type: 'DummyData' "
+      "    dummy_data_param { "
+      "      shape { dim: 3 dim: 10 } "
+      "      shape { dim: 3 dim: 1 dim: 2 } "
+      "      data_filler { type: 'gaussian' } "
+      "      data_filler { type: 'constant' value: 0.5 } "
+      "    } "
+      "    top: 'scores' "
+      "    top: 'targets' "
+      "  } "
+      "  layer { "
+      "    name: 'indices' "
+      "    type: 'ArgMax' "
+      "    argmax_param { axis: 1 } "
+      "    bottom: 'scores' "
+      "    top: 'indices' "
+      "  } "
+      "  layer { "
+      "    name: 'embed' "
+      "    type: 'Embed' "
+      "    embed_param { "
+      "      input_dim: 10 "
+      "      num_output: 2 "
+      "      bias_term: false "
+      "      sparse_gradient: true "
+      "      weight_filler { type: 'gaussian' } "
+      "    } "
+      "    bottom: 'indices' "
+      "    top: 'embed' "
+      "  } "
+      "  layer { "
+      "    name: 'loss' "
+      "    type: 'EuclideanLoss' "
+      "    bottom: 'embed' "
+      "    bottom: 'targets' "
+      "  } "
+      "} ");
+  // The gradients were tracked by row.
+  EXPECT_TRUE(this->solvers_[0]->net()->learnable_param_diff_rows(0) != NULL);
+  const vector<Dtype> weights = this->Weights(0);
+  for (int rank = 1; rank < this->solvers_.size(); ++rank) {
+    const vector<Dtype> replica = this->Weights(rank);
+    ASSERT_EQ(weights.size(), replica.size());
+    for (int i = 0; i < weights.size(); ++i) {
+      EXPECT_EQ(weights[i], replica[i]) << "rank " << rank << " at " << i;
+    }
+  }
+}
+
+}  // namespace caffe
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -132,6 +133,81 @@ TYPED_TEST(HDF5DataLayerTest, TestRead) {
   }
 }
 
+TYPED_TEST(HDF5DataLayerTest, TestReadChunks) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Reading the files of TestRead 3 rows at a time, with 2 chunks read
+  // ahead, gives the same batches.
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  param.add_top("label2");
+
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  int batch_size = 5;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_source(*(this->filename));
+  hdf5_data_param->set_chunk_size(3);
+  hdf5_data_param->set_prefetch(2);
+
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int data_size = 8 * 6 * 5;
+  for (int iter = 0; iter < 10; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    int label_offset = 1 + ((iter % 2 == 0) ? 0 : batch_size);
+    int data_offset = (iter % 2 == 0) ? 0 : batch_size * data_size;
+    int file_offset = (iter % 4 < 2) ? 0 : 2400;
+    for (int i = 0; i < batch_size; ++i) {
+      EXPECT_EQ(label_offset + i, this->blob_top_label_->cpu_data()[i]);
+      EXPECT_EQ(label_offset + i + 1, this->blob_top_label2_->cpu_data()[i]);
+    }
+    for (int idx = 0; idx < batch_size * data_size; ++idx) {
+      EXPECT_EQ(file_offset + data_offset + idx,
+          this->blob_top_data_->cpu_data()[idx]) << "iter " << iter;
+    }
+  }
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestShuffleChunks) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Shuffled chunks still output each of the 20 rows once per epoch, with
+  // their labels.
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  this->blob_top_vec_.resize(2);
+
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  int batch_size = 5;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_source(*(this->filename));
+  hdf5_data_param->set_chunk_size(4);
+  hdf5_data_param->set_shuffle(true);
+
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int data_size = 8 * 6 * 5;
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    vector<int> rows;
+    for (int iter = 0; iter < 4; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < batch_size; ++i) {
+        const Dtype* row = this->blob_top_data_->cpu_data() + i * data_size;
+        const int index = static_cast<int>(row[0]) / data_size;
+        EXPECT_EQ(1 + index % 10, this->blob_top_label_->cpu_data()[i]);
+        for (int j = 0; j < data_size; ++j) {
+          EXPECT_EQ(index * data_size + j, row[j]);
+        }
+        rows.push_back(index);
+      }
+    }
+    std::sort(rows.begin(), rows.end());
+    for (int i = 0; i < rows.size(); ++i) {
+      EXPECT_EQ(i, rows[i]);
+    }
+  }
+}
+
 TYPED_TEST(HDF5DataLayerTest, TestSkip) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter param;
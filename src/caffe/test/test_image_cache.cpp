@@ -0,0 +1,136 @@
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/image_cache.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ImageCacheTest : public ::testing::Test {
+ protected:
+  // Makes an image of the given shape whose values depend on seed.
+  string MakeImage(const vector<int>& shape, int seed) {
+    string image(shape[0] * shape[1] * shape[2], 0);
+    for (int i = 0; i < image.size(); ++i) {
+      image[i] = static_cast<char>(i * 7 + seed);
+    }
+    return image;
+  }
+
+  vector<int> Shape(int height, int width, int channels) {
+    vector<int> shape(3);
+    shape[0] = height;
+    shape[1] = width;
+    shape[2] = channels;
+    return shape;
+  }
+};
+
+TEST_F(ImageCacheTest, TestPutGet) {
+  ImageCache cache(1 << 20, "");
+  const vector<int> shape = Shape(10, 20, 3);
+  const string image = MakeImage(shape, 1);
+  vector<int> cached_shape;
+  string cached;
+  EXPECT_FALSE(cache.Get("a.jpg", &cached_shape, &cached));
+  cache.Put("a.jpg", shape, image.data());
+  EXPECT_TRUE(cache.Get("a.jpg", &cached_shape, &cached));
+  EXPECT_EQ(shape, cached_shape);
+  EXPECT_TRUE(image == cached);
+  EXPECT_FALSE(cache.Get("b.jpg", &cached_shape, &cached));
+  EXPECT_EQ(1, cache.size());
+  EXPECT_EQ(image.size(), cache.bytes());
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(2, cache.misses());
+}
+
+TEST_F(ImageCacheTest, TestEviction) {
+  ImageCache cache(4 * 4096, "");
+  const vector<int> shape = Shape(32, 32, 4);
+  for (int i = 0; i < 4; ++i) {
+    cache.Put(format_int(i), shape, MakeImage(shape, i).data());
+  }
+  EXPECT_EQ(4, cache.size());
+  EXPECT_EQ(0, cache.evictions());
+  // The image just used is kept, the next one least recently used is not.
+  vector<int> cached_shape;
+  string cached;
+  EXPECT_TRUE(cache.Get("0", &cached_shape, &cached));
+  cache.Put("4", shape, MakeImage(shape, 4).data());
+  EXPECT_EQ(4, cache.size());
+  EXPECT_EQ(1, cache.evictions());
+  EXPECT_TRUE(cache.Get("0", &cached_shape, &cached));
+  EXPECT_FALSE(cache.Get("1", &cached_shape, &cached));
+  EXPECT_TRUE(cache.Get("4", &cached_shape, &cached));
+  EXPECT_TRUE(MakeImage(shape, 4) == cached);
+  // Images larger than the cache are not cached.
+  const vector<int> large_shape = Shape(64, 64, 5);
+  cache.Put("5", large_shape, MakeImage(large_shape, 5).data());
+  EXPECT_FALSE(cache.Get("5", &cached_shape, &cached));
+  EXPECT_EQ(4, cache.size());
+}
+
+TEST_F(ImageCacheTest, TestManyImages) {
+  ImageCache cache(64 * 1024, "");
+  vector<int> cached_shape;
+  string cached;
+  int hits = 0;
+  for (int pass = 0; pass < 3; ++pass) {
+    // Every other image is one of a few hot ones.
+    for (int j = 0; j < 200; ++j) {
+      const int i = j % 2 ? j % 16 : j;
+      const string key = "image_" + format_int(i);
+      const vector<int> shape = Shape(8 + i % 13, 16 + i % 7, 1 + i % 3);
+      if (cache.Get(key, &cached_shape, &cached)) {
+        EXPECT_EQ(shape, cached_shape);
+        EXPECT_TRUE(MakeImage(shape, i) == cached);
+        ++hits;
+      } else {
+        cache.Put(key, shape, MakeImage(shape, i).data());
+      }
+      EXPECT_LE(cache.bytes(), cache.capacity());
+    }
+  }
+  EXPECT_GT(hits, 0);
+  EXPECT_GT(cache.evictions(), 0);
+  EXPECT_EQ(hits, cache.hits());
+}
+
+TEST_F(ImageCacheTest, TestOpen) {
+  shared_ptr<ImageCache> cache = ImageCache::Open(1 << 20, "");
+  EXPECT_EQ(cache.get(), ImageCache::Open(1 << 20, "").get());
+  // A local cache of another capacity is one of its own.
+  shared_ptr<ImageCache> larger = ImageCache::Open(2 << 20, "");
+  EXPECT_NE(cache.get(), larger.get());
+  EXPECT_EQ(1 << 20, cache->capacity());
+  EXPECT_EQ(2 << 20, larger->capacity());
+}
+
+TEST_F(ImageCacheTest, TestSharedMemory) {
+  const string name = "caffe_test_image_cache_" + format_int(getpid());
+  ImageCache::Remove(name);
+  {
+    // Two mappings of the segment, as in two processes.
+    ImageCache writer(1 << 20, name);
+    ImageCache reader(2 << 20, name);
+    EXPECT_EQ(1 << 20, reader.capacity());
+    const vector<int> shape = Shape(10, 20, 3);
+    writer.Put("a.jpg", shape, MakeImage(shape, 1).data());
+    vector<int> cached_shape;
+    string cached;
+    EXPECT_TRUE(reader.Get("a.jpg", &cached_shape, &cached));
+    EXPECT_EQ(shape, cached_shape);
+    EXPECT_TRUE(MakeImage(shape, 1) == cached);
+    EXPECT_EQ(1, writer.hits());
+  }
+  ImageCache::Remove(name);
+}
+
+}  // namespace caffe
@@ -215,5 +215,38 @@ TYPED_TEST(ImageDataLayerTest, TestSpace) {
   EXPECT_EQ(this->blob_top_label_->cpu_data()[0], 1);
 }
 
+TYPED_TEST(ImageDataLayerTest, TestCache) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  ImageDataParameter* image_data_param = param.mutable_image_data_param();
+  image_data_param->set_batch_size(1);
+  image_data_param->set_source(this->filename_reshape_.c_str());
+  image_data_param->set_new_height(128);
+  image_data_param->set_new_width(96);
+  image_data_param->set_shuffle(false);
+  ImageDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  image_data_param->set_cache_size(16);
+  Blob<Dtype> cached_data, cached_label;
+  vector<Blob<Dtype>*> cached_top_vec;
+  cached_top_vec.push_back(&cached_data);
+  cached_top_vec.push_back(&cached_label);
+  ImageDataLayer<Dtype> cached_layer(param);
+  cached_layer.SetUp(this->blob_bottom_vec_, cached_top_vec);
+  // Go through the data twice, the second time from the cache.
+  for (int iter = 0; iter < 4; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    cached_layer.Forward(this->blob_bottom_vec_, cached_top_vec);
+    ASSERT_EQ(this->blob_top_data_->count(), cached_data.count());
+    for (int i = 0; i < cached_data.count(); ++i) {
+      EXPECT_EQ(this->blob_top_data_->cpu_data()[i], cached_data.cpu_data()[i]);
+    }
+    EXPECT_EQ(iter % 2, cached_label.cpu_data()[0]);
+  }
+  shared_ptr<ImageCache> cache = ImageCache::Open(16 << 20, "");
+  EXPECT_EQ(2, cache->size());
+  EXPECT_GT(cache->hits(), 0);
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -135,6 +135,91 @@ TYPED_TEST(InnerProductLayerTest, TestForward) {
   }
 }
 
+// Packed weights give the same result as plain ones, including after the
+// weights change between passes.
+TYPED_TEST(InnerProductLayerTest, TestForwardPackedWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  if (Caffe::mode() == Caffe::CPU) {
+    for (int transpose = 0; transpose < 2; ++transpose) {
+      LayerParameter layer_param;
+      InnerProductParameter* inner_product_param =
+          layer_param.mutable_inner_product_param();
+      inner_product_param->set_num_output(10);
+      inner_product_param->set_transpose(transpose);
+      inner_product_param->mutable_weight_filler()->set_type("uniform");
+      inner_product_param->mutable_bias_filler()->set_type("uniform");
+      InnerProductLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      inner_product_param->set_pack_weights(true);
+      InnerProductLayer<Dtype> packed_layer(layer_param);
+      Blob<Dtype> packed_top;
+      vector<Blob<Dtype>*> packed_top_vec(1, &packed_top);
+      packed_layer.SetUp(this->blob_bottom_vec_, packed_top_vec);
+      for (int i = 0; i < layer.blobs().size(); ++i) {
+        packed_layer.blobs()[i]->ShareData(*layer.blobs()[i]);
+      }
+      for (int pass = 0; pass < 2; ++pass) {
+        if (pass > 0) {
+          caffe_scal(layer.blobs()[0]->count(), Dtype(-2),
+              layer.blobs()[0]->mutable_cpu_data());
+        }
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        packed_layer.Forward(this->blob_bottom_vec_, packed_top_vec);
+        for (int i = 0; i < packed_top.count(); ++i) {
+          EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+              packed_top.cpu_data()[i], 1e-4);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardSparseWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  if (Caffe::mode() == Caffe::CPU) {
+    for (int transpose = 0; transpose < 2; ++transpose) {
+      LayerParameter layer_param;
+      layer_param.set_phase(TEST);
+      InnerProductParameter* inner_product_param =
+          layer_param.mutable_inner_product_param();
+      inner_product_param->set_num_output(10);
+      inner_product_param->set_transpose(transpose);
+      inner_product_param->mutable_weight_filler()->set_type("uniform");
+      inner_product_param->mutable_bias_filler()->set_type("uniform");
+      InnerProductLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      inner_product_param->set_sparse_threshold(0.5);
+      InnerProductLayer<Dtype> sparse_layer(layer_param);
+      Blob<Dtype> sparse_top;
+      vector<Blob<Dtype>*> sparse_top_vec(1, &sparse_top);
+      sparse_layer.SetUp(this->blob_bottom_vec_, sparse_top_vec);
+      for (int i = 0; i < layer.blobs().size(); ++i) {
+        sparse_layer.blobs()[i]->ShareData(*layer.blobs()[i]);
+      }
+      Blob<Dtype>* weights = layer.blobs()[0].get();
+      for (int i = 0; i < weights->count(); ++i) {
+        if (i % 4) {
+          weights->mutable_cpu_data()[i] = 0;
+        }
+      }
+      // The second pass has dense weights and takes the dense path.
+      for (int pass = 0; pass < 2; ++pass) {
+        if (pass > 0) {
+          caffe_set(weights->count(), Dtype(0.5), weights->mutable_cpu_data());
+        }
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        sparse_layer.Forward(this->blob_bottom_vec_, sparse_top_vec);
+        for (int i = 0; i < sparse_top.count(); ++i) {
+          EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+              sparse_top.cpu_data()[i], 1e-4);
+        }
+      }
+    }
+  }
+}
+
 /**
  * @brief Init. an IP layer without transpose + random weights,
  * run Forward, save the result.
@@ -306,6 +306,30 @@ TEST_F(IOTest, TestDecodeDatum) {
   }
 }
 
+TEST_F(IOTest, TestDecodeImageToDatum) {
+  string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+  Datum datum, datum_ref;
+  EXPECT_TRUE(ReadFileToDatum(filename, &datum));
+  EXPECT_TRUE(DecodeImageToDatum(filename, 3, 100, 200, true, "", &datum));
+  ReadImageToDatum(filename, 3, 100, 200, true, &datum_ref);
+  EXPECT_FALSE(datum.encoded());
+  EXPECT_EQ(datum.label(), 3);
+  EXPECT_EQ(datum.channels(), datum_ref.channels());
+  EXPECT_EQ(datum.height(), datum_ref.height());
+  EXPECT_EQ(datum.width(), datum_ref.width());
+  EXPECT_TRUE(datum.data() == datum_ref.data());
+  // The file is kept as is when it already has the requested encoding.
+  EXPECT_TRUE(ReadFileToDatum(filename, &datum));
+  EXPECT_TRUE(DecodeImageToDatum(filename, 3, 0, 0, true, "jpg", &datum));
+  EXPECT_TRUE(datum.encoded());
+  EXPECT_EQ(datum.data().size(), 140391);
+  EXPECT_TRUE(ReadFileToDatum(filename, &datum));
+  EXPECT_TRUE(DecodeImageToDatum(filename, 3, 0, 0, true, "png", &datum));
+  ReadImageToDatum(filename, 3, 0, 0, true, "png", &datum_ref);
+  EXPECT_TRUE(datum.encoded());
+  EXPECT_TRUE(datum.data() == datum_ref.data());
+}
+
 TEST_F(IOTest, TestDecodeDatumToCVMat) {
   string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
   Datum datum;
@@ -1,12 +1,17 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
+#include <algorithm>
 #include <cmath>  // for std::fabs
+#include <limits>
+#include <vector>
 
 #include "gtest/gtest.h"
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/util/cpu_isa.hpp"
+#include "caffe/util/fast_math.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -119,6 +124,222 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestTanhSigmoid) {
+  const int n = this->blob_bottom_->count();
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  TypeParam* y = this->blob_top_->mutable_cpu_data();
+  caffe_tanh(n, x, y);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(y[i], std::tanh(x[i]), 1e-6);
+  }
+  caffe_sigmoid(n, x, y);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(y[i], 1. / (1. + std::exp(-x[i])), 1e-6);
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestPositiveMask) {
+  // The count is not a multiple of the 32 flags in a word.
+  const int n = this->blob_bottom_->count();
+  ASSERT_NE(0, n % 32);
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  vector<unsigned int> mask(caffe_mask_words(n), ~0u);
+  caffe_cpu_positive_mask(n, x, &mask[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(x[i] > 0 ? 1u : 0u, (mask[i / 32] >> (i % 32)) & 1);
+  }
+  // The flags past the end of the last word are clear.
+  EXPECT_EQ(0u, mask.back() >> (n % 32));
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestMaskScale) {
+  const int n = this->blob_bottom_->count();
+  const TypeParam* x = this->blob_bottom_->cpu_data();
+  vector<unsigned int> mask(caffe_mask_words(n));
+  caffe_cpu_positive_mask(n, x, &mask[0]);
+  TypeParam* y = this->blob_top_->mutable_cpu_data();
+  caffe_cpu_mask_scale(n, &mask[0], x, TypeParam(2), TypeParam(-1), y);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(x[i] * (x[i] > 0 ? 2 : -1), y[i]);
+  }
+  // In place, the elements past n are left alone.
+  const int m = n - 5;
+  caffe_cpu_mask_scale(m, &mask[0], y, TypeParam(0.5), TypeParam(0), y);
+  for (int i = 0; i < n; ++i) {
+    const TypeParam scaled = x[i] * (x[i] > 0 ? 2 : -1);
+    EXPECT_EQ(i < m ? std::max(x[i], TypeParam(0)) : scaled, y[i]);
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestBernoulliMask) {
+  const int sizes[] = {37, this->blob_bottom_->count()};
+  for (int s = 0; s < 2; ++s) {
+    const int n = sizes[s];
+    const int words = caffe_mask_words(n);
+    const TypeParam probabilities[] = {0, 0.3, 1};
+    for (int p = 0; p < 3; ++p) {
+      vector<unsigned int> mask(words, ~0u);
+      caffe_rng_bernoulli_mask(n, probabilities[p], &mask[0]);
+      int num_set = 0;
+      for (int i = 0; i < n; ++i) {
+        num_set += (mask[i / 32] >> (i % 32)) & 1;
+      }
+      EXPECT_EQ(0u, mask.back() >> (n % 32));
+      if (p == 0) {
+        EXPECT_EQ(0, num_set);
+      } else if (p == 2) {
+        EXPECT_EQ(n, num_set);
+      } else if (n > 1000) {
+        // Within 4 standard deviations of n p.
+        EXPECT_NEAR(0.3 * n, num_set, 4 * sqrt(n * 0.3 * 0.7));
+      }
+    }
+  }
+}
+
+// Each test runs every variant of the kernels the CPU supports.
+class FastMathTest : public ::testing::Test {
+ protected:
+  typedef void (*Function)(const int n, const float* a, float* y);
+  typedef double (*Reference)(double x);
+
+  FastMathTest() : selected_isa_(SelectedCpuIsa()) {}
+
+  virtual ~FastMathTest() {
+    SetSelectedCpuIsa(selected_isa_);
+  }
+
+  static int isa_count() { return DetectCpuIsa() + 1; }
+
+  static void SelectIsa(const int isa) {
+    SetSelectedCpuIsa(static_cast<CpuIsa>(isa));
+  }
+
+  // The distance of y from the float nearest to expected, in units of the
+  // spacing of floats around expected.
+  static double Ulps(const float y, const double expected) {
+    const float rounded = static_cast<float>(expected);
+    const float ulp = std::max(std::numeric_limits<float>::denorm_min(),
+        caffe_nextafter(std::fabs(rounded)) - std::fabs(rounded));
+    return std::fabs(y - expected) / ulp;
+  }
+
+  // Checks function over count points spread across [lo, hi], including
+  // the odd tail that is not a whole vector.
+  static void CheckRange(Function function, Reference reference,
+      const float lo, const float hi, const double max_ulps,
+      const double abs_error = 0) {
+    const int count = 100003;
+    std::vector<float> x(count), y(count);
+    for (int i = 0; i < count; ++i) {
+      x[i] = lo + (hi - lo) * (i + 0.5) / count;
+    }
+    for (int isa = 0; isa < isa_count(); ++isa) {
+      SelectIsa(isa);
+      function(count, &x[0], &y[0]);
+      for (int i = 0; i < count; ++i) {
+        const double expected = reference(x[i]);
+        if (std::fabs(y[i] - expected) <= abs_error) {
+          continue;
+        }
+        EXPECT_LE(Ulps(y[i], expected), max_ulps) << "x = " << x[i] << " ("
+            << CpuIsaName(static_cast<CpuIsa>(isa)) << ")";
+      }
+    }
+  }
+
+  static bool SameFloat(const float y, const float expected) {
+    return y == expected || (isnan(y) && isnan(expected));
+  }
+
+  static double Exp(double x) { return std::exp(x); }
+  static double Log(double x) { return std::log(x); }
+  static double Tanh(double x) { return std::tanh(x); }
+  static double Sigmoid(double x) { return 1. / (1. + std::exp(-x)); }
+  static double Pow(double x) { return std::pow(x, -0.75); }
+  static void FastPow(const int n, const float* a, float* y) {
+    fast_powx(n, a, -0.75f, y);
+  }
+
+  const CpuIsa selected_isa_;
+};
+
+TEST_F(FastMathTest, TestExp) {
+  CheckRange(fast_exp, Exp, -87.f, 88.7f, 2);
+  CheckRange(fast_exp, Exp, -1.f, 1.f, 2);
+}
+
+TEST_F(FastMathTest, TestLog) {
+  CheckRange(fast_log, Log, 1e-30f, 1e30f, 2);
+  CheckRange(fast_log, Log, 1e-3f, 10.f, 2, 1e-7);
+  CheckRange(fast_log, Log, 1e-44f, 1e-38f, 2);
+}
+
+TEST_F(FastMathTest, TestTanh) {
+  CheckRange(fast_tanh, Tanh, -10.f, 10.f, 3);
+  CheckRange(fast_tanh, Tanh, -1e-3f, 1e-3f, 3);
+}
+
+TEST_F(FastMathTest, TestSigmoid) {
+  CheckRange(fast_sigmoid, Sigmoid, -80.f, 80.f, 3);
+  CheckRange(fast_sigmoid, Sigmoid, -5.f, 5.f, 3);
+}
+
+TEST_F(FastMathTest, TestPowx) {
+  // |b * log(a)| stays below 0.83 on [1, 3] and 5.2 on [1e-3, 1e3].
+  CheckRange(FastPow, Pow, 1.f, 3.f, 4);
+  CheckRange(FastPow, Pow, 1e-3f, 1e3f, 13);
+}
+
+TEST_F(FastMathTest, TestSpecialValues) {
+  const float inf = std::numeric_limits<float>::infinity();
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float x[] = {0.f, -1.f, inf, -inf, nan, 100.f, -200.f,
+      std::numeric_limits<float>::denorm_min()};
+  const int kCount = sizeof(x) / sizeof(x[0]);
+  const int n = kCount;
+  float y[kCount];
+  for (int isa = 0; isa < isa_count(); ++isa) {
+    SelectIsa(isa);
+    SCOPED_TRACE(CpuIsaName(static_cast<CpuIsa>(isa)));
+    fast_exp(n, x, y);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_TRUE(SameFloat(y[i], std::exp(x[i])))
+          << "exp(" << x[i] << ") = " << y[i];
+    }
+    fast_log(n, x, y);
+    for (int i = 0; i < n; ++i) {
+      const float expected = std::log(x[i]);
+      if (isnan(expected) || isinf(expected)) {
+        EXPECT_TRUE(SameFloat(y[i], expected))
+            << "log(" << x[i] << ") = " << y[i];
+      } else {
+        EXPECT_LE(Ulps(y[i], Log(x[i])), 2) << "log(" << x[i] << ")";
+      }
+    }
+    fast_tanh(n, x, y);
+    EXPECT_EQ(1, y[2]);
+    EXPECT_EQ(-1, y[3]);
+    EXPECT_TRUE(isnan(y[4]));
+    fast_sigmoid(n, x, y);
+    EXPECT_EQ(0.5, y[0]);
+    EXPECT_EQ(1, y[2]);
+    EXPECT_EQ(0, y[3]);
+    EXPECT_TRUE(isnan(y[4]));
+    fast_powx(n, x, 2.f, y);
+    for (int i = 0; i < n; ++i) {
+      const double expected = std::pow(static_cast<double>(x[i]), 2.);
+      if (x[i] > 0 && x[i] < inf) {
+        EXPECT_LE(Ulps(y[i], expected), 2 + 4 * std::fabs(std::log(x[i])))
+            << "pow(" << x[i] << ", 2)";
+      } else {
+        EXPECT_TRUE(SameFloat(y[i], std::pow(x[i], 2.f)))
+            << "pow(" << x[i] << ", 2) = " << y[i];
+      }
+    }
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
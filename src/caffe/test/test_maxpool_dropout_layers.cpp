@@ -121,7 +121,14 @@ TYPED_TEST(MaxPoolingDropoutTest, TestBackward) {
   for (int i = 0; i < this->blob_bottom_->count(); ++i) {
     sum_with_dropout += bottom_diff[i];
   }
-  EXPECT_GE(sum_with_dropout, sum);
+  // Max pooling passes on the gradient of the units dropout kept, scaled up.
+  Dtype sum_kept = 0.;
+  const Dtype* top_diff = this->blob_top_->cpu_diff();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_TRUE(top_diff[i] == 0 || top_diff[i] == 2);
+    sum_kept += top_diff[i];
+  }
+  EXPECT_EQ(sum_with_dropout, sum_kept);
 }
 
 }  // namespace caffe
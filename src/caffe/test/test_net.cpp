@@ -9,6 +9,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/net.hpp"
+#include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -839,6 +840,83 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoFileWithState(proto, phase, level, stages);
   }
 
+  virtual void InitCheckpointNet(const string& net_options,
+      const string& ip2_options) {
+    const string ip_param =
+        "  inner_product_param { "
+        "    num_output: 10 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } ";
+    const string proto = net_options +
+        "name: 'CheckpointNetwork' "
+        "state { phase: TRAIN } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'DummyData' "
+        "  dummy_data_param { "
+        "    shape { dim: 4 dim: 6 } "
+        "    data_filler { type: 'gaussian' } "
+        "    shape { dim: 4 } "
+        "    data_filler { type: 'constant' value: 1 } "
+        "  } "
+        "  top: 'data' "
+        "  top: 'label' "
+        "} "
+        "layer { "
+        "  name: 'ip1' "
+        "  type: 'InnerProduct' " + ip_param +
+        "  bottom: 'data' "
+        "  top: 'ip1' "
+        "} "
+        "layer { "
+        "  name: 'bn1' "
+        "  type: 'BatchNorm' "
+        "  bottom: 'ip1' "
+        "  top: 'ip1' "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'ip1' "
+        "  top: 'ip1' "
+        "} "
+        "layer { "
+        "  name: 'drop1' "
+        "  type: 'Dropout' "
+        "  bottom: 'ip1' "
+        "  top: 'ip1' "
+        "} "
+        "layer { "
+        "  name: 'ip2' "
+        "  type: 'InnerProduct' " + ip_param + ip2_options +
+        "  bottom: 'ip1' "
+        "  top: 'ip2' "
+        "} "
+        "layer { "
+        "  name: 'relu2' "
+        "  type: 'ReLU' "
+        "  bottom: 'ip2' "
+        "  top: 'relu2' "
+        "} "
+        "layer { "
+        "  name: 'ip3' "
+        "  type: 'InnerProduct' " + ip_param +
+        "  bottom: 'relu2' "
+        "  top: 'ip3' "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'SoftmaxWithLoss' "
+        "  bottom: 'ip3' "
+        "  bottom: 'label' "
+        "  top: 'loss' "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
   int seed_;
   shared_ptr<Net<Dtype> > net_;
 };
@@ -1457,6 +1535,130 @@ TYPED_TEST(NetTest, TestFromTo) {
   }
 }
 
+TYPED_TEST(NetTest, TestCheckpointing) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Reference run without checkpoints, then the same net with 'ip2' marked
+  // as a checkpoint, by hand and through a segment budget that ip1 and ip2
+  // (4 x 10 activations each) reach together: the activations of ip1 are
+  // released and recomputed, and the results must not change.
+  const string budget = "checkpoint_segment_bytes: " +
+      format_int(80 * sizeof(Dtype)) + " ";
+  const string net_options[] = { "", "", budget };
+  const string ip2_options[] = { "", "checkpoint: true ", "" };
+  vector<shared_ptr<Blob<Dtype> > > ref_params;
+  Dtype ref_loss = 0;
+  for (int i = 0; i < 3; ++i) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitCheckpointNet(net_options[i], ip2_options[i]);
+    EXPECT_EQ(i > 0, this->net_->has_checkpoints());
+    Dtype loss;
+    this->net_->Forward(&loss);
+    if (i > 0) {
+      EXPECT_EQ(SyncedMemory::UNINITIALIZED,
+          this->net_->blob_by_name("ip1")->data()->head());
+      EXPECT_NE(SyncedMemory::UNINITIALIZED,
+          this->net_->blob_by_name("ip2")->data()->head());
+    }
+    this->net_->Backward();
+    vector<shared_ptr<Blob<Dtype> > > params;
+    this->CopyNetParams(true, &params);
+    if (i == 0) {
+      ref_params = params;
+      ref_loss = loss;
+      continue;
+    }
+    EXPECT_EQ(ref_loss, loss);
+    ASSERT_EQ(ref_params.size(), params.size());
+    for (int j = 0; j < params.size(); ++j) {
+      for (int k = 0; k < params[j]->count(); ++k) {
+        EXPECT_EQ(ref_params[j]->cpu_data()[k], params[j]->cpu_data()[k]);
+        EXPECT_EQ(ref_params[j]->cpu_diff()[k], params[j]->cpu_diff()[k]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestShareActivations) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'ShareNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 3 dim: 5 dim: 5 } "
+      "    data_filler { type: 'constant' value: 0.5 } "
+      "    shape { dim: 2 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 10 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "  bottom: 'conv' "
+      "  top: 'ip' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'SoftmaxWithLoss' "
+      "  bottom: 'ip' "
+      "  bottom: 'label' "
+      "  top: 'loss' "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.mutable_state()->set_phase(TRAIN);
+  Net<Dtype> train_net(param);
+  param.mutable_state()->set_phase(TEST);
+  Net<Dtype> test_net(param);
+  Net<Dtype> ref_net(param);
+  test_net.ShareTrainedLayersWith(&train_net);
+  ref_net.ShareTrainedLayersWith(&train_net);
+  test_net.ShareActivationsWith(&train_net);
+  // The activations and the im2col buffer take over the train net's memory,
+  // while the data layer tops keep their own.
+  set<SyncedMemory*> train_memory;
+  for (int i = 0; i < train_net.blobs().size(); ++i) {
+    train_memory.insert(train_net.blobs()[i]->data().get());
+  }
+  EXPECT_EQ(1, train_memory.count(test_net.blob_by_name("conv")->data().get()));
+  EXPECT_EQ(1, train_memory.count(test_net.blob_by_name("ip")->data().get()));
+  EXPECT_EQ(0, train_memory.count(test_net.blob_by_name("data")->data().get()));
+  // Interleaved runs of both nets give the results of unshared nets.
+  const Dtype train_loss = train_net.ForwardBackward();
+  for (int i = 0; i < 2; ++i) {
+    Dtype test_loss;
+    Dtype ref_loss;
+    test_net.Forward(&test_loss);
+    ref_net.Forward(&ref_loss);
+    EXPECT_EQ(ref_loss, test_loss);
+    EXPECT_EQ(train_loss, train_net.ForwardBackward());
+  }
+}
+
 class FilterNetTest : public ::testing::Test {
  protected:
   void RunFilterNetTest(
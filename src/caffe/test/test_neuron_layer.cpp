@@ -80,11 +80,11 @@ class NeuronLayerTest : public MultiDeviceTest<TypeParam> {
       }
     }
     const Dtype std_error = sqrt(dropout_ratio * (1 - dropout_ratio) / count);
-    // Fail if the number dropped was more than 1.96 * std_error away from the
-    // expected number -- requires 95% confidence that the dropout layer is not
+    // Fail if the number dropped was more than 2.58 * std_error away from the
+    // expected number -- requires 99% confidence that the dropout layer is not
     // obeying the given dropout_ratio for test failure.
     const Dtype empirical_dropout_ratio = 1 - num_kept / Dtype(count);
-    EXPECT_NEAR(empirical_dropout_ratio, dropout_ratio, 1.96 * std_error);
+    EXPECT_NEAR(empirical_dropout_ratio, dropout_ratio, 2.58 * std_error);
   }
 
   void TestExpForward(const float base, const float scale, const float shift) {
@@ -175,7 +175,9 @@ class NeuronLayerTest : public MultiDeviceTest<TypeParam> {
     layer_param.mutable_log_param()->set_scale(scale);
     layer_param.mutable_log_param()->set_shift(shift);
     LogLayer<Dtype> layer(layer_param);
-    GradientChecker<Dtype> checker(1e-2, 1e-2);
+    // Near 0, where log has a pole, the central difference over the step is
+    // too inaccurate to compare with: skip the inputs below 0.1.
+    GradientChecker<Dtype> checker(1e-2, 1e-2, 1701, 0., 0.1);
     checker.CheckGradientEltwise(&layer, blob_bottom_vec_, blob_top_vec_);
   }
 };
@@ -260,6 +262,52 @@ TYPED_TEST(NeuronLayerTest, TestReLUGradientWithNegativeSlope) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(NeuronLayerTest, TestReLUGradientWithSignMask) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "relu_param { negative_slope: 0.01 sign_mask: true }", &layer_param));
+  ReLULayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3, 1701, 0., 0.01);
+  checker.CheckGradientEltwise(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(NeuronLayerTest, TestReLUInPlaceWithSignMask) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "relu_param { negative_slope: 0.01 sign_mask: true }", &layer_param));
+  // Reference: out-of-place ReLU.
+  ReLULayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> top_diff(this->blob_top_->shape());
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&top_diff);
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  vector<bool> propagate_down(1, true);
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  // In-place ReLU with the mask must produce the same output and gradient.
+  Blob<Dtype> in_place(this->blob_bottom_->shape());
+  in_place.CopyFrom(*this->blob_bottom_);
+  vector<Blob<Dtype>*> in_place_vec(1, &in_place);
+  ReLULayer<Dtype> in_place_layer(layer_param);
+  in_place_layer.SetUp(in_place_vec, in_place_vec);
+  in_place_layer.Forward(in_place_vec, in_place_vec);
+  for (int i = 0; i < in_place.count(); ++i) {
+    EXPECT_EQ(this->blob_top_->cpu_data()[i], in_place.cpu_data()[i]);
+  }
+  caffe_copy(in_place.count(), top_diff.cpu_data(),
+      in_place.mutable_cpu_diff());
+  in_place_layer.Backward(in_place_vec, propagate_down, in_place_vec);
+  for (int i = 0; i < in_place.count(); ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_diff()[i], in_place.cpu_diff()[i]);
+  }
+}
+
 TYPED_TEST(NeuronLayerTest, TestELU) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -570,6 +618,40 @@ TYPED_TEST(NeuronLayerTest, TestDropoutThreeQuarters) {
   this->TestDropoutForward(kDropoutRatio);
 }
 
+TYPED_TEST(NeuronLayerTest, TestDropoutUnalignedMask) {
+  typedef typename TypeParam::Dtype Dtype;
+  // 37 inputs fill one word of the bit mask and 5 bits of another.
+  this->blob_bottom_->Reshape(1, 37, 1, 1);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.set_phase(TRAIN);
+  DropoutLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  caffe_set(this->blob_top_->count(), Dtype(1),
+      this->blob_top_->mutable_cpu_diff());
+  layer.Backward(this->blob_top_vec_, vector<bool>(1, true),
+      this->blob_bottom_vec_);
+  // Backward drops the same inputs as forward, including the last ones.
+  const Dtype* bottom_data = this->blob_bottom_->cpu_data();
+  const Dtype* bottom_diff = this->blob_bottom_->cpu_diff();
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  int num_kept = 0;
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    if (top_data[i] != 0) {
+      ++num_kept;
+      EXPECT_EQ(2, bottom_diff[i]);
+      EXPECT_EQ(bottom_data[i] * 2, top_data[i]);
+    } else {
+      EXPECT_EQ(0, bottom_diff[i]);
+    }
+  }
+  EXPECT_GT(num_kept, 0);
+  EXPECT_LT(num_kept, this->blob_bottom_->count());
+}
+
 TYPED_TEST(NeuronLayerTest, TestDropoutTestPhase) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -475,6 +475,61 @@ TYPED_TEST(PoolingLayerTest, TestGradientMax) {
   }
 }
 
+TYPED_TEST(PoolingLayerTest, TestMaxLargeWindows) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Windows of up to 254 elements record their argmax as a byte; larger ones
+  // fall back to the full index.
+  const int kernels[][2] = {{2, 127}, {15, 17}, {16, 16}};
+  for (int k = 0; k < 3; ++k) {
+    const int kernel_h = kernels[k][0];
+    const int kernel_w = kernels[k][1];
+    const int height = kernel_h + 1;
+    const int width = kernel_w + 2;
+    this->blob_bottom_->Reshape(2, 2, height, width);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_kernel_h(kernel_h);
+    pooling_param->set_kernel_w(kernel_w);
+    pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+    PoolingLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_EQ(2, this->blob_top_->height());
+    ASSERT_EQ(3, this->blob_top_->width());
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    caffe_set(this->blob_top_->count(), Dtype(1),
+        this->blob_top_->mutable_cpu_diff());
+    layer.Backward(this->blob_top_vec_, vector<bool>(1, true),
+        this->blob_bottom_vec_);
+    // Each window sends its gradient to its maximum.
+    vector<Dtype> expected_diff(this->blob_bottom_->count(), 0);
+    for (int c = 0; c < 2 * 2; ++c) {
+      const Dtype* bottom = this->blob_bottom_->cpu_data() +
+          c * height * width;
+      for (int ph = 0; ph < 2; ++ph) {
+        for (int pw = 0; pw < 3; ++pw) {
+          int argmax = ph * width + pw;
+          for (int h = ph; h < ph + kernel_h; ++h) {
+            for (int w = pw; w < pw + kernel_w; ++w) {
+              if (bottom[h * width + w] > bottom[argmax]) {
+                argmax = h * width + w;
+              }
+            }
+          }
+          EXPECT_EQ(bottom[argmax],
+              this->blob_top_->cpu_data()[(c * 2 + ph) * 3 + pw]);
+          expected_diff[c * height * width + argmax] += 1;
+        }
+      }
+    }
+    for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+      EXPECT_EQ(expected_diff[i], this->blob_bottom_->cpu_diff()[i]);
+    }
+  }
+}
+
 TYPED_TEST(PoolingLayerTest, TestForwardMaxPadded) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
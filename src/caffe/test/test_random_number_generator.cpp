@@ -5,6 +5,7 @@
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/philox.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -395,6 +396,62 @@ TYPED_TEST(RandomNumberGeneratorTest, TestRngBernoulliTimesBernoulli) {
   EXPECT_NEAR(true_mean, sample_p, bound);
 }
 
+TYPED_TEST(RandomNumberGeneratorTest, TestRngSeedReproducible) {
+  // The same seed reproduces the same fill, across several parallel chunks.
+  TypeParam* data = static_cast<TypeParam*>(this->data_->mutable_cpu_data());
+  TypeParam* data_2 =
+      static_cast<TypeParam*>(this->data_2_->mutable_cpu_data());
+  Caffe::set_random_seed(this->seed_);
+  caffe_rng_gaussian(this->sample_size_, TypeParam(0), TypeParam(1), data);
+  Caffe::set_random_seed(this->seed_);
+  caffe_rng_gaussian(this->sample_size_, TypeParam(0), TypeParam(1), data_2);
+  for (int i = 0; i < this->sample_size_; ++i) {
+    EXPECT_EQ(data[i], data_2[i]);
+  }
+  // Consecutive fills continue the stream rather than repeating it.
+  caffe_rng_gaussian(this->sample_size_, TypeParam(0), TypeParam(1), data_2);
+  int num_equal = 0;
+  for (int i = 0; i < this->sample_size_; ++i) {
+    num_equal += (data[i] == data_2[i]);
+  }
+  EXPECT_LT(num_equal, 10);
+}
+
+TEST(PhiloxTest, TestKnownAnswer) {
+  // Known-answer vectors of Philox4x32-10 from the Random123 distribution.
+  const uint32_t zero_ctr[4] = { 0, 0, 0, 0 };
+  const uint32_t zero_key[2] = { 0, 0 };
+  uint32_t out[4];
+  Philox::Block(zero_ctr, zero_key, out);
+  EXPECT_EQ(0x6627e8d5u, out[0]);
+  EXPECT_EQ(0xe169c58du, out[1]);
+  EXPECT_EQ(0xbc57ac4cu, out[2]);
+  EXPECT_EQ(0x9b00dbd8u, out[3]);
+  const uint32_t pi_ctr[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 };
+  const uint32_t pi_key[2] = { 0xa4093822, 0x299f31d0 };
+  Philox::Block(pi_ctr, pi_key, out);
+  EXPECT_EQ(0xd16cfe09u, out[0]);
+  EXPECT_EQ(0x94fdccebu, out[1]);
+  EXPECT_EQ(0x5001e420u, out[2]);
+  EXPECT_EQ(0x24126ea1u, out[3]);
+}
+
+TEST(PhiloxTest, TestGenerateByOffset) {
+  // Generating a range block by block, in lanes, or sequentially gives the
+  // same stream, which is what makes splitting a fill across threads exact.
+  Philox rng(0x12345678, 0x9abcdef0);
+  const int num_blocks = 37;
+  vector<uint32_t> whole(num_blocks * Philox::kBlockSize);
+  rng.Generate(0, num_blocks, &whole[0]);
+  vector<uint32_t> part(num_blocks * Philox::kBlockSize);
+  rng.Generate(0, 11, &part[0]);
+  rng.Generate(11, num_blocks - 11, &part[11 * Philox::kBlockSize]);
+  for (int i = 0; i < whole.size(); ++i) {
+    EXPECT_EQ(whole[i], part[i]);
+    EXPECT_EQ(whole[i], rng());
+  }
+}
+
 #ifndef CPU_ONLY
 
 TYPED_TEST(RandomNumberGeneratorTest, TestRngGaussianGPU) {
@@ -86,7 +86,11 @@ class ReductionLayerTest : public MultiDeviceTest<TypeParam> {
     reduction_param->set_coeff(coeff);
     reduction_param->set_axis(axis);
     ReductionLayer<Dtype> layer(layer_param);
-    GradientChecker<Dtype> checker(1e-2, 2e-3);
+    // The finite differences of ASUM cross its kink at 0 for the inputs
+    // closer to it than the step.
+    const Dtype kink_range =
+        op == ReductionParameter_ReductionOp_ASUM ? 1e-2 : -1;
+    GradientChecker<Dtype> checker(1e-2, 2e-3, 1701, 0., kink_range);
     checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
         this->blob_top_vec_);
   }
@@ -0,0 +1,240 @@
+#include <boost/filesystem.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/sgd_solvers.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/snapshot_store.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+namespace fs = boost::filesystem;
+
+static int CountFiles(const string& directory) {
+  int count = 0;
+  for (fs::directory_iterator it(directory), end; it != end; ++it) {
+    ++count;
+  }
+  return count;
+}
+
+template <typename Dtype>
+class SnapshotStoreTest : public ::testing::Test {
+ protected:
+  SnapshotStoreTest() : blob_(2, 3, 4, 5) {
+    MakeTempDir(&directory_);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&blob_);
+  }
+
+  string directory_;
+  Blob<Dtype> blob_;
+};
+
+TYPED_TEST_CASE(SnapshotStoreTest, TestDtypes);
+
+TYPED_TEST(SnapshotStoreTest, TestPutGet) {
+  typedef TypeParam Dtype;
+  SnapshotStore store(this->directory_);
+  const string id = store.Put(this->blob_);
+  BlobProto proto;
+  store.Get(id, &proto);
+  Blob<Dtype> restored;
+  restored.FromProto(proto);
+  ASSERT_TRUE(restored.ShapeEquals(proto));
+  EXPECT_EQ(this->blob_.shape(), restored.shape());
+  for (int i = 0; i < this->blob_.count(); ++i) {
+    EXPECT_EQ(this->blob_.cpu_data()[i], restored.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(SnapshotStoreTest, TestCreateOnPut) {
+  const string directory = this->directory_ + "/chunks";
+  SnapshotStore store(directory);
+  EXPECT_FALSE(fs::exists(directory));
+  store.Put(this->blob_);
+  EXPECT_EQ(1, CountFiles(directory));
+}
+
+TYPED_TEST(SnapshotStoreTest, TestDeduplication) {
+  typedef TypeParam Dtype;
+  SnapshotStore store(this->directory_);
+  const string id = store.Put(this->blob_);
+  EXPECT_EQ(id, store.Put(this->blob_));
+  EXPECT_EQ(1, store.chunks_written());
+  EXPECT_EQ(1, store.chunks_reused());
+  EXPECT_GT(store.bytes_written(), this->blob_.count() * sizeof(Dtype));
+  // The diff, the shape and the values are all part of the id.
+  EXPECT_NE(id, store.Put(this->blob_, true));
+  Blob<Dtype> reshaped;
+  reshaped.CopyFrom(this->blob_, false, true);
+  reshaped.Reshape(5, 4, 3, 2);
+  EXPECT_NE(id, store.Put(reshaped));
+  this->blob_.mutable_cpu_data()[7] += 1;
+  EXPECT_NE(id, store.Put(this->blob_));
+  EXPECT_EQ(4, store.chunks_written());
+  EXPECT_EQ(4, CountFiles(this->directory_));
+}
+
+template <typename TypeParam>
+class ChunkedSnapshotTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  // Trains a two layer regression whose first layer is frozen, snapshotting
+  // every iteration and keeping the last keep snapshots.
+  void Train(int max_iter, int keep) {
+    MakeTempDir(&directory_);
+    std::ostringstream proto;
+    proto <<
+       "base_lr: 0.01 "
+       "lr_policy: 'fixed' "
+       "momentum: 0.9 "
+       "max_iter: " << max_iter << " "
+       "snapshot: 1 "
+       "snapshot_format: CHUNKED "
+       "snapshot_keep: " << keep << " "
+       "snapshot_prefix: '" << directory_ << "/' "
+       "snapshot_after_train: false "
+       "random_seed: 1701 "
+       "net_param { "
+       "  name: 'TestNetwork' "
+       "  layer { "
+       "    name: 'data' "
+       "    type: 'DummyData' "
+       "    dummy_data_param { "
+       "      shape { dim: 4 dim: 3 } "
+       "      shape { dim: 4 dim: 2 } "
+       "      data_filler { type: 'gaussian' } "
+       "      data_filler { type: 'gaussian' } "
+       "    } "
+       "    top: 'data' "
+       "    top: 'targets' "
+       "  } "
+       "  layer { "
+       "    name: 'frozen' "
+       "    type: 'InnerProduct' "
+       "    param { lr_mult: 0 } "
+       "    param { lr_mult: 0 } "
+       "    inner_product_param { "
+       "      num_output: 5 "
+       "      weight_filler { type: 'gaussian' } "
+       "    } "
+       "    bottom: 'data' "
+       "    top: 'frozen' "
+       "  } "
+       "  layer { "
+       "    name: 'innerprod' "
+       "    type: 'InnerProduct' "
+       "    inner_product_param { "
+       "      num_output: 2 "
+       "      weight_filler { type: 'gaussian' } "
+       "    } "
+       "    bottom: 'frozen' "
+       "    top: 'innerprod' "
+       "  } "
+       "  layer { "
+       "    name: 'loss' "
+       "    type: 'EuclideanLoss' "
+       "    bottom: 'innerprod' "
+       "    bottom: 'targets' "
+       "  } "
+       "} ";
+    SolverParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto.str(), &param));
+    solver_.reset(new SGDSolver<Dtype>(param));
+    solver_->Solve();
+  }
+
+  string directory_;
+  shared_ptr<SGDSolver<Dtype> > solver_;
+};
+
+TYPED_TEST_CASE(ChunkedSnapshotTest, TestDtypesAndDevices);
+
+TYPED_TEST(ChunkedSnapshotTest, TestRetention) {
+  this->Train(4, 2);
+  // Two model and two solver state manifests, and the chunk directory.
+  EXPECT_EQ(5, CountFiles(this->directory_));
+  EXPECT_TRUE(fs::exists(this->directory_ + "/_iter_3.solverstate.manifest"));
+  EXPECT_TRUE(fs::exists(this->directory_ + "/_iter_4.caffemodel.manifest"));
+  // Each snapshot refers to 4 weight and 4 history blobs. The frozen
+  // weights and their history are shared, and the zero-filled frozen bias
+  // has the same chunk as its history, so that the 2 snapshots use
+  // 3 + 2 * 4 chunks.
+  EXPECT_EQ(11, CountFiles(this->directory_ + "/_chunks"));
+}
+
+TYPED_TEST(ChunkedSnapshotTest, TestRestore) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->Train(2, 0);
+  vector<shared_ptr<Blob<Dtype> > > expected;
+  const vector<Blob<Dtype>*>& params =
+      this->solver_->net()->learnable_params();
+  for (int i = 0; i < params.size(); ++i) {
+    expected.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    expected.back()->CopyFrom(*params[i], false, true);
+  }
+  // Restore into a solver whose weights are initialized differently.
+  SolverParameter param(this->solver_->param());
+  param.set_random_seed(1702);
+  SGDSolver<Dtype> solver(param);
+  solver.Restore(
+      (this->directory_ + "/_iter_2.solverstate.manifest").c_str());
+  EXPECT_EQ(2, solver.iter());
+  const vector<Blob<Dtype>*>& restored = solver.net()->learnable_params();
+  for (int i = 0; i < restored.size(); ++i) {
+    for (int j = 0; j < restored[i]->count(); ++j) {
+      EXPECT_EQ(expected[i]->cpu_data()[j], restored[i]->cpu_data()[j]);
+    }
+    for (int j = 0; j < solver.history()[i]->count(); ++j) {
+      EXPECT_EQ(this->solver_->history()[i]->cpu_data()[j],
+          solver.history()[i]->cpu_data()[j]);
+    }
+  }
+}
+
+TYPED_TEST(ChunkedSnapshotTest, TestReadMoved) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->Train(2, 0);
+  SnapshotManifest manifest;
+  ASSERT_TRUE(ReadProtoFromBinaryFile(
+      this->directory_ + "/_iter_2.caffemodel.manifest", &manifest));
+  EXPECT_EQ("_chunks", manifest.store());
+  // The manifests find their chunks wherever the snapshots are moved.
+  const string moved = this->directory_ + "_moved";
+  fs::rename(this->directory_, moved);
+  NetParameter param;
+  ReadNetParamsFromSnapshotStoreOrDie(moved + "/_iter_2.caffemodel.manifest",
+      &param);
+  EXPECT_FALSE(fs::exists(this->directory_));
+  const vector<Blob<Dtype>*>& params =
+      this->solver_->net()->learnable_params();
+  ASSERT_EQ(2, param.layer_size());
+  int p = 0;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    for (int j = 0; j < param.layer(i).blobs_size(); ++j, ++p) {
+      Blob<Dtype> blob;
+      blob.FromProto(param.layer(i).blobs(j));
+      ASSERT_EQ(params[p]->count(), blob.count());
+      for (int k = 0; k < blob.count(); ++k) {
+        EXPECT_EQ(params[p]->cpu_data()[k], blob.cpu_data()[k]);
+      }
+    }
+  }
+  EXPECT_EQ(params.size(), p);
+  fs::remove_all(moved);
+}
+
+}  // namespace caffe
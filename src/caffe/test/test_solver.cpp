@@ -1,3 +1,6 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <map>
 #include <string>
 #include <utility>
 #include <vector>
@@ -16,6 +19,54 @@ using std::ostringstream;
 
 namespace caffe {
 
+// Records the weights of the train net after every iteration and those each
+// background test evaluated, by the iteration it was tagged with. Background
+// tests are slowed down so that they overlap with training and each other.
+template <typename Dtype>
+class AsyncTestRecordingSolver : public SGDSolver<Dtype> {
+ public:
+  explicit AsyncTestRecordingSolver(const SolverParameter& param)
+      : SGDSolver<Dtype>(param), pending_(0), max_pending_(0) {
+    Record(this->net_.get(), &train_weights_[0]);
+  }
+
+  std::map<int, vector<Dtype> > train_weights_;
+  std::map<int, vector<Dtype> > test_weights_;
+  int pending_;
+  int max_pending_;
+  boost::mutex mutex_;
+
+ protected:
+  virtual void ApplyUpdate() {
+    SGDSolver<Dtype>::ApplyUpdate();
+    boost::mutex::scoped_lock lock(mutex_);
+    Record(this->net_.get(), &train_weights_[this->iter_ + 1]);
+  }
+
+  virtual void TestNet(Net<Dtype>* test_net, const int test_net_id,
+      const int iter, const bool interruptible) {
+    if (interruptible) {
+      SGDSolver<Dtype>::TestNet(test_net, test_net_id, iter, interruptible);
+      return;
+    }
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      EXPECT_EQ(0, test_weights_.count(iter));
+      Record(test_net, &test_weights_[iter]);
+      max_pending_ = std::max(max_pending_, ++pending_);
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+    SGDSolver<Dtype>::TestNet(test_net, test_net_id, iter, interruptible);
+    boost::mutex::scoped_lock lock(mutex_);
+    --pending_;
+  }
+
+  void Record(Net<Dtype>* net, vector<Dtype>* weights) {
+    const Blob<Dtype>& blob = *net->layer_by_name("innerprod")->blobs()[0];
+    weights->assign(blob.cpu_data(), blob.cpu_data() + blob.count());
+  }
+};
+
 template <typename TypeParam>
 class SolverTest : public MultiDeviceTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -106,4 +157,135 @@ TYPED_TEST(SolverTest, TestInitTrainTestNets) {
   EXPECT_TRUE(this->solver_->test_nets()[1]->has_layer("accuracy"));
 }
 
+TYPED_TEST(SolverTest, TestAsyncTestNetsCopyWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+     "base_lr: 0.1 "
+     "lr_policy: 'fixed' "
+     "max_iter: 4 "
+     "snapshot_after_train: false "
+     "test_interval: 2 "
+     "test_iter: 3 "
+     "test_async: true "
+     "test_async_max_pending: 1 "
+     "net_param { "
+     "  name: 'TestNetwork' "
+     "  layer { "
+     "    name: 'data' "
+     "    type: 'DummyData' "
+     "    dummy_data_param { "
+     "      data_filler { type: 'gaussian' } "
+     "      data_filler { type: 'constant' value: 1 } "
+     "      shape { "
+     "        dim: 5 "
+     "        dim: 2 "
+     "        dim: 3 "
+     "        dim: 4 "
+     "      } "
+     "      shape { "
+     "        dim: 5 "
+     "      } "
+     "    } "
+     "    top: 'data' "
+     "    top: 'label' "
+     "  } "
+     "  layer { "
+     "    name: 'innerprod' "
+     "    type: 'InnerProduct' "
+     "    inner_product_param { "
+     "      num_output: 10 "
+     "      weight_filler { type: 'gaussian' } "
+     "    } "
+     "    bottom: 'data' "
+     "    top: 'innerprod' "
+     "  } "
+     "  layer { "
+     "    name: 'loss' "
+     "    type: 'SoftmaxWithLoss' "
+     "    bottom: 'innerprod' "
+     "    bottom: 'label' "
+     "  } "
+     "} ";
+  this->InitSolverFromProtoString(proto);
+  this->solver_->Solve();
+  EXPECT_EQ(4, this->solver_->iter());
+  // The test net keeps weights of its own, last copied at iteration 4.
+  const Blob<Dtype>& train_weights =
+      *this->solver_->net()->layer_by_name("innerprod")->blobs()[0];
+  const Blob<Dtype>& test_weights =
+      *this->solver_->test_nets()[0]->layer_by_name("innerprod")->blobs()[0];
+  EXPECT_NE(train_weights.cpu_data(), test_weights.cpu_data());
+  ASSERT_EQ(train_weights.count(), test_weights.count());
+  for (int i = 0; i < train_weights.count(); ++i) {
+    EXPECT_EQ(train_weights.cpu_data()[i], test_weights.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(SolverTest, TestAsyncTestIterationsAndMaxPending) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string& proto =
+     "base_lr: 0.1 "
+     "lr_policy: 'fixed' "
+     "max_iter: 8 "
+     "snapshot_after_train: false "
+     "test_interval: 2 "
+     "test_iter: 1 "
+     "test_async: true "
+     "test_async_max_pending: 2 "
+     "net_param { "
+     "  name: 'TestNetwork' "
+     "  layer { "
+     "    name: 'data' "
+     "    type: 'DummyData' "
+     "    dummy_data_param { "
+     "      data_filler { type: 'gaussian' } "
+     "      data_filler { type: 'constant' value: 1 } "
+     "      shape { dim: 5 dim: 2 dim: 3 dim: 4 } "
+     "      shape { dim: 5 } "
+     "    } "
+     "    top: 'data' "
+     "    top: 'label' "
+     "  } "
+     "  layer { "
+     "    name: 'innerprod' "
+     "    type: 'InnerProduct' "
+     "    inner_product_param { "
+     "      num_output: 10 "
+     "      weight_filler { type: 'gaussian' } "
+     "    } "
+     "    bottom: 'data' "
+     "    top: 'innerprod' "
+     "  } "
+     "  layer { "
+     "    name: 'loss' "
+     "    type: 'SoftmaxWithLoss' "
+     "    bottom: 'innerprod' "
+     "    bottom: 'label' "
+     "  } "
+     "} ";
+  SolverParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  param.set_solver_mode(Caffe::mode() == Caffe::GPU ?
+      SolverParameter_SolverMode_GPU : SolverParameter_SolverMode_CPU);
+  AsyncTestRecordingSolver<Dtype> solver(param);
+  solver.Solve();
+  // Solve reports every evaluation before returning.
+  EXPECT_EQ(0, solver.pending_);
+  EXPECT_LE(solver.max_pending_, 2);
+  // Iterations 0, 2, 4 and 6 are tested during training and 8 after it, each
+  // with the weights the train net had at that iteration.
+  ASSERT_EQ(5, solver.test_weights_.size());
+  for (int iter = 0; iter <= 8; iter += 2) {
+    ASSERT_EQ(1, solver.test_weights_.count(iter)) << "iter " << iter;
+    const vector<Dtype>& expected = solver.train_weights_[iter];
+    const vector<Dtype>& tested = solver.test_weights_[iter];
+    ASSERT_EQ(expected.size(), tested.size());
+    for (int i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(expected[i], tested[i]) << "iter " << iter;
+    }
+  }
+  // Weights differ from one tested iteration to the next.
+  EXPECT_NE(solver.train_weights_[0][0], solver.train_weights_[8][0]);
+}
+
 }  // namespace caffe
@@ -50,6 +50,21 @@ TEST_F(SyncedMemoryTest, TestAllocationGPU) {
 
 #endif
 
+TEST_F(SyncedMemoryTest, TestVersion) {
+  SyncedMemory mem(10);
+  const size_t initial = mem.version();
+  mem.cpu_data();
+  EXPECT_EQ(mem.version(), initial);
+  mem.mutable_cpu_data();
+  const size_t written = mem.version();
+  EXPECT_GT(written, initial);
+  mem.cpu_data();
+  EXPECT_EQ(mem.version(), written);
+  char buffer[10];
+  mem.set_cpu_data(buffer);
+  EXPECT_GT(mem.version(), written);
+}
+
 TEST_F(SyncedMemoryTest, TestCPUWrite) {
   SyncedMemory mem(10);
   void* cpu_data = mem.mutable_cpu_data();
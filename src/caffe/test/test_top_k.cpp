@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/top_k.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class TopKTest : public ::testing::Test {
+ protected:
+  TopKTest() : n_(1000), stride_(3), x_(n_ * stride_) {}
+
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    caffe_rng_uniform<Dtype>(x_.size(), -1, 1, &x_[0]);
+    // Rounding leaves many ties, whose order is part of the contract.
+    for (int i = 0; i < x_.size(); ++i) {
+      x_[i] = static_cast<int>(x_[i] * 50) / Dtype(50);
+    }
+  }
+
+  // The (value, index) pairs of a row sorted as std::greater sorts them.
+  vector<std::pair<Dtype, int> > Sorted(const int stride) {
+    vector<std::pair<Dtype, int> > sorted(n_);
+    for (int i = 0; i < n_; ++i) {
+      sorted[i] = std::make_pair(x_[i * stride], i);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+        std::greater<std::pair<Dtype, int> >());
+    return sorted;
+  }
+
+  void TestTopK(const int k, const int stride) {
+    const vector<std::pair<Dtype, int> > sorted = Sorted(stride);
+    vector<Dtype> values(k);
+    vector<int> indices(k);
+    caffe_cpu_top_k(n_, &x_[0], stride, k, &values[0], &indices[0]);
+    for (int i = 0; i < k; ++i) {
+      EXPECT_EQ(sorted[i].first, values[i]) << "k = " << k << ", i = " << i;
+      EXPECT_EQ(sorted[i].second, indices[i]) << "k = " << k << ", i = " << i;
+    }
+  }
+
+  const int n_;
+  const int stride_;
+  vector<Dtype> x_;
+};
+
+TYPED_TEST_CASE(TopKTest, TestDtypes);
+
+TYPED_TEST(TopKTest, TestTopOne) {
+  this->TestTopK(1, 1);
+  this->TestTopK(1, this->stride_);
+}
+
+TYPED_TEST(TopKTest, TestSmallTopK) {
+  for (int k = 2; k <= 16; k += 7) {
+    this->TestTopK(k, 1);
+    this->TestTopK(k, this->stride_);
+  }
+}
+
+TYPED_TEST(TopKTest, TestLargeTopK) {
+  const int ks[] = {17, 100, 1000};
+  for (int i = 0; i < 3; ++i) {
+    this->TestTopK(ks[i], 1);
+    this->TestTopK(ks[i], this->stride_);
+  }
+}
+
+TYPED_TEST(TopKTest, TestRank) {
+  const vector<std::pair<TypeParam, int> > sorted =
+      this->Sorted(this->stride_);
+  for (int i = 0; i < this->n_; ++i) {
+    EXPECT_EQ(i, caffe_cpu_rank(this->n_, &this->x_[0], this->stride_,
+                                sorted[i].second));
+  }
+}
+
+}  // namespace caffe
@@ -85,6 +85,7 @@ size_t BlockingQueue<T>::size() const {
   return queue_.size();
 }
 
+template class BlockingQueue<int>;
 template class BlockingQueue<Batch<float>*>;
 template class BlockingQueue<Batch<double>*>;
 
@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <queue>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/util/channel_pruning.hpp"
+
+namespace caffe {
+
+using std::map;
+using std::pair;
+using std::set;
+
+// The changes needed to remove channels from one convolution.
+struct PruningPlan {
+  PruningPlan() : scale_layer(-1) {}
+  // The Scale layer holding the gamma of the convolution outputs, if any.
+  int scale_layer;
+  // (layer, param blob, axis) -> channels to keep along that axis.
+  map<pair<pair<int, int>, int>, vector<bool> > blob_masks;
+  // The convolutions whose num_output and group change.
+  PrunedConvolutions convolutions;
+  // Why the convolution cannot be pruned, if it cannot.
+  string failure;
+};
+
+static int CountKept(const vector<bool>& keep) {
+  return std::count(keep.begin(), keep.end(), true);
+}
+
+// Repeats each entry of keep times times, for layers that turn each channel
+// into several (Depthwise multipliers) or flatten it with its spatial extent
+// (InnerProduct).
+static vector<bool> Expand(const vector<bool>& keep, int times) {
+  vector<bool> expanded;
+  for (int i = 0; i < keep.size(); ++i) {
+    expanded.insert(expanded.end(), times, keep[i]);
+  }
+  return expanded;
+}
+
+static bool IsChannelwise(const string& type) {
+  static const char* types[] = {"BatchNorm", "Scale", "Bias", "PReLU", "ReLU",
+      "ELU", "Sigmoid", "TanH", "AbsVal", "BNLL", "Power", "Dropout",
+      "Pooling", "Split"};
+  for (int i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+    if (type == types[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Follows the outputs of the producer convolution through the net and records
+// how every affected layer has to change so that only the kept channels
+// remain.
+template <typename Dtype>
+static void Trace(const Net<Dtype>& net, int producer,
+    const vector<bool>& keep, PruningPlan* plan) {
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net.layers();
+  const string& producer_name = net.layer_names()[producer];
+  const int producer_channels = keep.size();
+  plan->blob_masks[std::make_pair(std::make_pair(producer, 0), 0)] = keep;
+  if (layers[producer]->blobs().size() > 1) {
+    plan->blob_masks[std::make_pair(std::make_pair(producer, 1), 0)] = keep;
+  }
+  plan->convolutions[producer_name] = std::make_pair(CountKept(keep), 1);
+  const set<int> outputs(net.output_blob_indices().begin(),
+      net.output_blob_indices().end());
+  map<int, vector<bool> > blob_keep;
+  std::queue<int> pending;
+  const int first_top = net.top_ids(producer)[0];
+  blob_keep[first_top] = keep;
+  pending.push(first_top);
+  set<int> visited_layers;
+  while (!pending.empty()) {
+    const int blob_id = pending.front();
+    pending.pop();
+    const string& blob_name = net.blob_names()[blob_id];
+    if (outputs.count(blob_id)) {
+      plan->failure = "its channels reach the net output " + blob_name;
+      return;
+    }
+    const vector<bool> mask = blob_keep[blob_id];
+    const int channels = mask.size();
+    for (int l = 0; l < layers.size(); ++l) {
+      const vector<int>& bottoms = net.bottom_ids(l);
+      if (l == producer || visited_layers.count(l) ||
+          std::find(bottoms.begin(), bottoms.end(), blob_id) ==
+          bottoms.end()) {
+        continue;
+      }
+      visited_layers.insert(l);
+      Layer<Dtype>& layer = *layers[l];
+      const LayerParameter& param = layer.layer_param();
+      const string& name = param.name();
+      const string type = layer.type();
+      const vector<shared_ptr<Blob<Dtype> > >& blobs = layer.blobs();
+      const bool depthwise = type == "Depthwise" || (type == "Convolution" &&
+          param.convolution_param().group() == channels && channels > 1);
+      if (bottoms.size() > 1 && type != "Split") {
+        plan->failure = "its channels reach " + type + " layer " + name +
+            ", which has several inputs";
+        return;
+      }
+      if (IsChannelwise(type)) {
+        if ((type == "Scale" || type == "Bias") &&
+            (type == "Scale" ? param.scale_param().axis() :
+             param.bias_param().axis()) != 1) {
+          plan->failure = type + " layer " + name + " is not per channel";
+          return;
+        }
+        if (type == "Pooling" && param.pooling_param().pool() ==
+            PoolingParameter_PoolMethod_STOCHASTIC) {
+          plan->failure = "unsupported pooling in " + name;
+          return;
+        }
+        // Per-channel parameters (BatchNorm statistics, Scale gamma and
+        // beta, Bias, PReLU slopes); BatchNorm's scale factor is left alone.
+        for (int b = 0; b < blobs.size(); ++b) {
+          if (blobs[b]->num_axes() == 1 && blobs[b]->count() == channels &&
+              !(type == "BatchNorm" && b == 2)) {
+            plan->blob_masks[std::make_pair(std::make_pair(l, b), 0)] = mask;
+          }
+        }
+        if (type == "Scale" && plan->scale_layer < 0 &&
+            channels == producer_channels && !blobs.empty()) {
+          plan->scale_layer = l;
+        }
+        for (int t = 0; t < net.top_ids(l).size(); ++t) {
+          const int top = net.top_ids(l)[t];
+          if (!blob_keep.count(top)) {
+            blob_keep[top] = mask;
+            pending.push(top);
+          }
+        }
+      } else if (depthwise) {
+        const int multiplier = blobs[0]->shape(0) / channels;
+        const vector<bool> expanded = Expand(mask, multiplier);
+        for (int b = 0; b < blobs.size(); ++b) {
+          plan->blob_masks[std::make_pair(std::make_pair(l, b), 0)] =
+              expanded;
+        }
+        if (type == "Convolution") {
+          const int kept = CountKept(mask);
+          plan->convolutions[name] = std::make_pair(kept * multiplier, kept);
+        }
+        const int top = net.top_ids(l)[0];
+        blob_keep[top] = expanded;
+        pending.push(top);
+      } else if (type == "Convolution" &&
+          param.convolution_param().group() == 1) {
+        plan->blob_masks[std::make_pair(std::make_pair(l, 0), 1)] = mask;
+      } else if (type == "InnerProduct" &&
+          param.inner_product_param().axis() == 1) {
+        const int spatial = net.blobs()[blob_id]->count(2);
+        const int axis = param.inner_product_param().transpose() ? 0 : 1;
+        plan->blob_masks[std::make_pair(std::make_pair(l, 0), axis)] =
+            Expand(mask, spatial);
+      } else {
+        plan->failure = "its channels reach " + type + " layer " + name;
+        return;
+      }
+    }
+  }
+}
+
+// Ranks the output channels of the producer convolution and returns which of
+// them to keep.
+template <typename Dtype>
+static vector<bool> SelectChannels(const Net<Dtype>& net, int producer,
+    float ratio, const string& criterion, const PruningPlan& plan) {
+  const Blob<Dtype>& weights = *net.layers()[producer]->blobs()[0];
+  const int channels = weights.shape(0);
+  const int filter_size = weights.count(1);
+  bool use_gamma = criterion == "gamma" ||
+      (criterion == "auto" && plan.scale_layer >= 0);
+  if (use_gamma && plan.scale_layer < 0) {
+    LOG(WARNING) << "No Scale layer follows " << net.layer_names()[producer]
+        << "; ranking its channels by the filter norms.";
+    use_gamma = false;
+  }
+  vector<pair<Dtype, int> > scores(channels);
+  for (int c = 0; c < channels; ++c) {
+    Dtype score = 0;
+    if (use_gamma) {
+      score = std::abs(
+          net.layers()[plan.scale_layer]->blobs()[0]->cpu_data()[c]);
+    } else {
+      const Dtype* filter = weights.cpu_data() + c * filter_size;
+      for (int i = 0; i < filter_size; ++i) {
+        score += std::abs(filter[i]);
+      }
+    }
+    scores[c] = std::make_pair(score, c);
+  }
+  std::sort(scores.begin(), scores.end());
+  const int removed = std::min(channels - 1,
+      static_cast<int>(channels * ratio + 0.5));
+  vector<bool> keep(channels, true);
+  for (int i = 0; i < removed; ++i) {
+    keep[scores[i].second] = false;
+  }
+  LOG(INFO) << net.layer_names()[producer] << ": keeping "
+      << channels - removed << " of " << channels << " channels (ranked by "
+      << (use_gamma ? "gamma" : "filter L1 norm") << ")";
+  return keep;
+}
+
+// Keeps the slices of blob along axis for which keep is true.
+template <typename Dtype>
+static void PruneBlob(const vector<bool>& keep, int axis, Blob<Dtype>* blob) {
+  vector<int> shape = blob->shape();
+  CHECK_EQ(shape[axis], static_cast<int>(keep.size()))
+      << "Inconsistent channel counts";
+  const int outer = blob->count(0, axis);
+  const int inner = blob->count(axis + 1);
+  vector<Dtype> kept;
+  for (int o = 0; o < outer; ++o) {
+    for (int c = 0; c < shape[axis]; ++c) {
+      if (keep[c]) {
+        const Dtype* slice = blob->cpu_data() + (o * shape[axis] + c) * inner;
+        kept.insert(kept.end(), slice, slice + inner);
+      }
+    }
+  }
+  shape[axis] = CountKept(keep);
+  blob->Reshape(shape);
+  std::copy(kept.begin(), kept.end(), blob->mutable_cpu_data());
+}
+
+template <typename Dtype>
+int PruneChannels(Net<Dtype>* net, float ratio, const string& criterion,
+    const set<string>& layers, PrunedConvolutions* convolutions) {
+  CHECK(ratio >= 0 && ratio < 1) << "The pruning ratio must be in [0, 1)";
+  CHECK(criterion == "auto" || criterion == "gamma" || criterion == "l1")
+      << "Unknown pruning criterion " << criterion;
+  set<string> requested = layers;
+  // Plan every convolution against the original weights first, then apply.
+  vector<PruningPlan> plans;
+  for (int l = 0; l < net->layers().size(); ++l) {
+    const string& name = net->layer_names()[l];
+    Layer<Dtype>& layer = *net->layers()[l];
+    if (string(layer.type()) != "Convolution" ||
+        layer.layer_param().convolution_param().group() != 1 ||
+        net->top_ids(l).size() != 1 ||
+        (!layers.empty() && !layers.count(name))) {
+      continue;
+    }
+    requested.erase(name);
+    const int channels = layer.blobs()[0]->shape(0);
+    PruningPlan probe;
+    Trace(*net, l, vector<bool>(channels, true), &probe);
+    if (!probe.failure.empty()) {
+      LOG(INFO) << "Not pruning " << name << ": " << probe.failure;
+      continue;
+    }
+    plans.push_back(PruningPlan());
+    Trace(*net, l, SelectChannels(*net, l, ratio, criterion, probe),
+        &plans.back());
+  }
+  CHECK(requested.empty()) << "No convolution named "
+      << *requested.begin() << " with group 1";
+
+  for (int p = 0; p < plans.size(); ++p) {
+    for (map<pair<pair<int, int>, int>, vector<bool> >::const_iterator it =
+         plans[p].blob_masks.begin(); it != plans[p].blob_masks.end(); ++it) {
+      const int l = it->first.first.first;
+      const int b = it->first.first.second;
+      PruneBlob(it->second, it->first.second,
+          net->layers()[l]->blobs()[b].get());
+    }
+    convolutions->insert(plans[p].convolutions.begin(),
+        plans[p].convolutions.end());
+  }
+  return plans.size();
+}
+
+void UpdatePrunedConvolutions(const PrunedConvolutions& convolutions,
+    NetParameter* param) {
+  for (int i = 0; i < param->layer_size(); ++i) {
+    LayerParameter* layer = param->mutable_layer(i);
+    PrunedConvolutions::const_iterator it = convolutions.find(layer->name());
+    if (it != convolutions.end()) {
+      layer->mutable_convolution_param()->set_num_output(it->second.first);
+      if (it->second.second > 1 ||
+          layer->convolution_param().has_group()) {
+        layer->mutable_convolution_param()->set_group(it->second.second);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void PrunedWeightsToProto(const Net<Dtype>& net, const NetParameter& param,
+    NetParameter* weights) {
+  *weights = param;
+  for (int i = 0; i < weights->layer_size(); ++i) {
+    LayerParameter* layer = weights->mutable_layer(i);
+    const shared_ptr<Layer<Dtype> > pruned_layer =
+        net.layer_by_name(layer->name());
+    layer->clear_blobs();
+    if (pruned_layer) {
+      for (int b = 0; b < pruned_layer->blobs().size(); ++b) {
+        pruned_layer->blobs()[b]->ToProto(layer->add_blobs());
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+double MultiplyAdds(const Net<Dtype>& net) {
+  double total = 0;
+  for (int l = 0; l < net.layers().size(); ++l) {
+    const string type = net.layers()[l]->type();
+    if (type != "Convolution" && type != "Depthwise" &&
+        type != "InnerProduct") {
+      continue;
+    }
+    const Blob<Dtype>& weights = *net.layers()[l]->blobs()[0];
+    const Blob<Dtype>& top = *net.top_vecs()[l][0];
+    if (type == "InnerProduct") {
+      const int num_output =
+          net.layers()[l]->layer_param().inner_product_param().num_output();
+      total += static_cast<double>(top.count()) * weights.count() /
+          num_output;
+    } else {
+      total += static_cast<double>(top.count()) * weights.count(1);
+    }
+  }
+  return total;
+}
+
+template int PruneChannels<float>(Net<float>* net, float ratio,
+    const string& criterion, const set<string>& layers,
+    PrunedConvolutions* convolutions);
+template int PruneChannels<double>(Net<double>* net, float ratio,
+    const string& criterion, const set<string>& layers,
+    PrunedConvolutions* convolutions);
+template void PrunedWeightsToProto<float>(const Net<float>& net,
+    const NetParameter& param, NetParameter* weights);
+template void PrunedWeightsToProto<double>(const Net<double>& net,
+    const NetParameter& param, NetParameter* weights);
+template double MultiplyAdds<float>(const Net<float>& net);
+template double MultiplyAdds<double>(const Net<double>& net);
+
+}  // namespace caffe
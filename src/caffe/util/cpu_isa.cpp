@@ -0,0 +1,109 @@
+#include <cstdlib>
+#include <string>
+
+#include "caffe/util/cpu_isa.hpp"
+
+#ifdef CAFFE_CPU_KERNELS_X86
+#include <cpuid.h>
+#endif
+
+namespace caffe {
+
+namespace {
+
+const char* const kCpuIsaNames[CPU_ISA_COUNT] = {
+  "generic", "sse4", "avx2", "avx512", "avx512_vnni"
+};
+
+#ifdef CAFFE_CPU_KERNELS_X86
+// The register states the OS saves on context switches (XCR0).
+unsigned int SavedRegisterStates() {
+  unsigned int eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return eax;
+}
+#endif
+
+CpuIsa InitialCpuIsa() {
+  const CpuIsa detected = DetectCpuIsa();
+  CpuIsa isa = detected;
+  const char* name = getenv("CAFFE_CPU_ISA");
+  if (name && *name) {
+    CHECK(CpuIsaFromName(name, &isa)) << "Unknown CAFFE_CPU_ISA " << name;
+    if (isa > detected) {
+      LOG(WARNING) << "CAFFE_CPU_ISA " << name << " is not supported by this "
+          << "CPU, using " << CpuIsaName(detected);
+      isa = detected;
+    }
+  }
+  LOG(INFO) << "Using " << CpuIsaName(isa) << " CPU kernels";
+  return isa;
+}
+
+CpuIsa& selected_cpu_isa() {
+  static CpuIsa isa = InitialCpuIsa();
+  return isa;
+}
+
+}  // namespace
+
+CpuIsa DetectCpuIsa() {
+#ifdef CAFFE_CPU_KERNELS_X86
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+      !(ecx & bit_SSE4_1) || !(ecx & bit_SSE4_2)) {
+    return CPU_ISA_GENERIC;
+  }
+  // AVX registers are only usable if the OS saves them.
+  if (!(ecx & bit_AVX) || !(ecx & bit_FMA) || !(ecx & bit_OSXSAVE)) {
+    return CPU_ISA_SSE4;
+  }
+  const unsigned int states = SavedRegisterStates();
+  const unsigned int kYmmStates = 0x6;  // SSE and AVX
+  const unsigned int kZmmStates = 0xe6;  // and the AVX-512 opmask and ZMM
+  if ((states & kYmmStates) != kYmmStates ||
+      !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) ||
+      !(ebx & bit_AVX2)) {
+    return CPU_ISA_SSE4;
+  }
+  if ((states & kZmmStates) != kZmmStates || !(ebx & bit_AVX512F) ||
+      !(ebx & bit_AVX512BW) || !(ebx & bit_AVX512DQ) ||
+      !(ebx & bit_AVX512VL)) {
+    return CPU_ISA_AVX2;
+  }
+  if (!(ecx & bit_AVX512VNNI)) {
+    return CPU_ISA_AVX512;
+  }
+  return CPU_ISA_AVX512_VNNI;
+#else
+  return CPU_ISA_GENERIC;
+#endif
+}
+
+const char* CpuIsaName(const CpuIsa isa) {
+  CHECK_GE(isa, 0);
+  CHECK_LT(isa, CPU_ISA_COUNT);
+  return kCpuIsaNames[isa];
+}
+
+bool CpuIsaFromName(const string& name, CpuIsa* isa) {
+  for (int i = 0; i < CPU_ISA_COUNT; ++i) {
+    if (name == kCpuIsaNames[i]) {
+      *isa = static_cast<CpuIsa>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+CpuIsa SelectedCpuIsa() {
+  return selected_cpu_isa();
+}
+
+void SetSelectedCpuIsa(const CpuIsa isa) {
+  CHECK_LE(isa, DetectCpuIsa()) << CpuIsaName(isa)
+      << " is not supported by this CPU";
+  selected_cpu_isa() = isa;
+}
+
+}  // namespace caffe
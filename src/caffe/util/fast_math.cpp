@@ -0,0 +1,76 @@
+#include <cmath>
+
+#include "caffe/util/cpu_kernel.hpp"
+#include "caffe/util/fast_math.hpp"
+
+namespace caffe {
+
+namespace {
+
+void exp_generic(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::exp(a[i]);
+  }
+}
+
+void log_generic(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::log(a[i]);
+  }
+}
+
+void powx_generic(const int n, const float* a, const float b, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::pow(a[i], b);
+  }
+}
+
+void tanh_generic(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::tanh(a[i]);
+  }
+}
+
+void sigmoid_generic(const int n, const float* a, float* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = 1.f / (1.f + std::exp(-a[i]));
+  }
+}
+
+}  // namespace
+
+REGISTER_CPU_KERNEL(FastMathFunction, fast_exp, CPU_ISA_GENERIC, exp_generic);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_log, CPU_ISA_GENERIC, log_generic);
+REGISTER_CPU_KERNEL(FastPowxFunction, fast_powx, CPU_ISA_GENERIC,
+    powx_generic);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_tanh, CPU_ISA_GENERIC,
+    tanh_generic);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_sigmoid, CPU_ISA_GENERIC,
+    sigmoid_generic);
+
+void fast_exp(const int n, const float* a, float* y) {
+  static CpuKernel<FastMathFunction> kernel("fast_exp");
+  kernel.get()(n, a, y);
+}
+
+void fast_log(const int n, const float* a, float* y) {
+  static CpuKernel<FastMathFunction> kernel("fast_log");
+  kernel.get()(n, a, y);
+}
+
+void fast_powx(const int n, const float* a, const float b, float* y) {
+  static CpuKernel<FastPowxFunction> kernel("fast_powx");
+  kernel.get()(n, a, b, y);
+}
+
+void fast_tanh(const int n, const float* a, float* y) {
+  static CpuKernel<FastMathFunction> kernel("fast_tanh");
+  kernel.get()(n, a, y);
+}
+
+void fast_sigmoid(const int n, const float* a, float* y) {
+  static CpuKernel<FastMathFunction> kernel("fast_sigmoid");
+  kernel.get()(n, a, y);
+}
+
+}  // namespace caffe
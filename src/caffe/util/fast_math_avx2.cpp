@@ -0,0 +1,55 @@
+// The AVX2 + FMA variants of the fast_math kernels.
+
+#include "caffe/util/cpu_kernel.hpp"
+#include "caffe/util/fast_math.hpp"
+
+#ifdef CAFFE_CPU_KERNELS_X86
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+
+#include "caffe/util/fast_math_vector.hpp"
+
+namespace caffe {
+
+namespace {
+
+typedef FastMathVector<32> Vector;
+
+void exp_avx2(const int n, const float* a, float* y) {
+  Vector::Exp(n, a, y);
+}
+
+void log_avx2(const int n, const float* a, float* y) {
+  Vector::Log(n, a, y);
+}
+
+void powx_avx2(const int n, const float* a, const float b, float* y) {
+  Vector::Powx(n, a, b, y);
+}
+
+void tanh_avx2(const int n, const float* a, float* y) {
+  Vector::Tanh(n, a, y);
+}
+
+void sigmoid_avx2(const int n, const float* a, float* y) {
+  Vector::Sigmoid(n, a, y);
+}
+
+}  // namespace
+
+}  // namespace caffe
+
+#pragma GCC pop_options
+
+namespace caffe {
+
+REGISTER_CPU_KERNEL(FastMathFunction, fast_exp, CPU_ISA_AVX2, exp_avx2);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_log, CPU_ISA_AVX2, log_avx2);
+REGISTER_CPU_KERNEL(FastPowxFunction, fast_powx, CPU_ISA_AVX2, powx_avx2);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_tanh, CPU_ISA_AVX2, tanh_avx2);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_sigmoid, CPU_ISA_AVX2, sigmoid_avx2);
+
+}  // namespace caffe
+
+#endif  // CAFFE_CPU_KERNELS_X86
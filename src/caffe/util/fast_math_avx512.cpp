@@ -0,0 +1,56 @@
+// The AVX-512 variants of the fast_math kernels.
+
+#include "caffe/util/cpu_kernel.hpp"
+#include "caffe/util/fast_math.hpp"
+
+#ifdef CAFFE_CPU_KERNELS_X86
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512dq,avx512vl")
+
+#include "caffe/util/fast_math_vector.hpp"
+
+namespace caffe {
+
+namespace {
+
+typedef FastMathVector<64> Vector;
+
+void exp_avx512(const int n, const float* a, float* y) {
+  Vector::Exp(n, a, y);
+}
+
+void log_avx512(const int n, const float* a, float* y) {
+  Vector::Log(n, a, y);
+}
+
+void powx_avx512(const int n, const float* a, const float b, float* y) {
+  Vector::Powx(n, a, b, y);
+}
+
+void tanh_avx512(const int n, const float* a, float* y) {
+  Vector::Tanh(n, a, y);
+}
+
+void sigmoid_avx512(const int n, const float* a, float* y) {
+  Vector::Sigmoid(n, a, y);
+}
+
+}  // namespace
+
+}  // namespace caffe
+
+#pragma GCC pop_options
+
+namespace caffe {
+
+REGISTER_CPU_KERNEL(FastMathFunction, fast_exp, CPU_ISA_AVX512, exp_avx512);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_log, CPU_ISA_AVX512, log_avx512);
+REGISTER_CPU_KERNEL(FastPowxFunction, fast_powx, CPU_ISA_AVX512, powx_avx512);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_tanh, CPU_ISA_AVX512, tanh_avx512);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_sigmoid, CPU_ISA_AVX512,
+    sigmoid_avx512);
+
+}  // namespace caffe
+
+#endif  // CAFFE_CPU_KERNELS_X86
@@ -0,0 +1,55 @@
+// The SSE4 variants of the fast_math kernels.
+
+#include "caffe/util/cpu_kernel.hpp"
+#include "caffe/util/fast_math.hpp"
+
+#ifdef CAFFE_CPU_KERNELS_X86
+
+#pragma GCC push_options
+#pragma GCC target("sse4.1,sse4.2")
+
+#include "caffe/util/fast_math_vector.hpp"
+
+namespace caffe {
+
+namespace {
+
+typedef FastMathVector<16> Vector;
+
+void exp_sse4(const int n, const float* a, float* y) {
+  Vector::Exp(n, a, y);
+}
+
+void log_sse4(const int n, const float* a, float* y) {
+  Vector::Log(n, a, y);
+}
+
+void powx_sse4(const int n, const float* a, const float b, float* y) {
+  Vector::Powx(n, a, b, y);
+}
+
+void tanh_sse4(const int n, const float* a, float* y) {
+  Vector::Tanh(n, a, y);
+}
+
+void sigmoid_sse4(const int n, const float* a, float* y) {
+  Vector::Sigmoid(n, a, y);
+}
+
+}  // namespace
+
+}  // namespace caffe
+
+#pragma GCC pop_options
+
+namespace caffe {
+
+REGISTER_CPU_KERNEL(FastMathFunction, fast_exp, CPU_ISA_SSE4, exp_sse4);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_log, CPU_ISA_SSE4, log_sse4);
+REGISTER_CPU_KERNEL(FastPowxFunction, fast_powx, CPU_ISA_SSE4, powx_sse4);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_tanh, CPU_ISA_SSE4, tanh_sse4);
+REGISTER_CPU_KERNEL(FastMathFunction, fast_sigmoid, CPU_ISA_SSE4, sigmoid_sse4);
+
+}  // namespace caffe
+
+#endif  // CAFFE_CPU_KERNELS_X86
@@ -0,0 +1,278 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe/util/gradient_compression.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename To, typename From>
+static inline To bit_cast(const From& from) {
+  To to;
+  memcpy(&to, &from, sizeof(to));  // NOLINT(caffe/alt_fn)
+  return to;
+}
+
+// IEEE half precision conversions, rounding to the nearest even value.
+static uint16_t float_to_half(float value) {
+  uint32_t f = bit_cast<uint32_t>(value);
+  const uint16_t sign = (f >> 16) & 0x8000;
+  f &= 0x7fffffff;
+  if (f >= 0x7f800000) {
+    // Infinity, or a quiet NaN.
+    return sign | 0x7c00 | (f > 0x7f800000 ? 0x200 : 0);
+  }
+  if (f >= 0x477ff000) {
+    // Rounds past the largest half, 65504.
+    return sign | 0x7c00;
+  }
+  if (f < 0x38800000) {
+    // Below the smallest normal half, 2^-14: adding 0.5 leaves the value
+    // rounded to a multiple of 2^-24 in the low mantissa bits.
+    const float rounded = bit_cast<float>(f) + 0.5f;
+    return sign | (bit_cast<uint32_t>(rounded) - 0x3f000000);
+  }
+  // Rebias the exponent from 127 to 15 and round away the low 13 bits.
+  f += 0xc8000fff + ((f >> 13) & 1);
+  return sign | (f >> 13);
+}
+
+static float half_to_float(uint16_t h) {
+  const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+  const uint32_t exponent = (h >> 10) & 0x1f;
+  const uint32_t mantissa = h & 0x3ff;
+  if (exponent == 0x1f) {
+    return bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+  }
+  if (exponent == 0) {
+    const float magnitude = mantissa * (1.f / (1 << 24));
+    return bit_cast<float>(sign | bit_cast<uint32_t>(magnitude));
+  }
+  return bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+// bfloat16 conversions, rounding to the nearest even value.
+static uint16_t float_to_bfloat16(float value) {
+  const uint32_t f = bit_cast<uint32_t>(value);
+  if ((f & 0x7fffffff) > 0x7f800000) {
+    return (f >> 16) | 0x40;
+  }
+  return (f + 0x7fff + ((f >> 16) & 1)) >> 16;
+}
+
+static float bfloat16_to_float(uint16_t b) {
+  return bit_cast<float>(static_cast<uint32_t>(b) << 16);
+}
+
+template <typename Dtype>
+GradientCompressor<Dtype>::GradientCompressor(
+    const GradientCompressionParameter& param, int count)
+    : param_(param), count_(count) {
+  CHECK_GT(count_, 0);
+  if (param_.error_feedback()) {
+    residual_.resize(count_, Dtype(0));
+  }
+  ResetStats();
+}
+
+template <typename Dtype>
+void GradientCompressor<Dtype>::Encode(const Dtype* grad, string* message) {
+  timer_.Start();
+  if (param_.error_feedback()) {
+    // Encode the gradient plus what the earlier encodings lost, and keep
+    // what this one loses.
+    Dtype* residual = &residual_[0];
+    caffe_axpy(count_, Dtype(1), grad, residual);
+    EncodeValues(residual, message);
+    DecodeValues(*message, Dtype(-1), residual);
+  } else {
+    EncodeValues(grad, message);
+  }
+  timer_.Stop();
+  encode_us_ += timer_.MicroSeconds();
+  raw_bytes_ += count_ * sizeof(Dtype);
+  encoded_bytes_ += message->size();
+}
+
+template <typename Dtype>
+void GradientCompressor<Dtype>::DecodeAdd(const string& message, Dtype alpha,
+    Dtype* grad) {
+  timer_.Start();
+  DecodeValues(message, alpha, grad);
+  timer_.Stop();
+  decode_us_ += timer_.MicroSeconds();
+}
+
+template <typename Dtype>
+double GradientCompressor<Dtype>::compression_ratio() const {
+  return encoded_bytes_ > 0 ? raw_bytes_ / encoded_bytes_ : 1;
+}
+
+template <typename Dtype>
+void GradientCompressor<Dtype>::ResetStats() {
+  raw_bytes_ = 0;
+  encoded_bytes_ = 0;
+  encode_us_ = 0;
+  decode_us_ = 0;
+}
+
+template <typename Dtype>
+void HalfGradientCompressor<Dtype>::EncodeValues(const Dtype* values,
+    string* message) {
+  message->resize(this->count_ * sizeof(uint16_t));
+  uint16_t* out = reinterpret_cast<uint16_t*>(&(*message)[0]);
+  for (int i = 0; i < this->count_; ++i) {
+    out[i] = float_to_half(values[i]);
+  }
+}
+
+template <typename Dtype>
+void HalfGradientCompressor<Dtype>::DecodeValues(const string& message,
+    Dtype alpha, Dtype* values) const {
+  CHECK_EQ(message.size(), this->count_ * sizeof(uint16_t));
+  const uint16_t* in = reinterpret_cast<const uint16_t*>(message.data());
+  for (int i = 0; i < this->count_; ++i) {
+    values[i] += alpha * half_to_float(in[i]);
+  }
+}
+
+template <typename Dtype>
+void BFloat16GradientCompressor<Dtype>::EncodeValues(const Dtype* values,
+    string* message) {
+  message->resize(this->count_ * sizeof(uint16_t));
+  uint16_t* out = reinterpret_cast<uint16_t*>(&(*message)[0]);
+  for (int i = 0; i < this->count_; ++i) {
+    out[i] = float_to_bfloat16(values[i]);
+  }
+}
+
+template <typename Dtype>
+void BFloat16GradientCompressor<Dtype>::DecodeValues(const string& message,
+    Dtype alpha, Dtype* values) const {
+  CHECK_EQ(message.size(), this->count_ * sizeof(uint16_t));
+  const uint16_t* in = reinterpret_cast<const uint16_t*>(message.data());
+  for (int i = 0; i < this->count_; ++i) {
+    values[i] += alpha * bfloat16_to_float(in[i]);
+  }
+}
+
+template <typename Dtype>
+TopKGradientCompressor<Dtype>::TopKGradientCompressor(
+    const GradientCompressionParameter& param, int count)
+    : GradientCompressor<Dtype>(param, count),
+      k_(std::min(count, std::max(1,
+          static_cast<int>(std::ceil(param.topk_ratio() * count))))),
+      order_(count) {
+  CHECK_GT(param.topk_ratio(), 0) << "topk_ratio must be in (0, 1].";
+  CHECK_LE(param.topk_ratio(), 1) << "topk_ratio must be in (0, 1].";
+}
+
+template <typename Dtype>
+struct LargerMagnitude {
+  explicit LargerMagnitude(const Dtype* values) : values_(values) {}
+  bool operator()(int a, int b) const {
+    return std::abs(values_[a]) > std::abs(values_[b]);
+  }
+  const Dtype* values_;
+};
+
+// The message holds the k indices followed by the k values, as floats.
+template <typename Dtype>
+void TopKGradientCompressor<Dtype>::EncodeValues(const Dtype* values,
+    string* message) {
+  for (int i = 0; i < this->count_; ++i) {
+    order_[i] = i;
+  }
+  std::nth_element(order_.begin(), order_.begin() + (k_ - 1), order_.end(),
+      LargerMagnitude<Dtype>(values));
+  // Ascending indices make decoding walk the gradient in order.
+  std::sort(order_.begin(), order_.begin() + k_);
+  message->resize(k_ * (sizeof(uint32_t) + sizeof(float)));
+  uint32_t* indices = reinterpret_cast<uint32_t*>(&(*message)[0]);
+  float* out = reinterpret_cast<float*>(indices + k_);
+  for (int i = 0; i < k_; ++i) {
+    indices[i] = order_[i];
+    out[i] = values[order_[i]];
+  }
+}
+
+template <typename Dtype>
+void TopKGradientCompressor<Dtype>::DecodeValues(const string& message,
+    Dtype alpha, Dtype* values) const {
+  const int k = message.size() / (sizeof(uint32_t) + sizeof(float));
+  CHECK_EQ(message.size(), k * (sizeof(uint32_t) + sizeof(float)));
+  const uint32_t* indices = reinterpret_cast<const uint32_t*>(message.data());
+  const float* in = reinterpret_cast<const float*>(indices + k);
+  for (int i = 0; i < k; ++i) {
+    CHECK_LT(indices[i], this->count_);
+    values[indices[i]] += alpha * in[i];
+  }
+}
+
+// The message holds the scale, as a float, followed by the sign bits, set
+// for negative values.
+template <typename Dtype>
+void SignGradientCompressor<Dtype>::EncodeValues(const Dtype* values,
+    string* message) {
+  const float scale = caffe_cpu_asum(this->count_, values) / this->count_;
+  message->assign(sizeof(float) + (this->count_ + 7) / 8, 0);
+  memcpy(&(*message)[0], &scale, sizeof(float));  // NOLINT(caffe/alt_fn)
+  uint8_t* bits = reinterpret_cast<uint8_t*>(&(*message)[sizeof(float)]);
+  for (int i = 0; i < this->count_; ++i) {
+    if (values[i] < 0) {
+      bits[i / 8] |= 1 << (i % 8);
+    }
+  }
+}
+
+template <typename Dtype>
+void SignGradientCompressor<Dtype>::DecodeValues(const string& message,
+    Dtype alpha, Dtype* values) const {
+  CHECK_EQ(message.size(), sizeof(float) + (this->count_ + 7) / 8);
+  float scale;
+  memcpy(&scale, message.data(), sizeof(float));  // NOLINT(caffe/alt_fn)
+  const Dtype step = alpha * scale;
+  const uint8_t* bits =
+      reinterpret_cast<const uint8_t*>(message.data() + sizeof(float));
+  for (int i = 0; i < this->count_; ++i) {
+    values[i] += ((bits[i / 8] >> (i % 8)) & 1) ? -step : step;
+  }
+}
+
+template <typename Dtype>
+GradientCompressor<Dtype>* GetGradientCompressor(
+    const GradientCompressionParameter& param, int count) {
+  switch (param.method()) {
+  case GradientCompressionParameter_Method_NONE:
+    return NULL;
+  case GradientCompressionParameter_Method_FP16:
+    return new HalfGradientCompressor<Dtype>(param, count);
+  case GradientCompressionParameter_Method_BF16:
+    return new BFloat16GradientCompressor<Dtype>(param, count);
+  case GradientCompressionParameter_Method_TOPK:
+    return new TopKGradientCompressor<Dtype>(param, count);
+  case GradientCompressionParameter_Method_SIGN:
+    return new SignGradientCompressor<Dtype>(param, count);
+  default:
+    LOG(FATAL) << "Unknown gradient compression method: " << param.method();
+  }
+  return NULL;
+}
+
+template GradientCompressor<float>* GetGradientCompressor<float>(
+    const GradientCompressionParameter& param, int count);
+template GradientCompressor<double>* GetGradientCompressor<double>(
+    const GradientCompressionParameter& param, int count);
+
+INSTANTIATE_CLASS(GradientCompressor);
+INSTANTIATE_CLASS(HalfGradientCompressor);
+INSTANTIATE_CLASS(BFloat16GradientCompressor);
+INSTANTIATE_CLASS(TopKGradientCompressor);
+INSTANTIATE_CLASS(SignGradientCompressor);
+
+}  // namespace caffe
@@ -0,0 +1,209 @@
+#include <algorithm>
+
+#include "caffe/util/grouped_conv.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Computes the range [*begin, *end) of output positions o for which the input
+// position o * stride + offset lies inside [0, size), so that the inner loops
+// need no bounds checks.
+inline void valid_output_range(const int offset, const int stride,
+    const int size, const int output_size, int* begin, int* end) {
+  const int first = offset >= 0 ? 0 : (stride - 1 - offset) / stride;
+  const int last = size - 1 - offset;
+  *begin = std::min(first, output_size);
+  *end = last < 0 ? *begin :
+      std::max(*begin, std::min(last / stride + 1, output_size));
+}
+
+template <typename Dtype>
+void grouped_conv_forward_cpu(const Dtype* data_im, const int num,
+    const int channels, const int height, const int width,
+    const Dtype* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, Dtype* data_out) {
+  const int output_h = (height + 2 * pad_h -
+      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int output_w = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const int in_per_group = channels / group;
+  const int out_per_group = num_output / group;
+  const int kernel_size = in_per_group * kernel_h * kernel_w;
+#ifdef _OPENMP
+  #pragma omp parallel for
+#endif
+  for (int index = 0; index < num * num_output; ++index) {
+    const int n = index / num_output;
+    const int c = index % num_output;
+    const Dtype* in = data_im +
+        (n * channels + c / out_per_group * in_per_group) * height * width;
+    const Dtype* w = weights + c * kernel_size;
+    Dtype* out = data_out + index * output_h * output_w;
+    caffe_set(output_h * output_w, Dtype(0), out);
+    for (int ci = 0; ci < in_per_group; ++ci, in += height * width) {
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        int oh_begin, oh_end;
+        valid_output_range(kh * dilation_h - pad_h, stride_h, height,
+            output_h, &oh_begin, &oh_end);
+        for (int kw = 0; kw < kernel_w; ++kw, ++w) {
+          int ow_begin, ow_end;
+          valid_output_range(kw * dilation_w - pad_w, stride_w, width,
+              output_w, &ow_begin, &ow_end);
+          const Dtype weight = *w;
+          for (int oh = oh_begin; oh < oh_end; ++oh) {
+            const Dtype* in_row = in +
+                (oh * stride_h + kh * dilation_h - pad_h) * width +
+                kw * dilation_w - pad_w;
+            Dtype* out_row = out + oh * output_w;
+            for (int ow = ow_begin; ow < ow_end; ++ow) {
+              out_row[ow] += weight * in_row[ow * stride_w];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void grouped_conv_backward_data_cpu(const Dtype* out_diff, const int num,
+    const int channels, const int height, const int width,
+    const Dtype* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, Dtype* im_diff) {
+  const int output_h = (height + 2 * pad_h -
+      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int output_w = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const int in_per_group = channels / group;
+  const int out_per_group = num_output / group;
+  const int kernel_size = in_per_group * kernel_h * kernel_w;
+#ifdef _OPENMP
+  #pragma omp parallel for
+#endif
+  for (int index = 0; index < num * channels; ++index) {
+    const int n = index / channels;
+    const int c = index % channels;
+    const int first_output = c / in_per_group * out_per_group;
+    Dtype* in = im_diff + index * height * width;
+    caffe_set(height * width, Dtype(0), in);
+    for (int co = first_output; co < first_output + out_per_group; ++co) {
+      const Dtype* out = out_diff + (n * num_output + co) * output_h * output_w;
+      const Dtype* w = weights + co * kernel_size +
+          c % in_per_group * kernel_h * kernel_w;
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        int oh_begin, oh_end;
+        valid_output_range(kh * dilation_h - pad_h, stride_h, height,
+            output_h, &oh_begin, &oh_end);
+        for (int kw = 0; kw < kernel_w; ++kw, ++w) {
+          int ow_begin, ow_end;
+          valid_output_range(kw * dilation_w - pad_w, stride_w, width,
+              output_w, &ow_begin, &ow_end);
+          const Dtype weight = *w;
+          for (int oh = oh_begin; oh < oh_end; ++oh) {
+            Dtype* in_row = in +
+                (oh * stride_h + kh * dilation_h - pad_h) * width +
+                kw * dilation_w - pad_w;
+            const Dtype* out_row = out + oh * output_w;
+            for (int ow = ow_begin; ow < ow_end; ++ow) {
+              in_row[ow * stride_w] += weight * out_row[ow];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void grouped_conv_backward_weight_cpu(const Dtype* data_im,
+    const Dtype* out_diff, const int num, const int channels,
+    const int height, const int width, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, Dtype* weight_diff) {
+  const int output_h = (height + 2 * pad_h -
+      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int output_w = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const int in_per_group = channels / group;
+  const int out_per_group = num_output / group;
+  const int kernel_size = in_per_group * kernel_h * kernel_w;
+#ifdef _OPENMP
+  #pragma omp parallel for
+#endif
+  for (int c = 0; c < num_output; ++c) {
+    for (int n = 0; n < num; ++n) {
+      const Dtype* in = data_im +
+          (n * channels + c / out_per_group * in_per_group) * height * width;
+      const Dtype* out = out_diff + (n * num_output + c) * output_h * output_w;
+      Dtype* w = weight_diff + c * kernel_size;
+      for (int ci = 0; ci < in_per_group; ++ci, in += height * width) {
+        for (int kh = 0; kh < kernel_h; ++kh) {
+          int oh_begin, oh_end;
+          valid_output_range(kh * dilation_h - pad_h, stride_h, height,
+              output_h, &oh_begin, &oh_end);
+          for (int kw = 0; kw < kernel_w; ++kw, ++w) {
+            int ow_begin, ow_end;
+            valid_output_range(kw * dilation_w - pad_w, stride_w, width,
+                output_w, &ow_begin, &ow_end);
+            Dtype sum = 0;
+            for (int oh = oh_begin; oh < oh_end; ++oh) {
+              const Dtype* in_row = in +
+                  (oh * stride_h + kh * dilation_h - pad_h) * width +
+                  kw * dilation_w - pad_w;
+              const Dtype* out_row = out + oh * output_w;
+              for (int ow = ow_begin; ow < ow_end; ++ow) {
+                sum += out_row[ow] * in_row[ow * stride_w];
+              }
+            }
+            *w += sum;
+          }
+        }
+      }
+    }
+  }
+}
+
+// Explicit instantiation
+template void grouped_conv_forward_cpu<float>(const float* data_im,
+    const int num, const int channels, const int height, const int width,
+    const float* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, float* data_out);
+template void grouped_conv_forward_cpu<double>(const double* data_im,
+    const int num, const int channels, const int height, const int width,
+    const double* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, double* data_out);
+template void grouped_conv_backward_data_cpu<float>(const float* out_diff,
+    const int num, const int channels, const int height, const int width,
+    const float* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, float* im_diff);
+template void grouped_conv_backward_data_cpu<double>(const double* out_diff,
+    const int num, const int channels, const int height, const int width,
+    const double* weights, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, double* im_diff);
+template void grouped_conv_backward_weight_cpu<float>(const float* data_im,
+    const float* out_diff, const int num, const int channels,
+    const int height, const int width, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, float* weight_diff);
+template void grouped_conv_backward_weight_cpu<double>(const double* data_im,
+    const double* out_diff, const int num, const int channels,
+    const int height, const int width, const int num_output, const int group,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w, const int dilation_h,
+    const int dilation_w, double* weight_diff);
+
+}  // namespace caffe
@@ -1,15 +1,34 @@
 #include "caffe/util/hdf5.hpp"
 
+#include <boost/thread/recursive_mutex.hpp>
+
+#include <algorithm>
 #include <string>
 #include <vector>
 
 namespace caffe {
 
+static boost::recursive_mutex hdf5_mutex;
+
+HDF5Lock::HDF5Lock() {
+  hdf5_mutex.lock();
+}
+
+HDF5Lock::~HDF5Lock() {
+  hdf5_mutex.unlock();
+}
+
+bool hdf5_is_file(const string& filename) {
+  HDF5Lock lock;
+  return H5Fis_hdf5(filename.c_str()) > 0;
+}
+
 // Verifies format of data stored in HDF5 file and reshapes blob accordingly.
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
     Blob<Dtype>* blob, bool reshape) {
+  HDF5Lock lock;
   // Verify that the dataset exists.
   CHECK(H5LTfind_dataset(file_id, dataset_name_))
       << "Failed to find HDF5 dataset " << dataset_name_;
@@ -86,6 +105,7 @@ void hdf5_load_nd_dataset_helper(
 template <>
 void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<float>* blob, bool reshape) {
+  HDF5Lock lock;
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob,
                               reshape);
   herr_t status = H5LTread_dataset_float(
@@ -96,6 +116,7 @@ void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
 template <>
 void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<double>* blob, bool reshape) {
+  HDF5Lock lock;
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob,
                               reshape);
   herr_t status = H5LTread_dataset_double(
@@ -103,10 +124,80 @@ void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
   CHECK_GE(status, 0) << "Failed to read double dataset " << dataset_name_;
 }
 
+// Reads a hyperslab of whole rows of a dataset, converted to type.
+template <typename Dtype>
+static hsize_t hdf5_load_nd_dataset_rows_helper(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    hsize_t start, hsize_t count, hid_t type, Blob<Dtype>* blob) {
+  CHECK(H5LTfind_dataset(file_id, dataset_name_))
+      << "Failed to find HDF5 dataset " << dataset_name_;
+  int ndims;
+  herr_t status = H5LTget_dataset_ndims(file_id, dataset_name_, &ndims);
+  CHECK_GE(status, 0) << "Failed to get dataset ndims for " << dataset_name_;
+  CHECK_GE(ndims, std::max(min_dim, 1));
+  CHECK_LE(ndims, max_dim);
+  std::vector<hsize_t> dims(ndims);
+  H5T_class_t class_;
+  status = H5LTget_dataset_info(
+      file_id, dataset_name_, &dims[0], &class_, NULL);
+  CHECK_GE(status, 0) << "Failed to get dataset info for " << dataset_name_;
+  CHECK(class_ == H5T_FLOAT || class_ == H5T_INTEGER)
+      << "Unsupported datatype class of " << dataset_name_;
+  const hsize_t rows = dims[0];
+  CHECK_LT(start, rows) << "Row " << start << " is out of " << dataset_name_;
+  if (count == 0 || count > rows - start) {
+    count = rows - start;
+  }
+
+  vector<int> blob_dims(ndims);
+  for (int i = 0; i < ndims; ++i) {
+    blob_dims[i] = dims[i];
+  }
+  blob_dims[0] = count;
+  blob->Reshape(blob_dims);
+
+  hid_t dataset = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to open HDF5 dataset " << dataset_name_;
+  hid_t file_space = H5Dget_space(dataset);
+  std::vector<hsize_t> offset(ndims, 0);
+  offset[0] = start;
+  dims[0] = count;
+  status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &offset[0], NULL,
+      &dims[0], NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of " << dataset_name_;
+  hid_t memory_space = H5Screate_simple(ndims, &dims[0], NULL);
+  status = H5Dread(dataset, type, memory_space, file_space, H5P_DEFAULT,
+      blob->mutable_cpu_data());
+  CHECK_GE(status, 0) << "Failed to read rows of " << dataset_name_;
+  H5Sclose(memory_space);
+  H5Sclose(file_space);
+  H5Dclose(dataset);
+  return rows;
+}
+
+template <>
+hsize_t hdf5_load_nd_dataset_rows<float>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, hsize_t start,
+    hsize_t count, Blob<float>* blob) {
+  HDF5Lock lock;
+  return hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, min_dim,
+      max_dim, start, count, H5T_NATIVE_FLOAT, blob);
+}
+
+template <>
+hsize_t hdf5_load_nd_dataset_rows<double>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, hsize_t start,
+    hsize_t count, Blob<double>* blob) {
+  HDF5Lock lock;
+  return hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, min_dim,
+      max_dim, start, count, H5T_NATIVE_DOUBLE, blob);
+}
+
 template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
     bool write_diff) {
+  HDF5Lock lock;
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -128,6 +219,7 @@ template <>
 void hdf5_save_nd_dataset<double>(
     hid_t file_id, const string& dataset_name, const Blob<double>& blob,
     bool write_diff) {
+  HDF5Lock lock;
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -146,6 +238,7 @@ void hdf5_save_nd_dataset<double>(
 }
 
 string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
+  HDF5Lock lock;
   // Get size of dataset
   size_t size;
   H5T_class_t class_;
@@ -163,6 +256,7 @@ string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
 
 void hdf5_save_string(hid_t loc_id, const string& dataset_name,
                       const string& s) {
+  HDF5Lock lock;
   herr_t status = \
     H5LTmake_dataset_string(loc_id, dataset_name.c_str(), s.c_str());
   CHECK_GE(status, 0)
@@ -170,6 +264,7 @@ void hdf5_save_string(hid_t loc_id, const string& dataset_name,
 }
 
 int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
+  HDF5Lock lock;
   int val;
   herr_t status = H5LTread_dataset_int(loc_id, dataset_name.c_str(), &val);
   CHECK_GE(status, 0)
@@ -178,6 +273,7 @@ int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
 }
 
 void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
+  HDF5Lock lock;
   hsize_t one = 1;
   herr_t status = \
     H5LTmake_dataset_int(loc_id, dataset_name.c_str(), 1, &one, &i);
@@ -186,6 +282,7 @@ void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
 }
 
 int hdf5_get_num_links(hid_t loc_id) {
+  HDF5Lock lock;
   H5G_info_t info;
   herr_t status = H5Gget_info(loc_id, &info);
   CHECK_GE(status, 0) << "Error while counting HDF5 links.";
@@ -193,6 +290,7 @@ int hdf5_get_num_links(hid_t loc_id) {
 }
 
 string hdf5_get_name_by_idx(hid_t loc_id, int idx) {
+  HDF5Lock lock;
   ssize_t str_size = H5Lget_name_by_idx(
       loc_id, ".", H5_INDEX_NAME, H5_ITER_NATIVE, idx, NULL, 0, H5P_DEFAULT);
   CHECK_GE(str_size, 0) << "Error retrieving HDF5 dataset at index " << idx;
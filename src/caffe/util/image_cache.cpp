@@ -0,0 +1,324 @@
+#include <boost/functional/hash.hpp>
+#include <boost/interprocess/anonymous_shared_memory.hpp>
+#include <boost/interprocess/managed_external_buffer.hpp>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/image_cache.hpp"
+
+namespace caffe {
+
+namespace bip = boost::interprocess;
+
+// The local segment, in anonymous memory, uses the same allocator as the
+// shared one, so that both are used through the same segment manager.
+typedef bip::managed_shared_memory SharedSegment;
+typedef bip::basic_managed_external_buffer<char,
+    bip::rbtree_best_fit<bip::mutex_family>, bip::iset_index> LocalSegment;
+typedef SharedSegment::segment_manager SegmentManager;
+BOOST_STATIC_ASSERT((boost::is_same<SegmentManager,
+    LocalSegment::segment_manager>::value));
+
+// The number of entries is the capacity over this typical image size (a
+// 224 x 224 color image), so a cache of smaller images holds fewer bytes.
+static const size_t kTypicalImageBytes = 224 * 224 * 3;
+// Get and Put only hold the lock for a copy, so waiting longer than this
+// means that a process died while holding it.
+static const int kLockTimeoutSeconds = 30;
+
+struct ImageCache::Entry {
+  Entry() : hash(0), key_size(0), next_free(-1), used(false),
+      referenced(false) {
+    shape[0] = shape[1] = shape[2] = 0;
+  }
+
+  // The key followed by the image.
+  bip::offset_ptr<char> memory;
+  size_t hash;
+  int key_size;
+  int shape[3];
+  int next_free;
+  bool used;
+  bool referenced;
+
+  size_t image_bytes() const {
+    return static_cast<size_t>(shape[0]) * shape[1] * shape[2];
+  }
+};
+
+struct ImageCache::Header {
+  explicit Header(size_t capacity)
+      : capacity(capacity), bytes(0), size(0), hand(0), fresh(0),
+        free_head(-1), hits(0), misses(0), evictions(0) { }
+
+  bip::interprocess_mutex mutex;
+  uint64_t capacity;
+  uint64_t bytes;
+  int size;
+  // The clock hand, over the entries.
+  int hand;
+  // The entries from fresh on were never used; the others that are free
+  // are listed from free_head.
+  int fresh;
+  int free_head;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+};
+
+class ImageCache::Segment {
+ public:
+  SegmentManager* manager() {
+    return shared_ ? shared_->get_segment_manager()
+        : local_->get_segment_manager();
+  }
+
+  shared_ptr<SharedSegment> shared_;
+  shared_ptr<bip::mapped_region> region_;
+  shared_ptr<LocalSegment> local_;
+};
+
+static int NumEntries(size_t capacity) {
+  return std::max<size_t>(capacity / kTypicalImageBytes, 16);
+}
+
+// Locks the cache, or fails if it stays locked: interprocess_mutex is not
+// robust, so a process killed while holding it would block every other
+// user of the segment forever.
+class ImageCache::Lock {
+ public:
+  explicit Lock(const ImageCache& cache)
+      : lock_(cache.header_->mutex,
+              boost::posix_time::microsec_clock::universal_time() +
+              boost::posix_time::seconds(kLockTimeoutSeconds)) {
+    CHECK(lock_.owns()) << "Image cache " << cache.name_ << " stayed locked "
+        "for " << kLockTimeoutSeconds << " s; a process using it may have "
+        "died. Remove it with ImageCache::Remove, or delete /dev/shm/"
+        << cache.name_;
+  }
+
+ private:
+  bip::scoped_lock<bip::interprocess_mutex> lock_;
+};
+
+ImageCache::ImageCache(size_t capacity, const string& name)
+    : name_(name), segment_(new Segment()) {
+  CHECK_GT(capacity, 0) << "Image cache capacity must be positive";
+  int num_entries = NumEntries(capacity);
+  // The images, their keys and the bookkeeping, with room for allocation
+  // overheads.
+  const size_t segment_size = capacity + (1 << 20) + num_entries *
+      (sizeof(Entry) + 2 * sizeof(int) + 256 + 64);
+  if (name.empty()) {
+    // Anonymous memory is only committed as the cache fills up.
+    segment_->region_.reset(new bip::mapped_region(
+        bip::anonymous_shared_memory(segment_size)));
+    segment_->local_.reset(new LocalSegment(bip::create_only,
+        segment_->region_->get_address(), segment_->region_->get_size()));
+  } else {
+    try {
+      segment_->shared_.reset(new SharedSegment(bip::open_or_create,
+          name.c_str(), segment_size));
+    } catch (const bip::interprocess_exception& e) {
+      LOG(FATAL) << "Failed to open shared memory segment " << name << ": "
+          << e.what();
+    }
+  }
+  SegmentManager* manager = segment_->manager();
+  header_ = manager->find_or_construct<Header>("header")(capacity);
+  if (header_->capacity != capacity) {
+    LOG(WARNING) << "Image cache " << name << " has a capacity of "
+        << header_->capacity << " bytes, not " << capacity;
+  }
+  num_entries_ = NumEntries(header_->capacity);
+  entries_ = manager->find_or_construct<Entry>("entries")[num_entries_]();
+  index_size_ = 2 * num_entries_;
+  index_ = manager->find_or_construct<int>("index")[index_size_](-1);
+}
+
+ImageCache::~ImageCache() { }
+
+shared_ptr<ImageCache> ImageCache::Open(size_t capacity, const string& name) {
+  static boost::mutex mutex;
+  static std::map<std::pair<string, size_t>, boost::weak_ptr<ImageCache> >
+      caches;
+  boost::mutex::scoped_lock lock(mutex);
+  // A shared cache keeps the capacity it was created with, and the
+  // constructor warns about others; local caches of another capacity are
+  // distinct.
+  const std::pair<string, size_t> key(name, name.empty() ? capacity : 0);
+  shared_ptr<ImageCache> cache = caches[key].lock();
+  if (!cache) {
+    cache.reset(new ImageCache(capacity, name));
+    caches[key] = cache;
+  }
+  return cache;
+}
+
+void ImageCache::Remove(const string& name) {
+  bip::shared_memory_object::remove(name.c_str());
+}
+
+int ImageCache::Find(const string& key, size_t hash) const {
+  for (int i = hash % index_size_; index_[i] >= 0;
+       i = (i + 1) % index_size_) {
+    const Entry& entry = entries_[index_[i]];
+    if (entry.hash == hash && entry.key_size == key.size() &&
+        memcmp(entry.memory.get(), key.data(), key.size()) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void ImageCache::Evict() {
+  CHECK_GT(header_->size, 0);
+  for (;; header_->hand = (header_->hand + 1) % num_entries_) {
+    Entry& entry = entries_[header_->hand];
+    if (!entry.used) {
+      continue;
+    }
+    if (entry.referenced) {
+      entry.referenced = false;
+      continue;
+    }
+    const string key(entry.memory.get(), entry.key_size);
+    int i = Find(key, entry.hash);
+    CHECK_GE(i, 0);
+    // Shift back the following entries that would not be found past the
+    // hole otherwise.
+    for (int j = (i + 1) % index_size_; index_[j] >= 0;
+         j = (j + 1) % index_size_) {
+      const int home = entries_[index_[j]].hash % index_size_;
+      const bool stays = i <= j ? (i < home && home <= j)
+          : (i < home || home <= j);
+      if (!stays) {
+        index_[i] = index_[j];
+        i = j;
+      }
+    }
+    index_[i] = -1;
+    segment_->manager()->deallocate(entry.memory.get());
+    header_->bytes -= entry.image_bytes();
+    --header_->size;
+    ++header_->evictions;
+    entry.memory = NULL;
+    entry.used = false;
+    entry.next_free = header_->free_head;
+    header_->free_head = header_->hand;
+    header_->hand = (header_->hand + 1) % num_entries_;
+    return;
+  }
+}
+
+bool ImageCache::Get(const string& key, vector<int>* shape, string* data) {
+  const size_t hash = boost::hash_value(key);
+  Lock lock(*this);
+  const int i = Find(key, hash);
+  if (i < 0) {
+    ++header_->misses;
+    return false;
+  }
+  ++header_->hits;
+  Entry& entry = entries_[index_[i]];
+  entry.referenced = true;
+  shape->assign(entry.shape, entry.shape + 3);
+  data->assign(entry.memory.get() + entry.key_size, entry.image_bytes());
+  return true;
+}
+
+void ImageCache::Put(const string& key, const vector<int>& shape,
+    const char* data) {
+  CHECK_EQ(shape.size(), 3) << "Images must have shape (height, width, "
+      "channels)";
+  const size_t image_bytes = static_cast<size_t>(shape[0]) * shape[1] *
+      shape[2];
+  const size_t hash = boost::hash_value(key);
+  Lock lock(*this);
+  if (image_bytes > header_->capacity || Find(key, hash) >= 0) {
+    return;
+  }
+  while (header_->size > 0 && (header_->size == num_entries_ ||
+      header_->bytes + image_bytes > header_->capacity)) {
+    Evict();
+  }
+  SegmentManager* manager = segment_->manager();
+  char* memory = static_cast<char*>(
+      manager->allocate(key.size() + image_bytes, std::nothrow));
+  // The segment may be too fragmented even though there is capacity left.
+  while (!memory && header_->size > 0) {
+    Evict();
+    memory = static_cast<char*>(
+        manager->allocate(key.size() + image_bytes, std::nothrow));
+  }
+  if (!memory) {
+    return;
+  }
+  int e;
+  if (header_->free_head >= 0) {
+    e = header_->free_head;
+    header_->free_head = entries_[e].next_free;
+  } else {
+    e = header_->fresh++;
+  }
+  Entry& entry = entries_[e];
+  memcpy(memory, key.data(), key.size());
+  memcpy(memory + key.size(), data, image_bytes);
+  entry.memory = memory;
+  entry.hash = hash;
+  entry.key_size = key.size();
+  std::copy(shape.begin(), shape.end(), entry.shape);
+  entry.used = true;
+  entry.referenced = false;
+  int i = hash % index_size_;
+  while (index_[i] >= 0) {
+    i = (i + 1) % index_size_;
+  }
+  index_[i] = e;
+  header_->bytes += image_bytes;
+  ++header_->size;
+}
+
+size_t ImageCache::capacity() const { return header_->capacity; }
+
+int ImageCache::size() const {
+  Lock lock(*this);
+  return header_->size;
+}
+
+size_t ImageCache::bytes() const {
+  Lock lock(*this);
+  return header_->bytes;
+}
+
+uint64_t ImageCache::hits() const {
+  Lock lock(*this);
+  return header_->hits;
+}
+
+uint64_t ImageCache::misses() const {
+  Lock lock(*this);
+  return header_->misses;
+}
+
+uint64_t ImageCache::evictions() const {
+  Lock lock(*this);
+  return header_->evictions;
+}
+
+}  // namespace caffe
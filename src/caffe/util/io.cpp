@@ -116,15 +116,20 @@ static bool matchExt(const std::string & fn,
   return false;
 }
 
-bool ReadImageToDatum(const string& filename, const int label,
-    const int height, const int width, const bool is_color,
-    const std::string & encoding, Datum* datum) {
-  cv::Mat cv_img = ReadImageToCVMat(filename, height, width, is_color);
+// Stores an image read from filename in datum. With file_read, datum
+// already holds the contents of the file, as read by ReadFileToDatum.
+static bool ImageToDatum(const cv::Mat& cv_img, const string& filename,
+    const int label, const int height, const int width, const bool is_color,
+    const std::string & encoding, const bool file_read, Datum* datum) {
   if (cv_img.data) {
     if (encoding.size()) {
       if ( (cv_img.channels() == 3) == is_color && !height && !width &&
-          matchExt(filename, encoding) )
-        return ReadFileToDatum(filename, label, datum);
+          matchExt(filename, encoding) ) {
+        if (!file_read)
+          return ReadFileToDatum(filename, label, datum);
+        datum->set_label(label);
+        return true;
+      }
       std::vector<uchar> buf;
       cv::imencode("."+encoding, cv_img, buf);
       datum->set_data(std::string(reinterpret_cast<char*>(&buf[0]),
@@ -140,6 +145,28 @@ bool ReadImageToDatum(const string& filename, const int label,
     return false;
   }
 }
+
+bool ReadImageToDatum(const string& filename, const int label,
+    const int height, const int width, const bool is_color,
+    const std::string & encoding, Datum* datum) {
+  cv::Mat cv_img = ReadImageToCVMat(filename, height, width, is_color);
+  return ImageToDatum(cv_img, filename, label, height, width, is_color,
+                      encoding, false, datum);
+}
+
+bool DecodeImageToDatum(const string& filename, const int label,
+    const int height, const int width, const bool is_color,
+    const std::string & encoding, Datum* datum) {
+  cv::Mat cv_img;
+  cv::Mat cv_img_origin = DecodeDatumToCVMat(*datum, is_color);
+  if (cv_img_origin.data && height > 0 && width > 0) {
+    cv::resize(cv_img_origin, cv_img, cv::Size(width, height));
+  } else {
+    cv_img = cv_img_origin;
+  }
+  return ImageToDatum(cv_img, filename, label, height, width, is_color,
+                      encoding, true, datum);
+}
 #endif  // USE_OPENCV
 
 bool ReadFileToDatum(const string& filename, const int label,
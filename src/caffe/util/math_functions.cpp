@@ -1,10 +1,14 @@
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
 #include "caffe/common.hpp"
+#include "caffe/util/fast_math.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/philox.hpp"
 #include "caffe/util/rng.hpp"
 
 namespace caffe {
@@ -41,11 +45,19 @@ void caffe_cpu_gemm_batched<float>(const CBLAS_TRANSPOSE TransA,
   int strideA = M * K;
   int strideB = K * N;
   int strideC = M * N;
+#if defined(USE_MKL) && INTEL_MKL_VERSION >= 20200002
+  cblas_sgemm_batch_strided(CblasRowMajor, TransA, TransB, M, N, K,
+      alpha, A, lda, strideA, B, ldb, strideB, beta, C, N, strideC, count);
+#else
+#ifdef _OPENMP
+  #pragma omp parallel for if (count > 1)
+#endif
   for (int i = 0; i < count; i++) {
     cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K,
         alpha, A + i * strideA, lda, B + i * strideB, ldb,
         beta, C + i * strideC, N);
   }
+#endif
 }
 
 template<>
@@ -58,11 +70,19 @@ void caffe_cpu_gemm_batched<double>(const CBLAS_TRANSPOSE TransA,
   int strideA = M * K;
   int strideB = K * N;
   int strideC = M * N;
+#if defined(USE_MKL) && INTEL_MKL_VERSION >= 20200002
+  cblas_dgemm_batch_strided(CblasRowMajor, TransA, TransB, M, N, K,
+      alpha, A, lda, strideA, B, ldb, strideB, beta, C, N, strideC, count);
+#else
+#ifdef _OPENMP
+  #pragma omp parallel for if (count > 1)
+#endif
   for (int i = 0; i < count; i++) {
     cblas_dgemm(CblasRowMajor, TransA, TransB, M, N, K,
         alpha, A + i * strideA, lda, B + i * strideB, ldb,
         beta, C + i * strideC, N);
   }
+#endif
 }
 
 template <>
@@ -211,7 +231,11 @@ void caffe_div<double>(const int n, const double* a, const double* b,
 template <>
 void caffe_powx<float>(const int n, const float* a, const float b,
     float* y) {
+#ifdef USE_MKL
   vsPowx(n, a, b, y);
+#else
+  fast_powx(n, a, b, y);
+#endif
 }
 
 template <>
@@ -242,7 +266,11 @@ void caffe_sqrt<double>(const int n, const double* a, double* y) {
 
 template <>
 void caffe_exp<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
   vsExp(n, a, y);
+#else
+  fast_exp(n, a, y);
+#endif
 }
 
 template <>
@@ -252,7 +280,11 @@ void caffe_exp<double>(const int n, const double* a, double* y) {
 
 template <>
 void caffe_log<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
   vsLn(n, a, y);
+#else
+  fast_log(n, a, y);
+#endif
 }
 
 template <>
@@ -260,6 +292,34 @@ void caffe_log<double>(const int n, const double* a, double* y) {
   vdLn(n, a, y);
 }
 
+template <>
+void caffe_tanh<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
+  vsTanh(n, a, y);
+#else
+  fast_tanh(n, a, y);
+#endif
+}
+
+template <>
+void caffe_tanh<double>(const int n, const double* a, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = std::tanh(a[i]);
+  }
+}
+
+template <>
+void caffe_sigmoid<float>(const int n, const float* a, float* y) {
+  fast_sigmoid(n, a, y);
+}
+
+template <>
+void caffe_sigmoid<double>(const int n, const double* a, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = 0.5 * std::tanh(0.5 * a[i]) + 0.5;
+  }
+}
+
 template <>
 void caffe_abs<float>(const int n, const float* a, float* y) {
     vsAbs(n, a, y);
@@ -286,16 +346,65 @@ float caffe_nextafter(const float b);
 template
 double caffe_nextafter(const double b);
 
+// The caffe_rng_* fills draw a fresh Philox key from the per-thread Caffe rng
+// stream and then generate the values counter by counter. The output is cut
+// into fixed-size chunks that are independent of one another, so filling in
+// parallel gives the same values as filling serially for a given seed.
+static const int kRngChunkSize = 4096;
+
+static Philox caffe_rng_philox() {
+  const uint32_t key0 = caffe_rng_rand();
+  const uint32_t key1 = caffe_rng_rand();
+  return Philox(key0, key1);
+}
+
+// Fills words with the values [offset, offset + count) of the rng stream;
+// offset must fall on a block boundary and words must have room for count
+// rounded up to a whole number of blocks.
+static inline void caffe_rng_words(const Philox& rng, const uint64_t offset,
+    const int count, uint32_t* words) {
+  rng.Generate(offset / Philox::kBlockSize,
+      (count + Philox::kBlockSize - 1) / Philox::kBlockSize, words);
+}
+
+template <typename Dtype>
+inline Dtype caffe_rng_unit(const uint32_t* words);
+
+template <>
+inline float caffe_rng_unit<float>(const uint32_t* words) {
+  return philox_uniform_float(words[0]);
+}
+
+template <>
+inline double caffe_rng_unit<double>(const uint32_t* words) {
+  return philox_uniform_double(words[0], words[1]);
+}
+
 template <typename Dtype>
 void caffe_rng_uniform(const int n, const Dtype a, const Dtype b, Dtype* r) {
   CHECK_GE(n, 0);
   CHECK(r);
   CHECK_LE(a, b);
-  boost::uniform_real<Dtype> random_distribution(a, caffe_nextafter<Dtype>(b));
-  boost::variate_generator<caffe::rng_t*, boost::uniform_real<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = variate_generator();
+  const Philox rng = caffe_rng_philox();
+  // Number of 32-bit words consumed per value.
+  const int words_per_value = sizeof(Dtype) / sizeof(uint32_t);
+  // The values lie in the closed interval [a, b], as with the Boost
+  // generator: stretch [0, 1) past b, and round the excess down to b.
+  const Dtype range = caffe_nextafter<Dtype>(b) - a;
+  const int num_chunks = (n + kRngChunkSize - 1) / kRngChunkSize;
+#ifdef _OPENMP
+  #pragma omp parallel for if (num_chunks > 1)
+#endif
+  for (int c = 0; c < num_chunks; ++c) {
+    uint32_t words[2 * kRngChunkSize];
+    const int begin = c * kRngChunkSize;
+    const int len = std::min(kRngChunkSize, n - begin);
+    caffe_rng_words(rng, static_cast<uint64_t>(begin) * words_per_value,
+        len * words_per_value, words);
+    for (int i = 0; i < len; ++i) {
+      r[begin + i] = std::min(b, a + range *
+          caffe_rng_unit<Dtype>(words + i * words_per_value));
+    }
   }
 }
 
@@ -313,11 +422,33 @@ void caffe_rng_gaussian(const int n, const Dtype a,
   CHECK_GE(n, 0);
   CHECK(r);
   CHECK_GT(sigma, 0);
-  boost::normal_distribution<Dtype> random_distribution(a, sigma);
-  boost::variate_generator<caffe::rng_t*, boost::normal_distribution<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = variate_generator();
+  const Philox rng = caffe_rng_philox();
+  const int words_per_value = sizeof(Dtype) / sizeof(uint32_t);
+  const Dtype two_pi = Dtype(2 * M_PI);
+  const int num_chunks = (n + kRngChunkSize - 1) / kRngChunkSize;
+#ifdef _OPENMP
+  #pragma omp parallel for if (num_chunks > 1)
+#endif
+  for (int c = 0; c < num_chunks; ++c) {
+    uint32_t words[2 * kRngChunkSize];
+    const int begin = c * kRngChunkSize;
+    const int len = std::min(kRngChunkSize, n - begin);
+    // Box-Muller turns each pair of uniforms into a pair of normals; the
+    // chunk size is even, so an odd tail only happens at the very end.
+    const int padded_len = len + (len & 1);
+    caffe_rng_words(rng, static_cast<uint64_t>(begin) * words_per_value,
+        padded_len * words_per_value, words);
+    for (int i = 0; i < len; i += 2) {
+      const uint32_t* w = words + i * words_per_value;
+      // 1 - u lies in (0, 1], which keeps the log finite.
+      const Dtype u1 = Dtype(1) - caffe_rng_unit<Dtype>(w);
+      const Dtype u2 = caffe_rng_unit<Dtype>(w + words_per_value);
+      const Dtype radius = sigma * std::sqrt(Dtype(-2) * std::log(u1));
+      r[begin + i] = a + radius * std::cos(two_pi * u2);
+      if (i + 1 < len) {
+        r[begin + i + 1] = a + radius * std::sin(two_pi * u2);
+      }
+    }
   }
 }
 
@@ -329,20 +460,37 @@ template
 void caffe_rng_gaussian<double>(const int n, const double mu,
                                 const double sigma, double* r);
 
-template <typename Dtype>
-void caffe_rng_bernoulli(const int n, const Dtype p, int* r) {
+template <typename Dtype, typename Itype>
+static void caffe_rng_bernoulli_fill(const int n, const Dtype p, Itype* r) {
   CHECK_GE(n, 0);
   CHECK(r);
   CHECK_GE(p, 0);
   CHECK_LE(p, 1);
-  boost::bernoulli_distribution<Dtype> random_distribution(p);
-  boost::variate_generator<caffe::rng_t*, boost::bernoulli_distribution<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = variate_generator();
+  const Philox rng = caffe_rng_philox();
+  // r[i] = 1 iff the i-th 32-bit word falls below p * 2^32; p == 1 gives a
+  // threshold above every word.
+  const uint64_t threshold = static_cast<uint64_t>(
+      static_cast<double>(p) * 4294967296.0);
+  const int num_chunks = (n + kRngChunkSize - 1) / kRngChunkSize;
+#ifdef _OPENMP
+  #pragma omp parallel for if (num_chunks > 1)
+#endif
+  for (int c = 0; c < num_chunks; ++c) {
+    uint32_t words[kRngChunkSize];
+    const int begin = c * kRngChunkSize;
+    const int len = std::min(kRngChunkSize, n - begin);
+    caffe_rng_words(rng, begin, len, words);
+    for (int i = 0; i < len; ++i) {
+      r[begin + i] = static_cast<Itype>(words[i] < threshold);
+    }
   }
 }
 
+template <typename Dtype>
+void caffe_rng_bernoulli(const int n, const Dtype p, int* r) {
+  caffe_rng_bernoulli_fill(n, p, r);
+}
+
 template
 void caffe_rng_bernoulli<double>(const int n, const double p, int* r);
 
@@ -351,23 +499,99 @@ void caffe_rng_bernoulli<float>(const int n, const float p, int* r);
 
 template <typename Dtype>
 void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r) {
+  caffe_rng_bernoulli_fill(n, p, r);
+}
+
+template
+void caffe_rng_bernoulli<double>(const int n, const double p, unsigned int* r);
+
+template
+void caffe_rng_bernoulli<float>(const int n, const float p, unsigned int* r);
+
+template <typename Dtype>
+void caffe_rng_bernoulli_mask(const int n, const Dtype p, unsigned int* mask) {
   CHECK_GE(n, 0);
-  CHECK(r);
+  CHECK(mask);
   CHECK_GE(p, 0);
   CHECK_LE(p, 1);
-  boost::bernoulli_distribution<Dtype> random_distribution(p);
-  boost::variate_generator<caffe::rng_t*, boost::bernoulli_distribution<Dtype> >
-      variate_generator(caffe_rng(), random_distribution);
-  for (int i = 0; i < n; ++i) {
-    r[i] = static_cast<unsigned int>(variate_generator());
+  const Philox rng = caffe_rng_philox();
+  const uint64_t threshold = static_cast<uint64_t>(
+      static_cast<double>(p) * 4294967296.0);
+  const int num_chunks = (n + kRngChunkSize - 1) / kRngChunkSize;
+#ifdef _OPENMP
+  #pragma omp parallel for if (num_chunks > 1)
+#endif
+  for (int c = 0; c < num_chunks; ++c) {
+    uint32_t words[kRngChunkSize];
+    const int begin = c * kRngChunkSize;
+    const int len = std::min(kRngChunkSize, n - begin);
+    caffe_rng_words(rng, begin, len, words);
+    // The chunk size is a multiple of 32, so chunks own whole mask words.
+    unsigned int* chunk_mask = mask + begin / 32;
+    for (int w = 0; w < caffe_mask_words(len); ++w) {
+      const int bits = std::min(32, len - w * 32);
+      unsigned int packed = 0;
+      for (int b = 0; b < bits; ++b) {
+        packed |= static_cast<unsigned int>(words[w * 32 + b] < threshold) << b;
+      }
+      chunk_mask[w] = packed;
+    }
   }
 }
 
 template
-void caffe_rng_bernoulli<double>(const int n, const double p, unsigned int* r);
+void caffe_rng_bernoulli_mask<float>(const int n, const float p,
+                                     unsigned int* mask);
 
 template
-void caffe_rng_bernoulli<float>(const int n, const float p, unsigned int* r);
+void caffe_rng_bernoulli_mask<double>(const int n, const double p,
+                                      unsigned int* mask);
+
+template <typename Dtype>
+void caffe_cpu_positive_mask(const int n, const Dtype* x, unsigned int* mask) {
+  const int num_words = caffe_mask_words(n);
+  for (int w = 0; w < num_words; ++w) {
+    const Dtype* xw = x + w * 32;
+    const int bits = std::min(32, n - w * 32);
+    unsigned int packed = 0;
+    for (int b = 0; b < bits; ++b) {
+      packed |= static_cast<unsigned int>(xw[b] > Dtype(0)) << b;
+    }
+    mask[w] = packed;
+  }
+}
+
+template
+void caffe_cpu_positive_mask<float>(const int n, const float* x,
+                                    unsigned int* mask);
+
+template
+void caffe_cpu_positive_mask<double>(const int n, const double* x,
+                                     unsigned int* mask);
+
+template <typename Dtype>
+void caffe_cpu_mask_scale(const int n, const unsigned int* mask,
+    const Dtype* x, const Dtype on, const Dtype off, Dtype* y) {
+  const int num_words = caffe_mask_words(n);
+  const Dtype delta = on - off;
+  for (int w = 0; w < num_words; ++w) {
+    const unsigned int packed = mask[w];
+    const Dtype* xw = x + w * 32;
+    Dtype* yw = y + w * 32;
+    const int bits = std::min(32, n - w * 32);
+    for (int b = 0; b < bits; ++b) {
+      yw[b] = xw[b] * (off + delta * static_cast<Dtype>((packed >> b) & 1));
+    }
+  }
+}
+
+template
+void caffe_cpu_mask_scale<float>(const int n, const unsigned int* mask,
+    const float* x, const float on, const float off, float* y);
+
+template
+void caffe_cpu_mask_scale<double>(const int n, const unsigned int* mask,
+    const double* x, const double on, const double off, double* y);
 
 template <>
 float caffe_cpu_strided_dot<float>(const int n, const float* x, const int incx,
@@ -0,0 +1,133 @@
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/packed_gemm.hpp"
+
+// The pack/compute API appeared in MKL 2017.
+#if defined(USE_MKL) && INTEL_MKL_VERSION >= 20170000
+#define CAFFE_MKL_GEMM_PACK
+#endif
+
+namespace caffe {
+
+#ifdef CAFFE_MKL_GEMM_PACK
+
+template <typename Dtype>
+size_t caffe_cpu_gemm_pack_size(const CBLAS_IDENTIFIER identifier,
+    const int M, const int N, const int K);
+
+template <>
+size_t caffe_cpu_gemm_pack_size<float>(const CBLAS_IDENTIFIER identifier,
+    const int M, const int N, const int K) {
+  return cblas_sgemm_pack_get_size(identifier, M, N, K);
+}
+
+template <>
+size_t caffe_cpu_gemm_pack_size<double>(const CBLAS_IDENTIFIER identifier,
+    const int M, const int N, const int K) {
+  return cblas_dgemm_pack_get_size(identifier, M, N, K);
+}
+
+inline void caffe_cpu_gemm_pack(const CBLAS_IDENTIFIER identifier,
+    const CBLAS_TRANSPOSE trans, const int M, const int N, const int K,
+    const float* src, const int ld, float* dest) {
+  cblas_sgemm_pack(CblasRowMajor, identifier, trans, M, N, K, 1.f, src, ld,
+      dest);
+}
+
+inline void caffe_cpu_gemm_pack(const CBLAS_IDENTIFIER identifier,
+    const CBLAS_TRANSPOSE trans, const int M, const int N, const int K,
+    const double* src, const int ld, double* dest) {
+  cblas_dgemm_pack(CblasRowMajor, identifier, trans, M, N, K, 1., src, ld,
+      dest);
+}
+
+inline void caffe_cpu_gemm_compute(const MKL_INT transA, const MKL_INT transB,
+    const int M, const int N, const int K, const float* A, const int lda,
+    const float* B, const int ldb, float* C) {
+  cblas_sgemm_compute(CblasRowMajor, transA, transB, M, N, K, A, lda, B, ldb,
+      0.f, C, N);
+}
+
+inline void caffe_cpu_gemm_compute(const MKL_INT transA, const MKL_INT transB,
+    const int M, const int N, const int K, const double* A, const int lda,
+    const double* B, const int ldb, double* C) {
+  cblas_dgemm_compute(CblasRowMajor, transA, transB, M, N, K, A, lda, B, ldb,
+      0., C, N);
+}
+
+#endif  // CAFFE_MKL_GEMM_PACK
+
+template <typename Dtype>
+PackedGemm<Dtype>::PackedGemm(bool weights_left,
+    CBLAS_TRANSPOSE trans_weights)
+    : weights_left_(weights_left), trans_weights_(trans_weights),
+      source_version_(0), offset_(0), M_(0), N_(0), K_(0), packed_(NULL) {}
+
+template <typename Dtype>
+PackedGemm<Dtype>::~PackedGemm() {
+#ifdef CAFFE_MKL_GEMM_PACK
+  if (packed_) {
+    mkl_free(packed_);
+  }
+#endif
+}
+
+template <typename Dtype>
+void PackedGemm<Dtype>::Gemm(const int M, const int N, const int K,
+    const Blob<Dtype>& weights, const int offset, const Dtype* X, Dtype* C) {
+  const Dtype* W = weights.cpu_data() + offset;
+#ifdef CAFFE_MKL_GEMM_PACK
+  const shared_ptr<SyncedMemory>& source = weights.data();
+  if (source_ != source || source_version_ != source->version() ||
+      offset_ != offset || M_ != M || N_ != N || K_ != K) {
+    Pack(M, N, K, W);
+    source_ = source;
+    source_version_ = source->version();
+    offset_ = offset;
+  }
+  if (weights_left_) {
+    caffe_cpu_gemm_compute(CblasPacked, CblasNoTrans, M, N, K, packed_, K,
+        X, N, C);
+  } else {
+    caffe_cpu_gemm_compute(CblasNoTrans, CblasPacked, M, N, K, X, K,
+        packed_, N, C);
+  }
+#else
+  if (weights_left_) {
+    caffe_cpu_gemm<Dtype>(trans_weights_, CblasNoTrans, M, N, K, Dtype(1),
+        W, X, Dtype(0), C);
+  } else {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, trans_weights_, M, N, K, Dtype(1),
+        X, W, Dtype(0), C);
+  }
+#endif
+}
+
+template <typename Dtype>
+void PackedGemm<Dtype>::Pack(const int M, const int N, const int K,
+    const Dtype* W) {
+#ifdef CAFFE_MKL_GEMM_PACK
+  if (packed_) {
+    mkl_free(packed_);
+  }
+  const CBLAS_IDENTIFIER identifier =
+      weights_left_ ? CblasAMatrix : CblasBMatrix;
+  // Leading dimension of op(W) as stored, i.e. before transposition.
+  int ld;
+  if (weights_left_) {
+    ld = (trans_weights_ == CblasNoTrans) ? K : M;
+  } else {
+    ld = (trans_weights_ == CblasNoTrans) ? N : K;
+  }
+  packed_ = static_cast<Dtype*>(mkl_malloc(
+      caffe_cpu_gemm_pack_size<Dtype>(identifier, M, N, K), 64));
+  CHECK(packed_) << "Failed to allocate the packed GEMM operand";
+  caffe_cpu_gemm_pack(identifier, trans_weights_, M, N, K, W, ld, packed_);
+  M_ = M;
+  N_ = N;
+  K_ = K;
+#endif
+}
+
+INSTANTIATE_CLASS(PackedGemm);
+
+}  // namespace caffe
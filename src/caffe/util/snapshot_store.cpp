@@ -0,0 +1,306 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstdlib>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/util/io.hpp"
+#include "caffe/util/snapshot_store.hpp"
+
+namespace caffe {
+
+namespace fs = boost::filesystem;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fmix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+// MurmurHash3_x64_128 of len bytes, seeded with and updating the state h, so
+// that several buffers can be hashed in sequence.
+static void Hash128(const void* key, size_t len, uint64_t* h) {
+  const uint8_t* data = static_cast<const uint8_t*>(key);
+  const size_t nblocks = len / 16;
+  const uint64_t c1 = 0x87c37b91114253d5ULL;
+  const uint64_t c2 = 0x4cf5ad432745937fULL;
+  uint64_t h1 = h[0];
+  uint64_t h2 = h[1];
+  for (size_t i = 0; i < nblocks; ++i) {
+    uint64_t k1, k2;
+    memcpy(&k1, data + i * 16, 8);  // NOLINT(caffe/alt_fn)
+    memcpy(&k2, data + i * 16 + 8, 8);  // NOLINT(caffe/alt_fn)
+    k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+    k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+  }
+  const uint8_t* tail = data + nblocks * 16;
+  const int rem = len & 15;
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+  for (int i = rem - 1; i >= 8; --i) {
+    k2 ^= static_cast<uint64_t>(tail[i]) << ((i - 8) * 8);
+  }
+  if (rem > 8) {
+    k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+  }
+  for (int i = std::min(rem, 8) - 1; i >= 0; --i) {
+    k1 ^= static_cast<uint64_t>(tail[i]) << (i * 8);
+  }
+  if (rem > 0) {
+    k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+  }
+  h1 ^= len;
+  h2 ^= len;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+  h1 += h2;
+  h2 += h1;
+  h[0] = h1;
+  h[1] = h2;
+}
+
+SnapshotStore::SnapshotStore(const string& directory)
+    : directory_(directory) {
+  ResetStats();
+}
+
+string SnapshotStore::ChunkFilename(const string& id) const {
+  return (fs::path(directory_) / id).string();
+}
+
+template <typename Dtype>
+string SnapshotStore::Put(const Blob<Dtype>& blob, bool write_diff) {
+  uint64_t h[2] = {sizeof(Dtype), write_diff};
+  const vector<int>& shape = blob.shape();
+  if (shape.size()) {
+    Hash128(&shape[0], shape.size() * sizeof(int), h);
+  }
+  if (blob.count()) {
+    Hash128(blob.cpu_data(), blob.count() * sizeof(Dtype), h);
+    if (write_diff) {
+      Hash128(blob.cpu_diff(), blob.count() * sizeof(Dtype), h);
+    }
+  }
+  std::ostringstream id;
+  id << std::hex << std::setfill('0') << std::setw(16) << h[0]
+     << std::setw(16) << h[1];
+  const string filename = ChunkFilename(id.str());
+  if (fs::exists(filename)) {
+    ++chunks_reused_;
+    return id.str();
+  }
+  if (!fs::exists(directory_)) {
+    CHECK(fs::create_directories(directory_))
+        << "Couldn't create snapshot store " << directory_;
+  }
+  BlobProto proto;
+  blob.ToRawProto(&proto, write_diff);
+  string bytes;
+  CHECK(proto.SerializeToString(&bytes));
+  // Write under a temporary name, so that an interrupted write never leaves
+  // a truncated chunk behind under its id.
+  const string temp_filename = filename + ".tmp";
+  std::ofstream output(temp_filename.c_str(),
+      std::ios::out | std::ios::trunc | std::ios::binary);
+  output.write(bytes.data(), bytes.size());
+  output.close();
+  CHECK(output.good()) << "Couldn't write snapshot chunk " << temp_filename;
+  fs::rename(temp_filename, filename);
+  ++chunks_written_;
+  bytes_written_ += bytes.size();
+  return id.str();
+}
+
+template string SnapshotStore::Put(const Blob<float>& blob, bool write_diff);
+template string SnapshotStore::Put(const Blob<double>& blob, bool write_diff);
+
+void SnapshotStore::Get(const string& id, BlobProto* proto) const {
+  const string filename = ChunkFilename(id);
+  std::ifstream input(filename.c_str(), std::ios::in | std::ios::binary);
+  CHECK(input.good()) << "Missing snapshot chunk " << filename;
+  std::ostringstream bytes;
+  bytes << input.rdbuf();
+  CHECK(proto->ParseFromString(bytes.str()))
+      << "Corrupt snapshot chunk " << filename;
+}
+
+void SnapshotStore::CollectGarbage(const vector<SnapshotManifest>& manifests) {
+  std::set<string> used;
+  for (int i = 0; i < manifests.size(); ++i) {
+    const SnapshotManifest& manifest = manifests[i];
+    for (int j = 0; j < manifest.layer_size(); ++j) {
+      used.insert(manifest.layer(j).chunk().begin(),
+          manifest.layer(j).chunk().end());
+    }
+    used.insert(manifest.history().begin(), manifest.history().end());
+  }
+  if (!fs::exists(directory_)) {
+    return;
+  }
+  int removed = 0;
+  for (fs::directory_iterator it(directory_), end; it != end; ++it) {
+    if (!used.count(it->path().filename().string())) {
+      fs::remove(it->path());
+      ++removed;
+    }
+  }
+  if (removed) {
+    LOG(INFO) << "Removed " << removed << " unused chunks from snapshot store "
+        << directory_;
+  }
+}
+
+void SnapshotStore::ResetStats() {
+  chunks_written_ = 0;
+  bytes_written_ = 0;
+  chunks_reused_ = 0;
+}
+
+// The components of the absolute path, without the "." ones.
+static vector<string> PathComponents(const fs::path& path) {
+  const fs::path absolute = fs::absolute(path);
+  vector<string> components;
+  for (fs::path::const_iterator it = absolute.begin(); it != absolute.end();
+       ++it) {
+    if (it->string() != ".") {
+      components.push_back(it->string());
+    }
+  }
+  return components;
+}
+
+void SetManifestStore(const SnapshotStore& store, const string& filename,
+    SnapshotManifest* manifest) {
+  const vector<string> base =
+      PathComponents(fs::path(filename).parent_path());
+  const vector<string> directory = PathComponents(store.directory());
+  int common = 0;
+  while (common < base.size() && common < directory.size() &&
+         base[common] == directory[common]) {
+    ++common;
+  }
+  fs::path relative;
+  for (int i = common; i < base.size(); ++i) {
+    relative /= "..";
+  }
+  for (int i = common; i < directory.size(); ++i) {
+    relative /= directory[i];
+  }
+  manifest->set_store(relative.empty() ? "." : relative.string());
+}
+
+string ManifestStoreDirectory(const SnapshotManifest& manifest,
+    const string& filename) {
+  const fs::path store(manifest.store());
+  if (store.is_absolute()) {
+    return store.string();
+  }
+  return (fs::path(filename).parent_path() / store).string();
+}
+
+template <typename Dtype>
+void WriteNetToSnapshotStore(const Net<Dtype>& net, bool write_diff,
+    SnapshotStore* store, const string& filename) {
+  SnapshotManifest manifest;
+  SetManifestStore(*store, filename, &manifest);
+  for (int i = 0; i < net.layers().size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs = net.layers()[i]->blobs();
+    if (blobs.empty()) {
+      continue;
+    }
+    SnapshotManifest_Layer* layer = manifest.add_layer();
+    layer->set_name(net.layer_names()[i]);
+    for (int j = 0; j < blobs.size(); ++j) {
+      layer->add_chunk(store->Put(*blobs[j], write_diff));
+    }
+  }
+  WriteProtoToBinaryFile(manifest, filename);
+}
+
+template void WriteNetToSnapshotStore(const Net<float>& net, bool write_diff,
+    SnapshotStore* store, const string& filename);
+template void WriteNetToSnapshotStore(const Net<double>& net, bool write_diff,
+    SnapshotStore* store, const string& filename);
+
+void ReadNetParamsFromSnapshotStoreOrDie(const string& filename,
+    NetParameter* param) {
+  SnapshotManifest manifest;
+  CHECK(ReadProtoFromBinaryFile(filename, &manifest))
+      << "Failed to parse snapshot manifest " << filename;
+  const SnapshotStore store(ManifestStoreDirectory(manifest, filename));
+  param->Clear();
+  for (int i = 0; i < manifest.layer_size(); ++i) {
+    LayerParameter* layer = param->add_layer();
+    layer->set_name(manifest.layer(i).name());
+    for (int j = 0; j < manifest.layer(i).chunk_size(); ++j) {
+      store.Get(manifest.layer(i).chunk(j), layer->add_blobs());
+    }
+  }
+}
+
+void RetainSnapshots(const string& snapshot_prefix, int keep,
+    SnapshotStore* store) {
+  if (keep <= 0) {
+    return;
+  }
+  // The prefix may end with a separator, making the file names "_iter_*".
+  const size_t separator = snapshot_prefix.find_last_of('/');
+  const fs::path directory = separator == string::npos ? fs::path(".") :
+      fs::path(snapshot_prefix.substr(0, separator + 1));
+  const string stem = snapshot_prefix.substr(separator + 1) + "_iter_";
+  const string suffix = ".solverstate.manifest";
+  // The solver state manifests of the run, by iteration.
+  std::map<int, string> states;
+  for (fs::directory_iterator it(directory), end; it != end; ++it) {
+    const string name = it->path().filename().string();
+    if (name.size() > stem.size() + suffix.size() &&
+        name.compare(0, stem.size(), stem) == 0 &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+      const int iter = atoi(name.substr(stem.size()).c_str());
+      states[iter] = it->path().string();
+    }
+  }
+  if (states.size() <= keep) {
+    return;
+  }
+  int to_remove = states.size() - keep;
+  vector<SnapshotManifest> kept;
+  for (std::map<int, string>::const_iterator it = states.begin();
+       it != states.end(); ++it, --to_remove) {
+    SnapshotManifest state;
+    CHECK(ReadProtoFromBinaryFile(it->second, &state))
+        << "Failed to parse snapshot manifest " << it->second;
+    if (to_remove > 0) {
+      LOG(INFO) << "Removing snapshot " << it->second;
+      fs::remove(it->second);
+      fs::remove(state.learned_net());
+      continue;
+    }
+    kept.push_back(state);
+    kept.push_back(SnapshotManifest());
+    CHECK(ReadProtoFromBinaryFile(state.learned_net(), &kept.back()))
+        << "Failed to parse snapshot manifest " << state.learned_net();
+  }
+  store->CollectGarbage(kept);
+}
+
+}  // namespace caffe
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "caffe/util/sparse_weights.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+SparseWeights<Dtype>::SparseWeights(const string& name, bool transposed,
+    float threshold)
+    : name_(name), transposed_(transposed), threshold_(threshold),
+      source_version_(0), rows_(0), cols_(0), sparsity_(0), sparse_(false) {}
+
+template <typename Dtype>
+bool SparseWeights<Dtype>::Update(const Blob<Dtype>& weights) {
+  const shared_ptr<SyncedMemory>& source = weights.data();
+  if (source_ == source && source_version_ == source->version()) {
+    return sparse_;
+  }
+  const Dtype* data = weights.cpu_data();
+  const int count = weights.count();
+  const int outer = weights.shape(0);
+  const int inner = count / outer;
+  rows_ = transposed_ ? inner : outer;
+  cols_ = transposed_ ? outer : inner;
+  int nonzeros = 0;
+  for (int i = 0; i < count; ++i) {
+    nonzeros += (data[i] != Dtype(0));
+  }
+  const bool first = !source_;
+  const bool was_sparse = sparse_;
+  sparsity_ = count > 0 ? 1.f - static_cast<float>(nonzeros) / count : 0.f;
+  sparse_ = sparsity_ >= threshold_;
+  row_start_.clear();
+  col_index_.clear();
+  values_.clear();
+  if (sparse_) {
+    row_start_.reserve(rows_ + 1);
+    col_index_.reserve(nonzeros);
+    values_.reserve(nonzeros);
+    for (int r = 0; r < rows_; ++r) {
+      row_start_.push_back(col_index_.size());
+      for (int c = 0; c < cols_; ++c) {
+        const Dtype value = transposed_ ? data[c * rows_ + r] :
+            data[r * cols_ + c];
+        if (value != Dtype(0)) {
+          col_index_.push_back(c);
+          values_.push_back(value);
+        }
+      }
+    }
+    row_start_.push_back(col_index_.size());
+  }
+  source_ = source;
+  source_version_ = source->version();
+  if (first || sparse_ != was_sparse) {
+    LOG(INFO) << name_ << ": weight sparsity " << 100 * sparsity_
+        << "%, using the " << (sparse_ ? "sparse" : "dense") << " path";
+  }
+  return sparse_;
+}
+
+template <typename Dtype>
+void SparseWeights<Dtype>::MultiplyLeft(const int N, const int group,
+    const Dtype* B, Dtype* C) const {
+  CHECK(sparse_);
+  const int rows_per_group = rows_ / group;
+  // Work on blocks of columns so that the rows of B they use stay in cache
+  // while all the output rows are computed.
+  const int block = 256;
+  const int blocks = (N + block - 1) / block;
+#ifdef _OPENMP
+  #pragma omp parallel for
+#endif
+  for (int index = 0; index < blocks * rows_; ++index) {
+    const int r = index % rows_;
+    const int begin = index / rows_ * block;
+    const int end = std::min(begin + block, N);
+    const Dtype* b = B + r / rows_per_group * cols_ * N;
+    Dtype* c = C + r * N;
+    for (int n = begin; n < end; ++n) {
+      c[n] = 0;
+    }
+    for (int i = row_start_[r]; i < row_start_[r + 1]; ++i) {
+      const Dtype value = values_[i];
+      const Dtype* b_row = b + col_index_[i] * N;
+      for (int n = begin; n < end; ++n) {
+        c[n] += value * b_row[n];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void SparseWeights<Dtype>::MultiplyRight(const int M, const Dtype* X,
+    Dtype* C) const {
+  CHECK(sparse_);
+  if (M == 1) {
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int r = 0; r < rows_; ++r) {
+      Dtype sum = 0;
+      for (int i = row_start_[r]; i < row_start_[r + 1]; ++i) {
+        sum += values_[i] * X[col_index_[i]];
+      }
+      C[r] = sum;
+    }
+    return;
+  }
+  // With several inputs, transpose X so that each weight scales a contiguous
+  // run of M values. The scratch space is per call, so that layers sharing
+  // these weights can run at the same time.
+  std::vector<Dtype> input_t(M * cols_);
+  for (int m = 0; m < M; ++m) {
+    for (int c = 0; c < cols_; ++c) {
+      input_t[c * M + m] = X[m * cols_ + c];
+    }
+  }
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  std::vector<Dtype> sums(threads * M);
+#ifdef _OPENMP
+  #pragma omp parallel
+#endif
+  {
+    int thread = 0;
+#ifdef _OPENMP
+    thread = omp_get_thread_num();
+#endif
+    Dtype* sum = &sums[thread * M];
+#ifdef _OPENMP
+    #pragma omp for
+#endif
+    for (int r = 0; r < rows_; ++r) {
+      std::fill(sum, sum + M, Dtype(0));
+      for (int i = row_start_[r]; i < row_start_[r + 1]; ++i) {
+        const Dtype value = values_[i];
+        const Dtype* x = &input_t[col_index_[i] * M];
+        for (int m = 0; m < M; ++m) {
+          sum[m] += value * x[m];
+        }
+      }
+      for (int m = 0; m < M; ++m) {
+        C[m * rows_ + r] = sum[m];
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(SparseWeights);
+
+}  // namespace caffe
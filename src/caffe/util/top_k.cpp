@@ -0,0 +1,203 @@
+#include <algorithm>
+
+#include "caffe/common.hpp"
+#include "caffe/util/top_k.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Up to this k, the selection is kept sorted by insertion; beyond it in a
+// heap, whose updates cost log(k) instead of k.
+const int kMaxSortedTopK = 16;
+// Rows are scanned in blocks of this many values, skipping the blocks whose
+// maximum does not reach the current selection.
+const int kBlock = 64;
+
+// Whether (a, i) comes before (b, j).
+template <typename Dtype>
+inline bool before(const Dtype a, const int i, const Dtype b, const int j) {
+  return a > b || (a == b && i > j);
+}
+
+// The maximum of count > 0 values, kept in independent lanes so that the
+// scan vectorizes for contiguous rows. NaNs are skipped unless first.
+template <typename Dtype>
+Dtype max_of(const Dtype* x, const int stride, const int count) {
+  const int kLanes = 8;
+  Dtype lanes[kLanes];
+  for (int l = 0; l < kLanes; ++l) {
+    lanes[l] = x[0];
+  }
+  int i = 0;
+  for (; i + kLanes <= count; i += kLanes) {
+    for (int l = 0; l < kLanes; ++l) {
+      const Dtype value = x[(i + l) * stride];
+      lanes[l] = value > lanes[l] ? value : lanes[l];
+    }
+  }
+  for (; i < count; ++i) {
+    const Dtype value = x[i * stride];
+    lanes[0] = value > lanes[0] ? value : lanes[0];
+  }
+  Dtype max_value = lanes[0];
+  for (int l = 1; l < kLanes; ++l) {
+    max_value = lanes[l] > max_value ? lanes[l] : max_value;
+  }
+  return max_value;
+}
+
+template <typename Dtype>
+void top_1(const int n, const Dtype* x, const int stride, Dtype* value,
+    int* index) {
+  // Find the maximum, then the last index holding it.
+  const Dtype max_value = max_of(x, stride, n);
+  int best = n - 1;
+  for (; best > 0 && !(x[best * stride] == max_value); --best) {}
+  if (!(x[best * stride] == x[best * stride])) {
+    // NaNs, which max_of skips over.
+    best = 0;
+    for (int i = 1; i < n; ++i) {
+      if (!before(x[best * stride], best, x[i * stride], i)) {
+        best = i;
+      }
+    }
+  }
+  *value = x[best * stride];
+  *index = best;
+}
+
+// Keeps values and indices sorted, the k-th entry being the threshold a
+// value must pass to enter.
+template <typename Dtype>
+void insert_sorted(const Dtype value, const int index, const int size,
+    const int k, Dtype* values, int* indices) {
+  int position = size;
+  for (; position > 0 &&
+       before(value, index, values[position - 1], indices[position - 1]);
+       --position) {
+    if (position < k) {
+      values[position] = values[position - 1];
+      indices[position] = indices[position - 1];
+    }
+  }
+  if (position < k) {
+    values[position] = value;
+    indices[position] = index;
+  }
+}
+
+template <typename Dtype>
+void top_k_sorted(const int n, const Dtype* x, const int stride, const int k,
+    Dtype* values, int* indices) {
+  for (int i = 0; i < k; ++i) {
+    insert_sorted(x[i * stride], i, i, k, values, indices);
+  }
+  for (int start = k; start < n; start += kBlock) {
+    const int end = std::min(start + kBlock, n);
+    // Later indices win ties, so values equal to the threshold enter too.
+    if (max_of(x + start * stride, stride, end - start) < values[k - 1]) {
+      continue;
+    }
+    for (int i = start; i < end; ++i) {
+      insert_sorted(x[i * stride], i, k, k, values, indices);
+    }
+  }
+}
+
+// Restores the heap property below root, in a heap of size entries whose
+// root is the entry that comes last.
+template <typename Dtype>
+void sift_down(int root, const int size, Dtype* values, int* indices) {
+  const Dtype value = values[root];
+  const int index = indices[root];
+  for (int child = 2 * root + 1; child < size; child = 2 * root + 1) {
+    if (child + 1 < size && before(values[child], indices[child],
+                                   values[child + 1], indices[child + 1])) {
+      ++child;
+    }
+    if (!before(value, index, values[child], indices[child])) {
+      break;
+    }
+    values[root] = values[child];
+    indices[root] = indices[child];
+    root = child;
+  }
+  values[root] = value;
+  indices[root] = index;
+}
+
+// Keeps the selection in a heap with the entry to replace next at the root,
+// then sorts it in place.
+template <typename Dtype>
+void top_k_heap(const int n, const Dtype* x, const int stride, const int k,
+    Dtype* values, int* indices) {
+  for (int i = 0; i < k; ++i) {
+    values[i] = x[i * stride];
+    indices[i] = i;
+  }
+  for (int i = k / 2 - 1; i >= 0; --i) {
+    sift_down(i, k, values, indices);
+  }
+  for (int start = k; start < n; start += kBlock) {
+    const int end = std::min(start + kBlock, n);
+    if (max_of(x + start * stride, stride, end - start) < values[0]) {
+      continue;
+    }
+    for (int i = start; i < end; ++i) {
+      const Dtype value = x[i * stride];
+      if (before(value, i, values[0], indices[0])) {
+        values[0] = value;
+        indices[0] = i;
+        sift_down(0, k, values, indices);
+      }
+    }
+  }
+  for (int size = k - 1; size > 0; --size) {
+    std::swap(values[0], values[size]);
+    std::swap(indices[0], indices[size]);
+    sift_down(0, size, values, indices);
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_cpu_top_k(const int n, const Dtype* x, const int stride,
+    const int k, Dtype* values, int* indices) {
+  CHECK_GE(k, 1);
+  CHECK_LE(k, n);
+  if (k == 1) {
+    top_1(n, x, stride, values, indices);
+  } else if (k <= kMaxSortedTopK) {
+    top_k_sorted(n, x, stride, k, values, indices);
+  } else {
+    top_k_heap(n, x, stride, k, values, indices);
+  }
+}
+
+template void caffe_cpu_top_k<float>(const int n, const float* x,
+    const int stride, const int k, float* values, int* indices);
+template void caffe_cpu_top_k<double>(const int n, const double* x,
+    const int stride, const int k, double* values, int* indices);
+
+template <typename Dtype>
+int caffe_cpu_rank(const int n, const Dtype* x, const int stride,
+    const int index) {
+  const Dtype value = x[index * stride];
+  int rank = 0;
+  for (int i = 0; i < index; ++i) {
+    rank += x[i * stride] > value;
+  }
+  for (int i = index + 1; i < n; ++i) {
+    rank += x[i * stride] >= value;
+  }
+  return rank;
+}
+
+template int caffe_cpu_rank<float>(const int n, const float* x,
+    const int stride, const int index);
+template int caffe_cpu_rank<double>(const int n, const double* x,
+    const int stride, const int index);
+
+}  // namespace caffe
@@ -30,6 +30,10 @@ DEFINE_string(gpu, "",
     "Optional; run in GPU mode on given device IDs separated by ','."
     "Use '-gpu all' to run on all available GPUs. The effective training "
     "batch size is multiplied by the number of devices.");
+DEFINE_int32(workers, 1,
+    "Optional; in CPU mode, the number of solver threads to train with data "
+    "parallelism. The effective training batch size is multiplied by the "
+    "number of workers.");
 DEFINE_string(solver, "",
     "The solver definition protocol buffer text file.");
 DEFINE_string(model, "",
@@ -210,6 +214,8 @@ int train() {
   if (gpus.size() == 0) {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
+    CHECK_GE(FLAGS_workers, 1) << "Need at least one worker.";
+    Caffe::set_solver_count(FLAGS_workers);
   } else {
     ostringstream s;
     for (int i = 0; i < gpus.size(); ++i) {
@@ -253,6 +259,10 @@ int train() {
 #else
     LOG(FATAL) << "Multi-GPU execution not available - rebuild with USE_NCCL";
 #endif
+  } else if (gpus.size() == 0 && FLAGS_workers > 1) {
+    caffe::CPUSync<float> sync(solver);
+    sync.Run(FLAGS_workers,
+        FLAGS_snapshot.size() > 0 ? FLAGS_snapshot.c_str() : NULL);
   } else {
     solver->Solve();
   }
@@ -1,16 +1,33 @@
+// This program computes the mean image of a leveldb/lmdb of Datum, and the
+// mean and standard deviation of each of its channels.
+// Usage:
+//   compute_image_mean [FLAGS] INPUT_DB [OUTPUT_FILE]
+//
+// The main thread reads the DB, optionally sampling a fraction of its
+// records, and hands batches of them to --threads workers, which decode
+// them and sum them up on their own. The sums are merged at the end.
+
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
+#include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "boost/random/uniform_real.hpp"
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
+#include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/rng.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
 
@@ -20,6 +37,122 @@ using boost::scoped_ptr;
 
 DEFINE_string(backend, "lmdb",
         "The backend {leveldb, lmdb} containing the images");
+DEFINE_int32(threads, 0,
+    "Number of threads decoding and summing up the images "
+    "(0 to use all cores)");
+DEFINE_double(sample, 1,
+    "Fraction of the images to compute the mean of, picked at random");
+DEFINE_int32(seed, 1701, "Seed of the random sampling of images");
+DEFINE_string(channel_stats, "",
+    "Optional: file to write the mean and standard deviation of each "
+    "channel to, one channel per line");
+
+#ifdef USE_OPENCV
+// Number of DB records handed to a worker at once.
+const int kBatchSize = 64;
+
+// Sums up images on one thread. Bytes are summed up exactly in 32 bits,
+// which vectorizes, and flushed to the double precision sums before they
+// can overflow.
+class MeanAccumulator {
+ public:
+  MeanAccumulator(int channels, int dim)
+      : channels_(channels), dim_(dim), count_(0), pending_(0),
+        sum_(channels * dim, 0), square_sum_(channels, 0),
+        byte_sum_(channels * dim, 0) { }
+
+  void Add(const Datum& datum) {
+    const std::string& data = datum.data();
+    const int size = std::max<int>(data.size(), datum.float_data_size());
+    CHECK_EQ(size, sum_.size()) << "Incorrect data field size " << size;
+    if (data.size() != 0) {
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+      uint32_t* byte_sum = &byte_sum_[0];
+      for (int i = 0; i < size; ++i) {
+        byte_sum[i] += bytes[i];
+      }
+      for (int c = 0; c < channels_; ++c) {
+        const uint8_t* channel = bytes + c * dim_;
+        uint64_t square_sum = 0;
+        for (int i = 0; i < dim_; ++i) {
+          square_sum += static_cast<uint32_t>(channel[i]) * channel[i];
+        }
+        square_sum_[c] += square_sum;
+      }
+      // 255 * kMaxPending fits in 32 bits.
+      if (++pending_ == kMaxPending) {
+        Flush();
+      }
+    } else {
+      for (int c = 0; c < channels_; ++c) {
+        for (int i = c * dim_; i < (c + 1) * dim_; ++i) {
+          const double value = datum.float_data(i);
+          sum_[i] += value;
+          square_sum_[c] += value * value;
+        }
+      }
+    }
+    ++count_;
+  }
+
+  // Adds the images summed up by other to this.
+  void Merge(MeanAccumulator* other) {
+    Flush();
+    other->Flush();
+    for (int i = 0; i < sum_.size(); ++i) {
+      sum_[i] += other->sum_[i];
+    }
+    for (int c = 0; c < channels_; ++c) {
+      square_sum_[c] += other->square_sum_[c];
+    }
+    count_ += other->count_;
+  }
+
+  void Flush() {
+    if (pending_ == 0) {
+      return;
+    }
+    for (int i = 0; i < sum_.size(); ++i) {
+      sum_[i] += byte_sum_[i];
+      byte_sum_[i] = 0;
+    }
+    pending_ = 0;
+  }
+
+  int count() const { return count_; }
+  const std::vector<double>& sum() const { return sum_; }
+  const std::vector<double>& square_sum() const { return square_sum_; }
+
+ private:
+  static const int kMaxPending = 1 << 24;
+
+  const int channels_;
+  const int dim_;
+  int count_;
+  int pending_;
+  std::vector<double> sum_;
+  std::vector<double> square_sum_;
+  std::vector<uint32_t> byte_sum_;
+};
+
+// Decodes and sums up the batches of DB records in slots, whose indices
+// come from full_slots and go back to free_slots, until -1 is popped.
+static void SumImages(std::vector<std::vector<string> >* slots,
+    BlockingQueue<int>* full_slots, BlockingQueue<int>* free_slots,
+    MeanAccumulator* accumulator) {
+  Datum datum;
+  for (int index = full_slots->pop(); index >= 0;
+       index = full_slots->pop()) {
+    std::vector<string>& batch = (*slots)[index];
+    for (int i = 0; i < batch.size(); ++i) {
+      datum.ParseFromString(batch[i]);
+      DecodeDatumNative(&datum);
+      accumulator->Add(datum);
+    }
+    free_slots->push(index);
+  }
+}
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -42,13 +175,13 @@ int main(int argc, char** argv) {
     gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/compute_image_mean");
     return 1;
   }
+  CHECK(FLAGS_sample > 0 && FLAGS_sample <= 1)
+      << "sample must be in (0, 1]";
 
   scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
   db->Open(argv[1], db::READ);
   scoped_ptr<db::Cursor> cursor(db->NewCursor());
 
-  BlobProto sum_blob;
-  int count = 0;
   // load first datum
   Datum datum;
   datum.ParseFromString(cursor->value());
@@ -56,67 +189,101 @@ int main(int argc, char** argv) {
   if (DecodeDatumNative(&datum)) {
     LOG(INFO) << "Decoding Datum";
   }
+  const int channels = datum.channels();
+  const int dim = datum.height() * datum.width();
 
-  sum_blob.set_num(1);
-  sum_blob.set_channels(datum.channels());
-  sum_blob.set_height(datum.height());
-  sum_blob.set_width(datum.width());
-  const int data_size = datum.channels() * datum.height() * datum.width();
-  int size_in_datum = std::max<int>(datum.data().size(),
-                                    datum.float_data_size());
-  for (int i = 0; i < size_in_datum; ++i) {
-    sum_blob.add_data(0.);
+  int threads = FLAGS_threads;
+  if (threads <= 0) {
+    threads = std::max<int>(1, boost::thread::hardware_concurrency());
+  }
+  std::vector<shared_ptr<MeanAccumulator> > accumulators;
+  std::vector<std::vector<string> > slots(4 * threads);
+  BlockingQueue<int> full_slots;
+  BlockingQueue<int> free_slots;
+  for (int i = 0; i < slots.size(); ++i) {
+    free_slots.push(i);
+  }
+  boost::thread_group workers;
+  for (int i = 0; i < threads; ++i) {
+    accumulators.push_back(shared_ptr<MeanAccumulator>(
+        new MeanAccumulator(channels, dim)));
+    workers.create_thread(boost::bind(&SumImages, &slots, &full_slots,
+        &free_slots, accumulators.back().get()));
   }
-  LOG(INFO) << "Starting iteration";
-  while (cursor->valid()) {
-    Datum datum;
-    datum.ParseFromString(cursor->value());
-    DecodeDatumNative(&datum);
 
-    const std::string& data = datum.data();
-    size_in_datum = std::max<int>(datum.data().size(),
-        datum.float_data_size());
-    CHECK_EQ(size_in_datum, data_size) << "Incorrect data field size " <<
-        size_in_datum;
-    if (data.size() != 0) {
-      CHECK_EQ(data.size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) + (uint8_t)data[i]);
+  LOG(INFO) << "Starting iteration with " << threads << " threads";
+  rng_t rng(FLAGS_seed);
+  boost::uniform_real<double> uniform(0, 1);
+  CPUTimer timer;
+  timer.Start();
+  int count = 0;
+  int index = free_slots.pop();
+  slots[index].clear();
+  while (cursor->valid()) {
+    if (FLAGS_sample == 1 || uniform(rng) < FLAGS_sample) {
+      slots[index].push_back(cursor->value());
+      if (slots[index].size() == kBatchSize) {
+        full_slots.push(index);
+        index = free_slots.pop();
+        slots[index].clear();
       }
-    } else {
-      CHECK_EQ(datum.float_data_size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) +
-            static_cast<float>(datum.float_data(i)));
+      ++count;
+      if (count % 10000 == 0) {
+        LOG(INFO) << "Processed " << count << " files.";
       }
     }
-    ++count;
-    if (count % 10000 == 0) {
-      LOG(INFO) << "Processed " << count << " files.";
-    }
     cursor->Next();
   }
+  full_slots.push(index);
+  for (int i = 0; i < threads; ++i) {
+    full_slots.push(-1);
+  }
+  workers.join_all();
+  for (int i = 1; i < threads; ++i) {
+    accumulators[0]->Merge(accumulators[i].get());
+  }
+  const MeanAccumulator& total = *accumulators[0];
+  CHECK_EQ(total.count(), count);
+  CHECK_GT(count, 0) << "No images sampled";
 
   if (count % 10000 != 0) {
     LOG(INFO) << "Processed " << count << " files.";
   }
-  for (int i = 0; i < sum_blob.data_size(); ++i) {
-    sum_blob.set_data(i, sum_blob.data(i) / count);
+  const float seconds = timer.Seconds();
+  LOG(INFO) << "Summed up " << count << " files in " << seconds << " s, "
+      << count / seconds << " files/s.";
+  BlobProto sum_blob;
+  sum_blob.set_num(1);
+  sum_blob.set_channels(datum.channels());
+  sum_blob.set_height(datum.height());
+  sum_blob.set_width(datum.width());
+  for (int i = 0; i < total.sum().size(); ++i) {
+    sum_blob.add_data(total.sum()[i] / count);
   }
   // Write to disk
   if (argc == 3) {
     LOG(INFO) << "Write to " << argv[2];
     WriteProtoToBinaryFile(sum_blob, argv[2]);
   }
-  const int channels = sum_blob.channels();
-  const int dim = sum_blob.height() * sum_blob.width();
-  std::vector<float> mean_values(channels, 0.0);
+  std::ofstream channel_stats;
+  if (FLAGS_channel_stats.size()) {
+    channel_stats.open(FLAGS_channel_stats.c_str());
+    CHECK(channel_stats.good()) << "Failed to open " << FLAGS_channel_stats;
+  }
   LOG(INFO) << "Number of channels: " << channels;
   for (int c = 0; c < channels; ++c) {
+    double channel_sum = 0;
     for (int i = 0; i < dim; ++i) {
-      mean_values[c] += sum_blob.data(dim * c + i);
+      channel_sum += total.sum()[dim * c + i];
+    }
+    const double mean = channel_sum / count / dim;
+    const double variance = total.square_sum()[c] / count / dim - mean * mean;
+    const double stddev = std::sqrt(std::max(variance, 0.));
+    LOG(INFO) << "mean_value channel [" << c << "]: " << mean;
+    LOG(INFO) << "std_value channel [" << c << "]: " << stddev;
+    if (channel_stats.is_open()) {
+      channel_stats << mean << " " << stddev << std::endl;
     }
-    LOG(INFO) << "mean_value channel [" << c << "]: " << mean_values[c] / dim;
   }
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
@@ -7,18 +7,27 @@
 // should be a list of files as well as their labels, in the format as
 //   subfolder1/file1.JPEG 7
 //   ....
+//
+// Images are read by one thread, decoded, resized and encoded by a pool of
+// --threads, and written in the order of LISTFILE, so that the DB does not
+// depend on the number of threads.
 
 #include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
+#include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
+#include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
@@ -42,6 +51,149 @@ DEFINE_bool(encoded, false,
     "When this option is on, the encoded image will be save in datum");
 DEFINE_string(encode_type, "",
     "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_int32(threads, 0,
+    "Number of threads decoding, resizing and encoding images "
+    "(0 to use all cores)");
+DEFINE_int32(readahead, 0,
+    "Number of images read ahead of the writer (0 for 16 per thread)");
+DEFINE_int32(commit_size, 1000, "Number of images per DB transaction");
+
+#ifdef USE_OPENCV
+// Images flow from a reader thread through the converting threads to the
+// writer in slots, which bound the number of images in memory. The writer
+// puts them in the order of the list, whichever thread finishes first.
+struct ImageSlot {
+  int line_id;
+  bool status;
+  Datum datum;
+  string value;
+};
+
+class ImageSetConverter {
+ public:
+  ImageSetConverter(const string& root_folder,
+      const std::vector<std::pair<std::string, int> >& lines, int threads,
+      int readahead)
+      : root_folder_(root_folder), lines_(lines), slots_(readahead),
+        read_seconds_(0), convert_seconds_(threads, 0), next_line_id_(0),
+        current_(-1) {
+    for (int i = 0; i < slots_.size(); ++i) {
+      free_.push(i);
+    }
+    threads_.create_thread(
+        boost::bind(&ImageSetConverter::Read, this, threads));
+    for (int i = 0; i < threads; ++i) {
+      threads_.create_thread(boost::bind(&ImageSetConverter::Convert, this,
+          i));
+    }
+  }
+  ~ImageSetConverter() { threads_.join_all(); }
+
+  // Returns the next image of the list, or NULL once all are written.
+  // Its slot is released by the next call.
+  ImageSlot* Next() {
+    if (current_ >= 0) {
+      free_.push(current_);
+    }
+    current_ = -1;
+    if (next_line_id_ == lines_.size()) {
+      return NULL;
+    }
+    std::map<int, int>::iterator it = pending_.find(next_line_id_);
+    while (it == pending_.end()) {
+      const int slot = converted_.pop();
+      pending_[slots_[slot].line_id] = slot;
+      it = pending_.find(next_line_id_);
+    }
+    current_ = it->second;
+    pending_.erase(it);
+    ++next_line_id_;
+    return &slots_[current_];
+  }
+
+  double read_seconds() const { return read_seconds_; }
+  double convert_seconds() const {
+    double seconds = 0;
+    for (int i = 0; i < convert_seconds_.size(); ++i) {
+      seconds += convert_seconds_[i];
+    }
+    return seconds;
+  }
+
+ protected:
+  void Read(int threads) {
+    CPUTimer timer;
+    for (int line_id = 0; line_id < lines_.size(); ++line_id) {
+      const int index = free_.pop();
+      ImageSlot& slot = slots_[index];
+      timer.Start();
+      slot.line_id = line_id;
+      slot.datum.Clear();
+      slot.status = ReadFileToDatum(root_folder_ + lines_[line_id].first,
+          lines_[line_id].second, &slot.datum);
+      if (!slot.status) {
+        LOG(ERROR) << "Could not open or find file "
+            << root_folder_ + lines_[line_id].first;
+      }
+      read_seconds_ += timer.MicroSeconds() / 1e6;
+      read_.push(index);
+    }
+    for (int i = 0; i < threads; ++i) {
+      read_.push(-1);
+    }
+  }
+
+  void Convert(int thread_id) {
+    const bool is_color = !FLAGS_gray;
+    const int resize_height = std::max<int>(0, FLAGS_resize_height);
+    const int resize_width = std::max<int>(0, FLAGS_resize_width);
+    CPUTimer timer;
+    for (int index = read_.pop(); index >= 0; index = read_.pop()) {
+      ImageSlot& slot = slots_[index];
+      timer.Start();
+      const string& fn = lines_[slot.line_id].first;
+      std::string enc = FLAGS_encode_type;
+      if (FLAGS_encoded && !enc.size()) {
+        // Guess the encoding type from the file name
+        size_t p = fn.rfind('.');
+        if ( p == fn.npos )
+          LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
+        enc = fn.substr(p);
+        std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+      }
+      if (slot.status) {
+        slot.status = DecodeImageToDatum(root_folder_ + fn,
+            lines_[slot.line_id].second, resize_height, resize_width,
+            is_color, enc, &slot.datum);
+      }
+      if (slot.status) {
+        CHECK(slot.datum.SerializeToString(&slot.value));
+      }
+      convert_seconds_[thread_id] += timer.MicroSeconds() / 1e6;
+      converted_.push(index);
+    }
+  }
+
+  const string root_folder_;
+  const std::vector<std::pair<std::string, int> >& lines_;
+  std::vector<ImageSlot> slots_;
+  BlockingQueue<int> free_;
+  BlockingQueue<int> read_;
+  BlockingQueue<int> converted_;
+  boost::thread_group threads_;
+  double read_seconds_;
+  std::vector<double> convert_seconds_;
+  // Accessed by the writer only.
+  std::map<int, int> pending_;
+  int next_line_id_;
+  int current_;
+};
+
+static void LogThroughput(const string& stage, int count, double seconds) {
+  LOG(INFO) << "  " << stage << ": " << count / std::max(seconds, 1e-9)
+      << " images/s per thread, " << seconds << " s busy";
+}
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -66,7 +218,6 @@ int main(int argc, char** argv) {
     return 1;
   }
 
-  const bool is_color = !FLAGS_gray;
   const bool check_size = FLAGS_check_size;
   const bool encoded = FLAGS_encoded;
   const string encode_type = FLAGS_encode_type;
@@ -91,8 +242,14 @@ int main(int argc, char** argv) {
   if (encode_type.size() && !encoded)
     LOG(INFO) << "encode_type specified, assuming encoded=true.";
 
-  int resize_height = std::max<int>(0, FLAGS_resize_height);
-  int resize_width = std::max<int>(0, FLAGS_resize_width);
+  int threads = FLAGS_threads;
+  if (threads <= 0) {
+    threads = std::max<int>(1, boost::thread::hardware_concurrency());
+  }
+  const int readahead = FLAGS_readahead > 0 ? FLAGS_readahead : 16 * threads;
+  CHECK_GT(FLAGS_commit_size, 0);
+  LOG(INFO) << "Converting with " << threads << " threads, reading "
+      << readahead << " images ahead.";
 
   // Create new DB
   scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
@@ -100,29 +257,22 @@ int main(int argc, char** argv) {
   scoped_ptr<db::Transaction> txn(db->NewTransaction());
 
   // Storing to db
-  std::string root_folder(argv[1]);
-  Datum datum;
   int count = 0;
   int data_size = 0;
   bool data_size_initialized = false;
+  double write_seconds = 0;
+  CPUTimer total_timer;
+  CPUTimer log_timer;
+  CPUTimer write_timer;
+  total_timer.Start();
+  log_timer.Start();
 
-  for (int line_id = 0; line_id < lines.size(); ++line_id) {
-    bool status;
-    std::string enc = encode_type;
-    if (encoded && !enc.size()) {
-      // Guess the encoding type from the file name
-      string fn = lines[line_id].first;
-      size_t p = fn.rfind('.');
-      if ( p == fn.npos )
-        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
-      enc = fn.substr(p);
-      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
-    }
-    status = ReadImageToDatum(root_folder + lines[line_id].first,
-        lines[line_id].second, resize_height, resize_width, is_color,
-        enc, &datum);
-    if (status == false) continue;
+  ImageSetConverter converter(argv[1], lines, threads, readahead);
+  for (ImageSlot* slot = converter.Next(); slot; slot = converter.Next()) {
+    if (slot->status == false) continue;
+    write_timer.Start();
     if (check_size) {
+      const Datum& datum = slot->datum;
       if (!data_size_initialized) {
         data_size = datum.channels() * datum.height() * datum.width();
         data_size_initialized = true;
@@ -133,25 +283,36 @@ int main(int argc, char** argv) {
       }
     }
     // sequential
-    string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
+    string key_str = caffe::format_int(slot->line_id, 8) + "_"
+        + lines[slot->line_id].first;
 
     // Put in db
-    string out;
-    CHECK(datum.SerializeToString(&out));
-    txn->Put(key_str, out);
+    txn->Put(key_str, slot->value);
 
-    if (++count % 1000 == 0) {
+    if (++count % FLAGS_commit_size == 0) {
       // Commit db
       txn->Commit();
       txn.reset(db->NewTransaction());
-      LOG(INFO) << "Processed " << count << " files.";
+      LOG(INFO) << "Processed " << count << " files, "
+          << FLAGS_commit_size / log_timer.Seconds() << " files/s.";
+      log_timer.Start();
     }
+    write_seconds += write_timer.MicroSeconds() / 1e6;
   }
   // write the last batch
-  if (count % 1000 != 0) {
+  if (count % FLAGS_commit_size != 0) {
+    write_timer.Start();
     txn->Commit();
+    write_seconds += write_timer.MicroSeconds() / 1e6;
     LOG(INFO) << "Processed " << count << " files.";
   }
+  const float seconds = total_timer.Seconds();
+  LOG(INFO) << "Converted " << count << " files in " << seconds << " s, "
+      << count / seconds << " files/s. Busy time per stage:";
+  LogThroughput("read", lines.size(), converter.read_seconds());
+  LogThroughput("decode/resize/encode", lines.size(),
+      converter.convert_seconds());
+  LogThroughput("write", count, write_seconds);
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
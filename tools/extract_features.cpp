@@ -1,24 +1,203 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
+#include "boost/thread.hpp"
 #include "google/protobuf/text_format.h"
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/net.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
 
 using caffe::Blob;
+using caffe::BlockingQueue;
 using caffe::Caffe;
+using caffe::CPUTimer;
 using caffe::Datum;
 using caffe::Net;
 using std::string;
 namespace db = caffe::db;
 
+// The features of a mini-batch for one feature blob, copied out of the net.
+struct FeatureBatch {
+  int num;
+  int channels;
+  int height;
+  int width;
+  std::vector<float> data;
+};
+
+// The size of the header of the npy files written, which is rewritten with
+// the final shape once all the features are written.
+const int kNpyHeaderSize = 128;
+
+// Writes the features of one blob on a thread of its own, so that the net
+// keeps running forward meanwhile. The batches are passed in slots, which
+// bound the number of batches waiting to be written. The features go to a DB
+// as one Datum per image, serialized in parallel (with OpenMP) and put in
+// order, or with db_type "npy" to a float32 .npy file of shape
+// (images, channels, height, width), written in bulk.
+class FeatureWriter {
+ public:
+  FeatureWriter(const string& db_type, const string& dataset_name,
+      const string& blob_name, int queue_size)
+      : blob_name_(blob_name), npy_(db_type == "npy"), batches_(queue_size),
+        current_(-1), count_(0), channels_(0), height_(0), width_(0),
+        write_seconds_(0) {
+    LOG(INFO)<< "Opening dataset " << dataset_name;
+    if (npy_) {
+      npy_file_.open(dataset_name.c_str(),
+          std::ios::out | std::ios::trunc | std::ios::binary);
+      CHECK(npy_file_.good()) << "Couldn't open " << dataset_name;
+      npy_file_ << string(kNpyHeaderSize, ' ');
+    } else {
+      db_.reset(db::GetDB(db_type));
+      db_->Open(dataset_name, db::NEW);
+    }
+    for (int i = 0; i < batches_.size(); ++i) {
+      free_.push(i);
+    }
+    thread_.reset(new boost::thread(&FeatureWriter::Run, this));
+  }
+
+  // Returns a batch to fill and pass to Write, waiting for one to be free.
+  FeatureBatch* next_batch() {
+    current_ = free_.pop();
+    return &batches_[current_];
+  }
+  void Write() { full_.push(current_); }
+
+  // Writes the remaining batches and closes the output.
+  void Close() {
+    full_.push(-1);
+    thread_->join();
+    if (npy_) {
+      WriteNpyHeader();
+      npy_file_.close();
+      CHECK(npy_file_.good()) << "Couldn't write the features of "
+          << blob_name_;
+    } else {
+      db_->Close();
+    }
+    LOG(ERROR)<< "Extracted features of " << count_ <<
+        " query images for feature blob " << blob_name_ << ", writing "
+        << count_ / std::max(write_seconds_, 1e-9) << " images/s";
+  }
+
+ protected:
+  void Run() {
+    boost::shared_ptr<db::Transaction> txn;
+    if (!npy_) {
+      txn.reset(db_->NewTransaction());
+    }
+    std::vector<string> values;
+    CPUTimer timer;
+    for (int index = full_.pop(); index >= 0; index = full_.pop()) {
+      timer.Start();
+      const FeatureBatch& batch = batches_[index];
+      CHECK_GT(batch.num, 0) << "Empty batch for feature blob " << blob_name_;
+      if (npy_) {
+        if (count_ == 0) {
+          channels_ = batch.channels;
+          height_ = batch.height;
+          width_ = batch.width;
+        }
+        CHECK(batch.channels == channels_ && batch.height == height_ &&
+            batch.width == width_) << "The shape of feature blob "
+            << blob_name_ << " changed, which npy output does not support";
+        npy_file_.write(reinterpret_cast<const char*>(&batch.data[0]),
+            batch.data.size() * sizeof(float));
+        count_ += batch.num;
+      } else {
+        WriteToDB(batch, &values, &txn);
+      }
+      write_seconds_ += timer.MicroSeconds() / 1e6;
+      free_.push(index);
+    }
+    // write the last batch
+    if (!npy_ && count_ % 1000 != 0) {
+      txn->Commit();
+    }
+  }
+
+  void WriteToDB(const FeatureBatch& batch, std::vector<string>* values,
+      boost::shared_ptr<db::Transaction>* txn) {
+    const int dim_features = batch.data.size() / batch.num;
+    values->resize(batch.num);
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int n = 0; n < batch.num; ++n) {
+      Datum datum;
+      datum.set_height(batch.height);
+      datum.set_width(batch.width);
+      datum.set_channels(batch.channels);
+      datum.mutable_float_data()->Resize(dim_features, 0);
+      memcpy(datum.mutable_float_data()->mutable_data(),
+          &batch.data[n * dim_features], dim_features * sizeof(float));
+      CHECK(datum.SerializeToString(&(*values)[n]));
+    }
+    for (int n = 0; n < batch.num; ++n) {
+      string key_str = caffe::format_int(count_, 10);
+      (*txn)->Put(key_str, (*values)[n]);
+      ++count_;
+      if (count_ % 1000 == 0) {
+        (*txn)->Commit();
+        txn->reset(db_->NewTransaction());
+        LOG(ERROR)<< "Extracted features of " << count_ <<
+            " query images for feature blob " << blob_name_;
+      }
+    }
+  }
+
+  // Writes the npy format 1.0 header, padded to kNpyHeaderSize bytes.
+  void WriteNpyHeader() {
+    const uint16_t one = 1;
+    const bool little_endian = *reinterpret_cast<const uint8_t*>(&one) == 1;
+    std::ostringstream dict;
+    dict << "{'descr': '" << (little_endian ? '<' : '>') << "f4', "
+        << "'fortran_order': False, 'shape': (" << count_ << ", "
+        << channels_ << ", " << height_ << ", " << width_ << "), }";
+    const size_t dict_size = kNpyHeaderSize - 10;
+    string header = dict.str();
+    CHECK_LT(header.size(), dict_size);
+    header.resize(dict_size - 1, ' ');
+    header += '\n';
+    const char magic[] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+        static_cast<char>(dict_size & 0xff), static_cast<char>(dict_size >> 8)};
+    npy_file_.seekp(0);
+    npy_file_.write(magic, sizeof(magic));
+    npy_file_.write(header.data(), header.size());
+  }
+
+  const string blob_name_;
+  const bool npy_;
+  boost::shared_ptr<db::DB> db_;
+  std::ofstream npy_file_;
+  std::vector<FeatureBatch> batches_;
+  BlockingQueue<int> free_;
+  BlockingQueue<int> full_;
+  boost::shared_ptr<boost::thread> thread_;
+  int current_;
+  int count_;
+  int channels_;
+  int height_;
+  int width_;
+  double write_seconds_;
+};
+
 template<typename Dtype>
 int feature_extraction_pipeline(int argc, char** argv);
 
@@ -42,7 +221,9 @@ int feature_extraction_pipeline(int argc, char** argv) {
     "Note: you can extract multiple features in one pass by specifying"
     " multiple feature blob names and dataset names separated by ','."
     " The names cannot contain white space characters and the number of blobs"
-    " and datasets must be equal.";
+    " and datasets must be equal.\n"
+    "With db_type npy, each dataset name is a .npy file to write the"
+    " features to as a float32 array.";
     return 1;
   }
   int arg_pos = num_required_args;
@@ -118,64 +299,43 @@ int feature_extraction_pipeline(int argc, char** argv) {
 
   int num_mini_batches = atoi(argv[++arg_pos]);
 
-  std::vector<boost::shared_ptr<db::DB> > feature_dbs;
-  std::vector<boost::shared_ptr<db::Transaction> > txns;
+  // Each writer holds a few batches, so that a slow DB write does not stall
+  // the net right away.
+  const int queue_size = 4;
+  std::vector<boost::shared_ptr<FeatureWriter> > writers;
   const char* db_type = argv[++arg_pos];
   for (size_t i = 0; i < num_features; ++i) {
-    LOG(INFO)<< "Opening dataset " << dataset_names[i];
-    boost::shared_ptr<db::DB> db(db::GetDB(db_type));
-    db->Open(dataset_names.at(i), db::NEW);
-    feature_dbs.push_back(db);
-    boost::shared_ptr<db::Transaction> txn(db->NewTransaction());
-    txns.push_back(txn);
+    writers.push_back(boost::shared_ptr<FeatureWriter>(new FeatureWriter(
+        db_type, dataset_names[i], blob_names[i], queue_size)));
   }
 
   LOG(ERROR)<< "Extracting Features";
 
-  Datum datum;
-  std::vector<int> image_indices(num_features, 0);
+  CPUTimer timer;
+  double forward_seconds = 0;
   for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index) {
+    timer.Start();
     feature_extraction_net->Forward();
+    forward_seconds += timer.MicroSeconds() / 1e6;
     for (int i = 0; i < num_features; ++i) {
       const boost::shared_ptr<Blob<Dtype> > feature_blob =
         feature_extraction_net->blob_by_name(blob_names[i]);
-      int batch_size = feature_blob->num();
-      int dim_features = feature_blob->count() / batch_size;
-      const Dtype* feature_blob_data;
-      for (int n = 0; n < batch_size; ++n) {
-        datum.set_height(feature_blob->height());
-        datum.set_width(feature_blob->width());
-        datum.set_channels(feature_blob->channels());
-        datum.clear_data();
-        datum.clear_float_data();
-        feature_blob_data = feature_blob->cpu_data() +
-            feature_blob->offset(n);
-        for (int d = 0; d < dim_features; ++d) {
-          datum.add_float_data(feature_blob_data[d]);
-        }
-        string key_str = caffe::format_int(image_indices[i], 10);
-
-        string out;
-        CHECK(datum.SerializeToString(&out));
-        txns.at(i)->Put(key_str, out);
-        ++image_indices[i];
-        if (image_indices[i] % 1000 == 0) {
-          txns.at(i)->Commit();
-          txns.at(i).reset(feature_dbs.at(i)->NewTransaction());
-          LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-              " query images for feature blob " << blob_names[i];
-        }
-      }  // for (int n = 0; n < batch_size; ++n)
+      FeatureBatch* batch = writers[i]->next_batch();
+      batch->num = feature_blob->num();
+      batch->channels = feature_blob->channels();
+      batch->height = feature_blob->height();
+      batch->width = feature_blob->width();
+      batch->data.resize(feature_blob->count());
+      std::copy(feature_blob->cpu_data(),
+          feature_blob->cpu_data() + feature_blob->count(),
+          batch->data.begin());
+      writers[i]->Write();
     }  // for (int i = 0; i < num_features; ++i)
   }  // for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index)
-  // write the last batch
+  LOG(ERROR)<< "Forward: " << num_mini_batches / std::max(forward_seconds, 1e-9)
+      << " mini-batches/s";
   for (int i = 0; i < num_features; ++i) {
-    if (image_indices[i] % 1000 != 0) {
-      txns.at(i)->Commit();
-    }
-    LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-        " query images for feature blob " << blob_names[i];
-    feature_dbs.at(i)->Close();
+    writers[i]->Close();
   }
 
   LOG(ERROR)<< "Successfully extracted the features!";
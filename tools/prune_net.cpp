@@ -0,0 +1,156 @@
+// This program removes whole output channels from the convolutions of a
+// trained net, rewriting both the net definition and its weights so that the
+// result is a smaller net that runs with fewer multiply-adds.
+// Usage:
+//   prune_net [FLAGS] MODEL WEIGHTS OUTPUT_MODEL OUTPUT_WEIGHTS
+//
+// where MODEL is a deploy prototxt and WEIGHTS the matching caffemodel. The
+// channels of every (or every listed) Convolution layer with group 1 are
+// ranked, by the magnitude of the Scale (BatchNorm gamma) weights following it
+// when there is one and by the L1 norm of the filters otherwise, and the
+// weakest are removed from the convolution and from every layer they flow
+// through: BatchNorm, Scale, Bias, PReLU, element-wise activations, Dropout,
+// Pooling, Depthwise and group == channels Convolution layers (keeping their
+// multiplier), up to the Convolution or InnerProduct layers consuming them.
+// Convolutions whose outputs reach anything else (e.g. Eltwise or Concat) are
+// left untouched (see caffe/util/channel_pruning.hpp). Fine-tune the pruned
+// net to recover accuracy. Given -test_model, a definition of the net with
+// its test data (e.g. train_val), the outputs of that net (e.g. accuracy) are
+// compared before and after pruning over -iterations batches.
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/channel_pruning.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using std::set;
+
+DEFINE_double(ratio, 0.25,
+    "The fraction of the output channels to remove from each convolution");
+DEFINE_string(layers, "",
+    "Optional: comma-separated names of the convolutions to prune; "
+    "by default all prunable ones are");
+DEFINE_string(criterion, "auto",
+    "How channels are ranked: 'gamma' (Scale weights), 'l1' (filter norms) "
+    "or 'auto' (gamma when there is a Scale layer, l1 otherwise)");
+DEFINE_string(test_model, "",
+    "Optional: another definition of the same net with test data (e.g. "
+    "train_val), whose outputs are compared before and after pruning");
+DEFINE_int32(iterations, 50,
+    "The number of batches -test_model is run for");
+DEFINE_string(test_model_output, "",
+    "Optional: where the pruned -test_model is written, for fine-tuning");
+
+// Runs the TEST phase of a net for -iterations batches and returns the mean
+// of each of its outputs, as caffe test does.
+static vector<float> Evaluate(const NetParameter& param,
+    const NetParameter& weights, vector<string>* names) {
+  NetParameter test_param = param;
+  test_param.mutable_state()->set_phase(TEST);
+  Net<float> net(test_param);
+  net.CopyTrainedLayersFrom(weights);
+  vector<float> scores;
+  names->clear();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    const vector<Blob<float>*>& result = net.Forward();
+    int index = 0;
+    for (int j = 0; j < result.size(); ++j) {
+      const string& name = net.blob_names()[net.output_blob_indices()[j]];
+      for (int k = 0; k < result[j]->count(); ++k, ++index) {
+        if (i == 0) {
+          scores.push_back(0);
+          names->push_back(name);
+        }
+        scores[index] += result[j]->cpu_data()[k] / FLAGS_iterations;
+      }
+    }
+  }
+  return scores;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Remove the weakest output channels of the\n"
+        "convolutions of a trained net.\n"
+        "Usage:\n"
+        "    prune_net [FLAGS] MODEL WEIGHTS OUTPUT_MODEL OUTPUT_WEIGHTS\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 5) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/prune_net");
+    return 1;
+  }
+  CHECK(FLAGS_test_model_output.empty() || !FLAGS_test_model.empty())
+      << "-test_model_output needs -test_model";
+  CHECK_GT(FLAGS_iterations, 0);
+  Caffe::set_mode(Caffe::CPU);
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(argv[1], &net_param);
+  net_param.mutable_state()->set_phase(TEST);
+  Net<float> net(net_param);
+  net.CopyTrainedLayersFrom(argv[2]);
+  const double multiply_adds = MultiplyAdds(net);
+
+  set<string> layers;
+  if (!FLAGS_layers.empty()) {
+    boost::split(layers, FLAGS_layers, boost::is_any_of(","));
+  }
+  PrunedConvolutions convolutions;
+  const int pruned = PruneChannels(&net, FLAGS_ratio, FLAGS_criterion,
+      layers, &convolutions);
+
+  NetParameter pruned_param;
+  ReadNetParamsFromTextFileOrDie(argv[1], &pruned_param);
+  UpdatePrunedConvolutions(convolutions, &pruned_param);
+  NetParameter pruned_weights;
+  PrunedWeightsToProto(net, pruned_param, &pruned_weights);
+
+  // Check that the result loads and runs.
+  NetParameter check_param = pruned_param;
+  check_param.mutable_state()->set_phase(TEST);
+  Net<float> pruned_net(check_param);
+  pruned_net.CopyTrainedLayersFrom(pruned_weights);
+  pruned_net.Forward();
+  LOG(INFO) << "Pruned " << pruned << " convolutions; multiply-adds "
+      << multiply_adds << " -> " << MultiplyAdds(pruned_net);
+
+  WriteProtoToTextFile(pruned_param, argv[3]);
+  WriteProtoToBinaryFile(pruned_weights, argv[4]);
+  if (!FLAGS_test_model.empty()) {
+    NetParameter test_param;
+    ReadNetParamsFromTextFileOrDie(FLAGS_test_model, &test_param);
+    NetParameter weights;
+    ReadNetParamsFromBinaryFileOrDie(argv[2], &weights);
+    vector<string> names;
+    const vector<float> before = Evaluate(test_param, weights, &names);
+    UpdatePrunedConvolutions(convolutions, &test_param);
+    const vector<float> after = Evaluate(test_param, pruned_weights, &names);
+    for (int i = 0; i < names.size(); ++i) {
+      LOG(INFO) << names[i] << " = " << before[i] << " -> " << after[i];
+    }
+    if (!FLAGS_test_model_output.empty()) {
+      WriteProtoToTextFile(test_param, FLAGS_test_model_output);
+    }
+  }
+  return 0;
+}